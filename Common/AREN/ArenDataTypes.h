@@ -5,6 +5,7 @@
 #pragma once
 
 // extract from AREN project.
+#if defined(_MSC_VER)
 typedef __int8 abyte;
 typedef unsigned __int8 aubyte;
 typedef __int16 ashort;
@@ -13,6 +14,18 @@ typedef __int32 aint;
 typedef unsigned __int32 auint;
 typedef __int64 along;
 typedef unsigned __int64 aulong;
+#else
+#include <stddef.h>
+// Same types MSVC maps those to, so overloads and printf formats don't change across compilers.
+typedef char abyte;
+typedef unsigned char aubyte;
+typedef short ashort;
+typedef unsigned short aushort;
+typedef int aint;
+typedef unsigned int auint;
+typedef long long along;
+typedef unsigned long long aulong;
+#endif
 //typedef half ahalf;
 typedef float asingle;
 typedef double adouble;
@@ -9,6 +9,11 @@ has been put in (the better HTON metod). */
 #include "ArenDataTypes.h"
 #include <array>
 
+#if defined(_M_AMD64) || defined _M_IX86 || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define AREN_LITTLE_ENDIAN 1
+#else
+#define AREN_LITTLE_ENDIAN 0
+#endif
 
 template<typename scalar>
 scalar SWAP_BYTES(scalar value) {
@@ -24,7 +29,7 @@ scalar SWAP_BYTES(scalar value) {
 
 template<typename scalar>
 scalar HTON(const scalar v) {
-#if defined(_M_AMD64) || defined _M_IX86
+#if AREN_LITTLE_ENDIAN
 	return SWAP_BYTES(v);
 #else
 #error HTON requires some attention!
@@ -37,7 +42,7 @@ scalar HTOBE(const scalar v) { return HTON(v); }
 
 template<typename scalar>
 scalar HTOLE(const scalar v) {
-#if defined(_M_AMD64) || defined _M_IX86
+#if AREN_LITTLE_ENDIAN
 	return v;
 #else
 #error HTOLE requires some attention!
@@ -47,7 +52,7 @@ scalar HTOLE(const scalar v) {
 
 template<typename scalar>
 scalar LETOH(const scalar v) {
-#if defined(_M_AMD64) || defined _M_IX86
+#if AREN_LITTLE_ENDIAN
 	return v;
 #else
 #error LETOH requires some attention!
@@ -57,7 +62,7 @@ scalar LETOH(const scalar v) {
 
 template<typename scalar>
 scalar BETOH(const scalar v) {
-#if defined(_M_AMD64) || defined _M_IX86
+#if AREN_LITTLE_ENDIAN
 	return SWAP_BYTES(v);
 #else
 #error LETOH requires some attention!
@@ -25,6 +25,7 @@ AbstractWorkSource::Events AbstractWorkSource::Refresh(bool canRead, bool canWri
     }
     Events ret;
 	if(canRead == false) return ret; // sends are still considered nops, as they don't really change the hi-level state
+    recvBuffer.MakeRoom();
     auto received(Receive(recvBuffer.NextBytes(), recvBuffer.Remaining()));
     if(received.first == false) {
         ret.connFailed = true;
@@ -33,34 +34,26 @@ AbstractWorkSource::Events AbstractWorkSource::Refresh(bool canRead, bool canWri
     else if(received.second == 0) return ret;
     ret.bytesReceived += received.second;
 	recvBuffer.used += received.second;
-	if(recvBuffer.Full()) recvBuffer.Grow();
 	
 	using namespace rapidjson;
 	Document object;
-	char *pos = recvBuffer.data.get();
-	char *lastEndl = nullptr;
+	char *const base = recvBuffer.data.get();
+	char *const end = recvBuffer.NextBytes();
+	char *pos = base + recvBuffer.scanned;
+	char *lineStart = base + recvBuffer.begin;
+	bool mangled = false;
     const auto prevDiff(GetCurrentDiff());
     const auto prevJob(stratum->GetCurrentJob());
-	while(pos < recvBuffer.NextBytes()) {
-		char *limit = std::find(pos, recvBuffer.NextBytes(), '\n');
-		if(limit >= recvBuffer.NextBytes()) pos = limit;
-		else {
-            ProcessLine(object, pos, limit - pos);
-            pos = limit;
-            lastEndl = pos++;
-
-        }
+	while(pos < end) {
+		char *limit = static_cast<char*>(memchr(pos, '\n', end - pos));
+		if(!limit) break;
+        ProcessLine(object, lineStart, limit - lineStart);
+        pos = lineStart = limit + 1;
+        mangled = true;
 	}
-	if(lastEndl) { // at least a line has been mangled
-		const char *src = lastEndl + 1;
-		char *dst = recvBuffer.data.get();
-		for(; src < recvBuffer.NextBytes(); src++, dst++) *dst = *src;
-		recvBuffer.used = src - (lastEndl + 1);
-#if _DEBUG
-		for(; dst < recvBuffer.data.get() + recvBuffer.allocated; dst++) *dst = 0;
-#endif
-	}
-	else return ret;
+	recvBuffer.scanned = recvBuffer.used;
+	recvBuffer.Consumed(lineStart - base);
+	if(!mangled) return ret;
     return BuildWU(ret, prevDiff, prevJob);
 }
 
@@ -171,15 +164,28 @@ AbstractWorkSource::AbstractWorkSource(const char *poolName, const CanonicalInfo
 
 
 void AbstractWorkSource::NewStratum(const Credentials &users) {
-    stratum.reset(new StratumState);
+    stratum.reset(new StratumState(previous.id, configureRefused? .0 : suggestedDiff));
     SetStratumCallbacks();
     for(const auto &auth : users) stratum->Authorize(auth.first, auth.second);
+    if(suggestedDiff > .0 && !suggestRefused) stratum->SuggestDifficulty(suggestedDiff);
+}
+
+
+void AbstractWorkSource::DifficultyNegotiated(const char *method, bool supported) {
+    if(supported) return;
+    if(strcmp(method, "mining.configure") == 0) configureRefused = true;
+    else if(strcmp(method, "mining.suggest_difficulty") == 0) suggestRefused = true;
 }
 
 
 void AbstractWorkSource::ClearStratum() {
+    if(stratum && stratum->Subscribed()) {
+        previous.id = stratum->GetSessionID();
+        previous.extraNonceOne = stratum->GetSubscription().extraNonceOne;
+        previous.jobs = stratum->GetValidJobs();
+    }
     stratum.reset();
-    memset(recvBuffer.data.get(), 0, recvBuffer.allocated); // be extra special sure
+    recvBuffer.Clear();
 }
 
 
@@ -240,22 +246,38 @@ std::array<aulong, 4> AbstractWorkSource::MakeTargetBits_NeoScrypt(adouble diff,
 
 
 bool AbstractWorkSource::SendChunk() {
-    if(stratum->pending.empty()) return true;
-    asizei count = 1;
-    while(count && stratum->pending.size()) {
-		StratumState::Blob &msg(stratum->pending.front());
-        auto sent(Send(msg.data.data() + msg.sent, msg.total - msg.sent));
+    /* During share bursts there might be quite some messages here. Sending them one at a time means a syscall each and
+    possibly a segment each as well so they're batched. Only complete messages leave the queue, partial writes
+    are just remembered in the blob and the next batch starts from there. */
+    const asizei MAX_GATHER = 16;
+    auto &pending(stratum->pending);
+    while(pending.size()) {
+        Chunk chunks[MAX_GATHER];
+        asizei count = 0, offered = 0;
+        for(auto msg = pending.cbegin(); msg != pending.cend() && count < MAX_GATHER; ++msg) {
+            chunks[count].data = msg->data.data() + msg->sent;
+            chunks[count].count = msg->total - msg->sent;
+            offered += chunks[count].count;
+            count++;
+        }
+        auto sent(Send(chunks, count));
         if(sent.first == false) return false;
-        count = sent.second;
-        msg.sent += count;
-        if(msg.sent == msg.total) {
+        asizei consumed = sent.second;
+        while(consumed) {
+            StratumState::Blob &msg(pending.front());
+            const asizei take = std::min(consumed, msg.total - msg.sent);
+            msg.sent += take;
+            consumed -= take;
+            if(msg.sent == msg.total) {
 #if STRATUM_DUMPTRAFFIC
-			stratumDump<<">>sent to server:"<<std::endl;
-			for(asizei i = 0; i < msg.total; i++) stratumDump<<msg.data[i];
-			stratumDump<<std::endl;
+			    stratumDump<<">>sent to server:"<<std::endl;
+			    for(asizei i = 0; i < msg.total; i++) stratumDump<<msg.data[i];
+			    stratumDump<<std::endl;
 #endif
-			stratum->pending.pop();
-		}
+			    stratum->PopSent();
+            }
+        }
+        if(sent.second < offered) break; // OS buffers are full, no point in insisting
 	}
     return true;
 }
@@ -269,6 +291,7 @@ void AbstractWorkSource::ProcessLine(rapidjson::Document &json, char *pos, asize
 #endif
 	ScopedFuncCall restoreChar([pos, len]() { pos[len] = '\n'; }); // not really necessary but I like the idea
 	pos[len] = 0;
+	if(HotMessagesSkipMangle() && hotParser.Parse(pos) && MangleHotMessage()) return;
 	json.ParseInsitu(pos);
     using namespace rapidjson;
 	const Value::ConstMemberIterator &id(json.FindMember("id"));
@@ -309,6 +332,33 @@ void AbstractWorkSource::ProcessLine(rapidjson::Document &json, char *pos, asize
 }
 
 
+bool AbstractWorkSource::MangleHotMessage() {
+    using stratum::parsing::HotMessageParser;
+    switch(hotParser.GetKind()) {
+    case HotMessageParser::hm_notify:
+        if(!hotParser.Decode(hotNotify)) return false;
+        stratum->Notify(hotNotify);
+        return true;
+    case HotMessageParser::hm_difficulty: {
+        double diff;
+        if(!hotParser.Decode(diff)) return false;
+        stratum->Notify(stratum::MiningSetDifficultyNotify(diff));
+        return true;
+    }
+    case HotMessageParser::hm_reply: {
+        aulong id;
+        bool accepted;
+        if(!hotParser.GetSubmitReply(id, accepted)) return false;
+        if(strcmp(stratum->Response(asizei(id)), "mining.submit")) return false;
+        ScopedFuncCall clear([this, id]() { stratum->RequestReplyReceived(asizei(id), false); });
+        stratum->Response(asizei(id), stratum::MiningSubmitResponse(accepted));
+        return true;
+    }
+    }
+    return false;
+}
+
+
 AbstractWorkSource::Events AbstractWorkSource::BuildWU(Events &ret, const stratum::WorkDiff &prevDiff, const stratum::MiningNotify &prevJob) const {
     const auto nowDiff(GetCurrentDiff());
     const auto nowJob(stratum->GetCurrentJob());
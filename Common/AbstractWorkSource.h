@@ -10,7 +10,9 @@
 #include <rapidjson/document.h>
 #include "../Common/AREN/ArenDataTypes.h"
 #include "Stratum/Work.h"
+#include "Stratum/hotParsing.h"
 #include "PoolInfo.h"
+#include "LatencyHistogram.h"
 
 
 /*! After more than 1 year in the works, I think it's a good idea to recap what AbstractWorkSources were supposed to be and what they really are.
@@ -61,12 +63,78 @@ public:
     \note Maybe the connection's gone belly up and we'll just consider everything stale. */
     auint IsCurrentJob(const std::string &job) const { return stratum? stratum->GetJobNetworkTime(job) : 0; }
 
+    /*! Same as IsCurrentJob but for the jobs which were current when the last connection went down.
+    Shares found on those can be kept around and sent once reconnected, if the server resumes our session. */
+    auint WasCurrentJob(const std::string &job) const {
+        for(const auto &el : previous.jobs) {
+            if(el.first == job) return el.second;
+        }
+        return 0;
+    }
+
+    /*! When reconnecting, the previous session ID is sent with mining.subscribe. If the server gives us the same extranonce1
+    back everything found for the previous connection is still good: shares can be sent as long as their job is still valid. */
+    enum SessionResume {
+        sr_unknown, //!< not connected or subscription not acknowledged yet
+        sr_resumed,
+        sr_new
+    };
+    SessionResume GetSessionResume() const {
+        if(!stratum || !stratum->Subscribed()) return sr_unknown;
+        if(previous.extraNonceOne.empty()) return sr_new;
+        return stratum->GetSubscription().extraNonceOne == previous.extraNonceOne? sr_resumed : sr_new;
+    }
+
+    bool Notified() const { return stratum && stratum->LastNotifyTimestamp() != 0; } //!< true if the current connection got a job
+
     /*! Blindly send shares. Initially, this filtered the values by "stale" status but it's now just a forwarder, that logic is delegated.
     \return Index of this result in the global stream to the pool. You can use this to reconstruct info from callbacks.
     \note It is assumed this is called only if IsCurrentJob returns true so stratum is assumed to be there. */
-	asizei SendShare(const std::string &job, auint ntime, auint nonce2, auint nonce) {
-		return stratum->SendWork(job, ntime, nonce2, nonce);
+	asizei SendShare(const std::string &job, auint ntime, auint nonce2, auint nonce, bool block = false) {
+		return stratum->SendWork(job, ntime, nonce2, nonce, block);
+	}
+
+	/*! True if the message with this index went out completely on the current connection so the server might have it.
+	A message still queued, or only partially written, never made it there as the server doesn't do anything with half a line.
+	\note Only meaningful before Disconnected: there's no queue to look at after that and nothing is considered written. */
+	bool Written(asizei index) const {
+		if(!stratum) return false;
+		for(const auto &msg : stratum->pending) {
+			if(msg.id == index) return false;
+		}
+		return true;
+	}
+
+	/*! Normally messages go out when the network layer says the socket is writable, at the next tick.
+	Call this to try sending right away, it's nonblocking anyway. Used for block shares, which can't wait.
+	\returns false if the connection failed. */
+	bool Flush() { return stratum == nullptr || stratum->pending.empty() || SendChunk(); }
+
+	//! Queue latencies for the current connection, all zeros if not connected.
+	StratumState::LaneLatency GetSendLatency(StratumState::Lane lane) const {
+		return stratum? stratum->GetSendLatency(lane) : StratumState::LaneLatency();
+	}
+
+	/*! Difficulty negotiation. Pools default to a difficulty they consider good for whoever connects and it's often way too low for fast algorithms,
+	resulting in hundreds of shares per minute. Who decides which difficulty is better is outer code, this only deals with the protocol.
+	The value is remembered across connections: on the next one it goes with mining.configure (if the server didn't refuse it before)
+	and with mining.suggest_difficulty right after authorization.
+	\returns false if the server told us it does not support suggestions, nothing is sent then. */
+	bool SuggestDifficulty(double diff) {
+		suggestedDiff = diff;
+		if(suggestRefused) return false;
+		if(stratum) stratum->SuggestDifficulty(diff);
+		return true;
 	}
+	double GetSuggestedDiff() const { return suggestedDiff; } //!< 0 if nothing suggested yet
+	bool SuggestionsRefused() const { return suggestRefused; }
+
+	/*! How long the pool takes to reply and how often it sends jobs. Unlike the stratum state those are kept across connections:
+	they're about the pool, not the connection and a pool dropping connections is likely to have something to show there. */
+	struct Timings {
+		LatencyHistogram submitRoundTrip, requestRoundTrip, notifyInterval;
+	};
+	const Timings& GetTimings() const { return timings; }
 
     /*! The usage pattern involves calling this only if Refresh returns Events::newWork = true, which happens only if a valid stratum object exists.
     Just polling at random will cause miners to reboot nonce count which will give you rejects.
@@ -97,12 +165,23 @@ protected:
 	so I cannot tell the difference anymore. To be called with non-null signature. */
 	virtual void MangleMessageFromServer(const std::string &idstr, const char *signature, const rapidjson::Value &notification) = 0;
 
+	/*! Notifies, difficulty changes and submit replies can skip the DOM, see MangleHotMessage. Those then go straight to the stratum state
+	and the two Mangle calls above are never called for them. This is only correct if they would do exactly that, so it's opt-in:
+	return true only if your Mangle calls give those messages to the stratum state as they are. */
+	virtual bool HotMessagesSkipMangle() const { return false; }
+
 	/*! Sending and receiving data is left to a derived class. This call tries to send stratum blobs guaranteed to always be at least 1 byte.
 	The send must be implemented in a non-blocking way, if no bytes can be sent right away, it can return 0
 	as the number of bytes sent (it is not considered an error). In practice, if an error occurs, .first of returned value will be false.
     Sending and receiving data is a fairly rare occurance so take the chance to run some validation on the socket.
+	Queued messages are sent together: each chunk is (the remaining part of) a message and they are to be sent in order as a single stream,
+	ideally with a single call to the OS. The number of bytes sent can span across chunks.
     \note This is called only when Refresh(canRead=true, x), which implies the socket is valid when this is called. */
-	virtual std::pair<bool, asizei> Send(const abyte *data, const asizei count) throw() = 0;
+	struct Chunk {
+		const abyte *data;
+		asizei count;
+	};
+	virtual std::pair<bool, asizei> Send(const Chunk *chunks, const asizei count) throw() = 0;
 
 	/*! \sa Send
     \note This is called only when Refresh(x, canWrite=true) */
@@ -122,30 +201,63 @@ protected:
     //! Implementations will return as_off as authorization status. Non-eligibility is assumed.
 	virtual void GetCredentials(std::vector< std::pair<const char*, StratumState::AuthStatus> > &list) const = 0;
 
+	/*! Derived classes call this when a reply to mining.configure or mining.suggest_difficulty is received, in place of the usual parsing.
+	Those are optional and servers not supporting them might reply with errors, this just remembers not to send them again. */
+	void DifficultyNegotiated(const char *method, bool supported);
+
 private:
 	/*! Data received by calling Receive(...) is stored here. Then, a pass searches for
-	newline messages and dispatches them to parsers. */
+	newline messages and dispatches them to parsers.
+	It's a fixed-capacity window over a single allocation so a pool bursting long notifies (lots of merkles) at you
+	costs linear time: [begin, used) holds the bytes not consumed yet,
+	[begin, scanned) is known to contain no newline so we don't search the same partial line again and again.
+	Lines are parsed in place. Leftovers are moved (once, memmove) only when the tail is full and there's room at the head.
+	Memory grows only if a single line doesn't fit in the whole buffer, which is really an exceptional thing. */
 	struct RecvBuffer {
 		std::unique_ptr<char[]> data;
 		asizei allocated;
+		asizei begin;
+		asizei scanned;
 		asizei used;
 		char* NextBytes() const { return data.get() + used; }
 		asizei Remaining() const { return allocated - used; }
 		bool Full() const { return used == allocated; }
-		void Grow() {
-			char *bigger = new char[allocated + 2048];
-			memcpy_s(bigger, allocated + 2048, data.get(), used);
-			data.reset(bigger);
-			allocated += 2048;
+		asizei Pending() const { return used - begin; }
+		//! Make sure there's at least a byte to Receive into.
+		void MakeRoom() {
+			if(!Full()) return;
+			if(begin) {
+				memmove(data.get(), data.get() + begin, used - begin);
+				scanned -= begin;
+				used -= begin;
+				begin = 0;
+				return;
+			}
+			const asizei bigger = allocated * 2;
+			std::unique_ptr<char[]> larger(new char[bigger]);
+			memcpy_s(larger.get(), bigger, data.get(), used);
+			data = std::move(larger);
+			allocated = bigger;
+		}
+		//! Called after the last complete line has been consumed. Going back to the start when empty is free and keeps MakeRoom a rare thing.
+		void Consumed(asizei until) {
+			begin = until;
+			if(begin == used) begin = scanned = used = 0;
+			else if(scanned < begin) scanned = begin;
+		}
+		void Clear() {
+			begin = scanned = used = 0;
+			memset(data.get(), 0, allocated); // be extra special sure
 		}
-		RecvBuffer() : used(0), data(new char[4096]), allocated(4096)  {
+		RecvBuffer() : begin(0), scanned(0), used(0), data(new char[INITIAL_SIZE]), allocated(INITIAL_SIZE)  {
 			#if _DEBUG
-				memset(data.get(), 0, 4096);
+				memset(data.get(), 0, INITIAL_SIZE);
 			#endif
 		}
 		// question is: why not to just use a std::vector, which has a data() call anyway?
 		// Because I really want to be sure of the allocation/deallocation semantics.
 		// Is  it worth it? Probably not.
+		static const asizei INITIAL_SIZE = 16 * 1024; // a notify with a dozen merkles is about 1.5 KiB
 	} recvBuffer;
 	// Iterating on nonces is fully miner's responsability now. We only tell it if it can go on or not.
 	//auint nonce2;
@@ -215,10 +327,34 @@ private:
         stratum->workerAuthCallback = [this](const std::string &worker, StratumState::AuthStatus status) {
             if(this->workerAuthCallback) this->workerAuthCallback(*this, worker, status);
         };
+        stratum->timingCallback = [this](StratumState::Timing kind, std::chrono::microseconds elapsed) {
+            LatencyHistogram *dst = &timings.notifyInterval;
+            if(kind == StratumState::st_submitRoundTrip) dst = &timings.submitRoundTrip;
+            else if(kind == StratumState::st_requestRoundTrip) dst = &timings.requestRoundTrip;
+            dst->Add(elapsed.count() / 1000.0);
+        };
     }
+    Timings timings;
 
     bool SendChunk();
     void ProcessLine(rapidjson::Document &parser, char *pos, asizei len);
 
+    /*! Most lines are notifies, difficulty changes and share replies. Those are not worth a DOM, they go through this first
+    and are dispatched directly to the stratum state, if HotMessagesSkipMangle allows. Both persist across lines so their buffers get reused.
+    \returns false if the line was not processed and must go through the usual virtual Mangle calls. */
+    bool MangleHotMessage();
+    stratum::parsing::HotMessageParser hotParser;
+    stratum::MiningNotify hotNotify;
+
+    //! Saved by ClearStratum.
+    struct PreviousSession {
+        std::string id;
+        std::vector<unsigned __int8> extraNonceOne;
+        std::vector<std::pair<std::string, auint>> jobs;
+    } previous;
+
+    double suggestedDiff = .0;
+    bool configureRefused = false, suggestRefused = false; //!< they're extensions, not all servers support them
+
     Events BuildWU(Events &ret, const stratum::WorkDiff &prevDiff, const stratum::MiningNotify &prevJob) const;
 };
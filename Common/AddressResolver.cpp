@@ -0,0 +1,161 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#include "AddressResolver.h"
+#include "AREN/ScopedFuncCall.h"
+#include <string.h>
+
+
+AddressResolver::AddressResolver(ResolveFunc resolve)
+	: positiveTTL(std::chrono::minutes(5)), negativeTTL(std::chrono::seconds(30)), maxThreads(4), state(std::make_shared<Shared>(resolve)) {
+}
+
+
+AddressResolver::~AddressResolver() {
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->quit = true;
+	state->queue.clear();
+	state->wakeup.notify_all();
+}
+
+
+auto AddressResolver::Lookup(std::vector<Address> &dst, const std::string &host, const std::string &port) -> Status {
+	std::unique_lock<std::mutex> lock(state->mutex);
+	const Key key(host, port);
+	auto match(state->cache.find(key));
+	if(match != state->cache.end()) {
+		Entry &entry(match->second);
+		if(entry.status == rs_pending) return rs_pending;
+		const auto age(Clock::now() - entry.when);
+		bool expired = age >= (entry.status == rs_failed? negativeTTL : (entry.ttl.count() >= 0? entry.ttl : positiveTTL));
+		// Addresses which stopped working might have moved: ask again, but not more often than failures are remembered.
+		if(entry.status == rs_resolved && age >= negativeTTL && Failing(entry.addresses)) expired = true;
+		if(!expired) {
+			if(entry.status == rs_resolved) dst = entry.addresses;
+			return entry.status;
+		}
+		entry.status = rs_pending; // expired, resolve again
+	}
+	else state->cache.insert(std::make_pair(key, Entry()));
+	state->queue.push_back(key);
+	// Threads are only launched when needed, on Windows they have to come after WSAStartup.
+	if(state->idle < state->queue.size() && state->threads < maxThreads) {
+		std::thread worker(Resolve, state);
+		worker.detach();
+		state->threads++;
+	}
+	state->wakeup.notify_one();
+	return rs_pending;
+}
+
+
+void AddressResolver::Resolve(std::shared_ptr<Shared> state) {
+	std::unique_lock<std::mutex> lock(state->mutex);
+	while(true) {
+		state->idle++;
+		state->wakeup.wait(lock, [&state]() { return state->quit || state->queue.empty() == false; });
+		state->idle--;
+		if(state->quit) return;
+		const Key key(state->queue.front());
+		state->queue.pop_front();
+		lock.unlock();
+
+		Answer got(state->resolve(key.first, key.second));
+		Entry answer;
+		answer.status = got.addresses.empty()? rs_failed : rs_resolved;
+		answer.addresses = std::move(got.addresses);
+		answer.ttl = got.ttl;
+		answer.when = Clock::now();
+
+		lock.lock();
+		if(state->quit) return;
+		state->cache[key] = std::move(answer);
+		state->generation++;
+	}
+}
+
+
+auto AddressResolver::SystemResolve(const std::string &host, const std::string &port) -> Answer {
+	addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+	addrinfo *result = nullptr;
+	Answer ret;
+	if(getaddrinfo(host.c_str(), port.c_str(), &hints, &result)) return ret;
+	ScopedFuncCall blast([result]() { freeaddrinfo(result); });
+	for(addrinfo *check = result; check; check = check->ai_next) {
+		if(check->ai_addrlen > sizeof(Address::address)) continue;
+		Address add;
+		memset(&add, 0, sizeof(add));
+		add.family = check->ai_family;
+		add.socktype = check->ai_socktype;
+		add.protocol = check->ai_protocol;
+		memcpy(&add.address, check->ai_addr, check->ai_addrlen);
+		add.length = check->ai_addrlen;
+		ret.addresses.push_back(add);
+	}
+	return ret;
+}
+
+
+bool AddressResolver::Failing(const std::vector<Address> &addresses) const {
+	for(const auto &el : addresses) {
+		auto stats(latency.find(AddressKey(el)));
+		if(stats == latency.cend() || stats->second.failures == 0) return false;
+	}
+	return addresses.size() != 0;
+}
+
+
+void AddressResolver::Order(std::vector<Address> &addresses) const {
+	std::vector<std::pair<const Address*, const Latency*>> known, fresh, failed;
+	for(const auto &el : addresses) {
+		auto stats(latency.find(AddressKey(el)));
+		if(stats == latency.cend()) fresh.push_back(std::make_pair(&el, nullptr));
+		else if(stats->second.failures) failed.push_back(std::make_pair(&el, &stats->second));
+		else known.push_back(std::make_pair(&el, &stats->second));
+	}
+	std::stable_sort(known.begin(), known.end(), [](const std::pair<const Address*, const Latency*> &a, const std::pair<const Address*, const Latency*> &b) {
+		return a.second->average < b.second->average;
+	});
+	std::stable_sort(failed.begin(), failed.end(), [](const std::pair<const Address*, const Latency*> &a, const std::pair<const Address*, const Latency*> &b) {
+		return a.second->failures < b.second->failures;
+	});
+	std::vector<Address> sorted;
+	sorted.reserve(addresses.size());
+	for(const auto &el : known) sorted.push_back(*el.first);
+	// Interleave families keeping the order the resolver gave within each family, starting with the first one it gave.
+	std::vector<bool> used(fresh.size(), false);
+	int family = fresh.size()? fresh[0].first->family : AF_UNSPEC;
+	for(asizei taken = 0; taken < fresh.size(); taken++) {
+		asizei pick = fresh.size();
+		for(asizei search = 0; search < fresh.size(); search++) {
+			if(used[search]) continue;
+			if(pick == fresh.size()) pick = search; // if the wanted family is over, take whatever comes first
+			if(fresh[search].first->family == family) {
+				pick = search;
+				break;
+			}
+		}
+		used[pick] = true;
+		sorted.push_back(*fresh[pick].first);
+		family = fresh[pick].first->family == AF_INET? AF_INET6 : AF_INET;
+	}
+	for(const auto &el : failed) sorted.push_back(*el.first);
+	addresses = std::move(sorted);
+}
+
+
+void AddressResolver::ConnectResult(const Address &address, bool success, std::chrono::milliseconds time) {
+	Latency &stats(latency[AddressKey(address)]);
+	if(!success) {
+		stats.failures++;
+		return;
+	}
+	stats.failures = 0;
+	const double ms = double(time.count());
+	stats.average = stats.average < .0? ms : stats.average * .75 + ms * .25;
+}
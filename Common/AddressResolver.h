@@ -0,0 +1,128 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+#include "AREN/ArenDataTypes.h"
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+
+#if defined(_WIN32)
+#include <WinSock2.h>
+#include <WS2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <netdb.h>
+#endif
+
+
+/*! getaddrinfo blocks. It's usually fast but when a DNS server is slow it takes everything down with it: since it used to be called
+by BeginConnection on the main thread, all the other pools, share submission and the web monitor were stalled for the duration.
+This object moves resolution to threads of its own and remembers the results so reconnecting to a pool doesn't need to resolve again.
+Failures are remembered as well (for less time), there's no point in hammering a server which just told us the name does not exist.
+Names are resolved by a few threads so a DNS server sitting on one name does not hold up the others.
+The answers are kept as long as their record TTL says but getaddrinfo does not tell it, so what it gives is kept for positiveTTL.
+That's fine for us: the OS resolver caches by record TTL on its own, we only reuse answers to reconnect and an answer whose addresses
+all failed to connect is not reused past negativeTTL, see Lookup. So a pool moving to a new address costs a failed attempt, not positiveTTL.
+The network objects poll this: Lookup never blocks. */
+class AddressResolver {
+public:
+	struct Address {
+		int family, socktype, protocol;
+		sockaddr_storage address;
+		asizei length;
+	};
+	enum Status {
+		rs_pending,
+		rs_resolved,
+		rs_failed
+	};
+	struct Answer {
+		std::vector<Address> addresses; //!< empty if the name could not be resolved
+		std::chrono::seconds ttl; //!< of the record, negative if not known. Then positiveTTL is used.
+		Answer() : ttl(-1) { }
+	};
+	//! Blocking resolution of a (host, port/service) pair. Called by the resolving threads, must be thread safe.
+	typedef std::function<Answer(const std::string &host, const std::string &port)> ResolveFunc;
+
+	/*! Networks waiting for a resolution to complete don't sleep more than this.
+	Answers are polled: there's no way to wake up a select or epoll from another thread there. */
+	static const asizei pollMilliseconds;
+
+	std::chrono::seconds positiveTTL; //!< how long a successful resolution is reused
+	std::chrono::seconds negativeTTL; //!< how long a failure is returned without trying again
+	asizei maxThreads; //!< names being resolved at the same time, the others wait
+
+	//! \param resolve the default is SystemResolve, the tests give a stub.
+	explicit AddressResolver(ResolveFunc resolve = SystemResolve);
+	~AddressResolver();
+
+	/*! Never blocks. If the name is known and not expired, dst is filled and rs_resolved is returned. If it is known to fail,
+	rs_failed is returned. Otherwise resolution is started (if not already in flight) and the result is rs_pending: call again later.
+	An answer is expired when its TTL is over, or when every address in it failed its last connection attempt and it's older than negativeTTL. */
+	Status Lookup(std::vector<Address> &dst, const std::string &host, const std::string &port);
+
+	//! Incremented each time an answer arrives. Saves going through all the pending connections when nothing changed.
+	asizei GetGeneration() const { return state->generation.load(); }
+
+	/*! Sorts addresses in the order they should be tried. Addresses which connected before go first, fastest first.
+	Addresses nobody tried yet come next, alternating families so a broken IPv6 (or IPv4) route costs at most a stagger.
+	Addresses which failed last time go last. This is main thread stuff, the resolving thread knows nothing about it. */
+	void Order(std::vector<Address> &addresses) const;
+
+	//! Networks call this when a connection attempt completes (the winner) or fails. Losers being cancelled are not reported.
+	void ConnectResult(const Address &address, bool success, std::chrono::milliseconds latency);
+
+	//! getaddrinfo, TCP only. It does not tell the TTL. Not called GetAddrInfo, that is a macro in WS2tcpip.h.
+	static Answer SystemResolve(const std::string &host, const std::string &port);
+
+private:
+	typedef std::chrono::steady_clock Clock;
+	typedef std::pair<std::string, std::string> Key; //!< host, port/service
+
+	struct Entry {
+		Status status;
+		std::vector<Address> addresses;
+		Clock::time_point when; //!< when the answer arrived, TTLs are applied at lookup
+		std::chrono::seconds ttl; //!< negative if the answer did not tell
+		Entry() : status(rs_pending), ttl(-1) { }
+	};
+
+	/*! The resolving threads could be stuck in getaddrinfo for a long time, I don't want to wait for them on shutdown.
+	So they are detached and everything they touch is shared with them: it goes away when the last one is done with it. */
+	struct Shared {
+		std::mutex mutex;
+		std::condition_variable wakeup;
+		std::map<Key, Entry> cache;
+		std::deque<Key> queue;
+		bool quit;
+		std::atomic<asizei> generation;
+		asizei threads, idle; //!< resolving threads running and those of them waiting for something to do
+		const ResolveFunc resolve;
+		explicit Shared(ResolveFunc resolver) : quit(false), generation(0), threads(0), idle(0), resolve(resolver) { }
+	};
+	std::shared_ptr<Shared> state;
+
+	struct Latency {
+		double average; //!< milliseconds, moving average of successful connections
+		auint failures; //!< consecutive
+		Latency() : average(-1.0), failures(0) { }
+	};
+	std::map<std::string, Latency> latency; //!< keyed by raw sockaddr bytes
+	static std::string AddressKey(const Address &address) {
+		return std::string(reinterpret_cast<const char*>(&address.address), address.length);
+	}
+	bool Failing(const std::vector<Address> &addresses) const; //!< true if all of them failed their last attempt
+
+	static void Resolve(std::shared_ptr<Shared> state);
+};
@@ -85,7 +85,7 @@ void FlipBytesIFBE(aubyte *begin, aubyte *end);
 
 template<asizei BYTES>
 void CopyFlippingBytesTOLE(aubyte *dst, const aubyte *src) {
-#if defined(_M_AMD64) || defined _M_IX86
+#if defined(_M_AMD64) || defined _M_IX86 || defined __x86_64__ || defined __i386__
 	src += BYTES - 1;
 	for(asizei loop = 0; loop < BYTES; loop++) {
 		*dst = *src;
@@ -0,0 +1,164 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#include "ChildProcess.h"
+#include <exception>
+#include <stdexcept>
+#include <string.h>
+
+#if !defined(_WIN32)
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+#include <limits.h>
+#if defined(__linux__)
+#include <sys/prctl.h>
+#endif
+#endif
+
+
+#if defined(_WIN32)
+
+static std::wstring Widen(const std::string &utf8) {
+	if(utf8.empty()) return std::wstring();
+	const int count = MultiByteToWideChar(CP_UTF8, 0, utf8.c_str(), int(utf8.length()), NULL, 0);
+	std::wstring ret(count, 0);
+	MultiByteToWideChar(CP_UTF8, 0, utf8.c_str(), int(utf8.length()), &ret[0], count);
+	return ret;
+}
+
+
+//! CommandLineToArgvW rules: quotes around everything, backslashes are literal unless they precede a quote.
+static void AppendQuoted(std::wstring &dst, const std::wstring &arg) {
+	dst += L'"';
+	asizei slashes = 0;
+	for(auto c : arg) {
+		if(c == L'\\') slashes++;
+		else {
+			if(c == L'"') dst.append(slashes + 1, L'\\');
+			slashes = 0;
+		}
+		dst += c;
+	}
+	dst.append(slashes, L'\\');
+	dst += L'"';
+}
+
+
+ChildProcess::ChildProcess(const std::string &program, const std::vector<std::string> &args) {
+	const std::wstring exe(Widen(program));
+	std::wstring cmdLine;
+	AppendQuoted(cmdLine, exe);
+	for(const auto &el : args) {
+		cmdLine += L' ';
+		AppendQuoted(cmdLine, Widen(el));
+	}
+	STARTUPINFOW startup;
+	memset(&startup, 0, sizeof(startup));
+	startup.cb = sizeof(startup);
+	PROCESS_INFORMATION info;
+	if(!CreateProcessW(exe.c_str(), &cmdLine[0], NULL, NULL, FALSE, CREATE_NO_WINDOW, NULL, NULL, &startup, &info)) {
+		throw std::exception("Could not start child process.");
+	}
+	CloseHandle(info.hThread);
+	process = info.hProcess;
+}
+
+
+ChildProcess::~ChildProcess() {
+	Kill();
+	CloseHandle(process);
+}
+
+
+bool ChildProcess::Running() {
+	if(exited) return false;
+	if(WaitForSingleObject(process, 0) != WAIT_OBJECT_0) return true;
+	DWORD code = 0;
+	GetExitCodeProcess(process, &code);
+	exitCode = int(code);
+	exited = true;
+	return false;
+}
+
+
+void ChildProcess::Kill() {
+	if(!Running()) return;
+	TerminateProcess(process, DWORD(-1));
+	WaitForSingleObject(process, INFINITE);
+	Running();
+}
+
+
+std::string ChildProcess::GetOwnExecutable() {
+	std::vector<wchar_t> path(MAX_PATH);
+	while(true) {
+		const DWORD len = GetModuleFileNameW(NULL, path.data(), DWORD(path.size()));
+		if(!len) return std::string();
+		if(len < path.size()) {
+			const int count = WideCharToMultiByte(CP_UTF8, 0, path.data(), int(len), NULL, 0, NULL, NULL);
+			std::string ret(count, 0);
+			WideCharToMultiByte(CP_UTF8, 0, path.data(), int(len), &ret[0], count, NULL, NULL);
+			return ret;
+		}
+		path.resize(path.size() * 2);
+	}
+}
+
+#else
+
+ChildProcess::ChildProcess(const std::string &program, const std::vector<std::string> &args) {
+	// Everything is built before forking: between fork and exec we can only call async-signal-safe functions.
+	std::vector<char*> argv;
+	argv.push_back(const_cast<char*>(program.c_str()));
+	for(const auto &el : args) argv.push_back(const_cast<char*>(el.c_str()));
+	argv.push_back(nullptr);
+#if defined(__linux__)
+	const pid_t parent = getpid();
+#endif
+	pid = fork();
+	if(pid < 0) throw std::runtime_error("Could not start child process.");
+	if(pid == 0) {
+#if defined(__linux__)
+		prctl(PR_SET_PDEATHSIG, SIGKILL); // strictly, when the forking thread goes away: it's the one owning this object anyway
+		if(getppid() != parent) _exit(127); // parent died before prctl
+#endif
+		execv(program.c_str(), argv.data());
+		_exit(127);
+	}
+}
+
+
+ChildProcess::~ChildProcess() { Kill(); }
+
+
+bool ChildProcess::Running() {
+	if(exited) return false;
+	int status = 0;
+	const pid_t got = waitpid(pid, &status, WNOHANG);
+	if(got == 0) return true;
+	if(got == pid) exitCode = WIFEXITED(status)? WEXITSTATUS(status) : WIFSIGNALED(status)? -WTERMSIG(status) : -1;
+	else exitCode = -1; // somebody else reaped it? Nothing to wait for anyway.
+	exited = true;
+	return false;
+}
+
+
+void ChildProcess::Kill() {
+	if(!Running()) return;
+	kill(pid, SIGKILL);
+	int status = 0;
+	if(waitpid(pid, &status, 0) == pid) exitCode = WIFEXITED(status)? WEXITSTATUS(status) : WIFSIGNALED(status)? -WTERMSIG(status) : -1;
+	exited = true;
+}
+
+
+std::string ChildProcess::GetOwnExecutable() {
+	char path[PATH_MAX];
+	const ssize_t len = readlink("/proc/self/exe", path, sizeof(path) - 1);
+	if(len <= 0) return std::string();
+	return std::string(path, asizei(len));
+}
+
+#endif
@@ -0,0 +1,48 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+#include "AREN/ArenDataTypes.h"
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <sys/types.h>
+#endif
+
+
+/*! A process we started and we're responsible for. It's killed when this object goes away so the owner must ask it nicely to quit
+before, if it cares. There's nothing else, no pipes, no redirection: talking to it is done by other means (see SharedMemory).
+On Linux the child is also killed by the kernel if we die first; Windows does not have that so the child has to look after itself. */
+class ChildProcess {
+public:
+	//! Starts it or throws std::exception. Arguments are passed as they are, no need to quote them.
+	ChildProcess(const std::string &program, const std::vector<std::string> &args);
+	~ChildProcess();
+	ChildProcess(const ChildProcess&) = delete;
+	ChildProcess& operator=(const ChildProcess&) = delete;
+
+	//! Does not block. Once this returns false, it will always return false and GetExitCode is meaningful.
+	bool Running();
+
+	//! Exit code of the process. On Linux processes killed by a signal have the negated signal number instead.
+	int GetExitCode() const { return exitCode; }
+
+	//! Forcibly terminates the process and waits for it to be gone. Nothing happens if it's gone already.
+	void Kill();
+
+	//! Full path of the program running the calling process, to start another instance of ourselves. Empty if the OS won't tell.
+	static std::string GetOwnExecutable();
+
+private:
+	bool exited = false;
+	int exitCode = 0;
+#if defined(_WIN32)
+	HANDLE process = NULL;
+#else
+	pid_t pid = -1;
+#endif
+};
@@ -0,0 +1,75 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+#include "AREN/ArenDataTypes.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+
+/*! Threads doing OpenCL might get stuck in the driver, to never return. They cannot be killed so they're detached and what they use
+is owned by somebody else: a "slot", anything having std::atomic<bool> exited and abandoned plus a bool stuck.
+- A thread sets exited as the very last thing it does to its slot (see Leaving), from then the owner can free it.
+- The owner sets abandoned to tell a thread to go away without touching anything else, and stuck if it's not expecting it to.
+- When the owner goes away, see Dismiss, it waits for the threads it's not given up on. Slots of threads still there are leaked rather
+  than freed under their feet: if they ever come back from the driver, they will use them. */
+namespace detached {
+
+//! Number of threads gone. Shared by the owner and the threads so it's there as long as somebody might touch it.
+typedef std::shared_ptr<std::atomic<auint>> ExitCounter;
+inline ExitCounter NewExitCounter() { return std::make_shared<std::atomic<auint>>(0); }
+
+
+/*! The first thing a detached thread builds, so it's the last to go on every way out, returning early or throwing.
+After exited is set the slot might be gone already so only the counter is touched after, and that's ours as well. */
+class Leaving {
+public:
+	Leaving(std::atomic<bool> &exited, ExitCounter counter) : exited(exited), counter(std::move(counter)) { }
+	~Leaving() {
+		exited.store(true, std::memory_order_release);
+		(*counter)++;
+	}
+	Leaving(const Leaving&) = delete;
+	Leaving& operator=(const Leaving&) = delete;
+
+private:
+	std::atomic<bool> &exited;
+	const ExitCounter counter;
+};
+
+
+/*! Owner side, when going away after asking the threads to quit. Waits at most patience for the spawned threads to leave, not counting
+those stuck, then abandons and leaks the slots of the threads still there. Slots in both vectors can be null or without a thread
+(exited set from the start). \returns number of slots leaked. */
+template<typename Slot>
+asizei Dismiss(std::vector<std::unique_ptr<Slot>> &current, std::vector<std::unique_ptr<Slot>> &retired, asizei spawned,
+               const ExitCounter &exits, std::chrono::milliseconds patience) {
+	using namespace std::chrono;
+	const auto limit(steady_clock::now() + patience);
+	auto stuck = [](const std::unique_ptr<Slot> &test) { return test && test->stuck && !test->exited.load(std::memory_order_acquire); };
+	// The counter goes first: a thread leaving between the two reads is counted by neither, that only makes us wait a bit more.
+	auto running = [&]() {
+		const asizei exited = exits->load();
+		const asizei given = std::count_if(current.cbegin(), current.cend(), stuck) + std::count_if(retired.cbegin(), retired.cend(), stuck);
+		return exited + given < spawned;
+	};
+	while(running() && steady_clock::now() < limit) std::this_thread::sleep_for(milliseconds(20));
+	asizei leaked = 0;
+	auto leak = [&leaked](std::unique_ptr<Slot> &test) {
+		if(!test || test->exited.load(std::memory_order_acquire)) return;
+		test->abandoned.store(true, std::memory_order_release);
+		test.release();
+		leaked++;
+	};
+	for(auto &el : current) leak(el);
+	for(auto &el : retired) leak(el);
+	return leaked;
+}
+
+
+}
@@ -0,0 +1,74 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+#include "AREN/ArenDataTypes.h"
+#include <array>
+#include <algorithm>
+
+
+/*! Averages hide what matters about network latency: a pool answering in 40ms most of the time and in 4s every now and then looks just
+like a pool always answering in 80ms. So timings are counted in buckets instead. Bucket limits are fixed and roughly logarithmic,
+from what a pool next door takes to what a pool about to drop takes. Fixed buckets mean nothing is ever allocated and two histograms
+can be compared (or summed) by just looking at the counts.
+There's also a moving average of the most recent samples, it's the quickest way to see something getting worse. */
+class LatencyHistogram {
+public:
+	//! Upper limits of the buckets, milliseconds. There's one more bucket after the last, taking everything else.
+	static const asizei numBuckets = 14;
+	static const std::array<double, numBuckets - 1>& GetLimits() {
+		static const std::array<double, numBuckets - 1> limits = {
+			10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 30000, 60000, 120000
+		};
+		return limits;
+	}
+
+	std::array<aulong, numBuckets> counts;
+	aulong samples;
+	double min, max; //!< milliseconds, meaningful only if samples != 0
+	double total; //!< milliseconds, sum of everything, for the overall average
+	double recent; //!< milliseconds, moving average giving the last samples most of the weight
+
+	LatencyHistogram() : samples(0), min(.0), max(.0), total(.0), recent(.0) { counts.fill(0); }
+
+	void Add(double ms) {
+		const auto &limits(GetLimits());
+		const asizei slot = std::upper_bound(limits.cbegin(), limits.cend(), ms) - limits.cbegin();
+		counts[slot]++;
+		min = samples? std::min(min, ms) : ms;
+		max = samples? std::max(max, ms) : ms;
+		recent = samples? recent * .875 + ms * .125 : ms;
+		total += ms;
+		samples++;
+	}
+
+	//! As if the other samples had been added here as well. There's no telling how the two moving averages interleave, the worst is kept.
+	void Merge(const LatencyHistogram &other) {
+		if(!other.samples) return;
+		for(asizei loop = 0; loop < counts.size(); loop++) counts[loop] += other.counts[loop];
+		min = samples? std::min(min, other.min) : other.min;
+		max = samples? std::max(max, other.max) : other.max;
+		recent = samples? std::max(recent, other.recent) : other.recent;
+		total += other.total;
+		samples += other.samples;
+	}
+
+	double Average() const { return samples? total / samples : .0; }
+
+	/*! Value below which the given fraction of samples is, it's the upper limit of the bucket reaching it so it's an estimation
+	on the pessimistic side. If it's the last bucket, max is returned. */
+	double Percentile(double fraction) const {
+		if(!samples) return .0;
+		const aulong want = std::max(aulong(1), aulong(fraction * samples + .5));
+		aulong seen = 0;
+		const auto &limits(GetLimits());
+		for(asizei loop = 0; loop < limits.size(); loop++) {
+			seen += counts[loop];
+			if(seen >= want) return std::min(limits[loop], max);
+		}
+		return max;
+	}
+
+	bool operator!=(const LatencyHistogram &other) const { return samples != other.samples || counts != other.counts; }
+};
@@ -0,0 +1,602 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#if defined(__linux__)
+#include "EpollNetwork.h"
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string.h>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+
+
+EpollNetwork::EpollNetwork() : wakePending(false), resolvedGeneration(0), resolving(0) {
+	epoll = epoll_create1(EPOLL_CLOEXEC);
+	if(epoll < 0) throw std::runtime_error("Could not create epoll instance.");
+	ScopedFuncCall closeEpoll([this]() { close(epoll); });
+	wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if(wakeFd < 0) throw std::runtime_error("Could not create eventfd to wake up SleepOn.");
+	ScopedFuncCall closeWake([this]() { close(wakeFd); });
+	epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN | EPOLLET;
+	ev.data.ptr = nullptr;
+	if(epoll_ctl(epoll, EPOLL_CTL_ADD, wakeFd, &ev)) throw std::runtime_error("Could not add eventfd to epoll set.");
+	closeWake.Dont();
+	closeEpoll.Dont();
+
+	if(!errMap.get()) {
+		std::unique_ptr< std::map<int, SockErr> > temp(new std::map<int, SockErr>);
+		auto add = [&temp](int soCode, SockErr portable) { temp->insert(std::make_pair(soCode, portable)); };
+		add(0, se_OK);
+		add(ENOMEM, se_outtaMemory);
+		add(ECANCELED, se_aborted);
+		add(EINPROGRESS, se_wouldBlock); // that's what a nonblocking connect says, it's the same as WSAEWOULDBLOCK there
+		add(EINTR, se_interrupted);
+		add(EBADF, se_badFile);
+		add(EACCES, se_denied);
+		add(EPERM, se_denied);
+		add(EFAULT, se_badPointer);
+		add(EINVAL, se_badArg);
+		add(EMFILE, se_outtaFiles);
+		add(ENFILE, se_outtaFiles);
+		add(EAGAIN, se_wouldBlock); // EWOULDBLOCK is the same on Linux
+		add(EALREADY, se_alreadyPerformed);
+		add(ENOTSOCK, se_notSocket);
+		add(EDESTADDRREQ, se_badDstAddress);
+		add(EMSGSIZE, se_tooLong);
+		add(EPROTOTYPE, se_badProtocol);
+		add(ENOPROTOOPT, se_badProtocolOption);
+		add(EPROTONOSUPPORT, se_unsupportedProtocol);
+		add(ESOCKTNOSUPPORT, se_unsupportedSocket);
+		add(EOPNOTSUPP, se_unsupportedOperation);
+		add(EPFNOSUPPORT, se_unsupportedFamily);
+		add(EAFNOSUPPORT, se_unsupportedAddress);
+		add(EADDRINUSE, se_usedPort);
+		add(EADDRNOTAVAIL, se_unavailable);
+		add(ENETDOWN, se_netFail);
+		add(ENETUNREACH, se_unreachable);
+		add(ENETRESET, se_connReset);
+		add(ECONNABORTED, se_connAborted);
+		add(ECONNRESET, se_connAbortedRemotely);
+		add(EPIPE, se_connAbortedRemotely);
+		add(ENOBUFS, se_outtaBuffers);
+		add(EISCONN, se_alreadyConnected);
+		add(ENOTCONN, se_notConnected);
+		add(ESHUTDOWN, se_shutdown);
+		add(ETOOMANYREFS, se_outtaReferences);
+		add(ETIMEDOUT, se_timedOut);
+		add(ECONNREFUSED, se_connRefused);
+		add(ELOOP, se_cannotConvert);
+		add(ENAMETOOLONG, se_nameTooLong);
+		add(EHOSTDOWN, se_remoteDown);
+		add(EHOSTUNREACH, se_unreachableHost);
+		add(ENOTEMPTY, se_dirNotEmpty);
+		add(EUSERS, se_outtaQuota);
+		add(EDQUOT, se_outtaStorageQuota);
+		add(ESTALE, se_staleFile);
+		add(EREMOTE, se_remote);
+		errMap = std::move(temp);
+	}
+}
+
+
+EpollNetwork::~EpollNetwork() {
+	while(connecting.empty() == false) {
+		auto el = connecting.begin();
+		delete el->second;
+		connecting.erase(el);
+	}
+	while(connections.empty() == false) {
+		auto el = connections.begin();
+		delete el->second;
+		connections.erase(el);
+	}
+	while(servers.empty() == false) {
+		auto el = servers.begin();
+		delete el->second;
+		servers.erase(el);
+	}
+	close(wakeFd);
+	close(epoll);
+}
+
+
+void EpollNetwork::Wake() {
+	if(wakePending.exchange(true)) return;
+	const uint64_t one = 1;
+	ssize_t written = write(wakeFd, &one, sizeof(one)); // can only fail if the counter is about to overflow, which means it's already set
+	(void)written;
+}
+
+
+void EpollNetwork::Register(Registration &reg) {
+	epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+	ev.data.ptr = &reg;
+	if(epoll_ctl(epoll, EPOLL_CTL_ADD, reg.fd, &ev)) throw std::runtime_error("Could not add socket to epoll set.");
+}
+
+
+auto EpollNetwork::BeginConnection(const char *host, const char *portService) -> std::pair<ConnectedSocketInterface*, ConnectionError> {
+	std::unique_ptr<ConnectedSocket> newSocket(new ConnectedSocket(host, portService));
+	ConnectedSocket *nullconn = nullptr;
+	ConnectedSocketInterface *proxy = static_cast<ConnectedSocketInterface*>(newSocket.get());
+	std::unique_ptr<PendingConnection> newConnection(new PendingConnection(newSocket.get()));
+	std::vector<AddressResolver::Address> addresses;
+	switch(resolver.Lookup(addresses, newSocket->host, newSocket->port)) {
+	case AddressResolver::rs_failed: return std::make_pair(nullconn, ce_failedResolve);
+	case AddressResolver::rs_pending: newConnection->resolving = true; break; // SleepOn will pick it up
+	case AddressResolver::rs_resolved: {
+		auto err = StartConnecting(*newConnection, addresses);
+		if(err != ce_ok) return std::make_pair(nullconn, err);
+	}
+	}
+	PendingConnection *pending = newConnection.get();
+	connecting.insert(std::make_pair(proxy, pending));
+	ScopedFuncCall cancelPending([this, proxy]() { connecting.erase(proxy); });
+	connections.insert(std::make_pair(proxy, newSocket.get()));
+	cancelPending.Dont();
+	if(pending->resolving) resolving++;
+	newConnection.release();
+	return std::make_pair(newSocket.release(), ce_ok);
+}
+
+
+auto EpollNetwork::StartConnecting(PendingConnection &pending, const std::vector<AddressResolver::Address> &addresses) -> ConnectionError {
+	pending.waiting = addresses;
+	resolver.Order(pending.waiting);
+	std::reverse(pending.waiting.begin(), pending.waiting.end());
+	return LaunchNext(pending);
+}
+
+
+auto EpollNetwork::LaunchNext(PendingConnection &pending) -> ConnectionError {
+	using namespace std::chrono;
+	SocketInterface *owner = static_cast<SocketInterface*>(pending.which);
+	bool noSocket = false;
+	while(pending.waiting.size()) {
+		const AddressResolver::Address check(pending.waiting.back());
+		pending.waiting.pop_back();
+		pending.candidates.reserve(pending.candidates.size() + 1);
+		/* This runs from SleepOn so nothing here throws: an address we cannot even try is just a bad one, the next might work.
+		ENETUNREACH for example is what an IPv6 address gives on an IPv4-only host. errno is looked at directly as
+		GetSocketError throws on values it does not know. */
+		int up = socket(check.family, check.socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, check.protocol);
+		if(up < 0) {
+			noSocket = true;
+			resolver.ConnectResult(check, false, milliseconds(0));
+			continue;
+		}
+		ScopedFuncCall clearSocket([up]() { close(up); });
+		if(connect(up, reinterpret_cast<const sockaddr*>(&check.address), socklen_t(check.length)) && errno != EINPROGRESS && errno != EAGAIN) {
+			resolver.ConnectResult(check, false, milliseconds(0));
+			continue;
+		}
+		Candidate add;
+		add.reg = std::make_unique<Registration>(owner, up, true);
+		add.address = check;
+		add.started = steady_clock::now();
+		pending.candidates.push_back(std::move(add));
+		clearSocket.Dont();
+		Register(*pending.candidates.back().reg);
+		pending.nextAttempt = pending.candidates.back().started + milliseconds(connectionStaggerMilliseconds);
+		return ce_ok;
+	}
+	if(pending.candidates.size()) return ce_ok;
+	return noSocket? ce_badSocket : ce_noRoutes;
+}
+
+
+asizei EpollNetwork::UpdateConnecting(asizei timeoutms) {
+	using namespace std::chrono;
+	const auto now(steady_clock::now());
+	for(auto el = connecting.begin(); el != connecting.end(); ) {
+		PendingConnection &pending(*el->second);
+		if(pending.resolving || pending.waiting.empty()) {
+			++el;
+			continue;
+		}
+		if(now >= pending.nextAttempt) LaunchNext(pending); // if it fails it's most likely low resources, keep going with what we have
+		if(pending.candidates.empty() && pending.waiting.empty()) {
+			pending.which->failed = true;
+			unresolved.push_back(el->first);
+			Drop(el->second);
+			el = connecting.erase(el);
+			continue;
+		}
+		++el;
+		if(pending.waiting.empty()) continue;
+		const auto next(duration_cast<milliseconds>(pending.nextAttempt - now).count());
+		if(next < 0) timeoutms = 0;
+		else if(asizei(next) < timeoutms) timeoutms = asizei(next);
+	}
+	return timeoutms;
+}
+
+
+void EpollNetwork::UpdateResolving() {
+	const asizei generation = resolver.GetGeneration();
+	if(generation == resolvedGeneration) return;
+	resolvedGeneration = generation;
+	std::vector<AddressResolver::Address> addresses;
+	for(auto el = connecting.begin(); el != connecting.end(); ) {
+		PendingConnection &pending(*el->second);
+		if(!pending.resolving) {
+			++el;
+			continue;
+		}
+		auto status = resolver.Lookup(addresses, pending.which->host, pending.which->port);
+		if(status == AddressResolver::rs_pending) {
+			++el;
+			continue;
+		}
+		pending.resolving = false;
+		resolving--;
+		if(status == AddressResolver::rs_resolved && StartConnecting(pending, addresses) == ce_ok) {
+			++el;
+			continue;
+		}
+		pending.which->failed = true; // signaled by SleepOn, just like a failed connection
+		unresolved.push_back(el->first);
+		Drop(el->second);
+		el = connecting.erase(el);
+	}
+}
+
+
+bool EpollNetwork::CloseConnection(ConnectedSocketInterface &object) {
+	auto el = connections.find(&object);
+	if(el == connections.cend()) return false;
+	auto pending = connecting.find(&object);
+	if(pending != connecting.cend()) {
+		if(pending->second->resolving) resolving--;
+		Drop(pending->second);
+		connecting.erase(pending);
+	}
+	Forget(el->second->reg);
+	Forget(el->first);
+	delete el->second; // closing the fd also takes it out of the epoll set
+	connections.erase(el);
+	return true;
+}
+
+
+asizei EpollNetwork::SleepOn(asizei timeoutms) {
+	/* The edge triggered set will only tell us about changes so before sleeping I check if the flags from previous
+	wakeups are still there. If they are, there's no reason to sleep. Events are still harvested as they're cheap.
+	Sleeping is a loop as something nobody is interested in might wake us up. */
+	using namespace std::chrono;
+	for(auto el : signaled) SetReady(*el, SocketInterface::si_none);
+	signaled.clear();
+	if(resolving) {
+		UpdateResolving();
+		if(resolving && timeoutms > AddressResolver::pollMilliseconds) timeoutms = AddressResolver::pollMilliseconds;
+	}
+	if(connecting.size()) timeoutms = UpdateConnecting(timeoutms);
+	const auto deadline = steady_clock::now() + milliseconds(timeoutms);
+	auto anyReady = [this]() {
+		for(auto reg : hot) {
+			if(reg->Ready()) return true;
+		}
+		return false;
+	};
+	bool pending = unresolved.size() || anyReady();
+	const int MAX_EVENTS = 64;
+	epoll_event events[MAX_EVENTS];
+	while(true) {
+		int wait = 0;
+		if(!pending) {
+			const auto now = steady_clock::now();
+			if(now < deadline) wait = int(duration_cast<milliseconds>(deadline - now).count());
+		}
+		int count = epoll_wait(epoll, events, MAX_EVENTS, wait);
+		if(count < 0) {
+			if(errno != EINTR) throw std::runtime_error("Some error occured while waiting for sockets to connect.");
+			count = 0;
+		}
+		for(int loop = 0; loop < count; loop++) {
+			Registration *reg = static_cast<Registration*>(events[loop].data.ptr);
+			if(!reg) { // Wake, there's nothing to signal but we have to stop sleeping
+				uint64_t counter;
+				ssize_t drained = read(wakeFd, &counter, sizeof(counter));
+				(void)drained;
+				wakePending = false; // after draining: a Wake in between is skipped but we're awake anyway, the opposite would leave the flag set forever
+				pending = true;
+				continue;
+			}
+			reg->Merge(events[loop].events);
+			MakeHot(*reg);
+		}
+		pending = pending || anyReady();
+		if(pending || wait == 0 || steady_clock::now() >= deadline) break;
+	}
+	// Registrations might go away while evaluating (connecting candidates) so figure out the sockets first.
+	evaluating.clear();
+	for(auto reg : hot) {
+		if(reg->Ready()) evaluating.push_back(reg->owner);
+	}
+	evaluating.insert(evaluating.end(), unresolved.begin(), unresolved.end());
+	unresolved.clear();
+	asizei awaken = 0;
+	for(auto socket : evaluating) {
+		if(socket->Signaled()) continue; // multiple candidates of the same connection
+		const auint flags = Activated(socket);
+		if(flags == SocketInterface::si_none) continue;
+		SetReady(*socket, flags);
+		signaled.push_back(socket);
+		awaken++;
+	}
+	auto cold = [](Registration *reg) {
+		if(reg->Cached()) return false;
+		reg->hot = false;
+		return true;
+	};
+	hot.erase(std::remove_if(hot.begin(), hot.end(), cold), hot.end());
+	return awaken;
+}
+
+
+SockErr EpollNetwork::GetSocketError() {
+	auto ret = errMap->find(errno);
+	if(ret == errMap->cend()) throw std::runtime_error("errno has an unmapped value.");
+	return ret->second;
+}
+
+
+bool EpollNetwork::Registration::Ready() const {
+	const auint interest = owner->GetInterest();
+	if(interest == SocketInterface::si_none) return false;
+	if(error || candidate) return error || hangup || writable; // connection completion is signaled in all the ways
+	if((interest & SocketInterface::si_read) && (readable || hangup)) return true;
+	return (interest & SocketInterface::si_write) && writable;
+}
+
+
+void EpollNetwork::MakeHot(Registration &reg) {
+	if(reg.hot) return;
+	reg.hot = true;
+	hot.push_back(&reg);
+}
+
+
+void EpollNetwork::Forget(Registration &reg) {
+	if(!reg.hot) return;
+	hot.erase(std::find(hot.begin(), hot.end(), &reg));
+	reg.hot = false;
+}
+
+
+void EpollNetwork::Forget(SocketInterface *socket) {
+	if(!socket->Signaled()) return;
+	signaled.erase(std::find(signaled.begin(), signaled.end(), socket));
+	SetReady(*socket, SocketInterface::si_none);
+}
+
+
+void EpollNetwork::Drop(PendingConnection *pending) {
+	for(const auto &el : pending->candidates) Forget(*el.reg);
+	delete pending;
+}
+
+
+auint EpollNetwork::Activated(SocketInterface *hilevel) {
+	const auint interest = hilevel->GetInterest();
+	auto el = connections.find(hilevel);
+	if(el == connections.cend()) {
+		auto listening = servers.find(hilevel);
+		if(listening == servers.cend()) return SocketInterface::si_none;
+		ServiceSocket &service(*listening->second);
+		if(service.reg.error) service.failed = true;
+		if(service.reg.readable && service.accepted.empty()) AcceptAll(service);
+		if(service.failed || !service.accepted.empty()) return interest;
+		return SocketInterface::si_none;
+	}
+	ConnectedSocket &conn(*el->second);
+	auto pending = connecting.find(hilevel);
+	if(pending == connecting.cend() && conn.reg.fd < 0) return conn.failed? interest : SocketInterface::si_none; // never connected
+	if(pending == connecting.cend()) {
+		if(conn.reg.error) conn.failed = true;
+		if((interest & SocketInterface::si_read) && conn.reg.hangup && !conn.failed) {
+			// same as the Windows version: wake up on close, if there's nothing left to read it's gone
+			abyte byte;
+			const ssize_t res = recv(conn.reg.fd, &byte, sizeof(byte), MSG_PEEK | MSG_DONTWAIT);
+			if(res == 0 || (res < 0 && errno != EAGAIN)) conn.failed = true;
+		}
+		if(conn.failed) return interest;
+		auint ret = SocketInterface::si_none;
+		if((interest & SocketInterface::si_read) && (conn.reg.readable || conn.reg.hangup)) ret |= SocketInterface::si_read;
+		if((interest & SocketInterface::si_write) && conn.reg.writable) ret |= SocketInterface::si_write;
+		return ret;
+	}
+	if(pending->second->resolving) return SocketInterface::si_none;
+	// Candidates signaling something are either connected or failed, SO_ERROR tells.
+	using namespace std::chrono;
+	auto &list(pending->second->candidates);
+	for(asizei loop = 0; loop < list.size(); loop++) {
+		Registration &candidate(*list[loop].reg);
+		if(!candidate.writable && !candidate.error && !candidate.hangup) continue;
+		int error = 0;
+		socklen_t len = sizeof(error);
+		if(getsockopt(candidate.fd, SOL_SOCKET, SO_ERROR, &error, &len) == 0 && error == 0 && candidate.writable) {
+			resolver.ConnectResult(list[loop].address, true, duration_cast<milliseconds>(steady_clock::now() - list[loop].started));
+			conn.reg.fd = candidate.fd;
+			conn.reg.Merge(EPOLLOUT | (candidate.readable? EPOLLIN : 0) | (candidate.hangup? EPOLLRDHUP : 0));
+			epoll_event ev;
+			memset(&ev, 0, sizeof(ev));
+			ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+			ev.data.ptr = &conn.reg;
+			if(epoll_ctl(epoll, EPOLL_CTL_MOD, conn.reg.fd, &ev)) conn.failed = true;
+			MakeHot(conn.reg);
+			Drop(pending->second);
+			connecting.erase(pending);
+			return interest;
+		}
+		resolver.ConnectResult(list[loop].address, false, milliseconds(0));
+		Forget(candidate);
+		close(candidate.fd);
+		list.erase(list.begin() + loop);
+		loop--;
+	}
+	if(list.empty() && pending->second->waiting.size()) { // no point in waiting for the stagger to elapse
+		LaunchNext(*pending->second);
+		if(list.size()) return SocketInterface::si_none;
+	}
+	if(list.empty()) { // will never finish connecting
+		Drop(pending->second);
+		connecting.erase(pending);
+		conn.failed = true;
+		return interest;
+	}
+	return SocketInterface::si_none;
+}
+
+
+void EpollNetwork::AcceptAll(ServiceSocket &listener) {
+	while(true) {
+		int client = accept4(listener.reg.fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if(client < 0) {
+			if(errno == EAGAIN || errno == EWOULDBLOCK) listener.reg.readable = !listener.accepted.empty();
+			else if(errno == EINTR || errno == ECONNABORTED) continue;
+			else if(errno == EMFILE || errno == ENFILE) { } // try again next time, don't clear readable
+			else listener.failed = true;
+			return;
+		}
+		listener.accepted.push_back(client);
+	}
+}
+
+
+asizei EpollNetwork::ConnectedSocket::Send(const abyte *message, asizei count) throw() {
+	Chunk single = { message, count };
+	return SendGather(&single, 1);
+}
+
+
+asizei EpollNetwork::ConnectedSocket::SendGather(const Chunk *chunks, asizei count) throw() {
+	const asizei MAX_BUFFERS = 64;
+	const asizei MAX_LEN = 128 * 1024 * 1024; // max 128 MiB per write seems enough
+	iovec buffers[MAX_BUFFERS];
+	if(count > MAX_BUFFERS) count = MAX_BUFFERS;
+	asizei offered = 0;
+	for(asizei loop = 0; loop < count; loop++) {
+		buffers[loop].iov_base = const_cast<abyte*>(chunks[loop].data);
+		buffers[loop].iov_len = chunks[loop].count > MAX_LEN? MAX_LEN : chunks[loop].count;
+		offered += buffers[loop].iov_len;
+	}
+	msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = buffers;
+	msg.msg_iovlen = count;
+	ssize_t sent = sendmsg(reg.fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+	if(sent < 0) {
+		if(errno == EAGAIN || errno == EWOULDBLOCK) reg.writable = false;
+		else if(errno != EINTR) failed = true;
+		return 0;
+	}
+	if(asizei(sent) < offered) reg.writable = false; // buffer is full, we'll get an edge when it drains
+	return asizei(sent);
+}
+
+
+asizei EpollNetwork::ConnectedSocket::Receive(abyte *storage, asizei count) throw() {
+	asizei len = count > 128 * 1024 * 1024? 128 * 1024 * 1024 : count;
+	ssize_t received = recv(reg.fd, storage, len, MSG_DONTWAIT);
+	if(received < 0) {
+		if(errno == EAGAIN || errno == EWOULDBLOCK) reg.readable = false;
+		else if(errno != EINTR) failed = true;
+		return 0;
+	}
+	if(received == 0 && len) { // orderly shutdown, there will never be anything else
+		reg.readable = false;
+		failed = true;
+	}
+	/* A short read on a stream socket means the receive queue is empty right now.
+	Anything arriving later produces a new edge so it is safe to stop thinking we have data. */
+	if(asizei(received) < len) reg.readable = false;
+	return asizei(received);
+}
+
+
+bool EpollNetwork::ConnectedSocket::GotData() const {
+	char dummy;
+	return recv(reg.fd, &dummy, sizeof(dummy), MSG_PEEK | MSG_DONTWAIT) > 0;
+}
+
+
+bool EpollNetwork::ConnectedSocket::CanSend() const {
+	pollfd me;
+	me.fd = reg.fd;
+	me.events = POLLOUT;
+	me.revents = 0;
+	return poll(&me, 1, 0) > 0 && (me.revents & POLLOUT);
+}
+
+
+void EpollNetwork::CloseServiceSocket(ServiceSocketInterface &what) {
+	auto rem = servers.find(&what);
+	if(rem != servers.end()) {
+		Forget(rem->second->reg);
+		Forget(rem->first);
+		delete rem->second;
+		servers.erase(rem);
+	}
+}
+
+
+NetworkInterface::ServiceSocketInterface& EpollNetwork::NewServiceSocket(aushort port, aushort numPending) {
+	addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+	hints.ai_flags = AI_PASSIVE;
+	addrinfo *result = nullptr;
+	ScopedFuncCall blast([&result]() { if(result) freeaddrinfo(result); });
+	const std::string number(std::to_string(port));
+	if(getaddrinfo(NULL, number.c_str(), &hints, &result)) throw std::runtime_error("getaddrinfo failed.");
+	int listener = -1;
+	ScopedFuncCall clearSocket([&listener]() { if(listener >= 0) close(listener); });
+	listener = socket(result->ai_family, result->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, result->ai_protocol);
+	if(listener < 0) throw std::runtime_error("Error creating new Service Socket, creation failed.");
+	int reuse = 1; // so restarting the program does not have to wait for TIME_WAIT to expire
+	setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+	if(bind(listener, result->ai_addr, result->ai_addrlen)) throw std::runtime_error("Error creating new Service Socket, could not bind.");
+	if(listen(listener, numPending? numPending : SOMAXCONN)) throw std::runtime_error("Error creating new Service Socket, could enter listen state.");
+	if(!port) {
+		sockaddr_in bound;
+		socklen_t len = sizeof(bound);
+		if(getsockname(listener, reinterpret_cast<sockaddr*>(&bound), &len) == 0) port = ntohs(bound.sin_port);
+	}
+
+	std::unique_ptr<ServiceSocket> add(new ServiceSocket(listener, port));
+	clearSocket.Dont();
+	Register(add->reg);
+	servers.insert(std::make_pair(static_cast<SocketInterface*>(add.get()), add.get()));
+	return *add.release();
+}
+
+
+NetworkInterface::ConnectedSocketInterface& EpollNetwork::BeginConnection(ServiceSocketInterface &listener) {
+	auto real(servers.find(&listener));
+	if(real == servers.cend()) throw std::runtime_error("Trying to create a connection from a socket not managed by this object.");
+	ServiceSocket &service(*real->second);
+	if(service.accepted.empty()) AcceptAll(service);
+	if(service.accepted.empty()) throw std::runtime_error("Could not accept an incoming connection.");
+	int client = service.accepted.front();
+	service.accepted.erase(service.accepted.begin());
+	if(service.accepted.empty()) service.reg.readable = false; // AcceptAll ran until EAGAIN, new requests will be new edges
+	ScopedFuncCall clearSocket([client]() { close(client); });
+	std::unique_ptr<ConnectedSocket> add(new ConnectedSocket(nullptr, nullptr));
+	add->reg.fd = client;
+	Register(add->reg); // it is already connected: adding reports the current state, we'll be writable right away
+	clearSocket.Dont();
+	connections.insert(std::make_pair(static_cast<SocketInterface*>(add.get()), add.get()));
+	return *add.release();
+}
+
+#endif
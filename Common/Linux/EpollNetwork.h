@@ -0,0 +1,158 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+
+#if defined(__linux__)
+#include "../Network.h"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string>
+#include <chrono>
+
+
+/*! The Linux implementation of NetworkInterface. The WindowsNetwork builds fd_sets from scratch at every SleepOn call,
+which is fine for a few pools but scales with the number of sockets we have, not with the number of sockets having something to say.
+This one registers every file descriptor exactly once in an edge-triggered epoll set and keeps track of the readiness
+it reported. Readiness is only forgotten when the socket tells us so (EAGAIN or a short read/write) as edge triggering
+won't tell us again. Registrations having some readiness cached are kept in a "hot" list and that's all SleepOn looks at:
+its cost is O(sockets with something cached), sockets are never re-registered and there are no lists to build.
+Everything is nonblocking, there's no way to get stuck in a send. */
+class EpollNetwork : public NetworkInterface {
+private:
+	/*! Every file descriptor in the epoll set has one of those attached in epoll_event::data.ptr.
+	This is just what epoll told us last time, the sockets clear the flags when they figure out they're stale. */
+	struct Registration {
+		int fd;
+		SocketInterface *owner;
+		bool candidate; //!< one of the addresses a connecting socket is trying, writable means it might be connected
+		bool readable, writable, hangup, error;
+		bool hot; //!< true if in the EpollNetwork::hot list
+		explicit Registration(SocketInterface *socket, int handle = -1, bool connecting = false)
+			: fd(handle), owner(socket), candidate(connecting), readable(false), writable(false), hangup(false), error(false), hot(false) { }
+		void Merge(uint32_t events) {
+			readable |= (events & EPOLLIN) != 0;
+			writable |= (events & EPOLLOUT) != 0;
+			hangup |= (events & (EPOLLRDHUP | EPOLLHUP)) != 0;
+			error |= (events & EPOLLERR) != 0;
+		}
+		bool Cached() const { return readable || writable || hangup || error; }
+		bool Ready() const; //!< true if something cached matches the owner's interest
+	};
+
+	class ConnectedSocket : public ConnectedSocketInterface {
+	public:
+		const std::string host;
+		const std::string port;
+		Registration reg;
+		bool failed;
+		ConnectedSocket(const char *hostname, const char *portOrService)
+			: host(hostname? hostname : ""), port(portOrService? portOrService : ""), reg(this), failed(false) {
+		}
+		~ConnectedSocket() { if(reg.fd >= 0) close(reg.fd); }
+		std::string PeerHost() const { return host; }
+		std::string PeerPort() const { return port; }
+		asizei Send(const abyte *octects, asizei count) throw();
+		asizei Receive(abyte  *octects, asizei buffSize) throw();
+		asizei SendGather(const Chunk *chunks, asizei count) throw(); //!< sendmsg with an iovec, no SIGPIPE.
+		bool GotData() const;
+		bool CanSend() const;
+		bool Works() const { return !failed; }
+	};
+
+	/*! With edge triggering, a listener reporting readable might have multiple connections queued and we would not be told again.
+	So when a listener wakes up, everything is accepted right away and queued there for BeginConnection(listener).
+	This way the "call BeginConnection only after SleepOn signaled" contract keeps working. */
+	struct ServiceSocket : public ServiceSocketInterface {
+		const aushort port;
+		Registration reg;
+		bool failed;
+		std::vector<int> accepted;
+		ServiceSocket(int s, aushort p) : port(p), reg(this, s), failed(false) { }
+		~ServiceSocket() {
+			for(auto fd : accepted) close(fd);
+			if(reg.fd >= 0) close(reg.fd);
+		}
+		aushort GetPort() const { return port; }
+		bool Works() const { return !failed; }
+	};
+
+	struct Candidate {
+		std::unique_ptr<Registration> reg; //!< epoll holds a pointer to it, it must not move
+		AddressResolver::Address address;
+		std::chrono::steady_clock::time_point started; //!< to measure connection latency
+	};
+
+	/*! Same as WindowsNetwork: resolved addresses are tried with a stagger and the first to connect wins.
+	Each candidate is registered on its own, the winner is re-pointed to its ConnectedSocket. */
+	struct PendingConnection {
+		ConnectedSocket *which;
+		std::vector<Candidate> candidates; //!< attempts in flight
+		std::vector<AddressResolver::Address> waiting; //!< not tried yet, next to try is at the back
+		std::chrono::steady_clock::time_point nextAttempt;
+		bool resolving; //!< waiting for AddressResolver, no candidates yet
+		PendingConnection(ConnectedSocket *resource = nullptr) : which(resource), resolving(false) { }
+		~PendingConnection() {
+			for(const auto &el : candidates) {
+				if(el.reg->fd >= 0 && el.reg->fd != which->reg.fd) close(el.reg->fd);
+			}
+		}
+	};
+
+	//! Maps errno values to my portable codes.
+	static std::unique_ptr< std::map<int, SockErr> > errMap;
+
+	int epoll;
+
+	/*! Wake writes there, it's in the epoll set with a null pointer as data so it's easy to tell apart from the sockets.
+	The flag avoids a syscall per Wake when the main thread is already going to wake up. */
+	int wakeFd;
+	std::atomic<bool> wakePending;
+
+	std::map<SocketInterface*, ConnectedSocket*> connections;
+	std::map<SocketInterface*, PendingConnection*> connecting;
+	std::map<SocketInterface*, ServiceSocket*> servers;
+
+	std::vector<Registration*> hot; //!< registrations with some readiness cached, the only ones SleepOn looks at
+	std::vector<SocketInterface*> signaled; //!< sockets made ready by the last SleepOn, they get cleared by the next
+	std::vector<SocketInterface*> evaluating; //!< scratch, persistent to avoid allocations
+
+	AddressResolver resolver;
+	asizei resolvedGeneration; //!< last AddressResolver generation UpdateResolving has seen
+	asizei resolving; //!< connections waiting for a name, SleepOn must poll the resolver while there are some
+	std::vector<SocketInterface*> unresolved; //!< failed resolution or ran out of addresses in this SleepOn, to be signaled
+
+	ConnectionError StartConnecting(PendingConnection &pending, const std::vector<AddressResolver::Address> &addresses);
+	void UpdateResolving(); //!< starts connecting sockets whose name has been resolved, fails the others
+	ConnectionError LaunchNext(PendingConnection &pending); //!< starts a connection attempt to the next waiting address
+	asizei UpdateConnecting(asizei timeoutms); //!< launches due attempts, returns timeout clamped to the next one
+
+	void Register(Registration &reg);
+	void MakeHot(Registration &reg);
+	void Forget(Registration &reg); //!< call before the registration goes away
+	void Forget(SocketInterface *socket); //!< same for a socket, which might be in the signaled list
+	void Drop(PendingConnection *pending); //!< forgets and deletes all candidates
+	auint Activated(SocketInterface *hilevel); //!< Readiness flags. Might move connected sockets out of connecting step.
+	void AcceptAll(ServiceSocket &listener);
+
+public:
+	EpollNetwork();
+	~EpollNetwork();
+	std::pair<ConnectedSocketInterface*, ConnectionError> BeginConnection(const char *host, const char *portService);
+	bool CloseConnection(ConnectedSocketInterface &object);
+
+	asizei SleepOn(asizei timeoutms);
+	SockErr GetSocketError();
+	void Wake();
+
+	ServiceSocketInterface& NewServiceSocket(aushort port, aushort numPending);
+	void CloseServiceSocket(ServiceSocketInterface &what);
+	ConnectedSocketInterface& BeginConnection(ServiceSocketInterface &listener);
+};
+
+#endif
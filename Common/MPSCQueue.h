@@ -0,0 +1,90 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+#include "AREN/ArenDataTypes.h"
+#include <atomic>
+#include <chrono>
+
+
+/*! Many threads push, one thread pops. That's what happens with results: every mining thread produces them and the main thread sends them.
+With a mutex, the main thread draining the queue and the mining threads pushing fight for the same lock, which is also the one guarding the
+work factories so a burst of results slows down everything else.
+
+This is Dmitry Vyukov's intrusive MPSC queue: pushing is an atomic exchange and a store, no loops, no waiting on other producers.
+Popping is done by a single thread so it needs no atomic read-modify-write at all. The catch is a producer preempted between its
+exchange and its store makes everything after it invisible until it resumes: Pop returns false in that case, even if the queue isn't
+empty. It's not a problem here as the consumer always tries again at the next tick, or earlier when woken up.
+
+Each element remembers when it's been pushed so the consumer can tell how long it waited. Depth is maintained by both sides so it's
+approximate while things are moving, good enough for monitoring. */
+template<typename Type>
+class MPSCQueue {
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	MPSCQueue() : head(&stub), tail(&stub), depth(0) { stub.next = nullptr; }
+	~MPSCQueue() {
+		Type drop;
+		while(Pop(drop)) { }
+	}
+	MPSCQueue(const MPSCQueue&) = delete;
+	MPSCQueue& operator=(const MPSCQueue&) = delete;
+
+	//! Can be called by any number of threads at once.
+	void Push(Type &&value) {
+		Node *add = new Node(std::move(value));
+		depth.fetch_add(1, std::memory_order_relaxed);
+		Link(add);
+	}
+
+	//! Only one thread can call this at a time. It's always the same one in practice.
+	bool Pop(Type &out, Clock::time_point &queued) {
+		Node *first = tail;
+		Node *next = first->next.load(std::memory_order_acquire);
+		if(first == &stub) { // stub is the placeholder for "nothing"
+			if(!next) return false;
+			tail = next;
+			first = next;
+			next = next->next.load(std::memory_order_acquire);
+		}
+		if(!next) { // last element, or a producer is halfway through pushing
+			if(first != head.load(std::memory_order_acquire)) return false;
+			Link(&stub); // so first gets a next and can go
+			next = first->next.load(std::memory_order_acquire);
+			if(!next) return false;
+		}
+		tail = next;
+		out = std::move(first->value);
+		queued = first->queued;
+		delete first;
+		depth.fetch_sub(1, std::memory_order_relaxed);
+		return true;
+	}
+	bool Pop(Type &out) {
+		Clock::time_point dontCare;
+		return Pop(out, dontCare);
+	}
+
+	asizei Size() const { return depth.load(std::memory_order_relaxed); }
+
+private:
+	struct Node {
+		std::atomic<Node*> next;
+		Type value;
+		Clock::time_point queued;
+		Node() : next(nullptr) { }
+		explicit Node(Type &&init) : next(nullptr), value(std::move(init)), queued(Clock::now()) { }
+	};
+	std::atomic<Node*> head; //!< last pushed, producers swap themselves in there
+	Node *tail; //!< next to pop, owned by the consumer
+	Node stub;
+	std::atomic<asizei> depth;
+
+	void Link(Node *add) {
+		add->next.store(nullptr, std::memory_order_relaxed);
+		Node *prev = head.exchange(add, std::memory_order_acq_rel);
+		prev->next.store(add, std::memory_order_release);
+	}
+};
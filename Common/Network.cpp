@@ -3,27 +3,54 @@
  * For conditions of distribution and use, see the LICENSE or hit the web.
  */
 #include "Network.h"
+#include <thread>
+#include <chrono>
 
 
-asizei NetworkInterface::AbstractDataSocket::Send(const aubyte *octects, asizei buffSize) {
+asizei NetworkInterface::AbstractDataSocket::Send(const aubyte *octects, asizei buffSize) throw() {
 	return Send(reinterpret_cast<const abyte*>(octects), buffSize);
 }
 
 
-asizei NetworkInterface::AbstractDataSocket::Receive(aubyte *storage, asizei buffSize) {
+asizei NetworkInterface::AbstractDataSocket::Receive(aubyte *storage, asizei buffSize) throw() {
 	return Receive(reinterpret_cast<abyte*>(storage), buffSize);
 }
 
 
+asizei NetworkInterface::AbstractDataSocket::SendGather(const Chunk *chunks, asizei count) throw() {
+	asizei total = 0;
+	for(asizei loop = 0; loop < count; loop++) {
+		const asizei sent = Send(chunks[loop].data, chunks[loop].count);
+		total += sent;
+		if(sent != chunks[loop].count) break;
+	}
+	return total;
+}
+
+
+#if defined(_WIN32)
 void WindowsNetwork::SetBlocking(SOCKET socket, bool blocks) {
 	unsigned long state = !blocks; // 0 nonblocking disabled!
 	if(ioctlsocket(socket, FIONBIO, &state)) throw std::exception("Cannot set socket blocking state.");
 }
 
 
-WindowsNetwork::WindowsNetwork() {
+WindowsNetwork::WindowsNetwork() : resolvedGeneration(0), wakeSocket(INVALID_SOCKET), wakePending(false) {
 	WSADATA blah;
 	if(WSAStartup(MAKEWORD(2, 2), &blah)) throw std::exception("Winsock2 failed to init.");
+	wakeSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if(wakeSocket == INVALID_SOCKET) throw std::exception("Could not create the socket to wake up SleepOn.");
+	ScopedFuncCall closeWake([this]() { closesocket(wakeSocket); });
+	sockaddr_in loopback;
+	memset(&loopback, 0, sizeof(loopback));
+	loopback.sin_family = AF_INET;
+	loopback.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	int len = sizeof(loopback);
+	if(bind(wakeSocket, reinterpret_cast<sockaddr*>(&loopback), len)) throw std::exception("Could not bind the socket to wake up SleepOn.");
+	if(getsockname(wakeSocket, reinterpret_cast<sockaddr*>(&loopback), &len)) throw std::exception("Could not bind the socket to wake up SleepOn.");
+	if(connect(wakeSocket, reinterpret_cast<sockaddr*>(&loopback), len)) throw std::exception("Could not connect the socket to wake up SleepOn.");
+	SetBlocking(wakeSocket, false);
+	closeWake.Dont();
 	
 	if(!errMap.get()) {
 		std::unique_ptr< std::map<int, SockErr> > temp(new std::map<int, SockErr>);
@@ -150,38 +177,33 @@ WindowsNetwork::~WindowsNetwork() {
 		delete el->second;
 		servers.erase(el);
 	}
+	closesocket(wakeSocket);
 	WSACleanup();
 }
 
 
+void WindowsNetwork::Wake() {
+	if(wakePending.exchange(true)) return;
+	const char poke = 0;
+	send(wakeSocket, &poke, 1, 0); // if the buffer is full there are bytes already there so it's not a problem
+}
+
+
 // Trailing return types are cool with better name resolution!
 auto WindowsNetwork::BeginConnection(const char *host, const char *portService) -> std::pair<ConnectedSocketInterface*, ConnectionError> {
 	std::unique_ptr<ConnectedSocket> newSocket(new ConnectedSocket(host, portService));
     ConnectedSocket *nullconn = nullptr;
 	ConnectedSocketInterface *proxy = static_cast<ConnectedSocketInterface*>(newSocket.get());
 	std::unique_ptr<PendingConnection> newConnection(new PendingConnection(newSocket.get()));
-	addrinfo hints;
-	memset(&hints, 0, sizeof(hints));
-	hints.ai_family = AF_UNSPEC;
-	hints.ai_socktype = SOCK_STREAM;
-	hints.ai_protocol = IPPROTO_TCP;
-	addrinfo *result = nullptr;
-	ScopedFuncCall blast([result]() { if(result) freeaddrinfo(result); });
-	if(getaddrinfo(host, portService, &hints, &result)) return std::make_pair(nullconn, ce_failedResolve);
-	for(addrinfo *check = result; check; check = check->ai_next) {
-		newConnection->candidates.reserve(newConnection->candidates.size() + 1);
-		SOCKET up = socket(check->ai_family, check->ai_socktype, check->ai_protocol);
-		if(up == INVALID_SOCKET) return std::make_pair(nullconn, ce_badSocket); // I assume this means I'm very low on resources
-		SetBlocking(up, false);
-		if(connect(up, check->ai_addr, int(check->ai_addrlen))) {
-			auto error = GetSocketError();
-			if(error == se_connRefused) continue; // this sometimes happens, for example connecting to "localhost" for some reason resolves to "0.0.0.0", which is invalid.
-			if(GetSocketError() != se_wouldBlock) throw std::exception("Could not start connection procedure for socket.");
-		}
-		// I could just skip this but its' possibly indication of low resources, no point in even starting
-		newConnection->candidates.push_back(up);
+	std::vector<AddressResolver::Address> addresses;
+	switch(resolver.Lookup(addresses, newSocket->host, newSocket->port)) {
+	case AddressResolver::rs_failed: return std::make_pair(nullconn, ce_failedResolve);
+	case AddressResolver::rs_pending: newConnection->resolving = true; break; // SleepOn will pick it up
+	case AddressResolver::rs_resolved: {
+		auto err = StartConnecting(*newConnection, addresses);
+		if(err != ce_ok) return std::make_pair(nullconn, err);
+	}
 	}
-	if(newConnection->candidates.size() == 0) return std::make_pair(nullconn, ce_noRoutes);
 	PendingConnection *pending = newConnection.get();
 	connecting.insert(std::make_pair(proxy, pending));
 	ScopedFuncCall cancelPending([this, proxy]() { connecting.erase(proxy); });
@@ -192,6 +214,103 @@ auto WindowsNetwork::BeginConnection(const char *host, const char *portService)
 }
 
 
+auto WindowsNetwork::StartConnecting(PendingConnection &pending, const std::vector<AddressResolver::Address> &addresses) -> ConnectionError {
+	std::vector<AddressResolver::Address> ordered(addresses);
+	resolver.Order(ordered);
+	pending.waiting.assign(ordered.crbegin(), ordered.crend());
+	return LaunchNext(pending);
+}
+
+
+auto WindowsNetwork::LaunchNext(PendingConnection &pending) -> ConnectionError {
+	using namespace std::chrono;
+	bool noSocket = false;
+	while(pending.waiting.size()) {
+		const AddressResolver::Address check(pending.waiting.back());
+		pending.waiting.pop_back();
+		pending.candidates.reserve(pending.candidates.size() + 1);
+		/* This runs from SleepOn so nothing here throws, a failing address is just skipped. Refused happens for example
+		connecting to "localhost" for some reason resolving to "0.0.0.0", unreachable with IPv6 addresses on IPv4-only hosts.
+		WSAGetLastError is looked at directly as GetSocketError throws on values it does not know. */
+		SOCKET up = socket(check.family, check.socktype, check.protocol);
+		if(up == INVALID_SOCKET) { // I assume this means I'm very low on resources
+			noSocket = true;
+			resolver.ConnectResult(check, false, milliseconds(0));
+			continue;
+		}
+		SetBlocking(up, false);
+		if(connect(up, reinterpret_cast<const sockaddr*>(&check.address), int(check.length)) && WSAGetLastError() != WSAEWOULDBLOCK) {
+			closesocket(up);
+			resolver.ConnectResult(check, false, milliseconds(0));
+			continue;
+		}
+		Candidate add;
+		add.socket = up;
+		add.address = check;
+		add.started = steady_clock::now();
+		pending.candidates.push_back(add);
+		pending.nextAttempt = add.started + milliseconds(connectionStaggerMilliseconds);
+		return ce_ok;
+	}
+	if(pending.candidates.size()) return ce_ok;
+	return noSocket? ce_badSocket : ce_noRoutes;
+}
+
+
+asizei WindowsNetwork::UpdateConnecting(asizei timeoutms) {
+	using namespace std::chrono;
+	const auto now(steady_clock::now());
+	for(auto el = connecting.begin(); el != connecting.end(); ) {
+		PendingConnection &pending(*el->second);
+		if(pending.resolving || pending.waiting.empty()) {
+			++el;
+			continue;
+		}
+		if(now >= pending.nextAttempt) LaunchNext(pending); // if it fails it's most likely low resources, keep going with what we have
+		if(pending.candidates.empty() && pending.waiting.empty()) { // nothing left to try, SleepOn will signal it
+			pending.which->failed = true;
+			delete el->second;
+			el = connecting.erase(el);
+			continue;
+		}
+		++el;
+		if(pending.waiting.empty()) continue;
+		const auto next(duration_cast<milliseconds>(pending.nextAttempt - now).count());
+		if(next < 0) timeoutms = 0;
+		else if(asizei(next) < timeoutms) timeoutms = asizei(next);
+	}
+	return timeoutms;
+}
+
+
+void WindowsNetwork::UpdateResolving() {
+	const asizei generation = resolver.GetGeneration();
+	if(generation == resolvedGeneration) return;
+	resolvedGeneration = generation;
+	std::vector<AddressResolver::Address> addresses;
+	for(auto el = connecting.begin(); el != connecting.end(); ) {
+		PendingConnection &pending(*el->second);
+		if(!pending.resolving) {
+			++el;
+			continue;
+		}
+		auto status = resolver.Lookup(addresses, pending.which->host, pending.which->port);
+		if(status == AddressResolver::rs_pending) {
+			++el;
+			continue;
+		}
+		pending.resolving = false;
+		if(status == AddressResolver::rs_resolved && StartConnecting(pending, addresses) == ce_ok) {
+			++el;
+			continue;
+		}
+		pending.which->failed = true; // signaled by SleepOn, just like a failed connection
+		delete el->second;
+		el = connecting.erase(el);
+	}
+}
+
+
 bool WindowsNetwork::CloseConnection(ConnectedSocketInterface &object) {
 	auto el = connections.find(&object);
 	if(el == connections.cend()) return false;
@@ -206,51 +325,84 @@ bool WindowsNetwork::CloseConnection(ConnectedSocketInterface &object) {
 }
 
 
-asizei WindowsNetwork::SleepOn(std::vector<SocketInterface*> &read, std::vector<SocketInterface*> &write, asizei timeoutms) {
+asizei WindowsNetwork::SleepOn(asizei timeoutms) {
 	/* This is going to be more complicated than expected because this function really does two things.
 	1- it transitions connecting sockets to connected
 	2- it does a proper sleep. 
 	I would just test the connecting sockets first and then the "ready" sockets, but this would imply a connection
 	timeout could stop everything. I also cannot just put the object in the queue as there's no real socket object in the
-	interface until it is connected. */
+	interface until it is connected.
+	select needs the sets rebuilt every time but at least they are built from what sockets want, no outer lists. */
 	fd_set readReady;
 	fd_set writeReady;
 	fd_set failures;
 	FD_ZERO(&readReady);
 	FD_ZERO(&writeReady);
 	FD_ZERO(&failures);
-	SOCKET biggest = max(BiggestSocket(failures, readReady, read), BiggestSocket(failures, writeReady, write));
+	SOCKET biggest = 0;
+	asizei failing = 0;
+	bool resolving = false;
+	if(connecting.size()) {
+		UpdateResolving();
+		timeoutms = UpdateConnecting(timeoutms);
+	}
+	auto watch = [&](SOCKET socket, bool reading, bool writing) {
+		if(reading) FD_SET(socket, &readReady);
+		if(writing) FD_SET(socket, &writeReady);
+		FD_SET(socket, &failures);
+		biggest = max(biggest, socket);
+	};
+	for(const auto &el : connections) {
+		SetReady(*el.first, SocketInterface::si_none);
+		const auint interest = el.first->GetInterest();
+		if(interest == SocketInterface::si_none) continue;
+		if(el.second->socket != INVALID_SOCKET) watch(el.second->socket, (interest & SocketInterface::si_read) != 0, (interest & SocketInterface::si_write) != 0);
+		else { // still in the connecting state, then it can have a sequence of sockets. Completion shows up as writable.
+			auto pending = connecting.find(el.first);
+			if(pending == connecting.cend()) { // failed to connect or resolve, keep signaling until outer code closes it
+				failing++;
+				continue;
+			}
+			resolving |= pending->second->resolving;
+			for(const auto &candidate : pending->second->candidates) watch(candidate.socket, false, true);
+		}
+	}
+	for(const auto &el : servers) {
+		SetReady(*el.first, SocketInterface::si_none);
+		if(el.first->GetInterest() & SocketInterface::si_read) watch(el.second->socket, true, false);
+	}
+	watch(wakeSocket, true, false);
+	if(failing) timeoutms = 0;
+	else if(resolving && timeoutms > AddressResolver::pollMilliseconds) timeoutms = AddressResolver::pollMilliseconds;
+	// The wake socket is always there so select never gets empty sets anymore.
 	biggest++; // select needs a +1 to test with strict inequality <
 	timeval timeout;
 	timeout.tv_sec = long(timeoutms / 1000);
 	timeout.tv_usec = (timeoutms % 1000) * 1000;
 	int result = select(int(biggest), &readReady, &writeReady, &failures, &timeout);
-	if(!result) {
-        for(auto &el : read) el = nullptr;
-        for(auto &el : write) el = nullptr;
-        return 0;
-    }
-	if(result < 1) throw std::exception("Some error occured while waiting for sockets to connect.");
+	if(result < 0) throw std::exception("Some error occured while waiting for sockets to connect.");
+	if(!result && !failing) return 0;
+	if(FD_ISSET(wakeSocket, &readReady)) {
+		char drain[16];
+		while(recv(wakeSocket, drain, sizeof(drain), 0) > 0) { }
+		wakePending = false; // after draining: a Wake in between is skipped but we're awake anyway, the opposite would leave the flag set forever
+	}
 	asizei awaken = 0;
-	for(auto &socket : read) {
-		if(Activated(failures, socket, readReady) == false) socket = nullptr;
-		else {
+	for(const auto &el : connections) {
+		if(el.first->GetInterest() == SocketInterface::si_none) continue;
+		const auint flags = Activated(failures, readReady, writeReady, el.first, *el.second);
+		SetReady(*el.first, flags);
+		if(flags) awaken++;
+	}
+	for(const auto &el : servers) {
+		const auint interest = el.first->GetInterest();
+		if(!(interest & SocketInterface::si_read)) continue;
+		if(FD_ISSET(el.second->socket, &failures)) el.second->failed = true;
+		if(el.second->failed || FD_ISSET(el.second->socket, &readReady)) {
+			SetReady(*el.first, interest);
 			awaken++;
-			// a read handle awakens on connection close as well! Check it out by peeking at data.
-			auto el = connections.find(socket);
-			if(el == connections.end()) continue;
-			abyte byte;
-			int res = recv(el->second->socket, &byte, sizeof(byte), MSG_PEEK);
-			if(res <= 0) { // 0- connection closed gracefully, <0 aborted, see error
-				auto err = GetSocketError();
-				el->second->failed = true;
-			}
 		}
 	}
-	for(asizei loop = 0; loop < write.size(); loop++) {
-		if(Activated(failures, write[loop], writeReady) == false) write[loop] = nullptr;
-		else awaken++;
-	}
 	return awaken;
 }
 
@@ -274,6 +426,24 @@ asizei WindowsNetwork::ConnectedSocket::Send(const abyte *message, asizei count)
 }
 
 
+asizei WindowsNetwork::ConnectedSocket::SendGather(const Chunk *chunks, asizei count) {
+	const asizei MAX_BUFFERS = 64; // more than enough, we're usually sending a handful of shares
+	const asizei MAX_LEN = 128 * 1024 * 1024;
+	WSABUF buffers[MAX_BUFFERS];
+	if(count > MAX_BUFFERS) count = MAX_BUFFERS;
+	for(asizei loop = 0; loop < count; loop++) {
+		buffers[loop].buf = const_cast<char*>(chunks[loop].data);
+		buffers[loop].len = ULONG(chunks[loop].count > MAX_LEN? MAX_LEN : chunks[loop].count);
+	}
+	DWORD sent = 0;
+	if(WSASend(socket, buffers, DWORD(count), &sent, 0, NULL, NULL) == SOCKET_ERROR) {
+		if(WSAGetLastError() != WSAEWOULDBLOCK) failed = true;
+		return 0;
+	}
+	return asizei(sent);
+}
+
+
 asizei WindowsNetwork::ConnectedSocket::Receive(abyte *storage, asizei count) {
 	int len = count > 128 * 1024 * 1024? 128 * 1024 * 1024 : int(count); // max 128 MiB per write seems enough
 	int received = recv(socket, storage, len, 0);
@@ -354,79 +524,62 @@ NetworkInterface::ConnectedSocketInterface& WindowsNetwork::BeginConnection(Serv
 }
 
 
-SOCKET WindowsNetwork::BiggestSocket(fd_set &failures, fd_set &set, std::vector<SocketInterface*> &monitor) const {
-	SOCKET biggest = 0;
-	for(const auto &socket : monitor) {
-		auto el = connections.find(socket);
-		if(el == connections.cend()) { // maybe it's a listening socket
-			auto servicing = servers.find(socket);
-			if(servicing == servers.cend()) { } // I am not managing this
-			else {
-				FD_SET(servicing->second->socket, &set);
-				FD_SET(servicing->second->socket, &failures);
-				biggest = max(biggest, servicing->second->socket);
-			}
-		}
-		else if(el->second->socket != INVALID_SOCKET) { // managing this, and fully initialized
-			FD_SET(el->second->socket, &set);
-			FD_SET(el->second->socket, &failures);
-			biggest = max(biggest, el->second->socket);
-		}
-		else { // still in the connecting state, then it can have a sequence of sockets.
-			auto pending = connecting.find(socket);
-			if(pending == connecting.cend()) throw std::exception("Impossible, code incoherent (socket is connecting but no connecting state)!");
-			auto &list(pending->second->candidates);
-			for(asizei inner = 0; inner < list.size(); inner++) {
-				FD_SET(list[inner], &set);
-				FD_SET(list[inner], &failures);
-				biggest = max(biggest, list[inner]);
-			}
-		}
-	}
-	return biggest;
-}
-
-
-bool WindowsNetwork::Activated(fd_set &failures, SocketInterface *hilevel, const fd_set &search) {
-	auto el = connections.find(hilevel);
-	if(el == connections.cend()) {
-		auto listening = servers.find(hilevel);
-		if(listening == servers.cend()) return false;
-		bool ret = FD_ISSET(listening->second->socket, &failures) != 0;
-		if(ret) listening->second->failed = true;
-		return ret || FD_ISSET(listening->second->socket, &search) != 0;
-	}
+auint WindowsNetwork::Activated(const fd_set &failures, const fd_set &readReady, const fd_set &writeReady, SocketInterface *hilevel, ConnectedSocket &conn) {
+	const auint interest = hilevel->GetInterest();
 	auto pending = connecting.find(hilevel);
+	if(pending == connecting.cend() && conn.socket == INVALID_SOCKET) return conn.failed? interest : SocketInterface::si_none; // never connected
 	if(pending == connecting.cend()) { // fully connected.
-		bool ret = FD_ISSET(el->second->socket, &failures) != 0;
-		if(ret) el->second->failed = true;
-		return ret || FD_ISSET(el->second->socket, &search) != 0;
+		if(FD_ISSET(conn.socket, &failures)) {
+			conn.failed = true;
+			return interest;
+		}
+		auint ret = SocketInterface::si_none;
+		if(FD_ISSET(conn.socket, &readReady)) {
+			ret |= SocketInterface::si_read;
+			// a read handle awakens on connection close as well! Check it out by peeking at data.
+			abyte byte;
+			int res = recv(conn.socket, &byte, sizeof(byte), MSG_PEEK);
+			if(res <= 0) conn.failed = true; // 0- connection closed gracefully, <0 aborted, see error
+		}
+		if(FD_ISSET(conn.socket, &writeReady)) ret |= SocketInterface::si_write;
+		return ret;
 	}
+	if(pending->second->resolving) return SocketInterface::si_none;
 	// if here, connection completed, move it to estabilished connections, but only if an active socket
 	// is really found - we might have been awakened due to timeout or another socket!
 	// We must also take care of the failing possibilities.
-	for(asizei loop = 0; loop < pending->second->candidates.size(); loop++) {
-		if(FD_ISSET(pending->second->candidates[loop], &failures)) {
-			closesocket(pending->second->candidates[loop]);
-            auto entry(pending->second->candidates.begin() + loop);
-			pending->second->candidates.erase(entry);
+	using namespace std::chrono;
+	const auto now(steady_clock::now());
+	auto &list(pending->second->candidates);
+	for(asizei loop = 0; loop < list.size(); loop++) {
+		if(FD_ISSET(list[loop].socket, &failures)) {
+			resolver.ConnectResult(list[loop].address, false, duration_cast<milliseconds>(now - list[loop].started));
+			closesocket(list[loop].socket);
+            auto entry(list.begin() + loop);
+			list.erase(entry);
             loop--;
 		}
 	}
-	if(pending->second->candidates.empty()) { // will never finish connecting
+	if(list.empty() && pending->second->waiting.size()) { // no point in waiting for the stagger
+		LaunchNext(*pending->second);
+		if(list.size()) return SocketInterface::si_none;
+	}
+	if(list.empty()) { // will never finish connecting
 		delete pending->second;
         connecting.erase(pending);
-        el->second->failed = true;
-		return true;
+        conn.failed = true;
+		return interest;
 	}
 
-	for(asizei loop = 0; loop < pending->second->candidates.size(); loop++) {
-		if(FD_ISSET(pending->second->candidates[loop], &search)) {
-			el->second->socket = pending->second->candidates[loop];
+	for(asizei loop = 0; loop < list.size(); loop++) {
+		if(FD_ISSET(list[loop].socket, &writeReady)) { // first to connect wins, the others are cancelled by the PendingConnection dtor
+			resolver.ConnectResult(list[loop].address, true, duration_cast<milliseconds>(now - list[loop].started));
+			conn.socket = list[loop].socket;
 			delete pending->second;
 			connecting.erase(pending);
-			return true;
+			return interest;
 		}
 	}
-	return false;
+	return SocketInterface::si_none;
 }
+#endif
@@ -9,6 +9,9 @@
 #include <memory>
 #include <map>
 #include <set>
+#include <chrono>
+#include <atomic>
+#include "AddressResolver.h"
 
 #if defined(_WIN32)
 #include <WinSock2.h>
@@ -126,10 +129,39 @@ class NetworkInterface {
 public:
 	static size_t connectionTimeoutSeconds;
 
+	/*! When a name resolves to multiple addresses they are not tried all at once nor one after the other: a new attempt is
+	started each time this amount of time elapses without a connection completing ("happy eyeballs"). First to connect wins. */
+	static asizei connectionStaggerMilliseconds;
+
 	class SocketInterface {
 	public:
+		enum Interest {
+			si_none = 0,
+			si_read = 1,
+			si_write = 2
+		};
 		virtual bool Works() const = 0; //!< false if an error occured
 		virtual ~SocketInterface() { }
+
+		/*! Sockets remember what they are waiting for. SleepOn considers every socket managed by the network object having
+		a non-zero interest so there are no lists to build each tick: set this when your state changes and it stays there.
+		\param flags a combination of Interest values. */
+		void SetInterest(auint flags) { interest = flags; }
+		auint GetInterest() const { return interest; }
+
+		/*! Those are the result of the last SleepOn and stay valid until the next call. They are not a live probe as
+		GotData() and CanSend() are: they only tell you if it's worth trying.
+		A socket failing while sleeping is signaled in every way it was interested in so always check Works(). */
+		bool Readable() const { return (ready & si_read) != 0; }
+		bool Writable() const { return (ready & si_write) != 0; }
+		bool Signaled() const { return ready != si_none; }
+
+	protected:
+		SocketInterface() : interest(si_none), ready(si_none) { }
+
+	private:
+		friend class NetworkInterface;
+		auint interest, ready;
 	};
 
 	class AbstractDataSocket : public SocketInterface {
@@ -141,6 +173,15 @@ public:
 		so this should always be able to consume at least an octet. */
 		asizei Send(const aubyte *octects, asizei count) throw();
 		asizei Receive(aubyte  *octects, asizei buffSize) throw();
+
+		struct Chunk {
+			const abyte *data;
+			asizei count;
+		};
+		/*! Sends a sequence of buffers in order as if they were a single one, possibly with a single call to the OS.
+		The default implementation just goes through Send one chunk at a time, stopping at the first partial write so
+		the semantics are the same: returns the number of bytes sent, spanning across chunks. */
+		virtual asizei SendGather(const Chunk *chunks, asizei count) throw();
 		virtual bool GotData() const = 0;
 		virtual bool CanSend() const = 0;
 		virtual bool Works() const = 0; //!< false if an error occured
@@ -173,10 +214,13 @@ public:
 
 	/*! Notice this function is called BeginConnection, not connect or something.
 	It immediately returns a socket so you can start building objects on top of it but it's very likely the connection
-	procedures will not be completed by the time this returns. It is necessary to use SleepOn putting this in the receiver
-	queue to figure out when the connection is ready to go - this will also allow the object to transition to a fully
+	procedures will not be completed by the time this returns. It is necessary to give it some interest and SleepOn
+	to figure out when the connection is ready to go - this will also allow the object to transition to a fully
 	working state without requiring thread locks.
 	In other terms, the returned connection is technically a future, but the object isn't so it is returned immediately.
+	Name resolution happens in the background as well (see AddressResolver): a socket waiting for its addresses is just
+	connecting for outer code. If resolution fails it will be signaled as failed, the next attempt will then get ce_failedResolve
+	right away as failures are remembered for a while.
     \returns A pointer to a new connected socket owned by this with .second being ce_ok OR
     nullptr, with .second being an error code. */
 	virtual std::pair<ConnectedSocketInterface*, ConnectionError> BeginConnection(const char *host, const char *portService) = 0;
@@ -185,28 +229,32 @@ public:
 	virtual bool CloseConnection(ConnectedSocketInterface &object) = 0;
 
 	/*! This function halts the program until at least one of the following conditions occur:
-	1- at least 1 socket in the read list has received at least 1 byte of data;
+	1- at least 1 socket interested in reading has received at least 1 byte of data;
 	  1a- Special for service sockets: those don't receiva data but rather connection requests to Accept.
-	2- at least 1 socket in the write list has buffer space to allow instant non-blocking send;
-	3- at least one socket completes connection, regardless you placed it in write or read list;
-	3- timeout is exceeded;
-	4- an error in monitored sockets (either send or receive list) is detected.
-	In the last case, the function will throw.
-	If timeout is exceeded, return value is zero.
-	In other cases, the return value is not-zero but due to issues in managing connecting sockets,
-    you should not assume this specific value has a meaning.
-	The pointers in the vectors passed do maintain their position but not their value.
-	The value is kept only for pointers which caused wakeup. Sleeping pointers are cleared.
-	This function is also used to perform full socket initialization in the case of connected streams.
+	2- at least 1 socket interested in writing has buffer space to allow instant non-blocking send;
+	3- at least one socket with any interest completes connection;
+	4- timeout is exceeded;
+	5- an error in monitored sockets is detected;
+	6- some other thread called Wake().
+	Only sockets managed by this with a non-zero interest are monitored, see SocketInterface::SetInterest.
+	Each of them gets its readiness flags updated so outer code can figure out its own state in O(1), no searching.
+	If timeout is exceeded, return value is zero. Otherwise it is the number of sockets signaled.
+	If there's nothing to monitor at all, this just sleeps.
+	This function is also used to perform full socket initialization in the case of connected streams, a socket completing
+	connection is signaled in every way it's interested in.
 	There's no guarantee successive reads or writes to consume 1 byte or more, but only they'll be instant.
-	Sockets not managed by this are ignored.
 	\note If a socket fails while sleeping, it will still provide an activation so outer code can react.
 	It is therefore strongly suggested to always check socket's Works(). Using CanSend() and GotData()
 	would be a bit overkill and might actually not work. */
-	virtual asizei SleepOn(std::vector<SocketInterface*> &read,
-	                       std::vector<SocketInterface*> &write, asizei timeoutms) = 0;
+	virtual asizei SleepOn(asizei timeoutms) = 0;
 	virtual SockErr GetSocketError() = 0;
 
+	/*! The only function here which is thread safe. Makes the SleepOn in progress return right away or, if the main thread
+	is not sleeping, the next one. Producers such as the mining threads call this after giving the main thread something to do
+	so it doesn't sit there until the timeout. Calls are coalesced: waking many times before SleepOn gets to run just makes it return once.
+	SleepOn returns 0 if it's been woken up and nothing else happened, just like a timeout. */
+	virtual void Wake() = 0;
+
 	/*! Creates a "service socket" on the local machine. It's a special "listen" socket used by clients to estabilish
 	new connections to this machine.
 	\param port number of local port to use on this machine. If 0, assigned by system.
@@ -218,9 +266,14 @@ public:
 	/*! Creates a connection by pulling out a connection request from a service socket. Always call this AFTER SleepOn
 	has returned indicating availability of a connection request to handle; other conditions are considered errors. */
 	virtual ConnectedSocketInterface& BeginConnection(ServiceSocketInterface &listener) = 0;
+
+protected:
+	//! Socket readiness is only written by SleepOn implementations.
+	static void SetReady(SocketInterface &socket, auint flags) { socket.ready = flags; }
 };
 
 
+#if defined(_WIN32)
 class WindowsNetwork : public NetworkInterface {
 private:
 	class ConnectedSocket : public ConnectedSocketInterface {
@@ -237,6 +290,7 @@ private:
 		std::string PeerPort() const { return port; }
 		asizei Send(const abyte *octects, asizei count);
 		asizei Receive(abyte  *octects, asizei buffSize);
+		asizei SendGather(const Chunk *chunks, asizei count); //!< WSASend is the Windows equivalent of writev
 		bool GotData() const;
 		bool CanSend() const;
 		bool Works() const { return !failed; }
@@ -258,15 +312,24 @@ private:
 	static std::unique_ptr< std::map<int, SockErr> > errMap;
 
 
+	struct Candidate {
+		SOCKET socket;
+		AddressResolver::Address address;
+		std::chrono::steady_clock::time_point started; //!< to measure connection latency
+	};
+
 	struct PendingConnection {
 		ConnectedSocket *which;
-		std::vector<SOCKET> candidates;
-		PendingConnection(ConnectedSocket *resource = nullptr) : which(resource) { }
+		std::vector<Candidate> candidates; //!< attempts in flight
+		std::vector<AddressResolver::Address> waiting; //!< not tried yet, next to try is at the back
+		std::chrono::steady_clock::time_point nextAttempt;
+		bool resolving; //!< waiting for AddressResolver, no candidates yet
+		PendingConnection(ConnectedSocket *resource = nullptr) : which(resource), resolving(false) { }
 		~PendingConnection() {
 			for(asizei loop = 0; loop < candidates.size(); loop++) {
-				if(which->socket == candidates[loop] || candidates[loop] == INVALID_SOCKET) continue;
+				if(which->socket == candidates[loop].socket || candidates[loop].socket == INVALID_SOCKET) continue;
 				//! \todo maybe we should call shutdown() to ensure all queued data makes it to the server first
-				closesocket(candidates[loop]);
+				closesocket(candidates[loop].socket);
 			}
 		}
 		bool operator==(const ConnectedSocket *s) const { return which == s; }
@@ -281,8 +344,21 @@ private:
 
 	std::map<SocketInterface*, ServiceSocket*> servers;
 
-    SOCKET BiggestSocket(fd_set &failures, fd_set &set, std::vector<SocketInterface*> &monitor) const;
-    bool Activated(fd_set &failures, SocketInterface *hilevel, const fd_set &search); //!< Might move connected sockets out of connecting step.
+	AddressResolver resolver;
+	asizei resolvedGeneration; //!< last AddressResolver generation UpdateResolving has seen
+
+	ConnectionError StartConnecting(PendingConnection &pending, const std::vector<AddressResolver::Address> &addresses);
+	void UpdateResolving(); //!< starts connecting sockets whose name has been resolved, fails the others
+	ConnectionError LaunchNext(PendingConnection &pending); //!< starts a connection attempt to the next waiting address
+	asizei UpdateConnecting(asizei timeoutms); //!< launches due attempts, returns timeout clamped to the next one
+
+	/*! select only waits on sockets so Wake sends a byte to an UDP socket connected to itself on the loopback, which is always
+	in the read set. The flag avoids sending more than a byte per sleep. */
+	SOCKET wakeSocket;
+	std::atomic<bool> wakePending;
+
+    //! Returns the readiness flags for a connection. Might move connected sockets out of connecting step.
+    auint Activated(const fd_set &failures, const fd_set &readReady, const fd_set &writeReady, SocketInterface *hilevel, ConnectedSocket &conn);
 
 public:
 	WindowsNetwork();
@@ -290,13 +366,21 @@ public:
 	std::pair<ConnectedSocketInterface*, ConnectionError> BeginConnection(const char *host, const char *portService);
 	bool CloseConnection(ConnectedSocketInterface &object);
 
-	asizei SleepOn(std::vector<SocketInterface*> &read, std::vector<SocketInterface*> &write, asizei timeoutms);
+	asizei SleepOn(asizei timeoutms);
 	SockErr GetSocketError();
+	void Wake();
 
 	ServiceSocketInterface& NewServiceSocket(aushort port, aushort numPending);
 	void CloseServiceSocket(ServiceSocketInterface &what);
 	ConnectedSocketInterface& BeginConnection(ServiceSocketInterface &listener);
 };
+#endif
 
 
+#if defined(_WIN32)
 typedef WindowsNetwork Network;
+#elif defined(__linux__)
+class EpollNetwork;
+typedef EpollNetwork Network;
+#include "Linux/EpollNetwork.h"
+#endif
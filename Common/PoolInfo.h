@@ -24,6 +24,7 @@ struct PoolInfo {
     string pass;
     string name;
     string algo;
+    double targetSharesPerMinute = .0; //!< if non-zero, difficulty is negotiated with the pool to find about this many shares
     explicit PoolInfo() = default;
     PoolInfo(const string &nick, const string &url, const string &userutf8, const string &passutf8)
         : user(userutf8), pass(passutf8), merkleMode(mm_SHA256D), name(nick), appLevelProtocol("stratum"),
@@ -0,0 +1,39 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+#include "AREN/ArenDataTypes.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+
+/*! An immutable value written by one thread and read by many. Once published a value is never modified: the writer builds a new one
+and publishes it, readers holding the old one keep using it until they notice the generation changed.
+
+Readers are supposed to look at the generation, which is a single atomic load, and get the value only when it changes. That's because
+getting the value is not lock free: std::atomic_load on a shared_ptr takes a lock the standard library keeps for this (a global spin lock
+with MSVC, one from a small pool of mutexes with libstdc++) as the pointer and the reference count cannot be updated together atomically.
+It's held for the time of a copy and taken once per publish by each reader so it's not worth doing anything more complicated. */
+template<typename Value>
+class PublishedSnapshot {
+public:
+	//! Never null, starts with a default built value at generation 0.
+	std::shared_ptr<const Value> Get() const { return std::atomic_load_explicit(&value, std::memory_order_acquire); }
+
+	//! A reader seeing a generation then calling Get gets that value or a newer one.
+	asizei Generation() const { return generation.load(std::memory_order_acquire); }
+
+	/*! \param guard the generation changes with this held. Readers sleeping on a condition variable check the generation with it held so
+	they can't miss the change. Notify them after this returns. */
+	void Publish(std::shared_ptr<const Value> next, std::mutex &guard) {
+		std::atomic_store_explicit(&value, std::move(next), std::memory_order_release);
+		std::unique_lock<std::mutex> lock(guard);
+		generation.fetch_add(1, std::memory_order_release);
+	}
+
+private:
+	std::shared_ptr<const Value> value { std::make_shared<Value>() }; //!< always accessed through the atomic_ functions
+	std::atomic<asizei> generation { 0 };
+};
@@ -0,0 +1,67 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#include "SharedMemory.h"
+#include <exception>
+#include <stdexcept>
+
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+#if defined(_WIN32)
+
+SharedMemory::SharedMemory(const std::string &name, asizei size, Mode mode) : size(size) {
+	const std::string osName("Local\\" + name); // session namespace, the other side is our child anyway
+	if(mode == sm_create) {
+		const aulong bytes(size);
+		mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, DWORD(bytes >> 32), DWORD(bytes), osName.c_str());
+		if(mapping && GetLastError() == ERROR_ALREADY_EXISTS) {
+			CloseHandle(mapping);
+			throw std::exception("Shared memory name already taken.");
+		}
+	}
+	else mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, osName.c_str());
+	if(!mapping) throw std::exception(mode == sm_create? "Could not create shared memory." : "Could not open shared memory.");
+	base = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+	if(!base) {
+		CloseHandle(mapping);
+		throw std::exception("Could not map shared memory.");
+	}
+}
+
+
+SharedMemory::~SharedMemory() {
+	UnmapViewOfFile(base);
+	CloseHandle(mapping); // the name goes away with the last handle
+}
+
+#else
+
+SharedMemory::SharedMemory(const std::string &name, asizei size, Mode mode) : size(size), owner(mode == sm_create), osName('/' + name) {
+	fd = shm_open(osName.c_str(), owner? O_RDWR | O_CREAT | O_EXCL : O_RDWR, 0600);
+	if(fd < 0) throw std::runtime_error(owner? "Could not create shared memory." : "Could not open shared memory.");
+	struct stat info;
+	const bool good = owner? ftruncate(fd, off_t(size)) == 0 : fstat(fd, &info) == 0 && asizei(info.st_size) >= size;
+	if(good) {
+		base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if(base != MAP_FAILED) return;
+	}
+	close(fd);
+	if(owner) shm_unlink(osName.c_str());
+	throw std::runtime_error("Could not map shared memory.");
+}
+
+
+SharedMemory::~SharedMemory() {
+	munmap(base, size);
+	close(fd);
+	if(owner) shm_unlink(osName.c_str());
+}
+
+#endif
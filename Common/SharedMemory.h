@@ -0,0 +1,42 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+#include "AREN/ArenDataTypes.h"
+#include <string>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#endif
+
+
+/*! A block of memory two processes can see, found by name. One process creates it, the other opens it knowing the name.
+It's always mapped read-write and comes zeroed. The creator removes the name when it goes away, the memory itself lives as long
+as somebody has it mapped, so the other side can keep using it even if the creator is gone.
+Names should be letters, numbers and underscores only, the OS decorations are added here. Failures throw std::exception. */
+class SharedMemory {
+public:
+	enum Mode {
+		sm_create, //!< fails if the name is already taken
+		sm_open //!< fails if the name does not exist or it's smaller than size
+	};
+	SharedMemory(const std::string &name, asizei size, Mode mode);
+	~SharedMemory();
+	SharedMemory(const SharedMemory&) = delete;
+	SharedMemory& operator=(const SharedMemory&) = delete;
+
+	void* Get() const { return base; }
+	asizei Size() const { return size; }
+
+private:
+	void *base = nullptr;
+	asizei size = 0;
+#if defined(_WIN32)
+	HANDLE mapping = NULL;
+#else
+	int fd = -1;
+	bool owner = false;
+	std::string osName;
+#endif
+};
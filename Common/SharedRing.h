@@ -0,0 +1,49 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+#include "AREN/ArenDataTypes.h"
+#include <atomic>
+#include <type_traits>
+
+
+/*! One producer, one consumer, fixed size, no locks, no pointers: it is meant to sit in a SharedMemory block with the two sides in
+different processes. Nothing in there can refer to the address space of either, so records are copied in and out and must be plain data.
+Counters only grow (wrapping around) and slot is counter % SLOTS, the difference between the two is how many records are waiting.
+
+The object is not constructed by anybody: shared memory comes zeroed and zero counters mean empty ring, that's all the initialization needed.
+For this to work across processes the atomics must be lock-free, otherwise they would be protected by a lock living in one process only. */
+template<typename Record, auint SLOTS>
+class SharedRing {
+	static_assert(SLOTS && (SLOTS & (SLOTS - 1)) == 0, "SharedRing size must be a power of two so it divides counters wrapping around.");
+	static_assert(std::is_trivially_copyable<Record>::value, "SharedRing records are memcopied across processes, they must be plain data.");
+	static_assert(ATOMIC_INT_LOCK_FREE == 2, "SharedRing needs lock-free atomics to be shared across processes.");
+public:
+	//! Producer side. \returns false if the ring is full, the consumer is late.
+	bool Push(const Record &add) {
+		const auint at = head.load(std::memory_order_relaxed);
+		if(at - tail.load(std::memory_order_acquire) == SLOTS) return false;
+		slots[at % SLOTS] = add;
+		head.store(at + 1, std::memory_order_release);
+		return true;
+	}
+
+	//! Consumer side. \returns false if there's nothing to pop.
+	bool Pop(Record &out) {
+		const auint at = tail.load(std::memory_order_relaxed);
+		if(head.load(std::memory_order_acquire) == at) return false;
+		out = slots[at % SLOTS];
+		tail.store(at + 1, std::memory_order_release);
+		return true;
+	}
+
+	//! Either side, it's exact only for the consumer.
+	auint Size() const { return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire); }
+
+private:
+	// Each side writes its own counter only, keep them on different cache lines.
+	alignas(64) std::atomic<auint> head; //!< next slot to write
+	alignas(64) std::atomic<auint> tail; //!< next slot to read
+	alignas(64) Record slots[SLOTS];
+};
@@ -7,6 +7,7 @@
 1- Effective work block headers
 2- Difficulty adjustments. */
 #include <array>
+#include <atomic>
 #include "../AREN/ArenDataTypes.h"
 
 
@@ -49,24 +50,27 @@ public:
     const std::string job;
     const bool restart; //!< if false, take nonce2 from previous factory, if any, call Continuing before anything else
 
-    void Continuing(const AbstractWorkFactory &previous) { nonce2 = previous.nonce2; }
+    void Continuing(const AbstractWorkFactory &previous) { nonce2 = previous.nonce2.load(); }
 
+    /*! Factories are shared by all the mining threads working for the same pool so this can be called by many threads at once.
+    Each call takes its own nonce2 from an atomic counter and slaps it in its own copy of the coinbase, nothing else is modified. */
     Work MakeNoncedHeader(bool littleEndianAlgo, aulong algoDiffNumerator) {
         Work result;
-        const asizei rem = coinbase.size() - nonceTwoOff;
-        const auint nonce2BE = HTON(nonce2);
-	    memcpy_s(coinbase.data() + nonceTwoOff, rem, &nonce2BE, sizeof(nonce2BE));
-        result.nonce2 = nonce2++;
+        result.nonce2 = nonce2.fetch_add(1, std::memory_order_relaxed);
+        std::vector<aubyte> nonced(coinbase);
+        const asizei rem = nonced.size() - nonceTwoOff;
+        const auint nonce2BE = HTON(result.nonce2);
+	    memcpy_s(nonced.data() + nonceTwoOff, rem, &nonce2BE, sizeof(nonce2BE));
         result.ntime = ntime;
         result.job = job;
 		std::array<aubyte, 32> merkleRoot;
-		initialMerkle(merkleRoot, coinbase);
+		initialMerkle(merkleRoot, nonced);
 		std::array<aubyte, 64> merkleSHA;
 		std::copy(merkleRoot.cbegin(), merkleRoot.cend(), merkleSHA.begin());
 		for(asizei loop = 0; loop < merkles.size(); loop++) {
 			auto &sign(merkles[loop]);
 			std::copy(sign.cbegin(), sign.cend(), merkleSHA.begin() + 32);
-			btc::SHA256Based(DestinationStream(merkleRoot.data(), sizeof(merkleRoot)), merkleSHA);
+			btc::SHA256Based(merkleRoot, merkleSHA);
 			std::copy(merkleRoot.cbegin(), merkleRoot.cend(), merkleSHA.begin());
 		}
 		// vvv I tried to do that using std::copy, but I hate it.
@@ -96,8 +100,15 @@ public:
 	}
     virtual double GetNetworkDiff() const = 0;
 
+    //! Previous block hash as it sits in the header. Pools giving out the same one are working on the same block.
+    std::array<aubyte, 32> GetPrevHash() const {
+        std::array<aubyte, 32> ret;
+        std::copy(blankHeader.cbegin() + 4, blankHeader.cbegin() + 36, ret.begin());
+        return ret;
+    }
+
 protected:
-    auint nonce2 = 0;
+    std::atomic<auint> nonce2 { 0 };
     asizei nonceTwoOff;
     auint ntime;
     std::vector<aubyte> coinbase; //!< binary, nonce2 is to be put there at a certain offset specified below.
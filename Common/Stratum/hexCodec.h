@@ -0,0 +1,231 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+#include "../AREN/ArenDataTypes.h"
+#if defined(_M_AMD64) || defined(_M_IX86)
+#include <intrin.h>
+#include <emmintrin.h>
+#include <immintrin.h>
+#define STRATUM_HEX_SIMD 1
+#define STRATUM_HEX_AVX2_TARGET
+#elif (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#include <cpuid.h>
+#include <emmintrin.h>
+#include <immintrin.h>
+#define STRATUM_HEX_SIMD 1
+#define STRATUM_HEX_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+namespace stratum {
+
+/*! Stratum traffic is mostly hex. Every notify carries a few KiB of it and every share we submit has to be hex-encoded back.
+This is the one place where hex is handled, both ways.
+Decoding is strict: anything which is not [0-9a-fA-F] is an error, as are odd lengths and it's up to the caller to decide what to do.
+On x86 there are SSE2 paths (always there on x64) and an AVX2 path for decoding, selected at runtime.
+The scalar code is still the reference, everything else must produce the same bytes. */
+namespace hex {
+
+namespace detail {
+
+//! 0xFF is invalid. Built on first use, no static initialization order fiasco.
+inline const aubyte* DecodeTable() {
+    struct Table {
+        aubyte value[256];
+        Table() {
+            for(asizei i = 0; i < 256; i++) value[i] = 0xFF;
+            for(asizei i = 0; i < 10; i++) value['0' + i] = aubyte(i);
+            for(asizei i = 0; i < 6; i++) {
+                value['a' + i] = aubyte(10 + i);
+                value['A' + i] = aubyte(10 + i);
+            }
+        }
+    };
+    static const Table table;
+    return table.value;
+}
+
+inline bool DecodeScalar(aubyte *dst, const char *src, asizei bytes) {
+    const aubyte *table = DecodeTable();
+    aubyte bad = 0;
+    for(asizei loop = 0; loop < bytes; loop++) {
+        const aubyte hi = table[aubyte(src[loop * 2])];
+        const aubyte lo = table[aubyte(src[loop * 2 + 1])];
+        bad |= hi | lo;
+        dst[loop] = aubyte(hi << 4) | (lo & 0x0F);
+    }
+    return (bad & 0xF0) == 0; // invalid marker has the high nibble set, no valid nibble has
+}
+
+inline void EncodeScalar(char *dst, const aubyte *src, asizei count) {
+    const char *digits = "0123456789abcdef";
+    for(asizei loop = 0; loop < count; loop++) {
+        dst[loop * 2] = digits[src[loop] >> 4];
+        dst[loop * 2 + 1] = digits[src[loop] & 0x0F];
+    }
+}
+
+#if STRATUM_HEX_SIMD
+inline bool HasAVX2() {
+    struct Probe {
+        bool avx2;
+        Probe() : avx2(false) {
+#if defined(_MSC_VER)
+            int info[4];
+            __cpuid(info, 0);
+            if(info[0] < 7) return;
+            __cpuid(info, 1);
+            const bool osxsave = (info[2] & (1 << 27)) != 0;
+            const bool avx = (info[2] & (1 << 28)) != 0;
+            if(!osxsave || !avx) return;
+            if((_xgetbv(0) & 6) != 6) return; // OS must save YMM state
+            __cpuidex(info, 7, 0);
+            avx2 = (info[1] & (1 << 5)) != 0;
+#else
+            unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+            if(__get_cpuid_max(0, nullptr) < 7) return;
+            __get_cpuid(1, &eax, &ebx, &ecx, &edx);
+            const bool osxsave = (ecx & bit_OSXSAVE) != 0;
+            const bool avx = (ecx & bit_AVX) != 0;
+            if(!osxsave || !avx) return;
+            unsigned int xcr0lo, xcr0hi; // _xgetbv would need the whole TU built with -mxsave
+            __asm__("xgetbv" : "=a"(xcr0lo), "=d"(xcr0hi) : "c"(0));
+            if((xcr0lo & 6) != 6) return; // OS must save YMM state
+            __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx);
+            avx2 = (ebx & bit_AVX2) != 0;
+#endif
+        }
+    };
+    static const Probe probe;
+    return probe.avx2;
+}
+
+//! 16 chars to 16 nibbles. All-ones in valid lanes of the mask, so the caller can just movemask it.
+inline __m128i Nibbles(__m128i chars, __m128i &valid) {
+    const __m128i lower = _mm_or_si128(chars, _mm_set1_epi8(0x20));
+    const __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(chars, _mm_set1_epi8('9' + 1)));
+    const __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+    valid = _mm_or_si128(digit, alpha);
+    const __m128i fromDigit = _mm_and_si128(digit, _mm_sub_epi8(chars, _mm_set1_epi8('0')));
+    const __m128i fromAlpha = _mm_and_si128(alpha, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10)));
+    return _mm_or_si128(fromDigit, fromAlpha);
+}
+
+//! Pairs of nibbles (hi first as in the string) to 16-bit values, one byte each.
+inline __m128i PackNibbles(__m128i nibbles) {
+    const __m128i hi = _mm_slli_epi16(_mm_and_si128(nibbles, _mm_set1_epi16(0x00FF)), 4);
+    const __m128i lo = _mm_srli_epi16(nibbles, 8);
+    return _mm_or_si128(hi, lo);
+}
+
+inline bool DecodeSSE2(aubyte *dst, const char *src, asizei &bytes) {
+    while(bytes >= 8) {
+        __m128i valid;
+        const __m128i nibbles = Nibbles(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src)), valid);
+        if(_mm_movemask_epi8(valid) != 0xFFFF) return false;
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), _mm_packus_epi16(PackNibbles(nibbles), _mm_setzero_si128()));
+        src += 16;
+        dst += 8;
+        bytes -= 8;
+    }
+    return true;
+}
+
+/*! MSVC lets us use AVX2 intrinsics without compiling everything for AVX2, GCC and Clang need the target attribute for this function only.
+Either way this is only ever called after HasAVX2().
+It does the same things as the SSE2 path, just twice as wide. The only catch is packing happens in 128-bit lanes. */
+STRATUM_HEX_AVX2_TARGET inline bool DecodeAVX2(aubyte *dst, const char *src, asizei &bytes) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i below0 = _mm256_set1_epi8('0' - 1), above9 = _mm256_set1_epi8('9' + 1);
+    const __m256i belowA = _mm256_set1_epi8('a' - 1), aboveF = _mm256_set1_epi8('f' + 1);
+    while(bytes >= 16) {
+        const __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+        const __m256i lower = _mm256_or_si256(chars, _mm256_set1_epi8(0x20));
+        const __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(chars, below0), _mm256_cmpgt_epi8(above9, chars));
+        const __m256i alpha = _mm256_and_si256(_mm256_cmpgt_epi8(lower, belowA), _mm256_cmpgt_epi8(aboveF, lower));
+        if(_mm256_movemask_epi8(_mm256_or_si256(digit, alpha)) != -1) return false;
+        const __m256i nibbles = _mm256_or_si256(_mm256_and_si256(digit, _mm256_sub_epi8(chars, _mm256_set1_epi8('0'))),
+                                                _mm256_and_si256(alpha, _mm256_sub_epi8(lower, _mm256_set1_epi8('a' - 10))));
+        const __m256i hi = _mm256_slli_epi16(_mm256_and_si256(nibbles, _mm256_set1_epi16(0x00FF)), 4);
+        const __m256i lo = _mm256_srli_epi16(nibbles, 8);
+        const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(_mm256_or_si256(hi, lo), zero), 0xD8);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm256_castsi256_si128(packed));
+        src += 32;
+        dst += 16;
+        bytes -= 16;
+    }
+    return true;
+}
+
+//! 8 bytes to 16 lowercase chars.
+inline void EncodeSSE2(char *dst, const aubyte *src, asizei &count) {
+    while(count >= 8) {
+        const __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src));
+        const __m128i hi = _mm_and_si128(_mm_srli_epi16(bytes, 4), _mm_set1_epi8(0x0F));
+        const __m128i lo = _mm_and_si128(bytes, _mm_set1_epi8(0x0F));
+        const __m128i nibbles = _mm_unpacklo_epi8(hi, lo);
+        const __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9)), _mm_set1_epi8('a' - '0' - 10));
+        const __m128i chars = _mm_add_epi8(_mm_add_epi8(nibbles, _mm_set1_epi8('0')), letters);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), chars);
+        src += 8;
+        dst += 16;
+        count -= 8;
+    }
+}
+#endif
+
+}
+
+
+/*! Decodes len hex chars to len / 2 bytes.
+\returns false if len is odd or a non-hex char is found. The content of dst is undefined in that case. */
+inline bool Decode(aubyte *dst, const char *src, asizei len) {
+    if(len % 2) return false;
+    asizei bytes = len / 2;
+#if STRATUM_HEX_SIMD
+    const asizei initial = bytes;
+    if(bytes >= 16 && detail::HasAVX2()) {
+        if(!detail::DecodeAVX2(dst, src, bytes)) return false;
+    }
+    if(bytes >= 8) {
+        const asizei done = initial - bytes;
+        if(!detail::DecodeSSE2(dst + done, src + done * 2, bytes)) return false;
+    }
+    const asizei done = initial - bytes;
+    dst += done;
+    src += done * 2;
+#endif
+    return detail::DecodeScalar(dst, src, bytes);
+}
+
+//! Value of a single hex char or 0xFF if invalid.
+inline aubyte DecodeNibble(char c) { return detail::DecodeTable()[aubyte(c)]; }
+
+//! Produces count * 2 lowercase hex chars. Does not terminate the string.
+inline void Encode(char *dst, const aubyte *src, asizei count) {
+#if STRATUM_HEX_SIMD
+    const asizei initial = count;
+    detail::EncodeSSE2(dst, src, count);
+    dst += (initial - count) * 2;
+    src += initial - count;
+#endif
+    detail::EncodeScalar(dst, src, count);
+}
+
+/*! Writes 8 lowercase hex chars representing the value as a big endian number, as printf("%08x") would do.
+This is what stratum wants for nonce2 and ntime. */
+inline void EncodeBE(char *dst, auint value) {
+    const aubyte bytes[4] = { aubyte(value >> 24), aubyte(value >> 16), aubyte(value >> 8), aubyte(value) };
+    detail::EncodeScalar(dst, bytes, sizeof(bytes));
+}
+
+/*! Same as above but for memory order of the value, which is what stratum wants for the nonce (it's really a part of the header). */
+inline void EncodeLE(char *dst, auint value) {
+    const aubyte bytes[4] = { aubyte(value), aubyte(value >> 8), aubyte(value >> 16), aubyte(value >> 24) };
+    detail::EncodeScalar(dst, bytes, sizeof(bytes));
+}
+
+
+}
+}
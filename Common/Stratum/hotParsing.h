@@ -0,0 +1,256 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+#include <rapidjson/reader.h>
+#include "parsing.h"
+
+namespace stratum {
+namespace parsing {
+
+/*! Building a DOM for every line is the right thing to do when you have no idea of what you'll be getting.
+But we mostly know: the overwhelming majority of pool traffic is mining.notify, mining.set_difficulty and replies to our own mining.submit.
+This object runs a single SAX pass on the line and remembers just enough to figure out which one it is.
+Strings are appended to an internal buffer, tokens only keep offsets there so after the first few messages nothing gets allocated anymore.
+Anything looking even slightly unusual (objects in params, result arrays, errors, methods I don't care about...) terminates the parse early:
+it's not an error, it just means the caller has to go through the usual DOM path. To make this possible, the line is never modified. */
+class HotMessageParser : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, HotMessageParser> {
+public:
+    enum Kind {
+        hm_unknown,
+        hm_notify,
+        hm_difficulty,
+        hm_reply
+    };
+
+    HotMessageParser() {
+        text.reserve(4 * 1024);
+        params.reserve(16);
+        merkles.reserve(32);
+    }
+
+    /*! \param line a nul-terminated line, not including the newline.
+    \returns false if the line must be parsed the usual way. This happens both for malformed lines and lines requiring the flexibility of a DOM. */
+    bool Parse(const char *line) {
+        Reset();
+        rapidjson::StringStream input(line);
+        reader.Parse<rapidjson::kParseDefaultFlags>(input, *this);
+        if(reader.HasParseError()) return false;
+        if(method.type == t_string) {
+            const char *name = Text(method);
+            if(!strcmp(name, "mining.notify")) kind = hm_notify;
+            else if(!strcmp(name, "mining.set_difficulty")) kind = hm_difficulty;
+        }
+        else if(method.type == t_none) kind = hm_reply;
+        return kind != hm_unknown;
+    }
+
+    Kind GetKind() const { return kind; }
+
+    //! Mirrors MiningNotifyParser, with one difference: only fields which are strings are accepted. Returns false if the DOM path is required.
+    //! Decoding errors are thrown exactly as the DOM path would do.
+    bool Decode(MiningNotify &dst) const {
+        if(kind != hm_notify || params.size() != 9) return false;
+        if(params[8].type != t_bool) return false;
+        for(asizei check = 0; check < 8; check++) {
+            if(check == 4) continue;
+            if(params[check].type != t_string) return false;
+        }
+        if(params[4].type != t_array) return false;
+        dst.clear = params[8].boolean;
+        dst.ntime = AbstractParser::DecodeHEX<__int32>(Text(params[7]), params[7].len);
+        dst.nbits = AbstractParser::DecodeHEX<__int32>(Text(params[6]), params[6].len);
+        dst.blockVer = AbstractParser::DecodeHEX<__int32>(Text(params[5]), params[5].len);
+        dst.job.assign(Text(params[0]), params[0].len);
+        AbstractParser::DecodeHEX(dst.prevHash, Text(params[1]), params[1].len);
+        AbstractParser::DecodeHEX(dst.coinBaseOne, Text(params[2]), params[2].len);
+        AbstractParser::DecodeHEX(dst.coinBaseTwo, Text(params[3]), params[3].len);
+        dst.merkles.resize(merkles.size());
+        for(asizei loop = 0; loop < merkles.size(); loop++) {
+            if(merkles[loop].type != t_string) throw std::exception("Merkle array contains non-string element.");
+            AbstractParser::DecodeHEX(dst.merkles[loop].hash, Text(merkles[loop]), merkles[loop].len);
+        }
+        return true;
+    }
+
+    //! Mirrors MiningSetDifficulty. 64-bit values go through the DOM which will complain accordingly.
+    bool Decode(double &difficulty) const {
+        if(kind != hm_difficulty || params.empty() || params[0].type != t_number) return false;
+        difficulty = params[0].number;
+        return true;
+    }
+
+    //! Replies are hot only if they have a numeric id (as all our ids are), a boolean result and no error.
+    //! This is the shape of every mining.submit reply. It's up to the caller to check the id matches a submit.
+    bool GetSubmitReply(aulong &id, bool &accepted) const {
+        if(kind != hm_reply || this->id.type != t_integer) return false;
+        if(result.type != t_bool || (error.type != t_none && error.type != t_null)) return false;
+        id = this->id.integer;
+        accepted = result.boolean;
+        return true;
+    }
+
+    // rapidjson::Reader handler interface ///////////////////////////////////////////////////////////////////////////
+    bool Default() { return false; }
+    bool Null() { return Scalar(Token(t_null)); }
+    bool Bool(bool b) {
+        Token add(t_bool);
+        add.boolean = b;
+        return Scalar(add);
+    }
+    bool Int(int i) { return i < 0? Number(double(i)) : Uint(unsigned(i)); }
+    bool Uint(unsigned u) {
+        Token add(t_number);
+        add.number = double(u);
+        add.integer = u;
+        add.natural = true;
+        return Scalar(add);
+    }
+    bool Int64(__int64 i) { return Scalar(Token(t_number64)); }
+    bool Uint64(unsigned __int64 u) {
+        if(depth == 1 && field == k_id) {
+            Token add(t_integer);
+            add.integer = u;
+            return Scalar(add);
+        }
+        return Scalar(Token(t_number64));
+    }
+    bool Double(double d) { return Number(d); }
+    bool String(const char *str, rapidjson::SizeType length, bool copy) {
+        Token add(t_string);
+        add.off = text.size();
+        add.len = length;
+        text.append(str, length);
+        text.push_back(0);
+        return Scalar(add);
+    }
+    bool Key(const char *str, rapidjson::SizeType length, bool copy) {
+        if(depth != 1) return false;
+        field = k_other;
+        auto is = [str, length](const char *name) { return strlen(name) == length && !strncmp(str, name, length); };
+        if(is("id")) field = k_id;
+        else if(is("method")) field = k_method;
+        else if(is("params")) field = k_params;
+        else if(is("result")) field = k_result;
+        else if(is("error")) field = k_error;
+        return true;
+    }
+    bool StartObject() {
+        if(depth) return false; // objects are only in errors and rare replies
+        depth++;
+        return true;
+    }
+    bool EndObject(rapidjson::SizeType memberCount) {
+        depth--;
+        return true;
+    }
+    bool StartArray() {
+        if(depth == 1 && field == k_params) params.clear();
+        else if(depth == 2 && field == k_params && !nested) {
+            params.push_back(Token(t_array));
+            nested = true;
+        }
+        else return false;
+        depth++;
+        return true;
+    }
+    bool EndArray(rapidjson::SizeType elementCount) {
+        depth--;
+        return true;
+    }
+
+private:
+    enum TokenType {
+        t_none,
+        t_null,
+        t_bool,
+        t_number,
+        t_number64, //!< those are not supported by parsers, will go DOM and be rejected there
+        t_integer,  //!< ids only
+        t_string,
+        t_array     //!< only as a params element, the merkle array
+    };
+    struct Token {
+        TokenType type;
+        asizei off, len;
+        double number;
+        aulong integer;
+        bool boolean, natural;
+        explicit Token(TokenType tt = t_none) : type(tt), off(0), len(0), number(.0), integer(0), boolean(false), natural(false) { }
+    };
+    enum Field {
+        k_other,
+        k_id,
+        k_method,
+        k_params,
+        k_result,
+        k_error
+    };
+
+    rapidjson::Reader reader;
+    std::string text;
+    std::vector<Token> params, merkles;
+    Token id, method, result, error;
+    Kind kind;
+    asizei depth;
+    Field field;
+    bool nested;
+
+    void Reset() {
+        text.clear();
+        params.clear();
+        merkles.clear();
+        id = method = result = error = Token();
+        kind = hm_unknown;
+        depth = 0;
+        field = k_other;
+        nested = false;
+    }
+
+    const char* Text(const Token &token) const { return text.c_str() + token.off; }
+
+    bool Number(double value) {
+        Token add(t_number);
+        add.number = value;
+        return Scalar(add);
+    }
+
+    bool Scalar(const Token &value) {
+        if(depth == 3) {
+            merkles.push_back(value);
+            return true;
+        }
+        if(depth == 2) {
+            params.push_back(value);
+            return true;
+        }
+        if(depth != 1) return false;
+        switch(field) {
+        case k_id: {
+            // ids are naturals, possibly as strings. Everything else goes to DOM which will throw.
+            id = value;
+            if(value.type == t_number && value.natural) id.type = t_integer;
+            else if(value.type == t_string) {
+                const char *digits = Text(value);
+                for(asizei check = 0; check < value.len; check++) {
+                    if(digits[check] < '0' || digits[check] > '9') return false;
+                }
+                id.type = t_integer;
+                id.integer = strtoul(digits, NULL, 10);
+            }
+            else if(value.type != t_integer && value.type != t_null) return false;
+            return true;
+        }
+        case k_method: method = value; return true;
+        case k_result: result = value; return true;
+        case k_error: error = value; return true;
+        case k_params: return false; // not an array, let the DOM complain
+        default: return true; // other fields are ignored by the DOM path as well
+        }
+    }
+};
+
+
+}
+}
@@ -5,6 +5,7 @@
 #pragma once
 #include <rapidjson/document.h> // Value
 #include "messages.h"
+#include "hexCodec.h"
 #include <memory>
 #include "../AREN/ArenDataTypes.h"
 
@@ -18,21 +19,17 @@ struct AbstractParser {
 	/*! Decode a hex character to its value, with safety checks.
 	\returns 0 <= ret < 16 */
 	static __int8 DecodeHEX(char c) {
-		c = toupper(c);
-		if(c >= '0' && c <= '9') return c - '0';
-		if(c >= 'A' && c <= 'F') return c - 'A' + 10;
-		throw std::exception("Hexadecimal string contains invalid character.");
-		return c;
+		const aubyte value = hex::DecodeNibble(c);
+		if(value > 0x0F) throw std::exception("Hexadecimal string contains invalid character.");
+		return __int8(value);
 	}
 
 	/* Decode a string made of hex digits in an array of uint8 being half as long.
 	\returns The vector used as destination. */
 	static std::vector<aubyte>& DecodeHEX(std::vector<aubyte> &dst, const char *hex, asizei len) {
-		if(len % 1) throw std::exception("Hexadecimal string truncated.");
+		if(len % 2) throw std::exception("Hexadecimal string truncated.");
 		dst.resize(len / 2);
-		for(size_t scan = 0; scan < len; scan += 2) {
-			dst[scan / 2] = DecodeHEX(hex[scan]) << 4 | DecodeHEX(hex[scan + 1]); // + is ok too
-		}
+		if(!hex::Decode(dst.data(), hex, len)) throw std::exception("Hexadecimal string contains invalid character.");
 		return dst;
 	}
 	static std::vector<unsigned __int8>& DecodeHEX(std::vector<unsigned __int8> &dst, const std::string &hex) {
@@ -40,17 +37,9 @@ struct AbstractParser {
 	}
 	/*! Takes a few bytes and produces a HEX string. */
 	static std::string EncodeToHEX(const aubyte *stream, asizei count) {
-		std::unique_ptr<char[]> enc(new char[count * 2 + 1]);
-		char *dst = enc.get();
-		char *digits = "0123456789abcdef";
-		for(asizei loop = 0; loop < count; loop++) {
-			*dst = digits[stream[loop] >> 4];
-			dst++;
-			*dst = digits[stream[loop] & 0x0F];
-			dst++;
-		}
-		*dst = 0;
-		return std::string(enc.get());
+		std::string enc(count * 2, 0);
+		if(count) hex::Encode(&enc[0], stream, count);
+		return enc;
 	}
 	static std::string EncodeToHEX(const std::vector<aubyte> &stream) {
 		return EncodeToHEX(stream.data(), stream.size());
@@ -62,21 +51,23 @@ struct AbstractParser {
 		return EncodeToHEX(reinterpret_cast<aubyte*>(&value), sizeof(value));
 	}
 	template<size_t SZ>
-	static std::array<unsigned __int8, SZ>& DecodeHEX(std::array<unsigned __int8, SZ> &dst, const std::string &hex) {
-		if(hex.length() % 1) throw std::exception("Hexadecimal string truncated.");
-		if(hex.size() < hex.length() / 2) throw std::exception("Hexadecimal string is too long, overflows available constant bits.");
-		for(size_t scan = 0; scan < hex.length(); scan += 2) {
-			dst[scan / 2] = DecodeHEX(hex[scan]) << 4 | DecodeHEX(hex[scan + 1]); // + is ok too
-		}
+	static std::array<unsigned __int8, SZ>& DecodeHEX(std::array<unsigned __int8, SZ> &dst, const char *hex, asizei len) {
+		if(len % 2) throw std::exception("Hexadecimal string truncated.");
+		if(dst.size() < len / 2) throw std::exception("Hexadecimal string is too long, overflows available constant bits.");
+		if(!hex::Decode(dst.data(), hex, len)) throw std::exception("Hexadecimal string contains invalid character.");
 		return dst;
 	}
+	template<size_t SZ>
+	static std::array<unsigned __int8, SZ>& DecodeHEX(std::array<unsigned __int8, SZ> &dst, const std::string &hex) {
+		return DecodeHEX(dst, hex.c_str(), hex.length());
+	}
 	template<typename Integer>
-	static Integer DecodeHEX(const std::string &hex) {
+	static Integer DecodeHEX(const char *hex, asizei len) {
 		Integer ret(0);
-		if(hex.length() / 2 > sizeof(Integer)) throw std::exception("Too many bits to pack.");
+		if(len / 2 > sizeof(Integer)) throw std::exception("Too many bits to pack.");
 		size_t shift = 0;
-		for(size_t scan = 0; scan < hex.length(); scan++) {
-			char c = hex[hex.length() - 1 - scan];
+		for(size_t scan = 0; scan < len; scan++) {
+			char c = hex[len - 1 - scan];
 			ret |= DecodeHEX(c) << shift;
 			//! \todo this assumes the target machine is little endian.
 			//! so when the message is big-endian, we also swap
@@ -85,6 +76,8 @@ struct AbstractParser {
 		}
 		return ret;
 	}
+	template<typename Integer>
+	static Integer DecodeHEX(const std::string &hex) { return DecodeHEX<Integer>(hex.c_str(), hex.length()); }
 
 	static std::string ToString(const rapidjson::Value &something) {
 		// Maybe it would be just better to pretty-print everything here and be done with it? Is that for documents only
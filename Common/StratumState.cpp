@@ -6,7 +6,7 @@
 
 
 asizei StratumState::PushMethod(const char *method, const string &pairs) {
-	asizei used = nextRequestID++;
+	asizei used = NextRequestID();
 	string idstr("{");
 	idstr += "\"id\": \"" + std::to_string(used) + "\", ";
 	idstr += "\"method\": \"";
@@ -16,10 +16,9 @@ asizei StratumState::PushMethod(const char *method, const string &pairs) {
 	Blob add(idstr.c_str(), idstr.length(), used);
 	pendingRequests.insert(std::make_pair(used, method));
 	ScopedFuncCall pullout([used, this] { pendingRequests.erase(used); });
-	pending.push(std::move(add));
+	pending.push_back(std::move(add));
 
 	pullout.Dont();
-	if(!nextRequestID) nextRequestID++; // we must have been running like one hundred years I guess
 	/* this was the initialization message. Regardless of when the server will
 	send the message, consider this to be initialization time. */
 	return used;
@@ -31,15 +30,21 @@ void StratumState::PushResponse(const string &serverid, const string &pairs) {
 	idstr += "\"id\": \"" + serverid + "\",";
 	idstr += pairs + "}\n";
 	Blob add(idstr.c_str(), idstr.length(), 0); // we don't need to track responses so just give them id 0
-	pending.push(std::move(add));
+	pending.push_back(std::move(add));
 }
 
 
-StratumState::StratumState()
-	: nextRequestID(1), difficulty(.0), errorCount(0) {
+StratumState::StratumState(const string &resumeSession, double minimumDiff)
+	: nextRequestID(1), difficulty(.0), errorCount(0), nextJobSlot(0) {
 	dataTimestamp = 0;
-	size_t used = PushMethod("mining.subscribe", KeyValue("params", "[]", false));
-	ScopedFuncCall pop([this]() { this->pending.pop(); });
+	if(minimumDiff > .0) { // BIP310: this goes first so the very first job can come with the right difficulty
+		const string params("[[\"minimum-difficulty\"], {\"minimum-difficulty.value\": " + DiffString(minimumDiff) + "}]");
+		PushMethod("mining.configure", KeyValue("params", params, false));
+	}
+	// Resuming needs the session ID as second parameter so the first must be the user agent.
+	const string params(resumeSession.empty()? "[]" : "[\"M8M\", " + Quoted(resumeSession) + "]");
+	size_t used = PushMethod("mining.subscribe", KeyValue("params", params, false));
+	ScopedFuncCall pop([this]() { this->pending.pop_back(); });
 	pendingRequests.insert(std::make_pair(used, "mining.subscribe"));
 	pop.Dont();
 }
@@ -53,7 +58,7 @@ void StratumState::Authorize(const char *user, const char *psw) {
 	identification += psw;
 	identification += "\"]";
 	asizei used = PushMethod("mining.authorize", KeyValue("params", identification, false));
-	ScopedFuncCall popMsg([this]() { this->pending.pop(); });
+	ScopedFuncCall popMsg([this]() { this->pending.pop_back(); });
 	pendingRequests.insert(std::make_pair(used, "mining.authorize"));
 	ScopedFuncCall popPending([this, used]() { this->pendingRequests.erase(used); });
 	workers.push_back(Worker(user, used));
@@ -63,6 +68,19 @@ void StratumState::Authorize(const char *user, const char *psw) {
 }
 
 
+void StratumState::SuggestDifficulty(double diff) {
+	PushMethod("mining.suggest_difficulty", KeyValue("params", "[" + DiffString(diff) + "]", false));
+}
+
+
+string StratumState::DiffString(double diff) {
+	std::stringstream str;
+	if(diff >= 1.0) str<<aulong(diff + .5);
+	else str<<std::setprecision(6)<<diff;
+	return str.str();
+}
+
+
 bool StratumState::IsWorker(const char *name) const {
 	auto match(std::find_if(workers.cbegin(), workers.cend(), [name](const Worker &test) { return test.name == name; }));
 	return match == workers.cend()? false : true;
@@ -76,30 +94,94 @@ StratumState::AuthStatus StratumState::GetAuthenticationStatus(const char *name)
 }
 
 
-asizei StratumState::SendWork(const std::string &job, auint ntime, auint nonce2, auint nonce) {
-	const char *user = workers[0].name.c_str(); //!< \todo quick hack to match, should be tracked by worker!
-	auto &worker(workers[0]);
+asizei StratumState::SendWork(const std::string &job, auint ntime, auint nonce2, auint nonce, bool block) {
+	auto &worker(workers[0]); //!< \todo quick hack to match, should be tracked by worker!
+	if(submitTemplate.job != job || submitTemplate.worker != worker.name) BuildSubmitTemplate(worker, job);
+
+	const size_t used = NextRequestID();
+	char digits[24];
+	asizei numDigits = 0;
+	for(asizei value = used; value || !numDigits; value /= 10) digits[numDigits++] = char('0' + value % 10);
+	const char prefix[] = "{\"id\": \"";
+	const asizei prefixLen = sizeof(prefix) - 1;
+
+	std::vector<__int8> message(TakeSpareBuffer());
+	message.resize(prefixLen + numDigits + submitTemplate.tail.size());
+	__int8 *dst = message.data();
+	memcpy(dst, prefix, prefixLen);
+	dst += prefixLen;
+	for(asizei cp = 0; cp < numDigits; cp++) *dst++ = digits[numDigits - 1 - cp];
+	memcpy(dst, submitTemplate.tail.data(), submitTemplate.tail.size());
+	stratum::hex::EncodeBE(dst + submitTemplate.nonce2Off, nonce2);
+	stratum::hex::EncodeBE(dst + submitTemplate.ntimeOff, ntime);
+	stratum::hex::EncodeLE(dst + submitTemplate.nonceOff, nonce); // the nonce is really part of the header so it goes in memory order
 
-	const char *sep = "\", \"";
-	std::stringstream params;
-	params<<std::hex;
-	params<<"[\""<<worker.name<<sep<<job<<sep
-		  <<std::setw(8)<<std::setfill('0')<<nonce2<<sep
-		  <<std::setw(8)<<std::setfill('0')<<ntime<<sep
-		  <<std::setw(8)<<std::setfill('0')<<HTON(nonce)<<"\"]";
-	const std::string message(params.str());
-	const size_t used = PushMethod("mining.submit", KeyValue("params", message, false));
-	ScopedFuncCall popMsg([this]() { this->pending.pop(); });
-	submittedWork.insert(std::make_pair(used, &worker));
-	ScopedFuncCall popSubmitted([this, used]() { this->submittedWork.erase(used); });
 	pendingRequests.insert(std::make_pair(used, "mining.submit"));
+	ScopedFuncCall pullout([used, this] { pendingRequests.erase(used); });
+	auto place(pending.end());
+	if(block) { // skip ordinary shares only: a partially sent message must be completed and authorization must go first
+		place = std::find_if(pending.begin(), pending.end(), [](const Blob &test) { return test.lane == sl_share && test.sent == 0; });
+	}
+	place = pending.insert(place, Blob(std::move(message), used, block? sl_block : sl_share));
+	ScopedFuncCall popMsg([this, place]() { this->pending.erase(place); });
+	submittedWork.insert(std::make_pair(used, &worker));
 	popMsg.Dont();
-	popSubmitted.Dont();
+	pullout.Dont();
 	worker.nonces.sent++;
     return used;
 }
 
 
+void StratumState::BuildSubmitTemplate(const Worker &worker, const std::string &job) {
+	// Must produce the very same bytes PushMethod would produce for this, minus the id.
+	const char *sep = "\", \"";
+	const string blank("00000000");
+	string tail("\", \"method\": \"mining.submit\", \"params\": [\"");
+	tail += worker.name + sep + job + sep;
+	const asizei nonce2Off = tail.length();
+	tail += blank + sep;
+	const asizei ntimeOff = tail.length();
+	tail += blank + sep;
+	const asizei nonceOff = tail.length();
+	tail += blank + "\"]}\n";
+
+	submitTemplate.tail.assign(tail.cbegin(), tail.cend());
+	submitTemplate.nonce2Off = nonce2Off;
+	submitTemplate.ntimeOff = ntimeOff;
+	submitTemplate.nonceOff = nonceOff;
+	submitTemplate.job = job;
+	submitTemplate.worker = worker.name;
+}
+
+
+std::vector<__int8> StratumState::TakeSpareBuffer() {
+	std::vector<__int8> ret;
+	if(spareBuffers.size()) {
+		ret = std::move(spareBuffers.back());
+		spareBuffers.pop_back();
+	}
+	return ret;
+}
+
+
+void StratumState::PopSent() {
+	const asizei MAX_SPARES = 32; // more than that and we have been through a burst. Let it go.
+	Blob &sent(pending.front());
+	using namespace std::chrono;
+	const double waited = duration_cast<microseconds>(steady_clock::now() - sent.queued).count() / 1000.0;
+	LaneLatency &stats(sendLatency[sent.lane]);
+	stats.average = stats.count? stats.average * .9 + waited * .1 : waited;
+	stats.worst = std::max(stats.worst, waited);
+	stats.count++;
+	if(sent.id && pendingRequests.find(sent.id) != pendingRequests.cend()) requestSent[sent.id] = steady_clock::now();
+	if(spareBuffers.size() < MAX_SPARES) {
+		spareBuffers.push_back(std::move(sent.data));
+		spareBuffers.back().clear();
+	}
+	pending.pop_front();
+}
+
+
 void StratumState::Request(const stratum::ClientGetVersionRequest &msg) {
     // There are various ways to produce a decent version string...
     // But at the end of the day it's just easier to fully rebuild and be done with it.
@@ -143,14 +225,55 @@ void StratumState::Response(asizei id, const stratum::MiningSubmitResponse &msg)
 }
 
 
+auint StratumState::GetJobNetworkTime(const std::string &job) const {
+	if(block.job == job) return block.ntime; // most likely
+	for(const auto &prev : recentJobs) {
+		if(prev.valid && prev.job == job) return prev.ntime;
+	}
+	return 0;
+}
+
+
+std::vector<std::pair<std::string, auint>> StratumState::GetValidJobs() const {
+	std::vector<std::pair<std::string, auint>> ret;
+	for(const auto &prev : recentJobs) {
+		if(prev.valid) ret.push_back(std::make_pair(prev.job, prev.ntime));
+	}
+	return ret;
+}
+
+
 void StratumState::Notify(const stratum::MiningNotify &msg) {
+	if(msg.clear) {
+		for(auto &prev : recentJobs) prev.valid = false;
+	}
+	auto slot(std::find_if(recentJobs.begin(), recentJobs.end(), [&msg](const RecentJob &test) { return test.job == msg.job; }));
+	if(slot == recentJobs.end()) {
+		slot = recentJobs.begin() + nextJobSlot;
+		nextJobSlot = (nextJobSlot + 1) % recentJobs.size();
+		slot->job = msg.job;
+	}
+	slot->ntime = msg.ntime;
+	slot->valid = true;
 	block = msg;
 	dataTimestamp = time(NULL);
+	using namespace std::chrono;
+	const auto now(steady_clock::now());
+	if(lastNotify != steady_clock::time_point() && timingCallback) timingCallback(st_notifyInterval, duration_cast<microseconds>(now - lastNotify));
+	lastNotify = now;
 }
 
 
 void StratumState::RequestReplyReceived(asizei id, bool error) {
 	ScopedFuncCall clear([this, id]() { pendingRequests.erase(pendingRequests.find(id)); });
+	auto sent(requestSent.find(id));
+	if(sent != requestSent.end()) {
+		using namespace std::chrono;
+		const auto elapsed(duration_cast<microseconds>(steady_clock::now() - sent->second));
+		requestSent.erase(sent);
+		const bool submit = std::string(Response(id)) == "mining.submit";
+		if(timingCallback) timingCallback(submit? st_submitRoundTrip : st_requestRoundTrip, elapsed);
+	}
 	if(error) {
 		ScopedFuncCall inc([this]() { this->errorCount++; });
 		if(std::string(Response(id)) == "mining.submit") Response(id, stratum::MiningSubmitResponse(false));
@@ -4,9 +4,10 @@
  */
 #pragma once
 #include <memory>
-#include <queue>
+#include <deque>
 #include <map>
 #include <time.h>
+#include <chrono>
 #include "../Common/Stratum/messages.h"
 #include "../Common/Stratum/parsing.h" // DecodeHEX
 #include "../Common/AREN/ScopedFuncCall.h"
@@ -57,7 +58,24 @@ public:
 	std::function<void(const std::string &worker, AuthStatus)> workerAuthCallback;
 	aulong errorCount;
 
-	explicit StratumState();
+	/*! Timings taken here but of interest to someone living longer than a connection.
+	Round trips go from the last byte of the request going to the OS to the reply being parsed. */
+	enum Timing {
+		st_submitRoundTrip,
+		st_requestRoundTrip, //!< all the other requests we send: subscribe, authorize
+		st_notifyInterval //!< between two consecutive mining.notify on this connection
+	};
+	std::function<void(Timing kind, std::chrono::microseconds elapsed)> timingCallback;
+
+	/*! \param resumeSession session ID given by the server on a previous connection, if any. The server might then
+	give us the same extranonce1 back so shares found for the previous connection are still good.
+	\param minimumDiff if non-zero, mining.configure is sent before anything else asking for the "minimum-difficulty" extension.
+	Servers not knowing about it reply with an error, which is harmless. */
+	explicit StratumState(const string &resumeSession = string(), double minimumDiff = .0);
+
+	/*! Asks the server to use this difficulty from now on, through mining.suggest_difficulty.
+	The server is free to ignore it and many do. It is just a message: whatever changes comes with mining.set_difficulty as usual. */
+	void SuggestDifficulty(double diff);
 	const string& GetSessionID() const { return subscription.sessionID; }
 
 	/*! The outer code should maintain a copy of this value. This to understand when the
@@ -91,30 +109,63 @@ public:
 
 	/*! If the job is still considered active then this returns the job ntime to be used for share submission.
 	Otherwise, it returns 0. That is considered by the stratum manager too old and thus likely to be rejected.
-	The outer code shall drop those shares as they have no valid ntime to be produced. */
-	auint GetJobNetworkTime(const std::string &job) const { return block.job == job? block.ntime : 0; }
+	The outer code shall drop those shares as they have no valid ntime to be produced.
+	A job is active if it's the current one or if it's one of the recent ones and no notify with clean_jobs has been received since. */
+	auint GetJobNetworkTime(const std::string &job) const;
+
+	//! Jobs for which GetJobNetworkTime would return non-zero, with their ntime.
+	std::vector<std::pair<std::string, auint>> GetValidJobs() const;
+
+	/*! Messages we send are classified so we can see how long each kind waits in the queue. Shares solving a block are
+	also sent before everything else: a block share waiting behind a burst of ordinary shares is a block getting orphaned. */
+	enum Lane {
+		sl_control, //!< subscribe, authorize and replies to the server
+		sl_share,
+		sl_block,
 
-    //! Returns unique number identifying the nonce sent to reconstruct info by other code on callbacks.
-	asizei SendWork(const std::string &job, auint ntime, auint nonce2, auint nonce);
+		sl_count
+	};
+
+	//! Returns unique number identifying the nonce sent to reconstruct info by other code on callbacks.
+	//! If block is true the share goes before all the ordinary shares not sent yet.
+	asizei SendWork(const std::string &job, auint ntime, auint nonce2, auint nonce, bool block = false);
 
 	/*! This structure contains an indivisible amount of information to	send the server via socket.
 	The message might be long, and multiple calls to send(...) might be needed. Rather than blocking
 	this thread I keep state about the messages and I send them in order.
-	Scheduling is easier and performed at higher level. */
+	Scheduling is easier and performed at higher level.
+	Members are not const anymore as block shares are inserted in the middle of the queue, which moves things around. */
 	struct Blob {
 		std::vector<__int8> data;
-		const size_t total;
-		const size_t id;
+		size_t total;
+		size_t id;
 		size_t sent;
+		Lane lane;
+		std::chrono::steady_clock::time_point queued;
 		Blob(const __int8 *msg, size_t count, size_t msgID)
-            : total(count), sent(0), id(msgID) {
+            : total(count), sent(0), id(msgID), lane(sl_control), queued(std::chrono::steady_clock::now()) {
             data.resize(total);
             std::copy(msg, msg + count, data.begin());
 		}
+		//! Takes ownership of an already rendered message, usually built in a recycled buffer.
+		Blob(std::vector<__int8> &&rendered, size_t msgID, Lane kind)
+			: data(std::move(rendered)), total(data.size()), sent(0), id(msgID), lane(kind), queued(std::chrono::steady_clock::now()) { }
 		// note no destructor --> leak. I destruct those when the pool is destroyed so copy
 		// is easy and no need for unique_ptr
 	};
-	std::queue<Blob> pending;
+	std::deque<Blob> pending; //!< not a queue anymore as senders want to look at more than one message at a time
+
+	//! Call this instead of pending.pop_front() when the front blob has been fully sent so its storage can be reused.
+	void PopSent();
+
+	//! Time between a message being queued and its last byte going to the OS.
+	struct LaneLatency {
+		asizei count;
+		double average; //!< milliseconds, moving average
+		double worst; //!< milliseconds
+		LaneLatency() : count(0), average(.0), worst(.0) { }
+	};
+	LaneLatency GetSendLatency(Lane lane) const { return sendLatency[lane]; }
 
 	// .id and .method --> Request \sa RequestReplyReceived
 	void Request(const stratum::ClientGetVersionRequest &msg);
@@ -161,6 +212,17 @@ private:
 	stratum::MiningNotify block; //!< sent by remote server and stored here
 	double difficulty;
 
+	/*! Jobs previously sent by the server, so shares found on them can still go out as long as the server doesn't tell us to drop them.
+	It's a ring, the current job is there as well. Slots can be in use (non-empty job) but invalid, after clean_jobs has been received. */
+	struct RecentJob {
+		std::string job;
+		auint ntime;
+		bool valid;
+		RecentJob() : ntime(0), valid(false) { }
+	};
+	std::array<RecentJob, 8> recentJobs;
+	asizei nextJobSlot;
+
 	struct Worker {
 		std::string name; //!< server side login credentials
 		const asizei id; //!< message ID used to request authorization. Not const because I build those after putting the message in queue.
@@ -175,6 +237,35 @@ private:
 	//!\returns the used ID.
 	asizei PushMethod(const char *method, const string &pairs);
 
+	//! Generates an unique id for a message originated by us. \sa PushMethod
+	asizei NextRequestID() {
+		const asizei used = nextRequestID++;
+		if(!nextRequestID) nextRequestID++; // we must have been running like one hundred years I guess
+		return used;
+	}
+
+	/*! Shares are the only thing we send often, sometimes many times per second and they're always the same except for a few bytes.
+	So rather than formatting them all the time through stringstreams, I build the message once for each (worker, job) pair, leaving
+	the hex values blank and then just copy it to a buffer and patch it. The only thing changing in length is the message id which
+	goes before all this. */
+	struct SubmitTemplate {
+		std::string worker, job;
+		std::vector<__int8> tail; //!< everything after the id digits, up to and including the newline.
+		asizei nonce2Off, ntimeOff, nonceOff; //!< offsets in tail of the 8-chars hex values
+		SubmitTemplate() : nonce2Off(0), ntimeOff(0), nonceOff(0) { }
+	} submitTemplate;
+	void BuildSubmitTemplate(const Worker &worker, const std::string &job);
+
+	//! Difficulties we send go as integers when they can, some servers don't like decimals at all.
+	static string DiffString(double diff);
+
+	/*! Blobs which have been sent have their storage moved here. Building new messages there means we don't allocate anything once
+	those have grown big enough, which happens really soon. */
+	std::vector< std::vector<__int8> > spareBuffers;
+	std::vector<__int8> TakeSpareBuffer();
+
+	std::array<LaneLatency, sl_count> sendLatency;
+
 	//! When replying to the server instead we have to use its id, which can be arbitrary.
 	void PushResponse(const std::string &id, const string &pairs);
 
@@ -183,6 +274,11 @@ private:
 	help the outer code in mangling responses. */
 	std::map<size_t, const char*> pendingRequests;
 
+	/*! When the requests above went out, filled in PopSent. A request leaves this map together with its pendingRequests entry,
+	so this is always tiny. */
+	std::map<size_t, std::chrono::steady_clock::time_point> requestSent;
+	std::chrono::steady_clock::time_point lastNotify; //!< 0 until the first notify of this connection
+
 	/*! Maps a mining.submit to the worker originating it so I can keep count of accepted/rejected shares. */
 	std::map<size_t, Worker*> submittedWork;
 };
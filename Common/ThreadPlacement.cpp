@@ -0,0 +1,288 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#include "ThreadPlacement.h"
+#include <algorithm>
+#include <fstream>
+#include <thread>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#include <intrin.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#endif
+
+
+namespace placement {
+
+
+CPUSet ParseCPUList(const std::string &list, std::string &error) {
+	CPUSet ret;
+	error.clear();
+	const char *scan = list.c_str();
+	auto skipBlanks = [&scan]() { while(*scan == ' ' || *scan == '\t' || *scan == '\n' || *scan == '\r') scan++; };
+	auto number = [&scan, &error](auint &dst) {
+		if(*scan < '0' || *scan > '9') {
+			error = "number expected";
+			return false;
+		}
+		aulong value = 0;
+		while(*scan >= '0' && *scan <= '9') {
+			value = value * 10 + (*scan - '0');
+			if(value > 0xFFFF) { // nobody has that many processors, it's a typo
+				error = "processor index too big";
+				return false;
+			}
+			scan++;
+		}
+		dst = auint(value);
+		return true;
+	};
+	skipBlanks();
+	if(*scan == 0) return ret; // empty list is valid, means "any"
+	while(true) {
+		auint first, last;
+		skipBlanks();
+		if(!number(first)) break;
+		skipBlanks();
+		last = first;
+		if(*scan == '-') {
+			scan++;
+			skipBlanks();
+			if(!number(last)) break;
+			skipBlanks();
+			if(last < first) {
+				error = "range " + std::to_string(first) + '-' + std::to_string(last) + " is reversed";
+				break;
+			}
+		}
+		for(auint add = first; add <= last; add++) ret.push_back(add);
+		if(*scan == 0) break;
+		if(*scan != ',') {
+			error = std::string("unexpected '") + *scan + "'";
+			break;
+		}
+		scan++;
+	}
+	if(error.size()) {
+		error += " at character " + std::to_string(scan - list.c_str());
+		ret.clear();
+		return ret;
+	}
+	std::sort(ret.begin(), ret.end());
+	ret.erase(std::unique(ret.begin(), ret.end()), ret.end());
+	return ret;
+}
+
+
+std::string DescribeCPUSet(const CPUSet &cpus) {
+	std::string ret;
+	for(asizei loop = 0; loop < cpus.size(); ) {
+		asizei last = loop;
+		while(last + 1 < cpus.size() && cpus[last + 1] == cpus[last] + 1) last++;
+		if(ret.size()) ret += ',';
+		ret += std::to_string(cpus[loop]);
+		if(last != loop) ret += (last == loop + 1? "," : "-") + std::to_string(cpus[last]);
+		loop = last + 1;
+	}
+	return ret;
+}
+
+
+#if defined(_WIN32)
+
+auint GetNumCPUs() {
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors? auint(info.dwNumberOfProcessors) : 1;
+}
+
+
+auint GetNumNUMANodes() {
+	ULONG highest = 0;
+	if(!GetNumaHighestNodeNumber(&highest)) return 1;
+	return auint(highest) + 1;
+}
+
+
+CPUSet GetNUMANodeCPUs(int node) {
+	CPUSet ret;
+	ULONGLONG mask = 0;
+	if(node < 0 || node > 0xFF || !GetNumaNodeProcessorMask(UCHAR(node), &mask)) return ret;
+	for(auint bit = 0; bit < 64; bit++) {
+		if(mask & (1ull << bit)) ret.push_back(bit);
+	}
+	return ret;
+}
+
+
+int GetPCIDeviceNUMANode(auint bus, auint device, auint function, auint domain) {
+	// It's there, as DEVPKEY_Device_Numa_Node, but it takes going through SetupAPI matching location strings. Explicit CPU lists work.
+	return -1;
+}
+
+
+bool SetCurrentThreadCPUs(const CPUSet &cpus) {
+	DWORD_PTR mask = 0;
+	for(auto cpu : cpus) {
+		if(cpu < sizeof(mask) * 8) mask |= DWORD_PTR(1) << cpu;
+	}
+	DWORD_PTR process, system;
+	if(!GetProcessAffinityMask(GetCurrentProcess(), &process, &system)) return false;
+	mask &= process;
+	if(!mask) return false;
+	return SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+}
+
+
+CPUSet GetCurrentThreadCPUs() {
+	// There's no GetThreadAffinityMask, the old mask is returned by setting a new one so set the process mask and put it back.
+	CPUSet ret;
+	DWORD_PTR process, system;
+	if(!GetProcessAffinityMask(GetCurrentProcess(), &process, &system)) return ret;
+	const DWORD_PTR mask = SetThreadAffinityMask(GetCurrentThread(), process);
+	if(!mask) return ret;
+	SetThreadAffinityMask(GetCurrentThread(), mask);
+	for(auint bit = 0; bit < sizeof(mask) * 8; bit++) {
+		if(mask & (DWORD_PTR(1) << bit)) ret.push_back(bit);
+	}
+	return ret;
+}
+
+
+bool PreferNUMANode(int node) {
+	return node >= 0 && auint(node) < GetNumNUMANodes();
+}
+
+
+//! TSC ticks per second, which is what QueryThreadCycleTime counts on every CPU able to run us. Spinning 10ms is plenty.
+static double MeasureCyclesPerSecond() {
+	LARGE_INTEGER frequency, start, now;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&start);
+	const unsigned __int64 first = __rdtsc();
+	do {
+		QueryPerformanceCounter(&now);
+	} while(now.QuadPart - start.QuadPart < frequency.QuadPart / 100);
+	const unsigned __int64 last = __rdtsc();
+	return double(last - first) * double(frequency.QuadPart) / double(now.QuadPart - start.QuadPart);
+}
+
+
+std::chrono::microseconds GetCurrentThreadCPUTime() {
+	static const double cyclesPerMicro = MeasureCyclesPerSecond() / 1e6;
+	ULONG64 cycles = 0;
+	if(!QueryThreadCycleTime(GetCurrentThread(), &cycles)) return std::chrono::microseconds(0);
+	return std::chrono::microseconds(std::chrono::microseconds::rep(double(cycles) / cyclesPerMicro));
+}
+
+#elif defined(__linux__)
+
+//! sysfs files I'm interested in are all single line, this returns it or an empty string if the file is not there.
+static std::string ReadSysfsLine(const std::string &path) {
+	std::ifstream file(path);
+	std::string ret;
+	if(file.good()) std::getline(file, ret);
+	return ret;
+}
+
+
+auint GetNumCPUs() {
+	const long count = sysconf(_SC_NPROCESSORS_CONF);
+	return count > 0? auint(count) : 1;
+}
+
+
+auint GetNumNUMANodes() {
+	std::string error;
+	const CPUSet nodes(ParseCPUList(ReadSysfsLine("/sys/devices/system/node/possible"), error)); // same format as CPU lists
+	return nodes.size()? nodes.back() + 1 : 1;
+}
+
+
+CPUSet GetNUMANodeCPUs(int node) {
+	if(node < 0) return CPUSet();
+	std::string error;
+	return ParseCPUList(ReadSysfsLine("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"), error);
+}
+
+
+int GetPCIDeviceNUMANode(auint bus, auint device, auint function, auint domain) {
+	char location[32];
+	snprintf(location, sizeof(location), "%04x:%02x:%02x.%x", domain, bus, device, function);
+	const std::string value(ReadSysfsLine(std::string("/sys/bus/pci/devices/") + location + "/numa_node"));
+	if(value.empty()) return -1;
+	try {
+		return std::stoi(value); // it's -1 already when the firmware does not tell
+	} catch(...) { }
+	return -1;
+}
+
+
+bool SetCurrentThreadCPUs(const CPUSet &cpus) {
+	cpu_set_t mask;
+	CPU_ZERO(&mask);
+	const auint count = GetNumCPUs();
+	bool any = false;
+	for(auto cpu : cpus) {
+		if(cpu >= count || cpu >= CPU_SETSIZE) continue;
+		CPU_SET(cpu, &mask);
+		any = true;
+	}
+	if(!any) return false;
+	return pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask) == 0;
+}
+
+
+CPUSet GetCurrentThreadCPUs() {
+	CPUSet ret;
+	cpu_set_t mask;
+	CPU_ZERO(&mask);
+	if(pthread_getaffinity_np(pthread_self(), sizeof(mask), &mask)) return ret;
+	for(auint cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if(CPU_ISSET(cpu, &mask)) ret.push_back(cpu);
+	}
+	return ret;
+}
+
+
+bool PreferNUMANode(int node) {
+	// No libnuma: it's just a syscall. The node mask is an array of longs, maxnode is the number of bits the kernel should look at.
+	const asizei bitsPerLong = sizeof(unsigned long) * 8;
+	unsigned long mask[1024 / (sizeof(unsigned long) * 8)] = { 0 };
+	if(node < 0 || asizei(node) >= sizeof(mask) * 8 || auint(node) >= GetNumNUMANodes()) return false;
+	mask[node / bitsPerLong] = 1ul << (node % bitsPerLong);
+	return syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, sizeof(mask) * 8) == 0;
+}
+
+
+std::chrono::microseconds GetCurrentThreadCPUTime() {
+	timespec now;
+	if(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now)) return std::chrono::microseconds(0);
+	return std::chrono::seconds(now.tv_sec) + std::chrono::microseconds(now.tv_nsec / 1000);
+}
+
+#else
+
+auint GetNumCPUs() { return std::max(1u, std::thread::hardware_concurrency()); }
+auint GetNumNUMANodes() { return 1; }
+CPUSet GetNUMANodeCPUs(int node) { return CPUSet(); }
+int GetPCIDeviceNUMANode(auint bus, auint device, auint function, auint domain) { return -1; }
+bool SetCurrentThreadCPUs(const CPUSet &cpus) { return false; }
+CPUSet GetCurrentThreadCPUs() { return CPUSet(); }
+bool PreferNUMANode(int node) { return false; }
+std::chrono::microseconds GetCurrentThreadCPUTime() {
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch());
+}
+
+#endif
+
+
+}
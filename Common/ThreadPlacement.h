@@ -0,0 +1,72 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+#include "AREN/ArenDataTypes.h"
+#include <vector>
+#include <string>
+#include <chrono>
+
+
+/*! Where threads run and where their memory comes from. On a desktop with a single CPU socket it doesn't matter at all, but multi-socket
+mining rigs are NUMA systems: each GPU hangs off the PCIe root of one socket and every transfer from a buffer sitting in the other socket's
+memory goes through the inter-socket link. The mining threads only wait on the GPU most of the time but they also build headers, map results
+and verify nonces on the CPU, and the OS will happily move them to the far socket just because a core there was idle.
+Same goes for the main thread: when it's doing network work it's better off not fighting with the mining threads for the same cores.
+
+So there are three things here:
+1- describing sets of logical processors, in the same "0-3,8,10-11" format Linux uses in sysfs and taskset;
+2- figuring out which NUMA node a PCI device is attached to and which processors belong to that node;
+3- restricting the calling thread to a set of processors and having its allocations come from a given node.
+Everything works on the calling thread only, that's the only thread which knows where it should be.
+Nothing throws: if the OS doesn't want to tell or doesn't allow something, you get an empty set or false and the thread keeps running
+wherever the scheduler wants, as it always did. */
+namespace placement {
+
+
+typedef std::vector<auint> CPUSet; //!< logical processor indices, sorted, no duplicates. Empty means "don't care".
+
+/*! Parses "0-3,8,10-11". Whitespace around numbers is tolerated, everything else isn't.
+\param error set to a description of the problem, if any. In that case the returned set is empty. */
+CPUSet ParseCPUList(const std::string &list, std::string &error);
+
+//! The inverse of ParseCPUList, produces the shortest list, using ranges.
+std::string DescribeCPUSet(const CPUSet &cpus);
+
+//! Logical processors in the system, including the ones not currently online. At least 1.
+auint GetNumCPUs();
+
+//! Always at least 1, even if the system does not know about NUMA.
+auint GetNumNUMANodes();
+
+/*! \returns set of processors belonging to the given node or an empty set if the node does not exist or the OS won't tell. */
+CPUSet GetNUMANodeCPUs(int node);
+
+/*! The PCI device at the given location is attached to a certain NUMA node, that's where the CPUs closest to it are.
+\returns -1 if not known, which is also the case for non-NUMA systems. Windows does not make this easy, so it's always -1 there for the time being. */
+int GetPCIDeviceNUMANode(auint bus, auint device, auint function, auint domain = 0);
+
+/*! Restrict the calling thread to run on the given processors only. Processors not in the system are ignored.
+On Windows only the first 64 processors can be used (it's the processor group of the process), the others are ignored as well.
+\returns false if the set ends up empty or the OS refused. In both cases the thread affinity is left untouched. */
+bool SetCurrentThreadCPUs(const CPUSet &cpus);
+
+//! Processors the calling thread is allowed to run on. Empty if the OS won't tell.
+CPUSet GetCurrentThreadCPUs();
+
+/*! Memory allocated by the calling thread from now on, including the host side of CL buffers and whatever the driver allocates
+on our behalf, should come from the given node if possible. It's only a preference: if the node is full, memory comes from elsewhere.
+On Linux this is set_mempolicy(MPOL_PREFERRED). On Windows allocations already come from the node of the thread ideal processor,
+which is in the node as long as the thread was restricted to it by SetCurrentThreadCPUs, so there's nothing to do.
+\returns false if the node is not valid or the OS refused. */
+bool PreferNUMANode(int node);
+
+/*! CPU time the calling thread consumed so far. Differences of this are what a piece of work really cost: unlike a wall clock it doesn't
+count the time the thread was preempted, sleeping or waiting on a lock. On Linux it's CLOCK_THREAD_CPUTIME_ID. GetThreadTimes on Windows
+only moves at scheduler ticks, 15ms or so, way too coarse for a few hashes, so it's QueryThreadCycleTime scaled by the TSC rate, which is
+measured once against QueryPerformanceCounter. Elsewhere it falls back to a steady wall clock. */
+std::chrono::microseconds GetCurrentThreadCPUTime();
+
+
+}
@@ -3,6 +3,7 @@
  * For conditions of distribution and use, see the LICENSE or hit the web.
  */
 #include "Framer.h"
+#include "../AREN/SerializationBuffers.h"
 
 namespace ws {
 
@@ -107,7 +108,7 @@ void Framer::EnqueueTextMessage(const char *msg, asizei len) {
 	}
 	else {
 		header[1] |= 127;
-		aulong extra = htonll(aulong(len));
+		aulong extra = HTON(aulong(len));
 		memcpy_s(header + 2, sizeof(header) - 2, &extra, sizeof(extra));
 		hbytes += 8;
 	}
@@ -180,7 +181,7 @@ aubyte* Framer::FrameDataUpdated(asizei got) {
 					else {
 						aulong network;
 						memcpy_s(&network, sizeof(network), inbound.data() + 2, 8);
-						plLen = ntohll(network);
+						plLen = BETOH(network);
 					}
 				}
 			}
@@ -213,9 +214,11 @@ void Framer::SendPong(const aubyte *payload, asizei byteCount) {
 
 void Framer::ClosePacketReceived(aushort reason) {
 	if(closeFrame.waitForReply) closeFrame.replyReceived = true;
-	else if(closeFrame.payload.size() == 0) { // then I have to reply...
-		closeFrame.payload.resize(sizeof(reason));
-		memcpy_s(closeFrame.payload.data(), closeFrame.payload.size(), &reason, sizeof(reason));
+	else if(closeFrame.payload.size() == 0) { // then I have to reply... it's a frame like the one EnqueueClose builds, echoing the reason as it came
+		const aubyte head[2] = { 0x88, 0x02 };
+		closeFrame.payload.resize(sizeof(head) + sizeof(reason));
+		memcpy_s(closeFrame.payload.data(), closeFrame.payload.size(), head, sizeof(head));
+		memcpy_s(closeFrame.payload.data() + sizeof(head), closeFrame.payload.size() - sizeof(head), &reason, sizeof(reason));
 		closeFrame.waitForReply = false; // default anyway
 	} else {
 		// ? I just ignore it
@@ -26,8 +26,13 @@ void WorkSource::Disconnected() {
 
 void WorkSource::MangleReplyFromServer(size_t id, const rapidjson::Value &result, const rapidjson::Value &error) {
 	const char *sent = stratum->Response(id);
+	const bool negotiation = strcmp(sent, "mining.configure") == 0 || strcmp(sent, "mining.suggest_difficulty") == 0;
 	if(error.IsNull() == false) {
 		ScopedFuncCall clear([this, id]() { stratum->RequestReplyReceived(id, true); });
+		if(negotiation) { // most likely "unknown method", it's fine
+			DifficultyNegotiated(sent, false);
+			return;
+		}
 		std::string desc;
 		aint code;
 		if(error.IsArray()) { // MPOS pools give us an array here, first number is an error code int, second is a string.
@@ -50,6 +55,18 @@ void WorkSource::MangleReplyFromServer(size_t id, const rapidjson::Value &result
 	}
 	else {
 		ScopedFuncCall clear([this, id]() { stratum->RequestReplyReceived(id, false); });
+		if(negotiation) {
+			bool supported = true; // suggest_difficulty replies are all over the place, only errors count
+			if(strcmp(sent, "mining.configure") == 0) {
+				supported = false;
+				if(result.IsObject()) {
+					auto ext(result.FindMember("minimum-difficulty"));
+					supported = ext != result.MemberEnd() && ext->value.IsBool() && ext->value.GetBool();
+				}
+			}
+			DifficultyNegotiated(sent, supported);
+			return;
+		}
 		bool mangled = false;
 		using namespace stratum::parsing;
 		MangleResult(mangled, sent, id, result, MiningSubscribe());
@@ -71,15 +88,22 @@ void WorkSource::MangleMessageFromServer(const std::string &idstr, const char *s
 }
 
 
-std::pair<bool, asizei> WorkSource::Send(const abyte *data, asizei count) {
-	asizei sent = pipe->Send(data, count);
+std::pair<bool, asizei> WorkSource::Send(const Chunk *chunks, asizei count) throw() {
+	const asizei MAX_CHUNKS = 16;
+	NetworkInterface::AbstractDataSocket::Chunk gather[MAX_CHUNKS];
+	if(count > MAX_CHUNKS) count = MAX_CHUNKS;
+	for(asizei cp = 0; cp < count; cp++) {
+		gather[cp].data = chunks[cp].data;
+		gather[cp].count = chunks[cp].count;
+	}
+	asizei sent = pipe->SendGather(gather, count);
     auto pair(std::make_pair(true, sent));
 	if(sent == 0 && pipe->Works() == false) pair.first = false;
 	return pair;
 }
 
 
-std::pair<bool, asizei> WorkSource::Receive(abyte *storage, asizei rem) {
+std::pair<bool, asizei> WorkSource::Receive(abyte *storage, asizei rem) throw() {
 	asizei received = pipe->Receive(storage, rem);
     auto pair(std::make_pair(true, received));
     if(received == 0 && pipe->Works() == false) pair.first = false;
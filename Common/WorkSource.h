@@ -55,39 +55,41 @@ private:
     std::vector< std::pair<std::string, std::string> > credentials;
 
 	template<typename Parser>
-	void MangleResult(bool &processed, const char *originally, size_t id, const rapidjson::Value &object, Parser &parser) {
+	void MangleResult(bool &processed, const char *originally, size_t id, const rapidjson::Value &object, Parser &&parser) {
 		if(processed) return;
 		if(parser.name != originally) return;
-		std::unique_ptr<Parser::Product> dispatch(parser.Mangle(object));
+		std::unique_ptr<typename Parser::Product> dispatch(parser.Mangle(object));
 		//if(dispatch.get() == nullptr) return; // impossible, would have thrown
 		stratum->Response(id, *dispatch.get());
 		processed = true;
 	}
 
 	template<typename Parser>
-	void MangleRequest(bool &processed, const char *methodName, const string &id, const rapidjson::Value &paramsArray, Parser &parser) {
+	void MangleRequest(bool &processed, const char *methodName, const string &id, const rapidjson::Value &paramsArray, Parser &&parser) {
 		if(processed) return;
 		if(parser.name != methodName) return;
-		std::unique_ptr<Parser::Product> dispatch(parser.Mangle(id, paramsArray));
+		std::unique_ptr<typename Parser::Product> dispatch(parser.Mangle(id, paramsArray));
 		//if(dispatch.get() == nullptr) return; // impossible, would have thrown
 		stratum->Request(*dispatch.get());
 		processed = true;
 	}
 
 	template<typename Parser>
-	void MangleNotification(bool &processed, const char *methodName, const rapidjson::Value &paramsArray, Parser &parser) {
+	void MangleNotification(bool &processed, const char *methodName, const rapidjson::Value &paramsArray, Parser &&parser) {
 		if(processed) return;
 		if(parser.name != methodName) return;
-		std::unique_ptr<Parser::Product> dispatch(parser.Mangle(paramsArray));
+		std::unique_ptr<typename Parser::Product> dispatch(parser.Mangle(paramsArray));
 		//if(dispatch.get() == nullptr) return; // impossible, would have thrown
 		stratum->Notify(*dispatch.get());
 		processed = true;
 	}
 
 protected:
-	void MangleReplyFromServer(size_t id, const rapidjson::Value &result, const rapidjson::Value &error);
-	void MangleMessageFromServer(const std::string &idstr, const char *signature, const rapidjson::Value &notification);
-	std::pair<bool, asizei> Send(const abyte *data, const asizei count);
-	std::pair<bool, asizei> Receive(abyte *storage, asizei rem);
+	// final, so the hot path stays equivalent to those. Derived classes wanting to mangle differently should derive from AbstractWorkSource.
+	void MangleReplyFromServer(size_t id, const rapidjson::Value &result, const rapidjson::Value &error) final;
+	void MangleMessageFromServer(const std::string &idstr, const char *signature, const rapidjson::Value &notification) final;
+	bool HotMessagesSkipMangle() const { return true; } // notifies, difficulty and submit replies only go to the stratum state, as the hot path does
+	std::pair<bool, asizei> Send(const Chunk *chunks, const asizei count) throw();
+	std::pair<bool, asizei> Receive(abyte *storage, asizei rem) throw();
 	void GetCredentials(std::vector< std::pair<const char*, StratumState::AuthStatus> > &list) const;
 };
@@ -92,6 +92,16 @@ public:
 
 template<typename LenType>
 class VariableLengthSHA256 : public AbstractSHA_bits<256, LenType> {
+	// The base depends on LenType, its members must be named explicitly. Visual C++ does not care, others do.
+	typedef AbstractSHA_bits<256, LenType> Base;
+	using Base::h;
+	using Base::pad;
+	using Base::bytesProcessed;
+public:
+	using Base::Restart;
+	using Base::EndBlocks;
+	using typename Base::Digest;
+	using Base::GetHash;
 private:
 	static auint SigmaO(auint v) { return _rotr(v,  7) ^ _rotr(v, 18) ^    (v >>  3); };
 	static auint SigmaI(auint v) { return _rotr(v, 17) ^ _rotr(v, 19) ^    (v >> 10); };
@@ -219,7 +229,7 @@ public:
 			auint temp = _rotl(a, 5) + f + e + K[ki] + w[i];
 			e = d;
 			d = c;
-			c = _lrotl(b, 30);
+			c = _rotl(b, 30);
 			b = a;
 			a = temp;
 		}
@@ -305,7 +315,7 @@ void PBKDF2(std::array<auint, 32> &output, const std::array<auint, 20> &passwd)
 	memcpy(pad+4, passwdpad, 48);
 	tstate.BlockProcessing(reinterpret_cast<const aubyte*>(pad));
 
-	HASHER::Digest ihashDWORD;
+	typename HASHER::Digest ihashDWORD;
 	tstate.GetHashLE(ihashDWORD);
 	const auint *ihash = reinterpret_cast<const auint*>(ihashDWORD.data());
 
@@ -372,7 +382,7 @@ void PBKDF2(std::array<aubyte, 8*4> &output, const std::array<auint, 20> &passwd
 		memcpy_s(pad, sizeof(pad), passwd.data() + 16, 4 * 4);
 		memcpy_s(pad + 4, sizeof(pad) - 4 * 4, passwdpad, sizeof(passwdpad));
 		tstate.BlockProcessing(reinterpret_cast<const aubyte*>(pad));
-		HASHER::Digest hash;
+		typename HASHER::Digest hash;
 		tstate.GetHashLE(hash);
 		memcpy_s(ihash, sizeof(ihash), hash.data(), sizeof(hash[0]) * hash.size());
 	}
@@ -397,7 +407,7 @@ void PBKDF2(std::array<aubyte, 8*4> &output, const std::array<auint, 20> &passwd
 		finalBlock[15] = HTON(auint(0x00000620));
 		tstate.BlockProcessing(reinterpret_cast<const aubyte*>(finalBlock));
 
-		HASHER::Digest hash;
+		typename HASHER::Digest hash;
 		tstate.GetHashLE(hash);
 		memcpy_s(pad, sizeof(pad), hash.data(), sizeof(hash));
 		memcpy_s(pad + 8, sizeof(pad) - 8 * 4, outerpad, sizeof(outerpad));
@@ -10,5 +10,11 @@ special variables in a single place so they can be monitored more easily. */
 #include "Network.h"
 
 
+#if defined(_WIN32)
 std::unique_ptr< std::map<int, SockErr> > WindowsNetwork::errMap;
+#elif defined(__linux__)
+std::unique_ptr< std::map<int, SockErr> > EpollNetwork::errMap;
+#endif
 size_t NetworkInterface::connectionTimeoutSeconds = 30;
+asizei NetworkInterface::connectionStaggerMilliseconds = 250;
+const asizei AddressResolver::pollMilliseconds = 50;
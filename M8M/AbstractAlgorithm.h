@@ -85,8 +85,9 @@ public:
 #if defined REPLICATE_CLDEVICE_LINEARINDEX // ugly hack to support non-unique cl_device_id values
     cl_uint linearDeviceIndex = auint(-1);
 #endif
-    const asizei hashCount;
-    const asizei uintsPerHash; /*!< Mining algorithms should use the following format for the result buffer (buffer of uints):
+    //! Those two are only changed by DataDrivenAlgorithm::Rebuild, between scans, by the thread driving the algorithm.
+    asizei hashCount;
+    asizei uintsPerHash; /*!< Mining algorithms should use the following format for the result buffer (buffer of uints):
         [0] amount of candidate nonces found, let's call it candCount.
         Candidate[candCount], where the Candidate structure is
             uint nonce;
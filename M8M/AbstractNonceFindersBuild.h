@@ -7,10 +7,18 @@
 #include "../BlockVerifiers/BlockVerifierInterface.h"
 #include "StopWaitDispatcher.h"
 #include "../Common/AbstractWorkSource.h"
+#include "../Common/MPSCQueue.h"
+#include "../Common/ThreadPlacement.h"
+#include "../Common/DetachedThreads.h"
+#include "../Common/PublishedSnapshot.h"
+#include "IsolatedWorker.h"
 #include <mutex>
+#include <condition_variable>
+#include <atomic>
 #include <queue>
 #include <thread>
 #include <chrono>
+#include <memory>
 
 
 /*! Interface for populating, initializing and starting a NonceFindersInterface object
@@ -33,6 +41,7 @@ public:
         CurrentWork source(src.diffMul);
         source.owner = key;
         owners.push_back(std::move(source));
+        Publish();
         return true;
     }
 
@@ -41,9 +50,23 @@ public:
         std::vector<AbstractAlgorithm::ResourceRequest> res;
         std::vector<AbstractAlgorithm::KernelRequest> kern;
         asizei numHashes = 0;
-        cl_context ctx;
+        cl_context ctx; //!< 0 means the mining thread creates one for dev alone, which is what RecoverQueue does
         cl_device_id dev;
         asizei candHashUints = 0;
+        /*! The mining thread restricts itself to those processors as soon as it starts, before allocating anything.
+        Empty means anywhere, as the OS pleases. */
+        placement::CPUSet affinity;
+        int numaNode = -1; //!< if not negative, the thread asks its memory to come from there, so the host side of its buffers is close to the device
+        /*! Nonce verification is the only thing in the mining thread really eating CPU. If this is not empty, the thread moves there
+        to verify and goes back to affinity (or wherever it was) after. */
+        placement::CPUSet verification;
+        /*! Isolated mode, see the isolation namespace. In the main process workerProgram is set: the thread does no CL at all,
+        it supervises a worker process running the device and feeds it. In the worker process workerChannel is set instead:
+        the thread runs the device as usual but takes headers from there and sends nonces back. */
+        std::string workerProgram;
+        std::vector<std::string> workerArgs;
+        auint workerDevice = 0;
+        isolation::Channel *workerChannel = nullptr;
     };
 
     /*! Initialize a mining thread using the passed device. Contents of the own parameter will be moved to internal memory. */
@@ -52,8 +75,15 @@ public:
                 , asizei devLinearIndex
 #endif
                 ) {
+        Recipe recipe;
+        recipe.build = own; // before it's moved away, RecoverQueue will need it again
+        recipe.loader = loader;
+#if defined REPLICATE_CLDEVICE_LINEARINDEX
+        recipe.devLinearIndex = devLinearIndex;
+#endif
+        recipes.push_back(std::move(recipe));
         miners.push_back(std::make_unique<Miner>(canon));
-        ScopedFuncCall clear([this]() { miners.pop_back(); });
+        ScopedFuncCall clear([this]() { miners.pop_back(); recipes.pop_back(); });
         MiningThreadParams boo(miners.size() - 1, *miners.back(), std::move(own)
 #if defined REPLICATE_CLDEVICE_LINEARINDEX
             , devLinearIndex      
@@ -62,9 +92,115 @@ public:
         boo.sourceGetter = loader;
         miners.back()->worker = std::thread(GetMiningMain(), boo);
         miners.back()->worker.detach();
+        spawned++;
         clear.Dont();
     }
 
+    /*! Gives up on the thread of the given queue and starts a new one on the same device. The new thread gets a context of its own
+    so it shares nothing with the old one: command queue, buffers and kernels are all new. Threads stuck in the driver cannot be killed
+    so the old one is left there; if it ever comes back it notices and goes away without touching anything, not even its results.
+    Other queues and the pools don't notice anything. Kernel sources must still be available from the loader.
+    Main thread only. */
+    void RecoverQueue(asizei queue) {
+        Miner &stuck(*miners[queue]);
+        std::unique_lock<std::mutex> lock(stuck.sync);
+        auto &tuned(stuck.retune? stuck.retune : stuck.retuned); // the new thread starts with the settings it was tuned to, see RetuneQueue
+        if(tuned) recipes[queue].build = std::move(*tuned);
+        lock.unlock();
+        miners[queue]->stuck = true;
+        Respawn(queue, true);
+    }
+
+    /*! Configuration reload, the device of this queue has to run something else. As RecoverQueue but the thread is not stuck: it leaves
+    at its next iteration and its resources are released after. The new one uses own.ctx, which can be 0 as in RecoverQueue.
+    Main thread only. */
+    void ReplaceQueue(asizei queue, AlgoBuild &&own, AbstractAlgorithm::SourceCodeBufferGetterFunc loader) {
+        recipes[queue].build = std::move(own);
+        recipes[queue].loader = loader;
+        Respawn(queue, false);
+    }
+
+    /*! Configuration reload, the device of this queue is not to be used anymore. The queue stays there, s_stopped, with no thread,
+    so queue indices don't change; ReplaceQueue can start it again. Main thread only. */
+    void StopQueue(asizei queue) {
+        SweepRetired();
+        auto placeholder(std::make_unique<Miner>(miners[queue]->canon));
+        placeholder->status = s_stopped;
+        placeholder->exited = true; // there's no thread, it can go as soon as it's replaced
+        miners[queue]->abandoned.store(true, std::memory_order_release);
+        retired.push_back(std::move(miners[queue]));
+        miners[queue] = std::move(placeholder);
+    }
+
+    /*! Configuration reload, the pools changed. The work providers become exactly those, in that order, which is also their priority.
+    Providers already there keep their work, difficulty and health. Threads working for a provider going away drop its work
+    as soon as they notice. Main thread only. */
+    void SyncWorkProviders(const std::vector<const AbstractWorkSource*> &sources) {
+        std::vector<CurrentWork> next;
+        next.reserve(sources.size());
+        for(const auto src : sources) {
+            const void *key = src;
+            auto match(std::find_if(owners.begin(), owners.end(), [key](const CurrentWork &test) { return test.owner == key; }));
+            if(match != owners.end()) next.push_back(std::move(*match));
+            else {
+                next.push_back(CurrentWork(src->diffMul));
+                next.back().owner = key;
+            }
+        }
+        owners = std::move(next);
+        Publish();
+    }
+
+    /*! Live tuning. The thread stops at the end of its current scan and sleeps, keeping everything it has allocated, until resumed.
+    It drops its work so when resumed it rolls a new header. Replacement threads stay paused as well. Main thread only. */
+    void PauseQueue(asizei queue, bool pause) {
+        std::unique_lock<std::mutex> lock(guard); // paused threads wait on workChanged, see ThreadedNonceFinders::Paused
+        miners[queue]->paused.store(pause, std::memory_order_release);
+        lock.unlock();
+        workChanged.notify_all();
+    }
+
+    /*! Live tuning. The thread rebuilds its algorithm with the resources, kernels, hash count and identifier of own at the end of its
+    current scan, reusing its context, queue and whatever buffers and kernels are the same, see DataDrivenAlgorithm::Rebuild.
+    Everything else, such as device and placement, stays as it is. If the rebuild fails the thread keeps going as before.
+    Either way GetQueueControl tells how it went. A request not applied yet is replaced. Main thread only. */
+    void RetuneQueue(asizei queue, AlgoBuild &&own) {
+        Miner &target(*miners[queue]);
+        auto build(std::make_unique<AlgoBuild>(recipes[queue].build));
+        build->identifier = std::move(own.identifier);
+        build->res = std::move(own.res);
+        build->kern = std::move(own.kern);
+        build->numHashes = own.numHashes;
+        build->candHashUints = own.candHashUints;
+        std::unique_lock<std::mutex> lock(target.sync);
+        target.retune = std::move(build);
+        target.retuneOutcome = "waiting for the current scan to complete";
+        lock.unlock();
+        target.retunePending.store(true, std::memory_order_release);
+    }
+
+    struct QueueControl {
+        bool paused = false; //!< as requested, the thread might still be completing its scan
+        bool retuning = false; //!< RetuneQueue was called, the thread has not got to it yet
+        std::string outcome; //!< of the last RetuneQueue
+    };
+    QueueControl GetQueueControl(asizei queue) const {
+        auto &worker(*miners[queue]);
+        QueueControl ret;
+        ret.paused = worker.paused.load(std::memory_order_acquire);
+        std::unique_lock<std::mutex> lock(worker.sync);
+        ret.retuning = worker.retune != nullptr;
+        ret.outcome = worker.retuneOutcome;
+        return ret;
+    }
+
+    std::chrono::steady_clock::time_point GetLastScanTime(asizei queue) const {
+        using std::chrono::steady_clock;
+        // Isolated queues are watched by their isolation::Supervisor already, which can do better: it can kill the process.
+        if(recipes[queue].build.workerProgram.size()) return steady_clock::time_point();
+        return steady_clock::time_point(steady_clock::duration(miners[queue]->lastScan.load(std::memory_order_acquire)));
+    }
+
     /*! Map a cl_device_id to a device linearIndex for feedback. If not found, -1 will be used.
     Again, populated at construction time and supposed to be never, ever touched again if not by async thread so not thread protected. */
     std::map<cl_device_id, auint> linearDevice;
@@ -74,34 +210,57 @@ public:
     It is assumed iterations always take at least one microseconds. Elapsed=0 can be used to signal device going to sleep. */
     std::function<void(asizei devIndex, bool found, std::chrono::microseconds elapsed)> onIterationCompleted;
 
+    /*! Called asynchronously by the mining threads after queueing something for ResultsFound. It's meant to wake up whoever is consuming them
+    (see NetworkInterface::Wake) so shares go out right away instead of waiting for the next tick. */
+    std::function<void()> onResultsFound;
+
     // Those are not really part of initialization but the class is still fairly easy.
+    // They're called by the main thread only, the mining threads see the changes through the published snapshot.
     bool SetDifficulty(const AbstractWorkSource &from, const stratum::WorkDiff &diff) {
-        std::unique_lock<std::mutex> lock(guard);
         auto match(std::find_if(owners.begin(), owners.end(), [&from](const CurrentWork &test) { return test.owner == &from; }));
         if(match == owners.end()) return false;
         match->workDiff = diff;
+        Publish();
         return true;
     }
     bool SetWorkFactory(const AbstractWorkSource &from, std::unique_ptr<stratum::AbstractWorkFactory> &factory) {
-        std::unique_lock<std::mutex> lock(guard);
         auto match(std::find_if(owners.begin(), owners.end(), [&from](const CurrentWork &test) { return test.owner == &from; }));
         if(match == owners.end()) return false;
-        AddFactory(factory.get());
-        if(match->factory) RemFactory(match->factory);
-        match->factory = factory.release();
+        match->factory.reset(factory.release()); // the old one stays alive as long as some thread is still using it
+        Publish();
+        return true;
+    }
+    bool SetDegraded(const AbstractWorkSource &from, bool degraded) {
+        auto match(std::find_if(owners.begin(), owners.end(), [&from](const CurrentWork &test) { return test.owner == &from; }));
+        if(match == owners.end()) return false;
+        if(match->degraded != degraded) {
+            match->degraded = degraded;
+            Publish();
+        }
         return true;
     }
 
 
     bool ResultsFound(NonceOriginIdentifier &src, VerifiedNonces &nonces) {
-        std::unique_lock<std::mutex> lock(guard);
-        if(results.empty()) return false;
-        src = results.front().first;
-        nonces = std::move(results.front().second);
-        results.pop();
+        // No lock, see results.
+        std::pair<NonceOriginIdentifier, VerifiedNonces> popped;
+        ResultQueue::Clock::time_point queued;
+        const asizei waiting = results.Size();
+        if(!results.Pop(popped, queued)) return false;
+        src = std::move(popped.first);
+        nonces = std::move(popped.second);
+        resultStats.peakDepth = std::max(resultStats.peakDepth, waiting);
+        resultStats.pulled++;
+        resultStats.age.Add(std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(ResultQueue::Clock::now() - queued).count());
         return true;
     }
 
+    ResultQueueStats GetResultQueueStats() const {
+        ResultQueueStats ret(resultStats);
+        ret.depth = results.Size();
+        return ret;
+    }
+
 
     std::array<asizei, 2> GetNumWorkQueues() const {
         // no need to protect as this is only updated at construction time
@@ -128,9 +287,9 @@ public:
         auto &worker(*miners[queue]);
         std::unique_lock<std::mutex> lock(worker.sync);
 #if defined REPLICATE_CLDEVICE_LINEARINDEX
-        asizei devIndex = worker.algo->linearDeviceIndex;
+        asizei devIndex = recipes[queue].devLinearIndex;
 #else
-        asizei devIndex = linearDevice.find(worker.algo->device)->second;
+        asizei devIndex = linearDevice.find(recipes[queue].build.dev)->second; // not from algo, a recovered thread might have not created it yet
 #endif
         return std::make_tuple(devIndex, worker.status, worker.exitMessage);
     }
@@ -143,23 +302,11 @@ public:
 
     ~AbstractNonceFindersBuild() {
         keepRunning = false;
-        using namespace std::chrono;
-        const system_clock::time_point requested(system_clock::now());
-        const std::chrono::milliseconds interval(200);
-        while(system_clock::now() < requested + seconds(10) && exitedThreads != miners.size()) std::this_thread::sleep_for(interval);
-        if(exitedThreads != miners.size()) {
-            /* some threads are unresponsive. In theory we could terminate those but thread termination is dangerous in Windows
-            and most likely in other OS as well (that's why C++11 does not have it by default).
-            In theory we could at least signal that error but we won't, not just because we're in a DTOR but also because
-            dead threads will have been detected before this is even run.
-
-            So, let's just hope the threads are really, really dead and get the rid of the resources.
-            If they wake up from the dead they'll bail out but perhaps that's the best thing to do.
-
-            In my experience dead threads are a fairly rare occurance. They are due mostly to brittle drivers and when they
-            die, they die in a OpenCL call to never return... so...
-            Basically we leak their stack-allocated resources. */
-        }
+        /* Thread termination is dangerous in Windows and most likely in other OS as well (that's why C++11 does not have it by default).
+        In my experience dead threads are a fairly rare occurance. They are due mostly to brittle drivers and when they
+        die, they die in a OpenCL call to never return. Those RecoverQueue gave up on are not even waited for.
+        Whatever is still there after a while is leaked, context included: if it ever comes back it uses its Miner. */
+        detached::Dismiss(miners, retired, spawned, exitedThreads, std::chrono::seconds(10));
     }
 
 protected:
@@ -169,37 +316,44 @@ protected:
         const void *owner;
         PoolInfo::DiffMultipliers diffMul;
         stratum::WorkDiff workDiff;
-        stratum::AbstractWorkFactory *factory; //! this is owned by the usedFactories std::map, which keeps them reference-counted
-        CurrentWork(PoolInfo::DiffMultipliers multipliers) : diffMul(multipliers), factory(nullptr) { }
+        /*! Shared by the snapshots having it and the threads using it. When a new job comes the main thread just replaces it, the old one
+        goes away when the last thread notices and moves on. */
+        std::shared_ptr<stratum::AbstractWorkFactory> factory;
+        bool degraded; //!< set by the main thread, the pool selection policy decides what to do with it
+        CurrentWork(PoolInfo::DiffMultipliers multipliers) : diffMul(multipliers), degraded(false) { }
     };
-    template<typename Type>
-    struct RefCounted {
-        std::unique_ptr<Type> res;
-        asizei count = 0;
-
-        RefCounted(Type *own) : res(own) { }
-        RefCounted<Type>(RefCounted<Type> &&other) {
-            res = std::move(other.res);
-            count = other.count;
-        }
-        RefCounted<Type>& operator=(RefCounted<Type> &&other) {
-            if(this != &other) {
-                count = other.count;
-                res = std::move(other.res);
-            }
-            return *this;
-        }
-        bool operator==(const Type *other) const { return res.get() == other; }
-        RefCounted<Type>& operator=(const RefCounted<Type> &) = delete;
-        RefCounted<Type>(const RefCounted<Type> &other) = delete;
+
+    /*! What the mining threads look at to decide what to do. The main thread changes its own copy of owners and publishes a new snapshot,
+    see PublishedSnapshot. Mining threads only check the generation at each iteration, the snapshot is read when it changes. */
+    struct WorkSnapshot {
+        std::vector<CurrentWork> owners;
     };
+    std::shared_ptr<const WorkSnapshot> Snapshot() const { return work.Get(); }
 
+    /*! Only used to sleep on workChanged, so threads without work wake up as soon as something is published, and by BadThings.
+    It's not held to read the work anymore. */
     mutable std::mutex guard;
-    std::vector<CurrentWork> owners;
-    std::vector< RefCounted<stratum::AbstractWorkFactory> > usedFactories;
-    /*!< This was originally a map but since there will be at worse dozens I take it easy and prefer easiness of tracking reference counting.
-    All threads collaborate in setting the reference counter so this is also protected, it's used together with this->owners. */
-    std::queue< std::pair<NonceOriginIdentifier, VerifiedNonces> > results;
+
+    /*! Mining threads compare the generation to what they've seen last: it's a single atomic load so they can do that at every iteration and
+    react right away to new jobs, new difficulty or failover. Sleeping threads wait on workChanged so they are woken up as soon as work arrives. */
+    PublishedSnapshot<WorkSnapshot> work;
+    std::condition_variable workChanged;
+
+    std::vector<CurrentWork> owners; //!< main thread's copy, the one being modified
+
+    //! Called by the main thread after changing owners.
+    void Publish() {
+        auto next(std::make_shared<WorkSnapshot>());
+        next->owners = owners;
+        work.Publish(std::move(next), guard);
+        workChanged.notify_all();
+    }
+
+    /*! Results are pushed by the mining threads and pulled by ResultsFound without taking any lock, a burst of results shouldn't wait
+    on anything nor slow down anyone. */
+    typedef MPSCQueue< std::pair<NonceOriginIdentifier, VerifiedNonces> > ResultQueue;
+    ResultQueue results;
+    ResultQueueStats resultStats; //!< only touched by ResultsFound, which is called by a single thread
 
     /*! One of those structs is generated for each thread so the objects themselves don't need to be thread-protected.
     In theory. In practice we still want to inquiry status of each thread to inspect for termination and whatever. */
@@ -221,10 +375,71 @@ protected:
         Status status = s_created;
         std::vector<std::string> exitMessage;
         asizei sleepCount = 0; // this is used to trigger "signal device unused" notification once
+
+        /*! steady_clock ticks of the last completed scan, or of when the thread started waiting for one: after initializing,
+        after sleeping for lack of work and after a retune. 0 while retuning, there's nothing to watch then.
+        Written by the mining thread, read by the watchdog, see GetLastScanTime. */
+        std::atomic<std::chrono::steady_clock::rep> lastScan { 0 };
+        std::atomic<bool> abandoned { false }; //!< set by RecoverQueue, the thread must go away as soon as it notices
+        std::atomic<bool> exited { false }; //!< last thing the thread does, after this nothing touches this object anymore
+        bool stuck = false; //!< abandoned by RecoverQueue, the thread is not expected to exit. Main thread only, see detached::Dismiss.
+        cl_context ownContext = 0; //!< created by the mining thread when AlgoBuild::ctx is 0
+
+        // Live tuning, see PauseQueue and RetuneQueue. The thread looks at those between scans only.
+        std::atomic<bool> paused { false };
+        std::atomic<bool> retunePending { false }; //!< retune is there, so the thread doesn't need to lock sync at each scan to find out
+        std::unique_ptr<AlgoBuild> retune; //!< guarded by sync, taken by the thread
+        std::unique_ptr<AlgoBuild> retuned; //!< guarded by sync, given back by the thread after applying it, RecoverQueue's recipe
+        std::string retuneOutcome; //!< guarded by sync
+
+        ~Miner() {
+            dispatcher.reset(); // those go before the context they use
+            algo.reset();
+            if(ownContext) clReleaseContext(ownContext);
+        }
     };
     std::vector< std::unique_ptr<Miner> > miners; //!< unique_ptr used so those objects are persistent and can be used directly by the threads.
+    std::vector< std::unique_ptr<Miner> > retired; //!< replaced by RecoverQueue, kept around as their threads might still use them
+
+    //! What GenQueue was given for each queue, so RecoverQueue can do it again. Main thread only.
+    struct Recipe {
+        AlgoBuild build;
+        AbstractAlgorithm::SourceCodeBufferGetterFunc loader;
+        asizei devLinearIndex = 0; //!< REPLICATE_CLDEVICE_LINEARINDEX only
+    };
+    std::vector<Recipe> recipes;
+    asizei spawned = 0; //!< threads started, including replacements, so the DTOR knows how many to wait for
+
+    //! Those which came back from the dead can go now, the others are leaked until we go away.
+    void SweepRetired() {
+        auto gone = [](const std::unique_ptr<Miner> &test) { return test->exited.load(std::memory_order_acquire); };
+        retired.erase(std::remove_if(retired.begin(), retired.end(), gone), retired.end());
+    }
+
+    /*! Starts a new thread for the queue from its recipe and abandons the current one.
+    \param ownContext the thread creates a context of its own instead of using the recipe's. */
+    void Respawn(asizei queue, bool ownContext) {
+        SweepRetired();
+        const Recipe &recipe(recipes[queue]);
+        auto replacement(std::make_unique<Miner>(miners[queue]->canon));
+        replacement->paused.store(miners[queue]->paused.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        AlgoBuild build(recipe.build);
+        if(ownContext) build.ctx = 0; // the one shared with the other devices might be what the driver is choking on
+        MiningThreadParams boo(queue, *replacement, std::move(build)
+#if defined REPLICATE_CLDEVICE_LINEARINDEX
+            , recipe.devLinearIndex
+#endif
+            );
+        boo.sourceGetter = recipe.loader;
+        replacement->worker = std::thread(GetMiningMain(), boo);
+        replacement->worker.detach();
+        spawned++;
+        miners[queue]->abandoned.store(true, std::memory_order_release);
+        retired.push_back(std::move(miners[queue]));
+        miners[queue] = std::move(replacement);
+    }
     std::atomic<bool> keepRunning = true;
-    std::atomic<auint> exitedThreads = 0; //!< This is used after a while to check how many threads exited before we destroy resources.
+    detached::ExitCounter exitedThreads = detached::NewExitCounter(); //!< This is used after a while to check how many threads exited before we destroy resources.
 
     struct MiningThreadParams { // resolve VC2015 bailing out for names too long
         Miner &miner;
@@ -250,28 +465,6 @@ protected:
     The miner structure is passed in an guaranteed to be persistent at the index passed in our management pool but it's basically empty with no algo nor dispatcher. */
     virtual std::function<void(MiningThreadParams)> GetMiningMain() = 0;
 
-    void RemFactory(stratum::AbstractWorkFactory *old) {
-        auto match(std::find_if(usedFactories.begin(), usedFactories.end(), [old](const RefCounted<stratum::AbstractWorkFactory> &test) {
-            return test.res.get() == old;
-        }));
-        if(match == usedFactories.end()) return; // impossible anyway because of context
-        match->count--;
-        if(match->count == 0) usedFactories.erase(match);
-    }
-
-    //! Either add +1 to reference count or take ownership and add pointer to list of used factories. A bit ugly conceptually.
-    stratum::AbstractWorkFactory* AddFactory(stratum::AbstractWorkFactory *ptr) {
-        auto match(std::find_if(usedFactories.begin(), usedFactories.end(), [&ptr](const RefCounted<stratum::AbstractWorkFactory> &test) {
-            return test.res.get() == ptr;
-        }));
-        if(match == usedFactories.end()) {
-            RefCounted<stratum::AbstractWorkFactory> add(ptr);
-            usedFactories.push_back(std::move(add));
-            match = usedFactories.end() - 1;
-        }
-        match->count++;
-        return match->res.get();
-    }
 
     /*! Each mining thread must validate nonces by itself before reporting them. This helper struct will come in handy to track how hashes were generated.
     Each mining thread generates one on starting a new algo iteration. */
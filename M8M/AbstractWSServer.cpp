@@ -8,28 +8,25 @@
 const auint AbstractWSServer::maxClients = 5;
 
 
-void AbstractWSServer::FillSleepLists(std::vector<Network::SocketInterface*> &toRead, std::vector<Network::SocketInterface*> &toWrite) {
+void AbstractWSServer::UpdateInterest() {
     if(!landing) return;  // it is always shut down after everything else so if that happens nothing is there for sure.
-    if(shutdownInitiated == TimePoint()) toRead.push_back(landing); // not going to accept this anymore if shutting down
-    std::for_each(clients.cbegin(), clients.cend(), [&toRead, &toWrite](const ClientState &ua) {
-        if(ua.initializer) {
-            if(ua.initializer->NeedsToSend()) toWrite.push_back(&ua.conn.get());
-            else toRead.push_back(&ua.conn.get());
-        }
-        else if(ua.ws) {
-            if(ua.ws->NeedsToSend()) toWrite.push_back(&ua.conn.get());
-            else toRead.push_back(&ua.conn.get());
-        }
-    });
+    typedef Network::SocketInterface SI;
+    landing->SetInterest(shutdownInitiated == TimePoint()? SI::si_read : SI::si_none); // not going to accept this anymore if shutting down
+    for(auto &ua : clients) {
+        auint interest = SI::si_none;
+        if(ua.initializer) interest = ua.initializer->NeedsToSend()? SI::si_write : SI::si_read;
+        else if(ua.ws) interest = ua.ws->NeedsToSend()? SI::si_write : SI::si_read;
+        ua.conn.get().SetInterest(interest);
+    }
 }
 
 
-void AbstractWSServer::Refresh(std::vector<Network::SocketInterface*> &toRead, std::vector<Network::SocketInterface*> &toWrite) {
+void AbstractWSServer::Refresh() {
     if(!landing) return; // fully shut down --> no clients either
     PurgeClosedConnections();
     if(AreYouClosing() == false) {
-        ReadWrite(toRead, toWrite);
-        UpgradeConnect(toRead, toWrite);
+        ReadWrite();
+        UpgradeConnect();
         EnqueuePushData();
     }
     else {
@@ -55,7 +52,7 @@ void AbstractWSServer::Refresh(std::vector<Network::SocketInterface*> &toRead, s
                 }
             }
         }
-        ReadWrite(toRead, toWrite); // We still have to send all the close requests and get their confirms...
+        ReadWrite(); // We still have to send all the close requests and get their confirms...
 
         // Oh wait! Above we played nice. But if a peer is not nice to us, we are not nice to it and kill TCP conn.
         if(shutdownInitiated < std::chrono::system_clock::now() - std::chrono::seconds(5)) {
@@ -80,37 +77,30 @@ void AbstractWSServer::Listen() {
 }
 
 
-void AbstractWSServer::ReadWrite(std::vector<Network::SocketInterface*> &toRead, std::vector<Network::SocketInterface*> &toWrite) {
+void AbstractWSServer::ReadWrite() {
     // First thing to do: serve already connected websockets. We first consume, then send.
-    for(const auto &skt : toRead) {
-        auto el = std::find(clients.begin(), clients.end(), skt);
-        if(el == clients.cend()) continue; // either not mine or landing socket
-        if(el->initializer) continue; // Upgrading socket state later.
+    for(auto &client : clients) {
+        if(client.initializer) continue; // Upgrading socket state later.
+        auto &skt(client.conn.get());
+        if(!skt.Readable()) continue;
         std::vector<ws::Connection::Message> msg;
-        if(!el->ws->Read(msg)) continue;
-        Mangle(*el, msg, *skt);
+        if(!client.ws->Read(msg)) continue;
+        Mangle(client, msg, skt);
     }
-    for(const auto &skt : toWrite) {
-        auto el = std::find(clients.begin(), clients.end(), skt);
-        if(el == clients.cend()) continue;
-        if(el->initializer) continue;
-        if(el->ws->NeedsToSend()) el->ws->Send();
+    for(auto &client : clients) {
+        if(client.initializer || !client.conn.get().Writable()) continue;
+        if(client.ws->NeedsToSend()) client.ws->Send();
     }
     // Now same read-write thing for sockets handshaking.
     for(auto &client : clients) {
-        auto r = std::find(toRead.begin(), toRead.end(), &client.conn.get());
-        auto w = std::find(toWrite.begin(), toWrite.end(), &client.conn.get());
-        if(r == toRead.end() && w == toWrite.end()) continue;
         if(client.ws) continue; // this one is for HTTP->WS upgrade, already mangled above
-        else {
-            if(r != toRead.end()) client.initializer->Receive();
-            if(w != toWrite.end()) client.initializer->Send();
-        }
+        if(client.conn.get().Readable()) client.initializer->Receive();
+        if(client.conn.get().Writable()) client.initializer->Send();
     }
 }
 
 
-void AbstractWSServer::UpgradeConnect(std::vector<Network::SocketInterface*> &toRead, std::vector<Network::SocketInterface*> &toWrite) {
+void AbstractWSServer::UpgradeConnect() {
     std::for_each(clients.begin(), clients.end(), [this](ClientState &client) {
         if(client.initializer && client.initializer->Upgraded()) {
             client.ws.reset(new ws::Connection(client.conn, true));
@@ -118,8 +108,7 @@ void AbstractWSServer::UpgradeConnect(std::vector<Network::SocketInterface*> &to
         }
     });
     // Last pick up new connections (only if not shutting down).
-    auto newPeer = std::find(toRead.begin(), toRead.end(), landing);
-    if(newPeer != toRead.end()) {
+    if(landing->Readable()) {
         auto &pipe(network.BeginConnection(*landing));
         if(clients.size() >= maxClients || shutdownInitiated != TimePoint()) network.CloseConnection(pipe); // or maybe I could not even allow it - I would keep getting waken up
         else {
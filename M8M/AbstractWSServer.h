@@ -20,8 +20,8 @@ public:
 
 	AbstractWSServer(NetworkInterface &netAPI, aushort servicePort, const char *httpRes, const char *wsProtoString)
 		: network(netAPI), landing(nullptr), numberedPushers(0), port(servicePort), processing(nullptr), resURI(httpRes), wsProtocol(wsProtoString) { }
-	void FillSleepLists(std::vector<Network::SocketInterface*> &toRead, std::vector<Network::SocketInterface*> &toWrite);
-	void Refresh(std::vector<Network::SocketInterface*> &toRead, std::vector<Network::SocketInterface*> &toWrite);
+	void UpdateInterest(); //!< sets what the landing socket and the clients wait for, call before Network::SleepOn
+	void Refresh();
 	void RegisterCommand(std::unique_ptr<commands::AbstractCommand> &cmd) {
         auto pair(std::make_pair(cmd->name, std::move(cmd)));
         commands.insert(std::move(pair));
@@ -95,8 +95,8 @@ private:
 	};
 
 
-	void ReadWrite(std::vector<Network::SocketInterface*> &toRead, std::vector<Network::SocketInterface*> &toWrite);
-	void UpgradeConnect(std::vector<Network::SocketInterface*> &toRead, std::vector<Network::SocketInterface*> &toWrite);
+	void ReadWrite();
+	void UpgradeConnect();
 	void Unsubscribe(const std::string &command, const std::string &stream);
 	void PurgeClosedConnections();
 	void EnqueuePushData();
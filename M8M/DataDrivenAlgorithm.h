@@ -4,6 +4,7 @@
  */
 #pragma once
 #include "AbstractAlgorithm.h"
+#include <algorithm>
 
 class DataDrivenAlgorithm : public AbstractAlgorithm {
 public:
@@ -24,7 +25,73 @@ public:
         return PrepareKernels(kern, specials, loader);
     }
 
+    /*! Live tuning. Becomes what Init would have built with those settings but resources described exactly as before keep their buffers
+    and kernels built from the same source, entry point and options keep their cl_kernel, only bound again.
+    Everything new is built before anything old goes so if errors are returned nothing changed and the algorithm is still good to go.
+    Only call this between scans, with nothing in flight. Special values are bound again in all cases, they might have changed too. */
+    std::vector<std::string> Rebuild(AbstractSpecialValuesProvider &specials, SourceCodeBufferGetterFunc loader, asizei numHashes, asizei candHashUints,
+                                     const std::vector<ResourceRequest> &res, const std::vector<KernelRequest> &kern) {
+        Built next;
+        next.hashCount = numHashes;
+        next.uintsPerHash = candHashUints;
+        next.kernRequests = kern;
+        std::vector<std::string> errors;
+        for(const auto &el : res) {
+            if(std::any_of(next.resRequests.cbegin(), next.resRequests.cend(), [&el](const ResourceRequest &test) { return test.name == el.name; })) {
+                errors.push_back("Duplicated resource name \"" + el.name + '"');
+                continue;
+            }
+            if(specials.SpecialValue(el.name)) {
+                errors.push_back("Trying to allocate special resource \"" + el.name + "\" from algorithm, invalid operation.");
+                continue;
+            }
+            next.resRequests.push_back(el);
+            if(el.immediate) continue;
+            auto same = [&el](const ResourceRequest &test) { return SameResource(test, el); };
+            if(std::any_of(resRequests.cbegin(), resRequests.cend(), same)) {
+                next.resHandles.insert(std::make_pair(el.name, resHandles[el.name]));
+                continue;
+            }
+            cl_mem build = CreateResource(el, errors);
+            if(build) next.resHandles.insert(std::make_pair(el.name, build));
+        }
+        std::vector<bool> taken(kernels.size());
+        for(const auto &el : kern) {
+            asizei reuse = 0;
+            while(reuse < kernels.size() && (taken[reuse] || !SameProgram(kernRequests[reuse], el))) reuse++;
+            if(reuse < kernels.size()) {
+                taken[reuse] = true;
+                next.kernels.push_back(KernelDriver(el.groupSize, kernels[reuse].clk));
+                continue;
+            }
+            cl_kernel build = BuildKernel(el, loader, errors);
+            if(build) next.kernels.push_back(KernelDriver(el.groupSize, build));
+        }
+        if(errors.empty()) {
+            Swap(next);
+            try {
+                BindAll(specials);
+            }
+            catch(std::string ohno) { errors.push_back(ohno); }
+            catch(const char *ohno) { errors.push_back(ohno); }
+            if(errors.size()) Swap(next); // back as it was
+        }
+        if(errors.size()) BindAll(specials); // was fine before so it will be fine again
+        // Now whatever is in next and not used anymore can go. It's the old stuff if everything went fine, what I've just built otherwise.
+        for(const auto &el : next.resHandles) {
+            auto used(std::find_if(resHandles.cbegin(), resHandles.cend(), [&el](const std::pair<std::string, cl_mem> &test) { return test.second == el.second; }));
+            if(used == resHandles.cend()) clReleaseMemObject(el.second);
+        }
+        for(const auto &el : next.kernels) {
+            auto used(std::find_if(kernels.cbegin(), kernels.cend(), [&el](const KernelDriver &test) { return test.clk == el.clk; }));
+            if(used == kernels.cend()) clReleaseKernel(el.clk);
+        }
+        return errors;
+    }
+
 private:
+    std::vector<KernelRequest> kernRequests; //!< where each of AbstractAlgorithm::kernels comes from, so Rebuild knows what can be kept
+
     /*! Derived classes are expected to call this somewhere in their ctor. It deals with allocating memory and eventually initializing it in a
     data-driven way. Note special resources cannot be created using this, at least in theory. Just create them in the ctor before PrepareKernels.
     While this is allowed to throw, it is suggested to produce a list of errors to be returned by Init(). */
@@ -38,118 +105,158 @@ private:
             }
             resRequests.push_back(res);
             if(res.immediate) continue; // nothing to allocate here
-            ScopedFuncCall popLast([this]() { resRequests.pop_back(); });
-            cl_mem build = 0;
-            ScopedFuncCall relMem([&build]() { if(build) clReleaseMemObject(build); });
-            cl_int err = 0;
-            asizei count = errors.size();
-            if(res.imageDesc.image_width) {
-                aubyte *src = const_cast<aubyte*>(res.initialData);
-                build = clCreateImage(context, res.memFlags, &res.channels, &res.imageDesc, src, &err);
-                if(err == CL_INVALID_VALUE) errors.push_back("Invalid flags specified for \"" + res.name + '"');
-                else if(err == CL_INVALID_IMAGE_FORMAT_DESCRIPTOR)  errors.push_back("Invalid image format descriptor for \"" + res.name + '"');
-                else if(err == CL_INVALID_IMAGE_DESCRIPTOR) errors.push_back("Invalid image descriptor for \"" + res.name + '"');
-                else if(err == CL_INVALID_IMAGE_SIZE) errors.push_back("Image \"" + res.name + "\" is too big!");
-                else if(err == CL_INVALID_HOST_PTR) errors.push_back("Invalid host data for \"" + res.name + '"');
-                else if(err == CL_IMAGE_FORMAT_NOT_SUPPORTED) errors.push_back("Invalid image format for \"" + res.name + '"');
-                else if(err != CL_SUCCESS) errors.push_back("Some error while creating \"" + res.name + "\")");
-                if(errors.size() != count) continue;
-            }
-            else {
-                cl_uint extraFlags = 0;
-                if(res.initialData) {
-                    if(res.useProvidedBuffer) extraFlags |= CL_MEM_USE_HOST_PTR;
-                    else extraFlags |= CL_MEM_COPY_HOST_PTR;
-                }
-                build = clCreateBuffer(context, res.memFlags | extraFlags, res.bytes, const_cast<aubyte*>(res.initialData), &err);
-                if(err == CL_INVALID_VALUE) errors.push_back("Invalid flags specified for \"" + res.name + '"');
-                else if(err == CL_INVALID_BUFFER_SIZE) errors.push_back("Invalid buffer size for \"" + res.name + "\": " + std::to_string(res.bytes));
-                else if(err == CL_INVALID_HOST_PTR) errors.push_back("Invalid host data for \"" + res.name + '"');
-                else if(err != CL_SUCCESS) errors.push_back("Some error while creating \"" + res.name + '"');
-                if(errors.size() != count) continue;
+            cl_mem build = CreateResource(res, errors);
+            if(!build) {
+                resRequests.pop_back();
+                continue;
             }
             resHandles.insert(std::make_pair(res.name, build));
-            relMem.Dont();
-            popLast.Dont();
         }
         return errors;
     }
 
+    //! Creates the buffer or image described. Returns 0 and adds the reason to errors if it can't.
+    cl_mem CreateResource(const ResourceRequest &res, std::vector<std::string> &errors) const {
+        cl_mem build = 0;
+        cl_int err = 0;
+        asizei count = errors.size();
+        if(res.imageDesc.image_width) {
+            aubyte *src = const_cast<aubyte*>(res.initialData);
+            build = clCreateImage(context, res.memFlags, &res.channels, &res.imageDesc, src, &err);
+            if(err == CL_INVALID_VALUE) errors.push_back("Invalid flags specified for \"" + res.name + '"');
+            else if(err == CL_INVALID_IMAGE_FORMAT_DESCRIPTOR)  errors.push_back("Invalid image format descriptor for \"" + res.name + '"');
+            else if(err == CL_INVALID_IMAGE_DESCRIPTOR) errors.push_back("Invalid image descriptor for \"" + res.name + '"');
+            else if(err == CL_INVALID_IMAGE_SIZE) errors.push_back("Image \"" + res.name + "\" is too big!");
+            else if(err == CL_INVALID_HOST_PTR) errors.push_back("Invalid host data for \"" + res.name + '"');
+            else if(err == CL_IMAGE_FORMAT_NOT_SUPPORTED) errors.push_back("Invalid image format for \"" + res.name + '"');
+            else if(err != CL_SUCCESS) errors.push_back("Some error while creating \"" + res.name + "\")");
+        }
+        else {
+            cl_uint extraFlags = 0;
+            if(res.initialData) {
+                if(res.useProvidedBuffer) extraFlags |= CL_MEM_USE_HOST_PTR;
+                else extraFlags |= CL_MEM_COPY_HOST_PTR;
+            }
+            build = clCreateBuffer(context, res.memFlags | extraFlags, res.bytes, const_cast<aubyte*>(res.initialData), &err);
+            if(err == CL_INVALID_VALUE) errors.push_back("Invalid flags specified for \"" + res.name + '"');
+            else if(err == CL_INVALID_BUFFER_SIZE) errors.push_back("Invalid buffer size for \"" + res.name + "\": " + std::to_string(res.bytes));
+            else if(err == CL_INVALID_HOST_PTR) errors.push_back("Invalid host data for \"" + res.name + '"');
+            else if(err != CL_SUCCESS) errors.push_back("Some error while creating \"" + res.name + '"');
+        }
+        if(errors.size() == count) return build;
+        if(build) clReleaseMemObject(build);
+        return 0;
+    }
+
     //! Similarly, kernels are described by data and built by resolving the previously declared resources. Device used to pull out eventual error logs.
     std::vector<std::string> PrepareKernels(const std::vector<KernelRequest> &kernels, AbstractSpecialValuesProvider &special, SourceCodeBufferGetterFunc loader) {
-        // By delegating the getter func to resolve source code buffers, this gets way simplier.
-        std::vector<std::pair<const char*, asizei>> sources;
         std::vector<std::string> errors;
+        this->kernels.reserve(kernels.size());
         for(const auto &k : kernels) {
-            std::vector<std::string> fileErrors;
-            sources.push_back(loader(fileErrors, k.fileName));
-            if(fileErrors.size()) {
-                for(const auto &el : fileErrors) errors.push_back(std::move(k.fileName + ": " + el));
-            }
+            cl_kernel build = BuildKernel(k, loader, errors);
+            if(build) this->kernels.push_back(KernelDriver(k.groupSize, build));
         }
         if(errors.size()) return errors;
-        // Run all the compile calls. One program must be built for each requested kernel as it will go with different compile options but they have the same source.
-        // OpenCL is reference counted (bleargh) so programs can go at the end of this function.
-        // I wanted to do this asyncronously but BuildProgram goes with notification functions instead of events (?) so I would have to do that multithreaded.
-        // Or, I might just Sleep one second. Not bad either but I cannot be bothered in getting a sleep call here.
-        // By the way, CL spec reads as error: "CL_INVALID_OPERATION if the build of a program executable for any of the devices listed in device_list by a previous
-        // call to clBuildProgram for program has not completed." So this is really non concurrent?
-        std::vector<cl_program> progs(kernels.size());
-        ScopedFuncCall clearProgs([&progs]() { for(auto el : progs) { if(el) clReleaseProgram(el); } });
-        for(asizei loop = 0; loop < kernels.size(); loop++) {
-            const char *str = sources[loop].first;
-            const asizei len = sources[loop].second;
-            cl_int err = 0;
-            cl_program created = clCreateProgramWithSource(context, 1, &str, &len, &err);
-            if(err != CL_SUCCESS) {
-                errors.push_back(std::string("Failed to create program \"") + kernels[loop].fileName + '"');
-                continue;
-            }
-            progs[loop] = created;
-
-            err = clBuildProgram(created, NULL, 0, kernels[loop].compileFlags.c_str(), NULL, NULL);
-            std::string errString;
-            if(err == CL_INVALID_BUILD_OPTIONS) {
-                errString = std::string("Invalid compile options \"");
-                errString += kernels[loop].compileFlags + "\" for ";
-                errString += kernels[loop].fileName + '.' + kernels[loop].entryPoint;
-            }
-            else if(err != CL_SUCCESS) {
-                errString = std::string("OpenCL error ") + std::to_string(err) + " for ";
-                errString += kernels[loop].fileName + '.' + kernels[loop].entryPoint + ", attempted compile with \"";
-                errString += kernels[loop].compileFlags + '"';
-            }
-            if(errString.length()) {
-                std::vector<char> log;
-                asizei requiredChars;
-                err = clGetProgramBuildInfo(created, device, CL_PROGRAM_BUILD_LOG, 0, NULL, &requiredChars);
-                if(err != CL_SUCCESS) {
-                    errors.push_back(errString + " (also failed to call clGetProgramBuildInfo successfully)"); // unrecognized compile options meh
-                    continue;
-                }
-                else {
-                    log.resize(requiredChars);
-                    err = clGetProgramBuildInfo(created, device, CL_PROGRAM_BUILD_LOG, log.size(), log.data(), &requiredChars);
-                    if(err != CL_SUCCESS) errString + "(also failed to get build error log)";
-                    errors.push_back(errString + '\n' + "ERROR LOG:\n" + std::string(log.data(), requiredChars));
-                }
-            }
+        kernRequests = kernels;
+        BindAll(special);
+        return errors;
+    }
+
+    /*! One program is built for each requested kernel as it will go with different compile options but they have the same source.
+    OpenCL is reference counted (bleargh) so the program can go as soon as the kernel is there.
+    I wanted to do this asyncronously but BuildProgram goes with notification functions instead of events (?) so I would have to do that multithreaded.
+    By the way, CL spec reads as error: "CL_INVALID_OPERATION if the build of a program executable for any of the devices listed in device_list by a previous
+    call to clBuildProgram for program has not completed." So this is really non concurrent?
+    \returns 0 if something went wrong, errors tell what. */
+    cl_kernel BuildKernel(const KernelRequest &kernel, SourceCodeBufferGetterFunc loader, std::vector<std::string> &errors) const {
+        // By delegating the getter func to resolve source code buffers, this gets way simplier.
+        std::vector<std::string> fileErrors;
+        const auto source(loader(fileErrors, kernel.fileName));
+        if(fileErrors.size()) {
+            for(const auto &el : fileErrors) errors.push_back(kernel.fileName + ": " + el);
+            return 0;
         }
-        if(errors.size()) return errors;
-        this->kernels.reserve(kernels.size());
+        const char *str = source.first;
+        const asizei len = source.second;
+        cl_int err = 0;
+        cl_program created = clCreateProgramWithSource(context, 1, &str, &len, &err);
+        if(err != CL_SUCCESS) {
+            errors.push_back(std::string("Failed to create program \"") + kernel.fileName + '"');
+            return 0;
+        }
+        ScopedFuncCall clearProg([created]() { clReleaseProgram(created); });
 
-        for(asizei loop = 0; loop < kernels.size(); loop++) {
-            cl_int err;
-            cl_kernel kern = clCreateKernel(progs[loop], kernels[loop].entryPoint.c_str(), &err);
+        err = clBuildProgram(created, NULL, 0, kernel.compileFlags.c_str(), NULL, NULL);
+        std::string errString;
+        if(err == CL_INVALID_BUILD_OPTIONS) {
+            errString = std::string("Invalid compile options \"");
+            errString += kernel.compileFlags + "\" for ";
+            errString += kernel.fileName + '.' + kernel.entryPoint;
+        }
+        else if(err != CL_SUCCESS) {
+            errString = std::string("OpenCL error ") + std::to_string(err) + " for ";
+            errString += kernel.fileName + '.' + kernel.entryPoint + ", compile options \"";
+            errString += kernel.compileFlags + '"';
+        }
+        if(errString.length()) {
+            std::vector<char> log;
+            asizei requiredChars;
+            err = clGetProgramBuildInfo(created, device, CL_PROGRAM_BUILD_LOG, 0, NULL, &requiredChars);
             if(err != CL_SUCCESS) {
-                errors.push_back(std::string("Could not create kernel \"") + kernels[loop].fileName + ':' + kernels[loop].entryPoint + "\", error " + std::to_string(err));
-                continue;
+                errors.push_back(errString + " (also failed to call clGetProgramBuildInfo successfully)"); // unrecognized compile options meh
+                return 0;
             }
-            this->kernels.push_back(KernelDriver(kernels[loop].groupSize, kern));
+            log.resize(requiredChars);
+            err = clGetProgramBuildInfo(created, device, CL_PROGRAM_BUILD_LOG, log.size(), log.data(), &requiredChars);
+            if(err != CL_SUCCESS) errString + "(also failed to get build error log)";
+            errors.push_back(errString + '\n' + "ERROR LOG:\n" + std::string(log.data(), requiredChars));
+            return 0;
         }
-        if(errors.size()) return errors;
-        for(asizei loop = 0; loop < kernels.size(); loop++) BindParameters(this->kernels[loop], kernels[loop], special, loop);
-        return errors;
+        cl_kernel kern = clCreateKernel(created, kernel.entryPoint.c_str(), &err);
+        if(err != CL_SUCCESS) {
+            errors.push_back(std::string("Could not create kernel \"") + kernel.fileName + ':' + kernel.entryPoint + "\", error " + std::to_string(err));
+            return 0;
+        }
+        return kern;
+    }
+
+    void BindAll(AbstractSpecialValuesProvider &special) {
+        for(asizei loop = 0; loop < kernels.size(); loop++) BindParameters(kernels[loop], kernRequests[loop], special, loop);
+    }
+
+    //! Buffers initialized from the same data are the same even if the data was parsed again and lives somewhere else now.
+    static bool SameResource(const ResourceRequest &one, const ResourceRequest &two) {
+        if(one.name != two.name || one.bytes != two.bytes || one.memFlags != two.memFlags || one.immediate != two.immediate) return false;
+        if(one.useProvidedBuffer != two.useProvidedBuffer) return false;
+        if((one.initialData == nullptr) != (two.initialData == nullptr)) return false;
+        if(one.initialData && one.initialData != two.initialData && memcmp(one.initialData, two.initialData, one.bytes)) return false;
+        if(one.useProvidedBuffer && one.initialData != two.initialData) return false; // the buffer IS that memory
+        const auto &a(one.imageDesc), &b(two.imageDesc);
+        if(a.image_type != b.image_type || a.image_width != b.image_width || a.image_height != b.image_height || a.image_depth != b.image_depth) return false;
+        if(a.image_array_size != b.image_array_size || a.image_row_pitch != b.image_row_pitch || a.image_slice_pitch != b.image_slice_pitch) return false;
+        return one.channels.image_channel_order == two.channels.image_channel_order && one.channels.image_channel_data_type == two.channels.image_channel_data_type;
+    }
+
+    static bool SameProgram(const KernelRequest &one, const KernelRequest &two) {
+        return one.fileName == two.fileName && one.entryPoint == two.entryPoint && one.compileFlags == two.compileFlags;
+    }
+
+    //! What Rebuild prepares, swapped in when everything is there.
+    struct Built {
+        asizei hashCount = 0, uintsPerHash = 0;
+        std::vector<KernelDriver> kernels;
+        std::vector<KernelRequest> kernRequests;
+        std::vector<ResourceRequest> resRequests;
+        std::map<std::string, cl_mem> resHandles;
+    };
+
+    void Swap(Built &other) {
+        std::swap(hashCount, other.hashCount);
+        std::swap(uintsPerHash, other.uintsPerHash);
+        kernels.swap(other.kernels);
+        kernRequests.swap(other.kernRequests);
+        resRequests.swap(other.resRequests);
+        resHandles.swap(other.resHandles);
     }
 
 
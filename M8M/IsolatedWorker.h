@@ -0,0 +1,233 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+#include "../Common/AREN/ArenDataTypes.h"
+#include "../Common/SharedMemory.h"
+#include "../Common/SharedRing.h"
+#include "../Common/ChildProcess.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <thread>
+#include <new>
+#include <string.h>
+
+
+/*! When a driver call hangs or crashes, it takes the mining thread with it and often the whole process. A thread stuck in a CL call
+cannot be killed safely, so ~AbstractNonceFindersBuild just waits a bit and leaks it. A process instead can be killed and started again.
+
+In isolated mode each device is driven by a worker process, which is M8M itself started with --worker. The mining thread in the main
+process becomes the worker supervisor: it still selects work, rolls headers and verifies nonces as usual but the CL side (algorithm
+resources, dispatcher, kernels) lives in the worker. Verification stays in the main process: a worker gone bad should not be trusted
+to tell what's good. Pool connections are in the main process as well so they don't even notice a worker going away.
+
+The two talk through a Channel in shared memory: headers go down, nonces come back up, both through lock-free rings so neither side
+ever waits for the other. There are no OS events: both sides poll, sleeping a little when there's nothing to do. */
+namespace isolation {
+
+
+static const auint PROTOCOL_VERSION = 1; //!< parent and worker are the same binary, but a stale worker from an old build must not misread
+static const auint MAX_NONCES = 32; //!< per ResultPacket, iterations finding more than this send more packets
+static const auint MAX_HASH_UINTS = 8; //!< 256 bit hashes, more than any algorithm produces
+
+
+//! Header to scan, the worker scans all nonces until a new header comes or it runs out of them.
+struct WorkPacket {
+    auint id; //!< comes back in the results so they can be matched to what was sent
+    auint reserved;
+    aulong targetBits;
+    std::array<aubyte, 80> header;
+};
+
+
+struct ResultPacket {
+    enum Flags {
+        rp_iteration = 1, //!< an iteration completed, elapsedus is valid. Iterations finding nothing send a packet anyway, it's the worker heartbeat too
+        rp_exhausted = 2, //!< all nonces scanned for this header, waiting for a new one
+        rp_more = 4 //!< there are more nonces for this iteration coming in the next packet
+    };
+    auint id; //!< WorkPacket::id of the header producing this
+    auint flags;
+    auint count; //!< of nonces
+    auint uintsPerHash;
+    aulong elapsedus;
+    std::array<auint, MAX_NONCES> nonces;
+    std::array<auint, MAX_NONCES * MAX_HASH_UINTS> hashes; //!< count * uintsPerHash are meaningful
+};
+
+
+enum WorkerState {
+    ws_starting, //!< set by the parent: worker is initializing. It's the shared memory zero, so a worker not even starting stays there.
+    ws_running, //!< set by the worker: initialized, accepting work
+    ws_failed //!< set by the worker, message tells why, process is about to exit
+};
+
+
+//! Lives in SharedMemory. Created (zeroed) by the parent, which then sets version and device.
+struct Channel {
+    auint version;
+    auint device; //!< linear index of the device the worker must use
+    SharedRing<WorkPacket, 8> work;
+    SharedRing<ResultPacket, 64> results;
+    std::atomic<auint> state;
+    std::atomic<auint> heartbeat; //!< bumped by the worker as it does things, even when idle
+    std::atomic<auint> parentBeat; //!< bumped by the parent, if it stops the parent is gone and the worker exits
+    std::atomic<auint> quit; //!< set by the parent to ask the worker to go away nicely
+    char message[1024]; //!< worker failure description, nul terminated, valid only after state becomes ws_failed
+};
+
+
+/*! Both sides poll. Spinning burns a CPU, sleeping adds latency: spin with yield for a while, then sleep.
+Results come at GPU iteration pace so the sleeping part is where things settle most of the time. */
+struct Backoff {
+    auint idle = 0;
+    void Busy() { idle = 0; }
+    void Idle() {
+        if(idle < 64) {
+            idle++;
+            std::this_thread::yield();
+        }
+        else std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }
+};
+
+
+/*! Owns a worker process, its shared memory and channel. Supervise must be called regularly, it's where workers are started,
+found dead or hung and started again. Everything is done by the calling thread, there's no thread in here.
+A new worker gets a new Channel so whatever was in flight for the previous one is gone: callers should check GetIncarnation. */
+class Supervisor {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    std::chrono::seconds startTimeout = std::chrono::minutes(5); //!< kernels might be built from source at first run, that's slow
+    std::chrono::seconds hangTimeout = std::chrono::seconds(30); //!< a running worker not beating for this long gets killed
+    std::chrono::milliseconds minBackoff = std::chrono::seconds(1); //!< wait before restarting, doubles at each failure
+    std::chrono::milliseconds maxBackoff = std::chrono::seconds(60); //!< also how long a worker must run for its failures to be forgotten
+    auint maxStartFailures = 3; //!< consecutive workers failing before even running, the supervisor gives up after this
+
+    enum State {
+        s_down, //!< no worker, waiting to start one
+        s_starting, //!< worker is initializing
+        s_running, //!< channel can be used
+        s_gaveUp //!< workers can't even start, GetLastError tells why, nothing else will happen
+    };
+
+    /*! \param program usually ChildProcess::GetOwnExecutable
+    \param args passed to each worker, followed by "--worker" and the channel name. */
+    Supervisor(const std::string &program, const std::vector<std::string> &args, auint device)
+        : program(program), args(args), device(device) { }
+
+    ~Supervisor() { Stop(std::chrono::seconds(2)); }
+
+    State Supervise(Clock::time_point now) {
+        if(state == s_gaveUp) return state;
+        if(worker) {
+            std::string why;
+            const auint ws = channel->state.load(std::memory_order_acquire);
+            if(!worker->Running()) why = "worker exited, code " + std::to_string(worker->GetExitCode());
+            else if(ws == ws_failed) why = "worker failed";
+            else if(ws == ws_starting && now > spawned + startTimeout) why = "worker took too long to initialize";
+            else if(ws == ws_running) {
+                const auint beat = channel->heartbeat.load(std::memory_order_relaxed);
+                if(state != s_running || beat != lastBeat) {
+                    state = s_running;
+                    lastBeat = beat;
+                    lastBeatTime = now;
+                    startFailures = 0;
+                    if(now > spawned + maxBackoff) failures = 0; // been running fine for a while
+                }
+                else if(now > lastBeatTime + hangTimeout) why = "worker hung";
+            }
+            if(why.empty()) {
+                channel->parentBeat.fetch_add(1, std::memory_order_relaxed);
+                return state;
+            }
+            if(ws == ws_failed) why += ": " + std::string(channel->message, strnlen(channel->message, sizeof(channel->message)));
+            Drop(why, now);
+            if(state == s_gaveUp) return state;
+        }
+        if(now < retryAt) return s_down;
+        try {
+            Spawn(now);
+        } catch(const std::exception &ohno) { Drop(std::string("could not start worker: ") + ohno.what(), now); }
+        return state;
+    }
+
+    //! Only if Supervise returned s_starting or s_running.
+    Channel* GetChannel() const { return channel; }
+
+    //! Incremented each time a worker is started. Channel contents are meaningful for one incarnation only.
+    auint GetIncarnation() const { return incarnation; }
+    //! Number of workers which went away for whatever reason.
+    auint GetRestarts() const { return restarts; }
+    const std::string& GetLastError() const { return lastError; }
+
+    //! Asks the worker to quit, gives it some time, then kills it. Supervise will start a new one.
+    void Stop(std::chrono::milliseconds grace) {
+        if(!worker) return;
+        channel->quit.store(1, std::memory_order_release);
+        const auto limit(Clock::now() + grace);
+        while(worker->Running() && Clock::now() < limit) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        worker.reset(); // kills if still running
+        channel = nullptr;
+        shared.reset();
+        if(state != s_gaveUp) state = s_down;
+    }
+
+private:
+    const std::string program;
+    const std::vector<std::string> args;
+    const auint device;
+    State state = s_down;
+    std::unique_ptr<SharedMemory> shared;
+    Channel *channel = nullptr;
+    std::unique_ptr<ChildProcess> worker; //!< destroyed before shared
+    auint incarnation = 0, restarts = 0;
+    auint failures = 0; //!< consecutive, for backoff
+    auint startFailures = 0; //!< consecutive workers failing before running
+    auint lastBeat = 0;
+    Clock::time_point spawned, lastBeatTime, retryAt;
+    std::string lastError;
+
+    void Spawn(Clock::time_point now) {
+        const std::string name("M8M_worker_" + std::to_string(reinterpret_cast<asizei>(this) & 0xFFFFFF) + '_' + std::to_string(Clock::now().time_since_epoch().count()));
+        shared.reset(new SharedMemory(name, sizeof(Channel), SharedMemory::sm_create));
+        channel = new (shared->Get()) Channel; // trivial, memory is zero
+        channel->version = PROTOCOL_VERSION;
+        channel->device = device;
+        std::vector<std::string> full(args);
+        full.push_back("--worker");
+        full.push_back(name);
+        worker.reset(new ChildProcess(program, full));
+        incarnation++;
+        spawned = now;
+        state = s_starting;
+    }
+
+    void Drop(const std::string &why, Clock::time_point now) {
+        const bool started = state == s_running;
+        worker.reset();
+        channel = nullptr;
+        shared.reset();
+        restarts++;
+        lastError = why;
+        failures++;
+        if(!started) startFailures++;
+        if(startFailures >= maxStartFailures) {
+            state = s_gaveUp;
+            return;
+        }
+        auto wait(minBackoff);
+        for(auint loop = 1; loop < failures && wait < maxBackoff; loop++) wait *= 2;
+        retryAt = now + std::min(wait, maxBackoff);
+        state = s_down;
+    }
+};
+
+
+}
@@ -30,6 +30,9 @@ struct StartParamsInferredStructs : StartParams {
     //! This controls creation of notification icon and its compositer. It could be handled just like the console but
     //! since this is more complicated, it isn't.
     bool invisible = false;
+
+    //! If not empty, we are a worker process for the M8M which started us, this is the name of the shared memory to talk to it.
+    std::string worker;
 };
 
 
@@ -45,8 +48,8 @@ void Parse(std::unique_ptr<OSUniqueChecker> &onlyOne, StartParamsInferredStructs
     }
     else {
         /* M8M is super spiffy and so minimalistic I often forgot it's already running.
-        Running multiple instances might make sense in the future (for example to mine different algos on different cards)
-        but it's not supported for the time being. Having multiple M8M instances doing the same thing will only cause driver work and GPU I$ to work extra hard. */
+        Running multiple instances used to be the only way to mine different algos on different cards, now a single instance does that,
+        see Settings::algos. Having multiple M8M instances doing the same thing will only cause driver work and GPU I$ to work extra hard. */
         onlyOne.reset(new OSUniqueChecker);
         if(onlyOne->CanStart(L"M8M_unique_instance_systemwide_mutex") == false) {
             const wchar_t *msg = L"It seems you forgot M8M is already running. Check out your notification area!\n"
@@ -103,6 +106,12 @@ void Parse(std::unique_ptr<OSUniqueChecker> &onlyOne, StartParamsInferredStructs
         }
     }
 
+    if(result.ConsumeParam(value, L"worker")) {
+        for(auto c : value) {
+            if(c) result.worker.push_back(char(c));
+        }
+    }
+
     if(result.FullyConsumed() == false) {
         const wchar_t *title = L"Dirty command line";
         const std::wstring rem(result.GetRemLine());
@@ -116,6 +125,36 @@ void Parse(std::unique_ptr<OSUniqueChecker> &onlyOne, StartParamsInferredStructs
 }
 
 
+/*! Isolated device mode, see the isolation namespace. We have been started by another M8M to run one device.
+Loads the same configuration and kernels as the parent but only to build the mining thread for the device in the channel,
+no pools, no icon, no web servers. Failures are reported through the channel, nobody would see them otherwise. */
+int WorkerMain(const StartParamsInferredStructs &start) {
+    SharedMemory shared(start.worker, sizeof(isolation::Channel), SharedMemory::sm_open);
+    auto &channel(*reinterpret_cast<isolation::Channel*>(shared.Get()));
+    if(channel.version != isolation::PROTOCOL_VERSION) return 3; // nothing else can be trusted
+    auto fail = [&channel](const char *msg) {
+        strncpy_s(channel.message, sizeof(channel.message), msg, _TRUNCATE);
+        channel.state.store(isolation::ws_failed, std::memory_order_release);
+        return 2;
+    };
+    try {
+        Network networkWrapper;
+        M8MWebServingApp application(networkWrapper);
+        application.LoadKernelDescriptions(L"algorithms.json", "kernels/");
+        std::unique_ptr<Settings> config(application.LoadSettings(start.configFile, start.configSpecified, start.algo.size()? start.algo.c_str() : nullptr));
+        if(!config) return fail("could not load configuration");
+        application.EnumerateDevices();
+        application.BecomeWorker(channel);
+        application.StartMining(config->algos, config->implParams);
+        return application.ServeParent();
+    }
+    catch(const char *msg) { return fail(msg); }
+    catch(const std::string msg) { return fail(msg.c_str()); }
+    catch(const std::exception &msg) { return fail(msg.what()); }
+    catch(...) { return fail("unknown exception"); }
+}
+
+
 #if defined(_WIN32)
 int WINAPI wWinMain(HINSTANCE instance, HINSTANCE unusedLegacyW16, PWSTR cmdLine, int showStatus) {
 #else
@@ -136,6 +175,7 @@ int main(int argc, char **argv) {
         StartParamsInferredStructs start(cmdLine);
         std::unique_ptr<OSUniqueChecker> sysSemaphore;
         Parse(sysSemaphore, start);
+        if(start.worker.size()) return WorkerMain(start);
         bool run = true, reboot = false;
         while(run) {
             if(reboot) {
@@ -147,9 +187,34 @@ int main(int argc, char **argv) {
             application.startTime.program = progStart;
             application.LoadKernelDescriptions(L"algorithms.json", "kernels/");
             application.InitIcon(start.invisible);
-            std::unique_ptr<Settings> config(application.LoadSettings(start.configFile, start.configSpecified, start.algo.size()? start.algo.c_str() : nullptr));
+            auto load = [&start, &application]() {
+                return application.LoadSettings(start.configFile, start.configSpecified, start.algo.size()? start.algo.c_str() : nullptr);
+            };
+            auto isolate = [&start, &application](const Settings &use) {
+                if(!use.isolateDevices) {
+                    application.SetIsolation(std::string(), std::vector<std::string>());
+                    return;
+                }
+                std::vector<std::string> args { "--alreadyRunning", "--invisible" };
+                std::wstring_convert< std::codecvt_utf8_utf16<wchar_t> > convert;
+                if(start.configSpecified) {
+                    args.push_back("--config");
+                    args.push_back(convert.to_bytes(start.configFile));
+                }
+                std::string algos;
+                for(const auto &el : use.algos) algos += (algos.size()? "," : "") + el;
+                args.push_back("--algo");
+                args.push_back(algos);
+                application.SetIsolation(ChildProcess::GetOwnExecutable(), args);
+            };
+            std::unique_ptr<Settings> config(load());
+            std::unique_ptr<Settings> abandoned; // a reload which failed halfway might have left references there
             if(config) { // pool setup
                 application.SetReconnectDelay(config->reconnDelay);
+                application.SetScanTimeWindows(config->scanTimeWindows);
+                application.SetThreadPlacement(config->placement);
+                application.SetWatchdog(config->watchdog);
+                isolate(*config);
                 for(asizei init = 0; init < config->pools.size(); init++) {
                     if(application.AddPool(*config->pools[init], application.GetCanonicalAlgoInfo(config->pools[init]->algo)) == false) {
                         application.Error(L"Unknown pool[" + std::to_wstring(init) + L"] algorithm");
@@ -157,19 +222,46 @@ int main(int argc, char **argv) {
                         break;
                     }
                 }
-                if(config) application.BeginPoolActivation(config->algo.c_str());
+                if(config) application.BeginPoolActivation(config->algos);
             }
             application.EnumerateDevices();
             if(config) { // pulling up the miner.
-                if(application.StartMining(config->algo, config->implParams)) application.startTime.hashing = std::chrono::system_clock::now();
+                if(application.StartMining(config->algos, config->implParams)) application.startTime.hashing = std::chrono::system_clock::now();
             }
             while(run = application.KeepRunning()) {
-                std::vector<Network::SocketInterface*> toRead, toWrite;
-                application.FillSleepLists(toRead, toWrite);
+                application.UpdateInterest();
+                // Mining threads call Wake when they find something so this is only the pace of timers and housekeeping.
                 const std::chrono::milliseconds tickTime(200);
-                if(toRead.size() || toWrite.size()) networkWrapper.SleepOn(toRead, toWrite, tickTime.count());
-                else std::this_thread::sleep_for(tickTime);
-                application.Refresh(toRead, toWrite);
+                networkWrapper.SleepOn(tickTime.count()); // just sleeps if nobody is interested in anything
+                application.Refresh();
+                if(application.TakeReloadRequest()) {
+                    if(!config) { // nothing to compare with, do it the old way
+                        application.RequestReboot();
+                        continue;
+                    }
+                    std::unique_ptr<Settings> fresh;
+                    // Whatever goes wrong loading, nothing changed yet: keep mining with what we have.
+                    try {
+                        fresh.reset(load());
+                    }
+                    catch(const std::exception &msg) { std::cout<<"Configuration reload failed: "<<msg.what()<<std::endl; }
+                    catch(const std::string &msg) { std::cout<<"Configuration reload failed: "<<msg<<std::endl; }
+                    catch(const std::wstring &msg) { std::cout<<"Configuration reload failed: "<<std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>>().to_bytes(msg)<<std::endl; }
+                    catch(const char *msg) { std::cout<<"Configuration reload failed: "<<msg<<std::endl; }
+                    catch(const wchar_t *msg) { std::cout<<"Configuration reload failed: "<<std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>>().to_bytes(msg)<<std::endl; }
+                    catch(...) { std::cout<<"Configuration reload failed, keeping the running configuration."<<std::endl; }
+                    if(!fresh) continue; // keep going as we are, LoadSettings told already
+                    try {
+                        isolate(*fresh);
+                        for(const auto &line : application.Reconfigure(*config, *fresh)) std::cout<<"Reload: "<<line<<std::endl;
+                        config = std::move(fresh);
+                    }
+                    catch(...) { // halfway there, who knows what's running with what
+                        std::cout<<"Configuration reload failed, restarting everything."<<std::endl;
+                        abandoned = std::move(fresh);
+                        application.RequestReboot();
+                    }
+                }
             }
             reboot = application.Reboot();
             if(reboot) run = true;
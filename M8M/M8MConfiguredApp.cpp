@@ -79,6 +79,7 @@ std::unique_ptr<PoolInfo> M8MConfiguredApp::ParsePoolExtended(std::unique_ptr<Po
     const auto diffMul(load.FindMember("diffMultipliers"));
     const auto merkleMode(load.FindMember("merkleMode"));
     const auto diffMode(load.FindMember("diffMode"));
+    const auto shareRate(load.FindMember("targetSharesPerMinute"));
     if(proto != load.MemberEnd() && proto->value.IsString()) add->appLevelProtocol = MakeString(proto->value);
     if(diffMul == load.MemberEnd()) {
         errors.push_back(std::string("pools[") + std::to_string(index) + "].diffMultipliers not found, old config file?");
@@ -126,5 +127,11 @@ std::unique_ptr<PoolInfo> M8MConfiguredApp::ParsePoolExtended(std::unique_ptr<Po
         else if(mmode == "neoScrypt") add->diffMode = PoolInfo::dm_neoScrypt;
         else throw std::string("Unknown difficulty calculation mode: \"" + mmode + "\".");
     }
+    if(shareRate != load.MemberEnd()) {
+        if(!shareRate->value.IsNumber() || shareRate->value.GetDouble() < .0) {
+            errors.push_back(std::string("pools[") + std::to_string(index) + "].targetSharesPerMinute must be a number >= 0, ignored.");
+        }
+        else add->targetSharesPerMinute = shareRate->value.GetDouble();
+    }
     return std::move(add);
 }
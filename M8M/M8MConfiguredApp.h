@@ -7,16 +7,36 @@
 #include "../Common/PoolInfo.h"
 #include "commands/Admin/GetRawConfigCMD.h"
 #include "commands/Admin/ConfigFileCMD.h"
+#include "MiningPerformanceWatcher.h"
+#include "../Common/ThreadPlacement.h"
+#include "QueueWatchdog.h"
 #include <codecvt>
 #include <rapidjson/filereadstream.h>
 #include <rapidjson/encodedstream.h>
 #include <rapidjson/error/en.h>
 
 
+/*! Where threads go, see placement namespace. Config file has it as
+"threadPlacement": { "mining": "auto", "verification": "0-1", "network": "2" }
+Every key is optional. "mining" is "auto" (the default), "none" or a CPU list. */
+struct ThreadPlacementSettings {
+    bool autoMining = true; //!< each mining thread goes to the NUMA node its device is attached to, if the system has more than one
+    placement::CPUSet mining; //!< if not empty, all mining threads go there and autoMining is ignored
+    placement::CPUSet verification; //!< mining threads move there to verify nonces
+    placement::CPUSet network; //!< the main thread, it's the one doing all the networking
+};
+
 struct Settings {
 	std::vector< unique_ptr<PoolInfo> > pools;
-	std::string driver, algo;
+	std::string driver;
+    /*! "algo" is an algorithm name or an array of them. Each one is mined at the same time by its own group of devices, with the pools
+    for it. Order matters: a device which could run more than one goes to the first, see M8MMiningApp::StartMining. */
+    std::vector<std::string> algos;
     std::chrono::seconds reconnDelay = std::chrono::seconds(120);
+    std::vector<std::chrono::seconds> scanTimeWindows; //!< empty = default, which is 5 seconds
+    ThreadPlacementSettings placement;
+    bool isolateDevices = false; //!< run each device in a worker process, see the isolation namespace
+    WatchdogSettings watchdog;
 	rapidjson::Document implParams;
 };
 
@@ -102,16 +122,61 @@ private:
 		    Value::ConstMemberIterator defAlgo = root.FindMember("algo");
             Value::ConstMemberIterator reconnDelay = root.FindMember("reconnectDelay");
 		    if(driver != root.MemberEnd() && driver->value.IsString()) ret->driver = MakeString(driver->value);
-            if(algoSelected) ret->algo = algoSelected;
+            if(algoSelected) ret->algos = SplitAlgos(algoSelected);
             else if(defAlgo == root.MemberEnd()) {
                 throw std::exception("Configuration file missing \"algo\" key, but required when \"--algo\" parameter is not specified.");
             }
-            else if(defAlgo->value.IsString() == false) throw std::exception("Invalid configuration, \"algo\" must be a string!");
-            else ret->algo = MakeString(defAlgo->value);
+            else if(defAlgo->value.IsString()) ret->algos.push_back(MakeString(defAlgo->value));
+            else if(defAlgo->value.IsArray()) {
+                for(SizeType loop = 0; loop < defAlgo->value.Size(); loop++) {
+                    const Value &name(defAlgo->value[loop]);
+                    if(name.IsString() == false || name.GetStringLength() == 0) throw std::exception("Invalid configuration, \"algo\" array must contain algorithm names only!");
+                    ret->algos.push_back(MakeString(name));
+                }
+            }
+            else throw std::exception("Invalid configuration, \"algo\" must be a string or an array of strings!");
+            if(ret->algos.empty()) throw std::exception("Invalid configuration, \"algo\" selects no algorithm!");
+            for(asizei loop = 0; loop < ret->algos.size(); loop++) {
+                for(asizei prev = 0; prev < loop; prev++) {
+                    if(_stricmp(ret->algos[prev].c_str(), ret->algos[loop].c_str()) == 0) throw "Algorithm \"" + ret->algos[loop] + "\" selected twice.";
+                }
+            }
             if(reconnDelay != root.MemberEnd()) {
                 if(reconnDelay->value.IsUint()) ret->reconnDelay = std::chrono::seconds(reconnDelay->value.GetUint());
                 else throw std::string("\"reconnectDelay\", value ") + std::to_string(reconnDelay->value.GetUint()) + " is invalid.";
             }
+            Value::ConstMemberIterator scanWindows = root.FindMember("scanTimeWindows");
+            if(scanWindows != root.MemberEnd()) {
+                const Value &list(scanWindows->value);
+                if(list.IsUint() && list.GetUint()) ret->scanTimeWindows.push_back(std::chrono::seconds(list.GetUint()));
+                else if(list.IsArray() && list.Size() && list.Size() <= MiningPerformanceWatcherInterface::MAX_WINDOWS) {
+                    for(SizeType loop = 0; loop < list.Size(); loop++) {
+                        if(list[loop].IsUint() == false || list[loop].GetUint() == 0) {
+                            errors.push_back("\"scanTimeWindows\"[" + std::to_string(loop) + "] must be a positive number of seconds.");
+                            ret->scanTimeWindows.clear();
+                            break;
+                        }
+                        ret->scanTimeWindows.push_back(std::chrono::seconds(list[loop].GetUint()));
+                    }
+                }
+                else errors.push_back("\"scanTimeWindows\" must be a number of seconds or an array of 1 to " + std::to_string(MiningPerformanceWatcherInterface::MAX_WINDOWS) + " of them.");
+            }
+            Value::ConstMemberIterator isolate = root.FindMember("isolateDevices");
+            if(isolate != root.MemberEnd()) {
+                if(isolate->value.IsBool()) ret->isolateDevices = isolate->value.GetBool();
+                else errors.push_back("\"isolateDevices\" must be true or false, ignored.");
+            }
+            Value::ConstMemberIterator watchdog = root.FindMember("watchdog");
+            if(watchdog != root.MemberEnd()) {
+                if(watchdog->value.IsBool()) ret->watchdog.enabled = watchdog->value.GetBool();
+                else if(watchdog->value.IsObject()) ParseWatchdog(ret->watchdog, errors, watchdog->value);
+                else errors.push_back("\"watchdog\" must be false or an object, ignored.");
+            }
+            Value::ConstMemberIterator threads = root.FindMember("threadPlacement");
+            if(threads != root.MemberEnd()) {
+                if(threads->value.IsObject()) ParsePlacement(ret->placement, errors, threads->value);
+                else errors.push_back("\"threadPlacement\" must be an object, ignored.");
+            }
 	    }
 	    Value::ConstMemberIterator implParams = root.FindMember("implParams");
 	    if(implParams != root.MemberEnd()) ret->implParams.CopyFrom(implParams->value, ret->implParams.GetAllocator());
@@ -125,6 +190,62 @@ private:
 
     static std::string MakeString(const rapidjson::Value &jv) { return std::string(jv.GetString(), jv.GetStringLength()); }
 
+    //! --algo takes a comma separated list, it's also how isolated workers are told what the parent is mining.
+    static std::vector<std::string> SplitAlgos(const char *list) {
+        std::vector<std::string> ret;
+        std::string name;
+        for(const char *c = list; ; c++) {
+            if(*c && *c != ',') {
+                if(*c != ' ') name.push_back(*c);
+                continue;
+            }
+            if(name.size()) ret.push_back(std::move(name));
+            name.clear();
+            if(!*c) break;
+        }
+        return ret;
+    }
+
+    //! Bad values are reported and ignored: running the threads wherever the OS wants is never a reason to not mine.
+    static void ParsePlacement(ThreadPlacementSettings &dst, std::vector<std::string> &errors, const rapidjson::Value &obj) {
+        auto cpus = [&errors, &obj](placement::CPUSet &list, const char *key) {
+            const auto value(obj.FindMember(key));
+            if(value == obj.MemberEnd()) return;
+            if(value->value.IsString() == false) {
+                errors.push_back(std::string("\"threadPlacement\".") + key + " must be a string such as \"0-3,8\", ignored.");
+                return;
+            }
+            std::string bad;
+            list = placement::ParseCPUList(MakeString(value->value), bad);
+            if(bad.size()) errors.push_back(std::string("\"threadPlacement\".") + key + ", " + bad + ", ignored.");
+        };
+        const auto mining(obj.FindMember("mining"));
+        if(mining != obj.MemberEnd() && mining->value.IsString()) {
+            const std::string mode(MakeString(mining->value));
+            if(mode == "auto") dst.autoMining = true;
+            else if(mode == "none") dst.autoMining = false;
+            else cpus(dst.mining, "mining");
+        }
+        else if(mining != obj.MemberEnd()) errors.push_back("\"threadPlacement\".mining must be \"auto\", \"none\" or a CPU list, ignored.");
+        cpus(dst.verification, "verification");
+        cpus(dst.network, "network");
+    }
+
+    //! As ParsePlacement, bad values are reported and the defaults are kept.
+    static void ParseWatchdog(WatchdogSettings &dst, std::vector<std::string> &errors, const rapidjson::Value &obj) {
+        auto positive = [&errors, &obj](const char *key) -> auint {
+            const auto value(obj.FindMember(key));
+            if(value == obj.MemberEnd()) return 0;
+            if(value->value.IsUint() && value->value.GetUint()) return value->value.GetUint();
+            errors.push_back(std::string("\"watchdog\".") + key + " must be a positive integer, ignored.");
+            return 0;
+        };
+        if(auint scanTimes = positive("scanTimes")) dst.scanTimes = scanTimes;
+        if(auint minimum = positive("minimum")) dst.minimum = std::chrono::seconds(minimum);
+        if(auint firstScan = positive("firstScan")) dst.firstScan = std::chrono::seconds(firstScan);
+        if(auint recoveries = positive("recoveries")) dst.recoveries = recoveries;
+    }
+
     // commands::admin::ConfigFileCMD::ConfigInfoProviderInterface //////////////////////////////////////////
     std::wstring Filename() const { return loadInfo.configFile; }
     bool Explicit() const { return loadInfo.specified; }
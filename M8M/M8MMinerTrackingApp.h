@@ -31,6 +31,13 @@ public:
         put->reasons.push_back(std::move(utf8));
     }
 
+    void ClearDeviceRejects() {
+        for(auto &dev : devRejects) dev.clear();
+    }
+
+    //! Call before StartMining, the first is the main window, see MiningPerformanceWatcherInterface.
+    void SetScanTimeWindows(const std::vector<std::chrono::seconds> &windows) { perfStats.SetAverageWindows(windows); }
+
     /*! Performance monitoring callback, called asynchronously by the miner thread(s). */
     void IterationCompleted(asizei devIndex, bool found, std::chrono::microseconds elapsed) {
         perfStats.Completed(devIndex, found, elapsed);
@@ -55,6 +62,13 @@ public:
         }
     }
 
+    /*! The slowest scan seen is what the watchdog wants: it should not fire just because the device had a bad moment. */
+    std::chrono::microseconds GetExpectedScanTime(asizei devIndex) const {
+        MiningPerformanceWatcherInterface::DevStats stats;
+        if(!perfStats.GetPerformance(stats, devIndex)) return std::chrono::microseconds(0);
+        return stats.max.count()? stats.max : stats.avg;
+    }
+
     void AddStale(asizei linDevice, asizei count) {
         deviceShares[linDevice].stale += count;
         deviceShares[linDevice].last = std::chrono::system_clock::now();
@@ -69,7 +83,7 @@ protected:
     Goes mostly to "rejectReason" command. */
     std::vector<std::vector<DeviceRejection>> devRejects;
 
-    SyncMiningPerformanceWatcher perfStats;
+    MiningPerformanceWatcher perfStats;
 
     struct TimeLapseShareStats : commands::monitor::DeviceShares::ShareStats {
         std::chrono::time_point<std::chrono::system_clock> first;
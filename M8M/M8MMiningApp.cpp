@@ -39,6 +39,7 @@ void M8MMiningApp::EnumerateDevices() {
                 computeNodes[loop].devices.back().clid = devBuff[dev];
                 computeNodes[loop].devices.back().type = type;
                 computeNodes[loop].devices.back().linearIndex = auint(linearIndex++);
+                computeNodes[loop].devices.back().numaNode = GetNUMANode(devBuff[dev]);
             }
             break;
         }
@@ -62,91 +63,229 @@ void M8MMiningApp::EnumerateDevices() {
 
 //! \todo This takes for granted driver is opencl... not that this is a real problem as different drivers would likely result
 //! in a different object being used... anyway...
-asizei M8MMiningApp::StartMining(const std::string &algo, const rapidjson::Value &everything) {
+asizei M8MMiningApp::StartMining(const std::vector<std::string> &algos, const rapidjson::Value &everything) {
     if(everything.IsObject() == false) {
         Error(L"Algo configs must be an object.");
         return 0;
     }
-    // Look it up case-insensitive.
-    const rapidjson::Value *useful = nullptr;
-    for(auto el = everything.MemberBegin(); el != everything.MemberEnd(); ++el) {
-        if(algo.size() != el->name.GetStringLength()) continue;
-        if(_strnicmp(el->name.GetString(), algo.c_str(), algo.size()) == 0) {
-            useful = &el->value;
-            break;
-        }
-    }
     // For the purpose of 'configInfo' command, as long as a mining algorithm is matched against the known algorithm families, it is to be output.
     // The rationale is: the more important a mistake is, the sooner we give up on providing informations.
-    miningAlgorithm = algo;
-    if(useful == nullptr) {
-        const std::string meh("Missing configs for the algo \"" + algo + "\".");
+    groups.clear();
+    groups.resize(algos.size());
+    for(asizei loop = 0; loop < algos.size(); loop++) groups[loop].algo = algos[loop];
+    auto implConfigs(GatherSettings(everything, [this](const std::string &meh) {
         std::wstring unicode;
         unicode.reserve(meh.length());
         for(asizei cp = 0; cp < meh.size(); cp++) unicode.push_back(meh[cp]);
         Error(unicode);
-        return 0;
-    }
+    }));
+    if(implConfigs.empty()) return 0;
     validConfigSelected = true;
-    auto implConfigs(Deduce(*useful));
     std::vector<bool> validImpl(implConfigs.size());
-    for(auto &el : validImpl) el = true;
-    if(implConfigs.empty()) {
-        Error(L"No configs for the current algo.");
-        return 0;
+    // map is nicer but case insensivity is meh, factories are owned by the source loader
+    std::vector<std::vector<std::pair<const char*, AbstractAlgoFactory*>>> factories(groups.size());
+    for(asizei loop = 0; loop < implConfigs.size(); loop++) {
+        const asizei group = configData[loop].group;
+        validImpl[loop] = GenFactory(factories[group], groups[group].miner, *implConfigs[loop], loop);
     }
-    configData.resize(implConfigs.size());
-    for(asizei cp = 0; cp < implConfigs.size(); cp++) configData[cp].value = implConfigs[cp];
-    std::vector<std::pair<const char*, AbstractAlgoFactory*>> factories; // map is nicer but case insensivity is meh, factories are owned by the source loader
-    std::unique_ptr<AbstractNonceFindersBuild> miner;
-    for(asizei loop = 0; loop < implConfigs.size(); loop++) validImpl[loop] = GenFactory(factories, miner, algo, *implConfigs[loop], loop);
     SelectSettings(factories, implConfigs, validImpl);
+    if(workerChannel) { // the parent has a thread for each device, each with its own worker, this is only for one
+        for(auto &plat : computeNodes) {
+            for(auto &dev : plat.devices) {
+                if(dev.linearIndex != workerChannel->device) dev.configIndex = asizei(-1);
+            }
+        }
+    }
     if(!BuildEveryUsefulContext()) {
         Error(L"No devices eligible to processing.");
         return 0;
     }
-    for(const auto &plat : computeNodes) { // we could limit this to only used devices or only used by this miner, but handy to have
-        for(const auto &dev : plat.devices) miner->linearDevice.insert(std::make_pair(dev.clid, dev.linearIndex));
+    for(auto &group : groups) {
+        if(group.miner) SetupGroup(group);
     }
-    miner->onIterationCompleted = [this](asizei devIndex, bool found, std::chrono::microseconds elapsed) {
-        IterationCompleted(devIndex, found, elapsed);
-    };
-    // Before creating the miners let's register the pools. It could be done anywhere but I like to validate some configuration first.
-    for(asizei loop = 0; loop < GetNumServers(); loop++) miner->RegisterWorkProvider(GetPool(loop));
     // Ok, now we're ready. Almost. I will now have to iterate the devices and configs once again.
     // Yes, I take it easy. It's a fast operation anyway, how many devices can you have?
     asizei launched = 0;
     for(auto &plat : computeNodes) {
         for(auto &dev : plat.devices) {
             if(dev.configIndex == asizei(-1)) continue;
-            GenQueue(dev, plat.ctx, *implConfigs[dev.configIndex], factories, algo, *miner);
+            dev.group = configData[dev.configIndex].group; // valid settings, so the group has its miner
+            auto &group(groups[dev.group]);
+            GenQueue(dev, plat.ctx, *implConfigs[dev.configIndex], factories[dev.group], group.algo, *group.miner);
             launched++;
         }
     }
-    this->miner = std::move(miner);
     return launched;
 }
 
 
-void M8MMiningApp::Refresh(std::vector<Network::SocketInterface*> &toRead, std::vector<Network::SocketInterface*> &toWrite) {
-    if(miner) TickMiner();
-    if(sources.Flushed() == false) {
-        if(miner) {
-            using namespace std::chrono;
-            static const seconds pollInterval(30);
-            static system_clock::time_point lastCheck;
-            if(lastCheck == system_clock::time_point()) lastCheck = system_clock::now();
-            else if(system_clock::now() >= lastCheck + pollInterval) {
-                for(asizei check = 0; check < miner->GetNumWorkQueues()[1]; check++) {
-                    auto stat(miner->GetTerminationReason(check));
-                    if(std::get<1>(stat) != miner->s_created) sources.Initialized(check);
-                }
-                lastCheck = system_clock::now();
-            }
+void M8MMiningApp::SetupGroup(Group &group) {
+    auto &miner(*group.miner);
+    for(const auto &plat : computeNodes) { // we could limit this to only used devices or only used by this miner, but handy to have
+        for(const auto &dev : plat.devices) miner.linearDevice.insert(std::make_pair(dev.clid, dev.linearIndex));
+    }
+    miner.onIterationCompleted = [this](asizei devIndex, bool found, std::chrono::microseconds elapsed) {
+        IterationCompleted(devIndex, found, elapsed);
+    };
+    miner.onResultsFound = [this]() { network.Wake(); };
+    // Before creating the miners let's register the pools. Work from pools for other algorithms would be hashed wrong, so only those for this one.
+    for(asizei loop = 0; loop < GetNumServers(); loop++) {
+        if(_stricmp(GetServerInfo(loop).algo.c_str(), group.algo.c_str()) == 0) miner.RegisterWorkProvider(GetPool(loop));
+    }
+}
+
+
+std::vector<const rapidjson::Value*> M8MMiningApp::GatherSettings(const rapidjson::Value &everything, const std::function<void(const std::string&)> &report) {
+    std::vector<const rapidjson::Value*> ret;
+    configData.clear();
+    for(asizei loop = 0; loop < groups.size(); loop++) {
+        const auto &algo(groups[loop].algo);
+        const rapidjson::Value *useful = everything.IsObject()? FindAlgoSettings(algo, everything) : nullptr;
+        if(useful == nullptr) {
+            report("Missing configs for the algo \"" + algo + "\".");
+            continue;
+        }
+        auto implConfigs(Deduce(*useful));
+        if(implConfigs.empty()) report("No configs for the algo \"" + algo + "\".");
+        for(auto el : implConfigs) {
+            ret.push_back(el);
+            configData.push_back(ConfigHolder());
+            configData.back().value = el;
+            configData.back().group = loop;
+        }
+    }
+    return ret;
+}
+
+
+void M8MMiningApp::Refresh() {
+    // Kernel sources used to be flushed once all the threads initialized. Now they stay: the watchdog and configuration reloads
+    // build mining threads again at any time. It's some hundred KiBs of text, compared to what a restart costs it's nothing.
+    if(groups.size()) {
+        TickMiner();
+        WatchQueues();
+    }
+    M8MPoolMonitoringApp::Refresh();
+}
+
+
+std::vector<std::string> M8MMiningApp::Reconfigure(const Settings &current, const Settings &fresh) {
+    std::vector<std::string> report;
+    std::vector<CanonicalInfo> canon;
+    for(const auto &pool : fresh.pools) canon.push_back(GetCanonicalAlgoInfo(pool->algo)); // before touching anything, this throws
+    if(current.reconnDelay != fresh.reconnDelay) {
+        SetReconnectDelay(fresh.reconnDelay);
+        report.push_back("reconnectDelay is now " + std::to_string(fresh.reconnDelay.count()) + " s");
+    }
+    watchdog = fresh.watchdog; // next time it looks, nothing to rebuild
+    if(current.scanTimeWindows != fresh.scanTimeWindows) report.push_back("scanTimeWindows changed, applied at next restart");
+    ReconfigurePools(fresh.pools, canon, report);
+    BeginPoolActivation(fresh.algos);
+
+    auto samePlacement = [](const ThreadPlacementSettings &one, const ThreadPlacementSettings &two) {
+        return one.autoMining == two.autoMining && one.mining == two.mining && one.verification == two.verification && one.network == two.network;
+    };
+    auto mining = [](const Group &group) { return group.miner != nullptr; };
+    const std::string everything(reload::RebuildEverything(std::any_of(groups.cbegin(), groups.cend(), mining), current.algos, fresh.algos,
+                                                           samePlacement(current.placement, fresh.placement), current.isolateDevices == fresh.isolateDevices));
+    if(everything.size()) {
+        report.push_back(everything + ", rebuilding every device");
+        StopMining();
+        SetThreadPlacement(fresh.placement);
+        const asizei launched = StartMining(fresh.algos, fresh.implParams);
+        report.push_back(std::to_string(launched) + " device" + (launched == 1? "" : "s") + " started");
+        return report;
+    }
+    for(auto &group : groups) {
+        if(!group.miner) continue; // if it gets settings, Redeploy gives it the pools
+        std::vector<const AbstractWorkSource*> providers;
+        for(asizei loop = 0; loop < GetNumServers(); loop++) {
+            if(_stricmp(GetServerInfo(loop).algo.c_str(), group.algo.c_str()) == 0) providers.push_back(&GetPool(loop));
+        }
+        group.miner->SyncWorkProviders(providers);
+    }
+    Redeploy(fresh.implParams, report);
+    return report;
+}
+
+
+void M8MMiningApp::StopMining() {
+    groups.clear(); // waits for the threads to go away, or gives up on them
+    for(auto &plat : computeNodes) {
+        if(plat.ctx) clReleaseContext(plat.ctx);
+        plat.ctx = 0;
+        for(auto &dev : plat.devices) {
+            dev.configIndex = asizei(-1);
+            dev.group = asizei(-1);
+            dev.queue = asizei(-1);
+            dev.inContext = false;
+        }
+    }
+    configData.clear();
+    tuned.clear();
+    validConfigSelected = false;
+    ClearDeviceRejects();
+}
+
+
+void M8MMiningApp::Redeploy(const rapidjson::Value &everything, std::vector<std::string> &report) {
+    // What each device was running, still there as the old configuration is alive until we return.
+    std::vector<const rapidjson::Value*> was;
+    for(auto &plat : computeNodes) {
+        for(auto &dev : plat.devices) {
+            was.push_back(dev.configIndex != asizei(-1)? &RunningSettings(dev) : nullptr); // live tuning is lost if the configuration disagrees
+            dev.configIndex = asizei(-1);
+        }
+    }
+    // Then assign settings to devices again as StartMining does, that's the only way to be sure they end up where they would.
+    ClearDeviceRejects();
+    auto implConfigs(GatherSettings(everything, [&report](const std::string &msg) { report.push_back(msg); }));
+    std::vector<std::vector<std::pair<const char*, AbstractAlgoFactory*>>> factories(groups.size());
+    std::vector<bool> validImpl(implConfigs.size());
+    for(asizei loop = 0; loop < implConfigs.size(); loop++) {
+        auto &group(groups[configData[loop].group]);
+        std::unique_ptr<AbstractNonceFindersBuild> miner; // same algorithm, the current miner is just fine
+        validImpl[loop] = GenFactory(factories[configData[loop].group], miner, *implConfigs[loop], loop);
+        if(validImpl[loop] && !group.miner) { // had no usable settings before
+            group.miner = std::move(miner);
+            SetupGroup(group);
+        }
+    }
+    SelectSettings(factories, implConfigs, validImpl);
+
+    struct Backend { // the real thing, see reload::Redeploy
+        M8MMiningApp &app;
+        Platform &plat;
+        std::vector<std::vector<std::pair<const char*, AbstractAlgoFactory*>>> &factories;
+        void StopQueue(Device &dev) { app.groups[dev.group].miner->StopQueue(dev.queue); }
+        std::string GenQueue(Device &dev, const rapidjson::Value &settings) {
+            auto &target(app.groups[dev.group]);
+            app.GenQueue(dev, dev.inContext? plat.ctx : 0, settings, factories[dev.group], target.algo, *target.miner);
+            if(dev.queue < target.recovered.size()) target.recovered[dev.queue] = 0;
+            return dev.inContext? "" : " in a context of its own";
+        }
+        const std::string& GetAlgo(asizei group) const { return app.groups[group].algo; }
+    };
+    asizei linear = 0;
+    for(auto &plat : computeNodes) {
+        Backend backend { *this, plat, factories };
+        for(auto &dev : plat.devices) {
+            const rapidjson::Value *now = dev.configIndex != asizei(-1)? implConfigs[dev.configIndex] : nullptr;
+            const asizei group = dev.configIndex != asizei(-1)? configData[dev.configIndex].group : asizei(-1);
+            const std::string line(reload::Redeploy(backend, dev, "device " + std::to_string(dev.linearIndex), was[linear++], now, group));
+            if(line.size()) report.push_back(line);
         }
-        if(sources.GetNumRegisteredConsumers() == sources.GetNumInitializedConsumers() || !miner) sources.Flush();
     }
-    M8MPoolMonitoringApp::Refresh(toRead, toWrite);
+    tuned.clear(); // was is done, now everything runs as the configuration tells, kept devices included
+}
+
+
+const rapidjson::Value* M8MMiningApp::FindAlgoSettings(const std::string &algo, const rapidjson::Value &everything) {
+    for(auto el = everything.MemberBegin(); el != everything.MemberEnd(); ++el) {
+        if(algo.size() != el->name.GetStringLength()) continue;
+        if(_strnicmp(el->name.GetString(), algo.c_str(), algo.size()) == 0) return &el->value;
+    }
+    return nullptr;
 }
 
 
@@ -179,19 +318,24 @@ std::pair<const char*, AbstractAlgoFactory*> M8MMiningApp::NewAlgoFactory(std::u
 
 
 
-void M8MMiningApp::SelectSettings(const std::vector<std::pair<const char*, AbstractAlgoFactory*>> &factories,
+void M8MMiningApp::SelectSettings(const std::vector<std::vector<std::pair<const char*, AbstractAlgoFactory*>>> &factories,
                                   const std::vector<const rapidjson::Value*> &configs,
                                   const std::vector<bool> &valid) {
     std::vector<DevRequirements> requirements(configs.size());
+    std::vector<bool> usable(valid);
     for(asizei loop = 0; loop < configs.size(); loop++) {
         auto reqd(configs[loop]->FindMember("requirements"));
-        if(reqd != configs[loop]->MemberEnd() && reqd->value.IsObject()) ParseRequirements(requirements[loop], *configs[loop]);
+        if(reqd == configs[loop]->MemberEnd() || reqd->value.IsObject() == false) continue;
+        auto errors(ParseRequirements(requirements[loop], reqd->value));
+        for(auto &err : errors) configData[loop].staticRejects.push_back(err);
+        if(errors.size()) usable[loop] = false;
     }
     for(asizei loop = 0; loop < configs.size(); loop++) {
-        if(valid[loop] == false) continue;
+        if(usable[loop] == false) continue;
         auto specify(configs[loop]->FindMember("impl"));
         const std::string impl(specify->value.GetString(), specify->value.GetStringLength());
-        auto uses(std::find_if(factories.cbegin(), factories.cend(), [&impl](const std::pair<const char*, AbstractAlgoFactory*> &check) {
+        const auto &group(factories[configData[loop].group]);
+        auto uses(std::find_if(group.cbegin(), group.cend(), [&impl](const std::pair<const char*, AbstractAlgoFactory*> &check) {
             return _stricmp(impl.c_str(), check.first) == 0;
         }));
         uses->second->Parse(*configs[loop]); // initialize state
@@ -204,7 +348,7 @@ void M8MMiningApp::SelectSettings(const std::vector<std::pair<const char*, Abstr
                 auto errors(uses->second->Eligible(p.clid, d.clid)); // fine because of construction
                 bool good = errors.empty();
                 for(auto &err : errors) AddDeviceReject(loop, err, d.linearIndex);
-                errors = requirements[loop].Eligible(p.clid, d.clid);
+                errors = requirements[loop].Eligible(p.clid, d);
                 good &= errors.empty();
                 for(auto &err : errors) AddDeviceReject(loop, err, d.linearIndex);
                 if(good) d.configIndex = loop;
@@ -219,7 +363,8 @@ asizei M8MMiningApp::BuildEveryUsefulContext() {
     for(auto &plat : computeNodes) {
         std::vector<cl_device_id> eligible;
         for(auto &dev : plat.devices) {
-            if(dev.configIndex != asizei(-1)) eligible.push_back(dev.clid);
+            dev.inContext = dev.configIndex != asizei(-1);
+            if(dev.inContext) eligible.push_back(dev.clid);
         }
         if(eligible.size()) {
             cl_context_properties cprops[] = {
@@ -234,7 +379,20 @@ asizei M8MMiningApp::BuildEveryUsefulContext() {
     return activate;
 }
 
-void M8MMiningApp::ParseRequirements(DevRequirements &build, const rapidjson::Value &match) const {
+std::vector<std::string> M8MMiningApp::ParseRequirements(DevRequirements &build, const rapidjson::Value &requirements) const {
+    std::vector<std::string> errors;
+    auto devices(requirements.FindMember("devices"));
+    if(devices != requirements.MemberEnd()) {
+        // That's the way to put each card on the algorithm it's best at. Without this, the first settings a device is eligible for win.
+        if(devices->value.IsArray() == false) errors.push_back("requirements.devices must be an array of device linear indices.");
+        else {
+            for(auto el = devices->value.Begin(); el != devices->value.End(); ++el) {
+                if(el->IsUint()) build.devices.push_back(el->GetUint());
+                else errors.push_back("requirements.devices must contain device linear indices only.");
+            }
+        }
+    }
+    return errors;
 }
 
 
@@ -243,40 +401,57 @@ void M8MMiningApp::TickMiner() {
     VerifiedNonces sharesFound;
     using namespace std::chrono;
     static system_clock::time_point nextStatusCheck;
-    if(miner->ResultsFound(from, sharesFound)) {
-        if(firstNonce == system_clock::time_point()) {
-            firstNonce = system_clock::now();
-            std::wstring msg(L"Found my first result!\n");
-            if(sharesFound.wrong) msg = L"GPU produced bad numbers.\nSomething is very wrong!"; //!< \todo blink yellow for a few seconds every time a result is wrong
-            else msg += L"Numbers are getting crunched as expected.";
-            Popup(msg.c_str());
-            ChangeState(sharesFound.wrong? STATE_ERROR : STATE_OK, true);
-        }
-        else if(this->GetNumActiveServers()) { // As long as mining is going on and producing results, I consider it a win, provided stuff can go somewhere!
-            //! \todo Also consider the amount of rejects - how to? With multiple pools it's not so easy.
-            //! \todo Also consider the amount of HW errors. This is easier than pools but I still have to think about it.
-            if(GetIconState() != STATE_OK) ChangeState(STATE_OK, true);
+    pulled.clear();
+    for(auto &group : groups) {
+        if(!group.miner) continue;
+        while(group.miner->ResultsFound(from, sharesFound)) { // we're woken up as soon as something is found, take everything there
+            if(firstNonce == system_clock::time_point()) {
+                firstNonce = system_clock::now();
+                std::wstring msg(L"Found my first result!\n");
+                if(sharesFound.wrong) msg = L"GPU produced bad numbers.\nSomething is very wrong!"; //!< \todo blink yellow for a few seconds every time a result is wrong
+                else msg += L"Numbers are getting crunched as expected.";
+                Popup(msg.c_str());
+                ChangeState(sharesFound.wrong? STATE_ERROR : STATE_OK, true);
+            }
+            else if(this->GetNumActiveServers()) { // As long as mining is going on and producing results, I consider it a win, provided stuff can go somewhere!
+                //! \todo Also consider the amount of rejects - how to? With multiple pools it's not so easy.
+                //! \todo Also consider the amount of HW errors. This is easier than pools but I still have to think about it.
+                if(GetIconState() != STATE_OK) ChangeState(STATE_OK, true);
+            }
+            UpdateDeviceStats(sharesFound); // this one goes to a derived class
+            pulled.push_back(std::make_pair(std::move(from), std::move(sharesFound)));
         }
-        UpdateDeviceStats(sharesFound); // this one goes to a derived class
-        SendResults(from, sharesFound); // this to a base class
     }
+    if(pulled.size()) SendResults(pulled); // this to a base class, all at once so they can be batched by pool. Results know their pool, groups don't matter.
 
     if(nextStatusCheck == system_clock::time_point()) nextStatusCheck = system_clock::now() + minutes(1);
     else if(nextStatusCheck < system_clock::now()) {
         nextStatusCheck += minutes(1);
-        auto status(miner->GetNumWorkQueues());
-        if(status[0] == status[1]) Error(L"All miners failed!");
+        std::array<asizei, 2> status = { 0, 0 };
+        for(const auto &group : groups) {
+            if(!group.miner) continue;
+            auto count(group.miner->GetNumWorkQueues());
+            status[0] += count[0];
+            status[1] += count[1];
+        }
+        if(status[1] && status[0] == status[1]) Error(L"All miners failed!");
         else if(status[0]) Error(std::to_wstring(status[0]) + L"miner" + (status[0] > 1? L"s" : L"") + L" failed!");
         else {
             asizei slow = 0;
-            for(asizei loop = 0; loop < status[1]; loop++) {
-                auto probe(miner->GetTerminationReason(loop));
-                if(std::get<1>(probe) == miner->s_created) continue; // not very likely considering a result has been already found by somebody else
-                auto lastWU(miner->GetLastWUGenTime(loop));
-                if(lastWU + minutes(5) < std::chrono::system_clock::now()) slow++;
-                // In theory this should be a function of block time so for BTC we need at least 10 minutess to force a change by changing block.
-                // Everybody else use shorter blocks (BSTY being a notable exception) we should be rolling work anyway if we run out of nonce2 bits.
-                // Soooo... this is cutting it short. But I don't care.
+            for(const auto &group : groups) {
+                if(!group.miner) continue;
+                auto &miner(*group.miner);
+                for(asizei loop = 0; loop < miner.GetNumWorkQueues()[1]; loop++) {
+                    auto probe(miner.GetTerminationReason(loop));
+                    if(std::get<1>(probe) == miner.s_created) continue; // not very likely considering a result has been already found by somebody else
+                    if(std::get<1>(probe) == miner.s_stopped) continue; // not used anymore after a configuration reload
+                    if(miner.GetQueueControl(loop).paused) continue;
+                    auto lastWU(miner.GetLastWUGenTime(loop));
+                    if(lastWU + minutes(5) < std::chrono::system_clock::now()) slow++;
+                    // In theory this should be a function of block time so for BTC we need at least 10 minutess to force a change by changing block.
+                    // Everybody else use shorter blocks (BSTY being a notable exception) we should be rolling work anyway if we run out of nonce2 bits.
+                    // Soooo... this is cutting it short. But I don't care.
+                }
             }
             if(slow) Error(L"Some miners are not generating any work!");
         }
@@ -284,8 +459,30 @@ void M8MMiningApp::TickMiner() {
 }
 
 
+void M8MMiningApp::WatchQueues() {
+    using namespace std::chrono;
+    if(!watchdog.enabled) return;
+    const auto now(steady_clock::now());
+    if(now < nextWatch) return;
+    nextWatch = now + seconds(1); // that's way more than enough, deadlines are at least several seconds
+    auto expected = [this](asizei devIndex) { return GetExpectedScanTime(devIndex); };
+    auto report = [this](const QueueStall &stall) {
+        if(stall.givingUp) {
+            Error(L"Device " + std::to_wstring(stall.device) + L" stalled again, giving up on it.");
+            return;
+        }
+        std::cout<<"Device "<<stall.device<<" did not complete a scan in "<<stall.late.count()<<" ms (expected "
+                 <<duration_cast<milliseconds>(stall.expected).count()<<" ms), rebuilding it."<<std::endl;
+    };
+    for(auto &group : groups) {
+        if(group.miner) ::WatchQueues(*group.miner, group.recovered, watchdog, now, expected, report);
+    }
+}
+
+
 bool M8MMiningApp::GenFactory(std::vector<std::pair<const char*, AbstractAlgoFactory*>> &factories, std::unique_ptr<AbstractNonceFindersBuild> &miner,
-                              const std::string &algo, const rapidjson::Value &implConfig, asizei index) {
+                              const rapidjson::Value &implConfig, asizei index) {
+    const std::string &algo(groups[configData[index].group].algo);
     auto entry(implConfig.FindMember("impl"));
     if(entry == implConfig.MemberEnd()) {
         configData[index].staticRejects.push_back(std::string("Missing \"impl\" value."));
@@ -323,28 +520,227 @@ void M8MMiningApp::GenQueue(Device &dev, cl_context ctx, const rapidjson::Value
     }
     factory->Parse(implConfig);
     // Eligibility already evaluated. Note only Parse sets internal state, Eligible does not!
-    AbstractNonceFindersBuild::AlgoBuild build;
-    factory->Kernels(build.kern);
-    factory->Resources(build.res, cryptoConstants);
+    AbstractNonceFindersBuild::AlgoBuild build(DescribeAlgorithm(dev, *factory));
     sources.AddUser(algo, use);
-    dev.resources.hashCount = factory->GetHashCount();
-    build.numHashes = factory->GetHashCount();
-    build.candHashUints = factory->GetNumUintsPerCandidate();
     build.ctx = ctx;
     build.dev = dev.clid;
-    build.identifier = factory->GetAlgoIdentifier();
-    AbstractAlgorithm::DescribeResources(dev.resources.memUsage, build.res);
+    PlaceMiningThread(build, dev);
+    if(workerProgram.size()) {
+        build.workerProgram = workerProgram;
+        build.workerArgs = workerArgs;
+        build.workerDevice = dev.linearIndex;
+    }
+    build.workerChannel = workerChannel;
     // At this point we used to init this work queue. This is now just matters of adding an entry and spawning a thread.
     const std::string algoFamily(factory->GetAlgoIdentifier().algorithm);
     auto lambda = [this](std::vector<std::string> &errors, const std::string &kernFile) -> std::pair<const char*, asizei> {
         return sources.GetSourceBuffer(errors, kernFile);
     };
     std::function<std::pair<const char*, asizei>(std::vector<std::string> &errors, const std::string &kernFile)> loader(lambda);
+    if(dev.queue != asizei(-1)) {
+        miner.ReplaceQueue(dev.queue, std::move(build), loader);
+        return;
+    }
     miner.GenQueue(std::move(build), loader, GetCanonicalAlgoInfo(algoFamily)
 #if defined REPLICATE_CLDEVICE_LINEARINDEX
         , dev.linearIndex
 #endif
     );
+    dev.queue = miner.GetNumWorkQueues()[1] - 1;
+}
+
+
+AbstractNonceFindersBuild::AlgoBuild M8MMiningApp::DescribeAlgorithm(Device &dev, const AbstractAlgoFactory &factory) {
+    AbstractNonceFindersBuild::AlgoBuild build;
+    factory.Kernels(build.kern);
+    factory.Resources(build.res, cryptoConstants);
+    build.numHashes = factory.GetHashCount();
+    build.candHashUints = factory.GetNumUintsPerCandidate();
+    build.identifier = factory.GetAlgoIdentifier();
+    dev.resources.hashCount = build.numHashes;
+    dev.resources.memUsage.clear();
+    AbstractAlgorithm::DescribeResources(dev.resources.memUsage, build.res);
+    return build;
+}
+
+
+const rapidjson::Value& M8MMiningApp::RunningSettings(const Device &dev) const {
+    auto live(tuned.find(dev.linearIndex));
+    return live != tuned.cend()? *live->second : *configData[dev.configIndex].value;
+}
+
+
+commands::admin::DeviceControlCMD::DeviceControlInterface::State M8MMiningApp::ControlDevice(auint device, const Change &change) {
+    Platform *plat = nullptr;
+    Device *dev = nullptr;
+    for(auto &p : computeNodes) {
+        for(auto &d : p.devices) {
+            if(d.linearIndex != device) continue;
+            plat = &p;
+            dev = &d;
+        }
+    }
+    const std::string name("Device " + std::to_string(device));
+    if(!dev) throw name + " does not exist.";
+    if(dev->configIndex == asizei(-1) || dev->queue == asizei(-1)) throw name + " is not mining, give it settings in the configuration and reload.";
+    if(change.algo.size() || change.impl.size() || change.linearIntensity) {
+        if(workerProgram.size()) throw name + " runs in a worker process, change the configuration and reload instead.";
+        asizei target = dev->group;
+        if(change.algo.size()) {
+            auto named = [&change](const Group &group) { return _stricmp(group.algo.c_str(), change.algo.c_str()) == 0; };
+            target = std::find_if(groups.cbegin(), groups.cend(), named) - groups.cbegin();
+            if(target == groups.size()) {
+                std::string conc("Only");
+                for(const auto &group : groups) conc += ' ' + group.algo;
+                throw conc + " can be mined, adding " + change.algo + " takes a configuration change and reload.";
+            }
+        }
+        // Settings are built as if they were in the configuration so they go through the same validation.
+        // Moving to another algorithm, the settings to start from are the first ones the configuration has for it.
+        asizei config = dev->configIndex;
+        if(target != dev->group) {
+            config = 0;
+            while(config < configData.size() && (configData[config].group != target || configData[config].staticRejects.size())) config++;
+            if(config == configData.size() || !groups[target].miner) throw name + " cannot mine " + groups[target].algo + ", there are no good settings for it in the configuration.";
+        }
+        auto settings(std::make_unique<rapidjson::Document>());
+        settings->CopyFrom(config == dev->configIndex? RunningSettings(*dev) : *configData[config].value, settings->GetAllocator());
+        auto &alloc(settings->GetAllocator());
+        if(change.linearIntensity) {
+            settings->RemoveMember("linearIntensity");
+            settings->AddMember("linearIntensity", change.linearIntensity, alloc);
+        }
+        if(change.impl.size()) {
+            settings->RemoveMember("impl");
+            settings->AddMember("impl", rapidjson::Value(change.impl.c_str(), rapidjson::SizeType(change.impl.length()), alloc), alloc);
+        }
+        auto impl(settings->FindMember("impl"));
+        if(impl == settings->MemberEnd() || !impl->value.IsString()) throw name + " settings have no \"impl\" value."; // can't happen, it's mining
+        auto &group(groups[target]);
+        std::unique_ptr<AbstractNonceFindersBuild> unused;
+        auto gen(NewAlgoFactory(unused, group.algo.c_str(), impl->value.GetString())); // throws std::string if not there
+        auto factory(gen.second);
+        auto errors(factory->Parse(*settings));
+        if(errors.empty()) errors = factory->Eligible(plat->clid, dev->clid);
+        if(errors.size()) {
+            std::string conc(name + " cannot use those settings:");
+            for(const auto &el : errors) conc += ' ' + el;
+            throw conc;
+        }
+        if(target == dev->group) group.miner->RetuneQueue(dev->queue, DescribeAlgorithm(*dev, *factory));
+        else {
+            // Queues are by group so it's a new mining thread there. Its context is still good, it's not bound to an algorithm.
+            const bool paused = groups[dev->group].miner->GetQueueControl(dev->queue).paused;
+            groups[dev->group].miner->StopQueue(dev->queue);
+            dev->group = target;
+            dev->queue = asizei(-1);
+            dev->configIndex = config;
+            const std::vector<std::pair<const char*, AbstractAlgoFactory*>> factories { gen };
+            GenQueue(*dev, dev->inContext? plat->ctx : 0, *settings, factories, group.algo, *group.miner);
+            if(dev->queue < group.recovered.size()) group.recovered[dev->queue] = 0;
+            if(paused) group.miner->PauseQueue(dev->queue, true);
+        }
+        tuned[device] = std::move(settings);
+    }
+    auto &miner(*groups[dev->group].miner);
+    if(change.pause != pr_keep) miner.PauseQueue(dev->queue, change.pause == pr_pause);
+
+    State ret;
+    const rapidjson::Value &running(RunningSettings(*dev));
+    ret.algo = groups[dev->group].algo;
+    auto impl(running.FindMember("impl"));
+    if(impl != running.MemberEnd() && impl->value.IsString()) ret.impl.assign(impl->value.GetString(), impl->value.GetStringLength());
+    auto intensity(running.FindMember("linearIntensity"));
+    if(intensity != running.MemberEnd() && intensity->value.IsUint()) ret.linearIntensity = intensity->value.GetUint();
+    ret.hashCount = dev->resources.hashCount;
+    const auto control(miner.GetQueueControl(dev->queue));
+    ret.paused = control.paused;
+    ret.pending = control.retuning;
+    ret.lastChange = control.outcome;
+    return ret;
+}
+
+
+void M8MMiningApp::SetThreadPlacement(const ThreadPlacementSettings &settings) {
+    threadPlacement = settings;
+    if(settings.network.empty()) return;
+    if(placement::SetCurrentThreadCPUs(settings.network)) std::cout<<"Network thread: "<<placement::DescribeCPUSet(settings.network)<<std::endl;
+    else std::cout<<"Could not move network thread to "<<placement::DescribeCPUSet(settings.network)<<", running anywhere."<<std::endl;
+}
+
+
+int M8MMiningApp::ServeParent() {
+    using namespace std::chrono;
+    auto &channel(*workerChannel);
+    auto fail = [&channel](const std::string &msg) {
+        const asizei len = std::min(msg.length(), sizeof(channel.message) - 1);
+        memcpy(channel.message, msg.c_str(), len);
+        channel.message[len] = 0;
+        channel.state.store(isolation::ws_failed, std::memory_order_release);
+        return 2;
+    };
+    // The parent told us all the algorithms so the device ends up mining the same as it would there. Only one group gets it.
+    auto used = [](const Group &group) { return group.miner && group.miner->GetNumWorkQueues()[1]; };
+    auto group(std::find_if(groups.cbegin(), groups.cend(), used));
+    if(group == groups.cend()) return fail("device " + std::to_string(channel.device) + " is not eligible for mining.");
+    auto &miner(*group->miner);
+    // The parent beats every time it looks at us, which is at least a few times per second. If it stops, it's gone.
+    // On Linux we would be killed anyway but Windows does not do that.
+    const seconds orphaned(30);
+    auint parentBeat = channel.parentBeat.load(std::memory_order_relaxed);
+    auto lastBeat(steady_clock::now());
+    while(channel.quit.load(std::memory_order_acquire) == 0) {
+        std::this_thread::sleep_for(milliseconds(100));
+        const auint beat = channel.parentBeat.load(std::memory_order_relaxed);
+        const auto now(steady_clock::now());
+        if(beat != parentBeat) {
+            parentBeat = beat;
+            lastBeat = now;
+        }
+        else if(now > lastBeat + orphaned) return 1;
+        auto stat(miner.GetTerminationReason(0));
+        if(std::get<1>(stat) == miner.s_initFailed || std::get<1>(stat) == miner.s_failed) {
+            std::string conc;
+            for(const auto &msg : std::get<2>(stat)) conc += msg + ' ';
+            return fail(conc);
+        }
+    }
+    return 0;
+}
+
+
+void M8MMiningApp::PlaceMiningThread(AbstractNonceFindersBuild::AlgoBuild &build, const Device &dev) const {
+    build.verification = threadPlacement.verification;
+    if(threadPlacement.mining.size()) build.affinity = threadPlacement.mining;
+    else if(threadPlacement.autoMining && dev.numaNode >= 0 && placement::GetNumNUMANodes() > 1) {
+        // On a single node system all the processors are in the node, no point in restricting anything.
+        build.affinity = placement::GetNUMANodeCPUs(dev.numaNode);
+        if(build.affinity.size()) build.numaNode = dev.numaNode;
+    }
+    if(build.affinity.empty() && build.verification.empty()) return;
+    std::cout<<"Device "<<dev.linearIndex<<" mining thread: "<<(build.affinity.size()? placement::DescribeCPUSet(build.affinity) : std::string("any CPU"));
+    if(build.numaNode >= 0) std::cout<<" (NUMA node "<<build.numaNode<<')';
+    if(build.verification.size()) std::cout<<", verifying on "<<placement::DescribeCPUSet(build.verification);
+    std::cout<<std::endl;
+}
+
+
+int M8MMiningApp::GetNUMANode(cl_device_id dev) {
+    // Vendor extensions, their constants are in the vendor headers only (cl_ext.h of the AMD APP SDK and CUDA) so I keep my own copy.
+    const cl_device_info TOPOLOGY_AMD = 0x4037, PCI_BUS_ID_NV = 0x4008, PCI_SLOT_ID_NV = 0x4009;
+    const cl_uint TOPOLOGY_TYPE_PCIE_AMD = 1;
+    union {
+        struct { cl_uint type; cl_uint data[5]; } raw;
+        struct { cl_uint type; cl_char unused[17]; cl_char bus, device, function; } pcie;
+    } amd;
+    if(clGetDeviceInfo(dev, TOPOLOGY_AMD, sizeof(amd), &amd, NULL) == CL_SUCCESS && amd.raw.type == TOPOLOGY_TYPE_PCIE_AMD) {
+        return placement::GetPCIDeviceNUMANode(aubyte(amd.pcie.bus), aubyte(amd.pcie.device), aubyte(amd.pcie.function));
+    }
+    cl_uint bus, slot; // NV packs device and function in the slot, as in the PCI devfn byte
+    if(clGetDeviceInfo(dev, PCI_BUS_ID_NV, sizeof(bus), &bus, NULL) == CL_SUCCESS && clGetDeviceInfo(dev, PCI_SLOT_ID_NV, sizeof(slot), &slot, NULL) == CL_SUCCESS) {
+        return placement::GetPCIDeviceNUMANode(bus, slot >> 3, slot & 7);
+    }
+    return -1; // CPU devices, Intel, old drivers...
 }
 
 
@@ -472,6 +868,7 @@ commands::monitor::ConfigInfoCMD::ConfigInfo M8MMiningApp::GetConfig(asizei i) c
     ret.specified = configData[i].value;
     ret.rejectReasons = configData[i].staticRejects;
     ret.impl = configData[i].impl;
+    ret.algo = groups[configData[i].group].algo;
     for(const auto &plat : computeNodes) {
         for(const auto &dev : plat.devices) {
             if(dev.configIndex == i) ret.devices.push_back(auint(dev.linearIndex));
@@ -492,3 +889,26 @@ bool M8MMiningApp::GetResources(AbstractAlgorithm::ConfigDesc &desc, auint devIn
     }
     return false;
 }
+
+
+std::string M8MMiningApp::GetSelectedAlgorithm() const {
+    std::string ret;
+    for(const auto &group : groups) ret += (ret.size()? ", " : "") + group.algo;
+    return ret;
+}
+
+
+bool M8MMiningApp::GetResultQueueStats(NonceFindersInterface::ResultQueueStats &out) const {
+    bool any = false;
+    out = NonceFindersInterface::ResultQueueStats();
+    for(const auto &group : groups) {
+        if(!group.miner) continue;
+        const auto stats(group.miner->GetResultQueueStats());
+        out.depth += stats.depth;
+        out.peakDepth = std::max(out.peakDepth, stats.peakDepth);
+        out.pulled += stats.pulled;
+        out.age.Merge(stats.age);
+        any = true;
+    }
+    return any;
+}
@@ -11,6 +11,8 @@
 #include "commands/Monitor/SystemInfoCMD.h"
 #include "commands/Monitor/AlgosCMD.h"
 #include "commands/Monitor/ConfigInfoCMD.h"
+#include "commands/Monitor/ResultQueueCMD.h"
+#include "commands/Admin/DeviceControlCMD.h"
 #include "AlgoSourcesLoader.h"
 
 
@@ -21,7 +23,9 @@ It also includes most details of the old "OpenCL12Wrapper" object, which I never
 integrate several additional information which was previously tracked by other means such as the configuration used by each device. */
 class M8MMiningApp : public M8MPoolMonitoringApp,
                      protected commands::monitor::SystemInfoCMD::ProcessingNodesEnumeratorInterface,
-                     protected commands::monitor::ConfigInfoCMD::ConfigDescriptorInterface {
+                     protected commands::monitor::ConfigInfoCMD::ConfigDescriptorInterface,
+                     protected commands::monitor::ResultQueueCMD::ValueSourceInterface,
+                     protected commands::admin::DeviceControlCMD::DeviceControlInterface {
 public:
     M8MMiningApp(NetworkInterface &factory) : M8MPoolMonitoringApp(factory) { }
 
@@ -37,10 +41,42 @@ public:
     After all, temporary information should not go out of its scope in theory.
     \returns Number of queues successfully created.
     \note Retains references to the varios objects contained by allConfigs. Back when I considered making this multi-step I remember considering a more flexible solution
-    but - surprise - it just isn't worth it. */
-    asizei StartMining(const std::string &algo, const rapidjson::Value &allConfigs);
+    but - surprise - it just isn't worth it.
+    Each algorithm gets its own group of devices, fed by the pools for that algorithm only. Settings are tried in algorithm order, then in configuration
+    order: a device eligible for more than one algorithm mines the first. Use "requirements": { "devices": [...] } to say otherwise. */
+    asizei StartMining(const std::vector<std::string> &algos, const rapidjson::Value &allConfigs);
 
-    void Refresh(std::vector<Network::SocketInterface*> &toRead, std::vector<Network::SocketInterface*> &toWrite);
+    /*! Configuration reload, without restarting. Pools and devices whose settings did not change keep going untouched: a device keeps
+    its mining thread with its context, programs and buffers. Changed pools are reconnected, changed devices get a new mining thread
+    in the same context, or move to another algorithm's group if the settings say so. Changing the algorithms being mined, thread placement
+    or isolation rebuilds the whole miner, that's still faster than a restart as pools don't notice and web servers stay there.
+    Call SetIsolation before, with what fresh wants. If this throws, the state is inconsistent and a restart is the only option.
+    \param current what the application has been running with so far, configurations given to StartMining point there.
+    \param fresh what it will run with from now on. Must stay around just like the current one did.
+    \returns what happened, a line for each thing rebuilt. */
+    std::vector<std::string> Reconfigure(const Settings &current, const Settings &fresh);
+
+    /*! Call before StartMining, from the main thread. The main thread is the one doing the networking so if
+    ThreadPlacementSettings::network is set, it's moved there right away. The rest is used when spawning the mining threads. */
+    void SetThreadPlacement(const ThreadPlacementSettings &settings);
+
+    /*! Call before StartMining. The watchdog rebuilds devices from the kernel sources, which are kept around. */
+    void SetWatchdog(const WatchdogSettings &settings) { watchdog = settings; }
+
+    /*! Call before StartMining to run each device in a worker process, see the isolation namespace.
+    \param args given to each worker so it loads the same configuration, "--worker <channel>" will be added. */
+    void SetIsolation(const std::string &program, const std::vector<std::string> &args) {
+        workerProgram = program;
+        workerArgs = args;
+    }
+
+    /*! This process is a worker: call before StartMining, which will then only use the device the channel tells.
+    Then call ServeParent, which returns when it's time to exit. The channel must stay there until then. */
+    void BecomeWorker(isolation::Channel &channel) { workerChannel = &channel; }
+    //! \returns process exit code, 0 if the parent asked us to go away.
+    int ServeParent();
+
+    void Refresh();
 
     ~M8MMiningApp() {
         for(auto &el : computeNodes) {
@@ -58,15 +94,26 @@ public:
 
 private:
     bool validConfigSelected = false;
-    std::string miningAlgorithm;
-    std::unique_ptr<NonceFindersInterface> miner;
+    /*! AbstractNonceFindersBuild takes for granted every pool it's given produces work for every queue it has, so it's one per algorithm.
+    Each has the pools for its algorithm only and the devices mining it. Difficulty and results are tracked by pool already so there's
+    nothing else to split. */
+    struct Group {
+        std::string algo; //!< as given to StartMining, there's a group for each even if there are no settings for it
+        std::unique_ptr<AbstractNonceFindersBuild> miner; //!< nullptr if no settings for the algorithm could be used
+        std::vector<auint> recovered; //!< how many times the watchdog recovered each queue
+    };
+    std::vector<Group> groups;
     struct Device {
         cl_device_id clid = 0;
         auint linearIndex = 0;
         asizei configIndex = asizei(-1);
+        asizei group = asizei(-1); //!< which one has the queue, if any
+        asizei queue = asizei(-1); //!< of the group miner, once created it stays there even if the device is not used anymore, see Reconfigure
+        bool inContext = false; //!< if Platform::ctx includes this, devices started by Reconfigure create their own context
         AbstractAlgorithm::ConfigDesc resources;
 
         knownHardware::Architecture architecture { knownHardware::arch_unknown };
+        int numaNode = -1; //!< where the device is attached, if the system is NUMA and the driver tells us where the device is
         struct Type {
             bool cpu, gpu, accelerator, /*custom,*/ defaultDevice;
             Type() { cpu = gpu = accelerator = defaultDevice = false; }
@@ -81,35 +128,68 @@ private:
 	};
     std::vector<Platform> computeNodes;
     std::chrono::system_clock::time_point firstNonce; //!< if clear, not found yet.
+    ThreadPlacementSettings threadPlacement;
+    std::string workerProgram; //!< isolated mode, main process: SetIsolation
+    std::vector<std::string> workerArgs;
+    isolation::Channel *workerChannel = nullptr; //!< isolated mode, worker process: BecomeWorker
+    WatchdogSettings watchdog;
+    std::chrono::steady_clock::time_point nextWatch;
 
     struct DevRequirements {
-        std::vector<std::string> Eligible(cl_platform_id pid, cl_device_id did) { return std::vector<std::string>(); }
+        std::vector<auint> devices; //!< linear indices, empty means any
+        std::vector<std::string> Eligible(cl_platform_id pid, const Device &dev) const {
+            std::vector<std::string> ret;
+            if(devices.size() && std::find(devices.cbegin(), devices.cend(), dev.linearIndex) == devices.cend()) ret.push_back("Not in requirements.devices.");
+            return ret;
+        }
     };
 
     struct ConfigHolder { //!< holds reference to the algo-impl configuration and list of reject reasons, if any, also resources consumed
         const rapidjson::Value *value;
         std::vector<std::string> staticRejects;
         std::string impl;
+        asizei group; //!< settings are given by algorithm, so is the miner using them
         // resources are not kept here. They are kept in mapped device instead so each device, even using the same config can have different resources.
         // This is especially important for "AUTO" targeting in
     };
     std::vector<ConfigHolder> configData;
+    //! Settings changed by ControlDevice, by device linear index. They replace the configData entry the device was assigned.
+    std::map<auint, std::unique_ptr<rapidjson::Document>> tuned;
+    //! What the device is mining with, either from the configuration or tuned. Only for devices with settings assigned.
+    const rapidjson::Value& RunningSettings(const Device &dev) const;
 
     std::vector<const rapidjson::Value*> Deduce(const rapidjson::Value &algoSettings);
     //! This should have better naming as it also builds the miner... but I cannot figure out anything more meaningful.
     //! In theory building the miner should go somewhere else but it's handy to have it there to reduce the amount of repetitions.
     std::pair<const char*, AbstractAlgoFactory*> NewAlgoFactory(std::unique_ptr<AbstractNonceFindersBuild> &miner, const char *algo, const char *impl);
-    void SelectSettings(const std::vector<std::pair<const char*, AbstractAlgoFactory*>> &factories,
+    //! Mangle settings and assign them to devices. Factories are by group, implementation names are only unique in an algorithm.
+    void SelectSettings(const std::vector<std::vector<std::pair<const char*, AbstractAlgoFactory*>>> &factories,
                         const std::vector<const rapidjson::Value*> &configs,
-                        const std::vector<bool> &valid); //!< mangle settings and assign them to devices
+                        const std::vector<bool> &valid);
     asizei BuildEveryUsefulContext();
-    void ParseRequirements(DevRequirements &build, const rapidjson::Value &match) const;
+    //! \returns what's wrong with the "requirements" object, the settings are not used if anything.
+    std::vector<std::string> ParseRequirements(DevRequirements &build, const rapidjson::Value &requirements) const;
+    /*! Helper to StartMining and Redeploy. Settings for each group, in order, become the new configData.
+    Algorithms with no settings are told to report and skipped. */
+    std::vector<const rapidjson::Value*> GatherSettings(const rapidjson::Value &allConfigs, const std::function<void(const std::string&)> &report);
+    //! Hooks a freshly created group miner to this and gives it the pools for its algorithm.
+    void SetupGroup(Group &group);
 
+    // The pool knows which group it feeds, only the group registered it. The others just tell they don't know it.
     void WorkChange(const AbstractWorkSource &source, std::unique_ptr<stratum::AbstractWorkFactory> &recent) {
-        if(miner) miner->SetWorkFactory(source, recent);
+        for(auto &group : groups) {
+            if(group.miner && group.miner->SetWorkFactory(source, recent)) break;
+        }
     }
     void DiffChange(const AbstractWorkSource &source, const stratum::WorkDiff &recent) {
-        if(miner) miner->SetDifficulty(source, recent);
+        for(auto &group : groups) {
+            if(group.miner && group.miner->SetDifficulty(source, recent)) break;
+        }
+    }
+    void HealthChange(const AbstractWorkSource &source, bool degraded) {
+        for(auto &group : groups) {
+            if(group.miner && group.miner->SetDegraded(source, degraded)) break;
+        }
     }
 
     static void _stdcall ErrorsToSTDOUT(const char *err, const void *priv, size_t privSz, void *userData) {
@@ -131,11 +211,27 @@ private:
 
     void TickMiner();
 
-    //! Helper function to StartMining
+    //! The watchdog, once a second, see QueueWatchdog.h.
+    void WatchQueues();
+    std::vector<std::pair<NonceOriginIdentifier, VerifiedNonces>> pulled; //!< results drained by TickMiner, kept around to not reallocate every tick
+
+    //! Helper function to StartMining. The algorithm is the one of configData[index].group, miner gets a new one for it, see NewAlgoFactory.
     bool GenFactory(std::vector<std::pair<const char*, AbstractAlgoFactory*>> &factories, std::unique_ptr<AbstractNonceFindersBuild> &miner,
-                    const std::string &algo, const rapidjson::Value &implConfig, asizei index);
-    //! Helper to StartMining
+                    const rapidjson::Value &implConfig, asizei index);
+    //! Algorithm part of the mining thread description for the device: resources, kernels and such. The factory must have parsed the settings.
+    AbstractNonceFindersBuild::AlgoBuild DescribeAlgorithm(Device &dev, const AbstractAlgoFactory &factory);
+    //! Helper to StartMining and Reconfigure. The device gets a new queue or, if it has one already, the thread there is replaced.
     void GenQueue(Device &dev, cl_context ctx, const rapidjson::Value &implConfig, const std::vector<std::pair<const char*, AbstractAlgoFactory*>> &factories, const std::string &algo, AbstractNonceFindersBuild &miner);
+    //! Releases the miner and contexts, waiting for the mining threads to go away. StartMining can be called again after this.
+    void StopMining();
+    //! Helper to Reconfigure, the algorithms are the same but their settings might not be.
+    void Redeploy(const rapidjson::Value &allConfigs, std::vector<std::string> &report);
+    //! Settings for algo, looked up case insensitive. nullptr if not there.
+    static const rapidjson::Value* FindAlgoSettings(const std::string &algo, const rapidjson::Value &allConfigs);
+    //! Decides where the mining thread for the given device should run, according to threadPlacement.
+    void PlaceMiningThread(AbstractNonceFindersBuild::AlgoBuild &build, const Device &dev) const;
+    //! Asks the driver where the device is on the PCI bus, then the OS which NUMA node that is. -1 if any of the two doesn't know.
+    static int GetNUMANode(cl_device_id dev);
 
 protected:
     AlgoSourcesLoader sources;
@@ -143,12 +239,18 @@ protected:
     /*! Why is the given device not mapped to to the given config? Again, temporary objects here. */
     virtual void AddDeviceReject(asizei config, std::string &utf8, asizei devIndex) = 0;
 
+    //! Forget what AddDeviceReject was told, settings are going to be assigned to devices again.
+    virtual void ClearDeviceRejects() = 0;
+
     /*! Performance monitoring callback, called asynchronously by the miner thread(s). */
     virtual void IterationCompleted(asizei devIndex, bool found, std::chrono::microseconds elapsed) = 0;
 
     /*! Stuff returned from a mining device. Validated but potentially stale. Not sent to pool yet! */
     virtual void UpdateDeviceStats(const VerifiedNonces &found) = 0;
 
+    /*! How long a scan takes on the given device, as measured by performance monitoring. Zero if not known yet. */
+    virtual std::chrono::microseconds GetExpectedScanTime(asizei devIndex) const = 0;
+
     asizei GetNumDevices() const {
         asizei count = 0;
         for(const auto &plat : computeNodes) count += plat.devices.size();
@@ -169,9 +271,15 @@ protected:
 
     // commands::monitor::ConfigInfoCMD::ConfigDescriptorInterface //////////////////////////////////////////
     bool ValidSelection() const { return validConfigSelected; }
-    std::string GetSelectedAlgorithm() const { return miningAlgorithm; }
+    std::string GetSelectedAlgorithm() const;
     bool ValidConfig() const { return configData.size() != 0; }
     asizei GetNumDeducedConfigs() const { return configData.size(); }
     commands::monitor::ConfigInfoCMD::ConfigInfo GetConfig(asizei i) const;
     bool GetResources(AbstractAlgorithm::ConfigDesc &desc, auint dev) const;
+
+    // commands::monitor::ResultQueueCMD::ValueSourceInterface //////////////////////////////////////////////
+    bool GetResultQueueStats(NonceFindersInterface::ResultQueueStats &out) const; //!< all the groups together
+
+    // commands::admin::DeviceControlCMD::DeviceControlInterface ////////////////////////////////////////////
+    State ControlDevice(auint device, const Change &change);
 };
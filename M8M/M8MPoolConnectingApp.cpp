@@ -5,28 +5,83 @@
 #include "M8MPoolConnectingApp.h"
 
 bool M8MPoolConnectingApp::AddPool(const PoolInfo &copy, const CanonicalInfo &algoInfo) {
-    pools.push_back(Pool());
-    pools.back().config = copy;
-    pools.back().source = std::make_unique<WorkSource>(copy.name, algoInfo, std::make_pair(copy.diffMode, copy.diffMul), copy.merkleMode);
-    auto &source(*pools.back().source);
+    pools.push_back(NewPool(copy, algoInfo));
+    return true;
+}
+
+
+M8MPoolConnectingApp::Pool M8MPoolConnectingApp::NewPool(const PoolInfo &copy, const CanonicalInfo &algoInfo) {
+    Pool ret;
+    ret.config = copy;
+    ret.source = std::make_unique<WorkSource>(copy.name, algoInfo, std::make_pair(copy.diffMode, copy.diffMul), copy.merkleMode);
+    auto &source(*ret.source);
     source.AddCredentials(copy.user, copy.pass);
     source.errorCallback = [this](const AbstractWorkSource &owner, asizei i, int errorCode, const std::string &message) {
         StratumError(owner, i, errorCode, message);
     };
     source.shareResponseCallback = [this](const AbstractWorkSource &me, asizei shareID, StratumShareResponse stat) {
+        ShareReplied(me, stat);
         ShareResponse(me, shareID, stat);
     };
     source.workerAuthCallback = [this](const AbstractWorkSource &owner, const std::string &worker, StratumState::AuthStatus status) {
         WorkerAuthorization(owner, worker, status);
     };
-    return true;
+    return ret;
+}
+
+
+void M8MPoolConnectingApp::ReconfigurePools(const std::vector<std::unique_ptr<PoolInfo>> &fresh, const std::vector<CanonicalInfo> &canon, std::vector<std::string> &report) {
+    std::vector<const PoolInfo*> was, now;
+    std::vector<std::string> names; // was is gone once the kept pools are moved
+    for(const auto &el : pools) {
+        was.push_back(&el.config);
+        names.push_back(el.config.name);
+    }
+    for(const auto &el : fresh) now.push_back(el.get());
+    const auto plan(reload::PlanPools(was, now));
+    auto named = [](const PoolInfo &pool) { return "pool \"" + pool.name + '"'; };
+    for(auto index : plan.dropped) {
+        const bool changed = std::find_if(fresh.cbegin(), fresh.cend(), [this, index](const std::unique_ptr<PoolInfo> &test) {
+            return test->name == pools[index].config.name;
+        }) != fresh.cend();
+        if(!changed) report.push_back(named(pools[index].config) + " removed");
+        Retire(pools[index]);
+    }
+    std::vector<Pool> next;
+    next.reserve(fresh.size());
+    for(asizei loop = 0; loop < fresh.size(); loop++) {
+        if(plan.reuse[loop] != asizei(-1)) next.push_back(std::move(pools[plan.reuse[loop]]));
+        else {
+            const bool changed = std::find(names.cbegin(), names.cend(), fresh[loop]->name) != names.cend();
+            report.push_back(named(*fresh[loop]) + (changed? " changed, reconnecting" : " added"));
+            next.push_back(NewPool(*fresh[loop], canon[loop]));
+        }
+    }
+    pools = std::move(next);
+    PoolListChanged();
+}
+
+
+void M8MPoolConnectingApp::Retire(Pool &entry) {
+    ConnectionState(*entry.source, ce_closing);
+    if(entry.route) {
+        entry.source->Shutdown();
+        network.CloseConnection(*entry.route);
+        entry.route = nullptr;
+    }
+    // Nobody is going to tell us what happened to those and its journal goes away with it.
+    for(auto el = sentShares.begin(); el != sentShares.end(); ) {
+        if(el->first.owner == entry.source.get()) el = sentShares.erase(el);
+        else ++el;
+    }
 }
 
 
-asizei M8MPoolConnectingApp::BeginPoolActivation(const char *algo) {
+asizei M8MPoolConnectingApp::BeginPoolActivation(const std::vector<std::string> &algos) {
     asizei activated = 0;
     for(auto &entry : pools) {
-        if(_stricmp(entry.config.algo.c_str(), algo)) { // different algos get disabled.
+        auto mined = [&entry](const std::string &algo) { return _stricmp(entry.config.algo.c_str(), algo.c_str()) == 0; };
+        if(std::none_of(algos.cbegin(), algos.cend(), mined)) { // different algos get disabled.
             if(entry.route) {
                 entry.source->Shutdown();
                 network.CloseConnection(*entry.route);
@@ -64,105 +119,260 @@ asizei M8MPoolConnectingApp::BeginPoolActivation(const char *algo) {
 }
 
 
-void M8MPoolConnectingApp::FillSleepLists(std::vector<Network::SocketInterface*> &toRead, std::vector<Network::SocketInterface*> &toWrite) {
+void M8MPoolConnectingApp::UpdateInterest() {
     for(const auto &server : pools) {
         if(server.route == nullptr) continue;
         if(server.source->Ready() == false || // still connecting
-            server.source->NeedsToSend()) toWrite.push_back(server.route);
-        else toRead.push_back(server.route); // that is, I give priority to sending over reading, only one per tick
+            server.source->NeedsToSend()) server.route->SetInterest(Network::SocketInterface::si_write);
+        else server.route->SetInterest(Network::SocketInterface::si_read); // that is, I give priority to sending over reading, only one per tick
     }
 }
 
 
-void M8MPoolConnectingApp::Refresh(std::vector<Network::SocketInterface*> &toRead, std::vector<Network::SocketInterface*> &toWrite) {
+void M8MPoolConnectingApp::Refresh() {
     M8MConfiguredApp::Tick();
     // First of all, shut down pools whose connection has gone down.
-    auto goodbye = [this](Network::SocketInterface *test) {
-        if(!test) return; // this happens as Network::SleepOn clears dormient sockets.
-        if(test->Works()) return;
-        auto entry(std::find_if(pools.begin(), pools.end(), [test](Pool &entry) { return entry.route == test; }));
-        if(entry == pools.end()) return; // this could be for example a mini-server web socket
-        ConnectionState(*entry->source, ce_failed);
-        entry->source->Disconnected();
-        network.CloseConnection(*entry->route);
-        entry->route = nullptr;
-
-        auto zero = std::chrono::system_clock::time_point();
-        if(entry->activated != zero) {
-            auto now(std::chrono::system_clock::now());
-            entry->totalTime += now - entry->activated;
-            entry->activated = zero;
-            entry->nextReconnect = now + reconnectDelay;
-        }
-    };
-    for(auto entry : toRead) goodbye(entry);
-    for(auto entry : toWrite) goodbye(entry);
+    for(auto &entry : pools) {
+        if(entry.route && entry.route->Signaled() && entry.route->Works() == false) Goodbye(entry);
+    }
     // Then do proper IO.
-    auto activated = [](const std::vector<Network::SocketInterface*> &sockets, Network::SocketInterface *check) {
-        return std::find(sockets.cbegin(), sockets.cend(), check) != sockets.cend();
-    };
     for(auto &entry : pools) {
-        if(entry.source->Ready() == false) continue;
-        auto r(activated(toRead, entry.route));
-        auto w(activated(toWrite, entry.route));
+        if(entry.source->Ready() == false || entry.route == nullptr) continue;
+        auto r(entry.route->Readable());
+        auto w(entry.route->Writable());
         if(!w && !r) continue;
 
         auto &pool(*entry.source);
         auto happens(pool.Refresh(r, w));
-        if(happens.connFailed) goodbye(entry.route);
+        if(happens.connFailed) Goodbye(entry);
         else {
             if(happens.bytesReceived) PoolCommand(pool);
             if(happens.diffChanged) DiffChange(pool, pool.GetCurrentDiff());
-            if(happens.newWork) WorkChange(pool, std::unique_ptr<stratum::AbstractWorkFactory>(pool.GenWork()));
+            if(happens.newWork) {
+                std::unique_ptr<stratum::AbstractWorkFactory> work(pool.GenWork());
+                JobReceived(entry, *work);
+                WorkChange(pool, work);
+            }
         }
     }
     // Then initialize pools which have just connected.
     for(auto &entry : pools) {
         if(entry.source->Ready()) continue; // already fully enabled, not connecting
         if(entry.route == nullptr) continue; // disabled, different algo, not even trying
-        if(!activated(toWrite, entry.route)) continue;
+        if(!entry.route->Writable()) continue;
         entry.activated = std::chrono::system_clock::now();
         entry.numActivations++;
         entry.source->Use(entry.route); // what if connection failed? Nothing. We try anyway and then bail out.
         ConnectionState(*entry.source, ce_ready);
     }
+    UpdateHealth();
+    NegotiateDifficulty();
+    for(auto &entry : pools) ReplayJournal(entry);
     AttemptReconnections();
 }
 
 
-void M8MPoolConnectingApp::SendResults(const NonceOriginIdentifier &from, const VerifiedNonces &sharesFound) {
-    AbstractWorkSource *owner = nullptr;
-    asizei poolIndex = 0;
-    for(asizei search = 0; search < pools.size(); search++) {
-        if(pools[search].source.get() == from.owner) {
-            owner = pools[search].source.get();
-            poolIndex = search;
-            break;
+void M8MPoolConnectingApp::Goodbye(Pool &entry) {
+    ConnectionState(*entry.source, ce_failed);
+    // Shares waiting for a reply won't get one. They can't stay there anyway as the next connection will reuse their ids.
+    // Only the ones still in the send queue go in the journal, this must happen before Disconnected throws the queue away.
+    const asizei journaled = entry.journal.shares.size();
+    for(auto el = sentShares.begin(); el != sentShares.end(); ) {
+        if(el->first.owner != entry.source.get()) {
+            ++el;
+            continue;
         }
+        entry.journal.Unanswered(el->second, entry.source->Written(el->first.shareIndex), journalCapacity);
+        el = sentShares.erase(el);
+    }
+    entry.journal.Open(journaled, std::chrono::steady_clock::now());
+    entry.source->Disconnected();
+    network.CloseConnection(*entry.route);
+    entry.route = nullptr;
+    if(entry.health.degraded) HealthChange(*entry.source, false); // it has no work anyway, give it a fresh start when it's back
+    entry.health = PoolHealth();
+
+    auto zero = std::chrono::system_clock::time_point();
+    if(entry.activated != zero) {
+        auto now(std::chrono::system_clock::now());
+        const bool stable = now - entry.activated >= reconnectDelay;
+        entry.totalTime += now - entry.activated;
+        entry.activated = zero;
+        // A connection which worked for a while is worth trying again right away, that's also the only chance to send the journal.
+        // One which goes down soon after coming up waits so we don't hammer a server with problems.
+        entry.nextReconnect = stable? now : now + reconnectDelay;
+    }
+}
+
+
+void M8MPoolConnectingApp::ReplayJournal(Pool &entry) {
+    using namespace std::chrono;
+    auto &journal(entry.journal);
+    if(!journal.open) return;
+    const auto now(steady_clock::now());
+    if(now - journal.since > journalMaxAge) { // whatever it is, we're too late
+        JournalClosed(entry, journal.Drop());
+        return;
+    }
+    journal.Expire(now, journalMaxAge);
+
+    auto &pool(*entry.source);
+    switch(pool.GetSessionResume()) {
+    case AbstractWorkSource::sr_unknown: return; // still reconnecting
+    case AbstractWorkSource::sr_new: // different extranonce1, all those shares are for something else
+        JournalClosed(entry, journal.Drop());
+        return;
     }
-    if(!owner) throw "Impossible, WU owner not found"; // really wrong stuff. Most likely a bug in code or possibly we just got hit by some cosmic ray
+    std::vector< std::pair<const char*, StratumState::AuthStatus> > workers;
+    pool.GetUserNames(workers);
+    for(const auto &el : workers) {
+        if(el.second == StratumState::as_pending) return;
+    }
+    if(!pool.Notified()) return; // the first job tells us what's still valid
+    auto result(journal.Replay([this, &pool](const ShareFeedbackData &share) {
+        if(!pool.IsCurrentJob(share.job)) return false;
+        ShareIdentifier shareSrc;
+        shareSrc.owner = &pool;
+        shareSrc.shareIndex = pool.SendShare(share.job, share.ntime, share.nonce2, share.nonce, share.block);
+        sentShares.insert(std::make_pair(shareSrc, share));
+        return true;
+    }));
+    if(result.fresh) AddSent(pool, result.fresh);
+    JournalClosed(entry, result);
+}
+
+
+void M8MPoolConnectingApp::JournalClosed(const Pool &entry, const ShareJournal<ShareFeedbackData>::Outcome &result) {
+    if(result.replayed || result.dropped || result.unanswered) SharesReplayed(*entry.source, result.replayed, result.dropped, result.unanswered);
+}
+
+
+void M8MPoolConnectingApp::JobReceived(Pool &entry, const stratum::AbstractWorkFactory &work) {
+    using namespace std::chrono;
+    const auto now(steady_clock::now());
+    const bool first = entry.health.lastNotify == steady_clock::time_point();
+    const auto block(work.GetPrevHash());
+    entry.health.lastNotify = now;
+    if(!first && block == entry.health.block) return; // same block, just a new job
+    entry.health.block = block;
+    auto match(std::find_if(announced.cbegin(), announced.cend(), [&block](const std::pair<std::array<aubyte, 32>, steady_clock::time_point> &test) {
+        return test.first == block;
+    }));
+    if(match == announced.cend()) { // we're the first to know
+        const asizei KEEP = 16;
+        if(announced.size() == KEEP) announced.erase(announced.begin());
+        announced.push_back(std::make_pair(block, now));
+        if(!first) {
+            entry.health.Announced(.0);
+            entry.jobLag.Add(.0);
+        }
+        return;
+    }
+    if(first) return; // a pool which just connected is certainly going to be late with a block we already know
+    const double lag = double(duration_cast<milliseconds>(now - match->second).count());
+    entry.health.Announced(lag);
+    entry.jobLag.Add(lag);
+}
+
+
+void M8MPoolConnectingApp::ShareReplied(const AbstractWorkSource &pool, StratumShareResponse stat) {
+    if(stat != StratumShareResponse::ssr_accepted && stat != StratumShareResponse::ssr_rejected) return;
+    pools[GetPoolIndex(pool)].health.Replied(stat == StratumShareResponse::ssr_rejected);
+}
+
+
+void M8MPoolConnectingApp::UpdateHealth() {
+    const auto now(std::chrono::steady_clock::now());
+    for(auto &entry : pools) {
+        if(entry.source->Ready() == false || entry.health.Update(now, healthLimits) == false) continue;
+        const bool degraded = entry.health.degraded;
+        HealthChange(*entry.source, degraded);
+        ConnectionState(*entry.source, degraded? ce_degraded : ce_recovered);
+    }
+}
+
+
+void M8MPoolConnectingApp::SendResults(std::vector<std::pair<NonceOriginIdentifier, VerifiedNonces>> &batch) {
+    typedef std::pair<NonceOriginIdentifier, VerifiedNonces> Result;
+    std::stable_sort(batch.begin(), batch.end(), [](const Result &a, const Result &b) { return std::less<const void*>()(a.first.owner, b.first.owner); });
+    for(auto run = batch.cbegin(); run != batch.cend(); ) {
+        const void *key = run->first.owner;
+        const auto end = std::find_if(run, batch.cend(), [key](const Result &el) { return el.first.owner != key; });
+        auto match(std::find_if(pools.begin(), pools.end(), [key](const Pool &test) { return test.source.get() == key; }));
+        if(match == pools.end()) { // pool removed by a configuration reload, those were found before the miners noticed
+            run = end;
+            continue;
+        }
+        bool block = false;
+        for(; run != end; ++run) block |= SendResults(*match, run->first, run->second);
+        // A block share waiting for the next tick might be a block lost. If the socket isn't writable it just stays queued.
+        if(block && !match->source->Flush()) Goodbye(*match);
+    }
+}
+
+
+bool M8MPoolConnectingApp::SendResults(Pool &entry, const NonceOriginIdentifier &from, const VerifiedNonces &sharesFound) {
+    AbstractWorkSource *owner = entry.source.get();
     if(sharesFound.wrong) BadHashes(*owner, sharesFound.device, sharesFound.wrong);
+    {
+        const auto now(std::chrono::steady_clock::now());
+        auto &shareRate(GetShareRate(entry));
+        entry.verification += sharesFound.verification;
+        for(asizei loop = 0; loop < sharesFound.nonces.size(); loop++) {
+            shareRate.Found(sharesFound.targetDiff, now);
+            entry.recentShares.push_back(now);
+        }
+        while(entry.recentShares.size() && now - entry.recentShares.front() > std::chrono::minutes(1)) entry.recentShares.pop_front();
+    }
     auto ntime = owner->IsCurrentJob(from.job);
     if(ntime) {
         asizei sent = 0;
+        bool block = false;
         for(auto &result : sharesFound.nonces) {
             ShareIdentifier shareSrc;
             shareSrc.owner = owner;
-            shareSrc.shareIndex = owner->SendShare(from.job, ntime, sharesFound.nonce2, result.nonce);
+            shareSrc.shareIndex = owner->SendShare(from.job, ntime, sharesFound.nonce2, result.nonce, result.block);
+            block |= result.block;
 
             ShareFeedbackData fback;
-            fback.block = result.block;
-            fback.hashSlice = result.hashSlice;
-            fback.shareDiff = result.diff;
-            fback.targetDiff = sharesFound.targetDiff;
-            fback.gpuIndex = sharesFound.device;
+            FillFeedback(fback, from, ntime, sharesFound, result);
 
             sentShares.insert(std::make_pair(shareSrc, fback));
             sent++;
         }
         AddSent(*owner, sent);
+        return block;
+    }
+    else if(entry.journal.open && (ntime = owner->WasCurrentJob(from.job)) != 0) {
+        for(auto &result : sharesFound.nonces) {
+            ShareFeedbackData fback;
+            FillFeedback(fback, from, ntime, sharesFound, result);
+            entry.journal.Add(fback, false, journalCapacity);
+        }
     }
     else AddStale(sharesFound.device, sharesFound.nonces.size());
+    return false;
+}
+
+
+void M8MPoolConnectingApp::NegotiateDifficulty() {
+    const auto now(std::chrono::steady_clock::now());
+    for(auto &entry : pools) {
+        if(entry.config.targetSharesPerMinute <= .0 || !entry.source->Notified()) continue;
+        if(entry.source->SuggestionsRefused()) continue;
+        const double current = entry.source->GetCurrentDiff().shareDiff / entry.config.diffMul.stratum;
+        const double diff = GetShareRate(entry).Suggest(entry.rate, entry.config.targetSharesPerMinute, entry.config.diffMul.stratum, current, now);
+        if(diff > .0) entry.source->SuggestDifficulty(diff);
+    }
+}
+
+
+ShareRateController& M8MPoolConnectingApp::GetShareRate(const Pool &entry) {
+    std::string algo(entry.config.algo);
+    std::transform(algo.begin(), algo.end(), algo.begin(), [](char c) { return char(tolower(c)); });
+    auto match(shareRates.find(algo));
+    if(match == shareRates.end()) match = shareRates.insert(std::make_pair(algo, shareRateDefaults)).first;
+    return match->second;
 }
 
 
@@ -8,6 +8,11 @@
 #include "commands/Monitor/PoolCMD.h"
 #include "../Common/WorkSource.h"
 #include "NonceStructs.h"
+#include "ShareRateController.h"
+#include "ReloadPlan.h"
+#include "ShareJournal.h"
+#include "PoolHealth.h"
+#include <deque>
 
 /*! Managing pool connections was originally part of the "Connections" object, later renamed "PoolManager".
 The main problem with the pool manager is that pretty much everybody needed it for what it did or perhaps just
@@ -27,13 +32,22 @@ public:
     /*! Activating a pool involves pulling up a TCP connection to it. It's a non-blocking operation.
     After the TCP connection comes up, a proper stratum object will be created and handshake will take place.
     At some point the pool(s) will be able to generate work.
+    Only pools for the given algorithms are activated, the others are disabled.
     \returns Number of pools attempting activation. If this is zero, something is definitely wrong in config. */
-    asizei BeginPoolActivation(const char *algo);
+    asizei BeginPoolActivation(const std::vector<std::string> &algos);
 
     void SetReconnectDelay(std::chrono::seconds retry) { reconnectDelay = retry; }
 
-	virtual void FillSleepLists(std::vector<Network::SocketInterface*> &toRead, std::vector<Network::SocketInterface*> &toWrite);
-    virtual void Refresh(std::vector<Network::SocketInterface*> &toRead, std::vector<Network::SocketInterface*> &toWrite);
+    /*! Configuration reload. The pools become the given ones, in that order. Pools which did not change keep going as they are:
+    connection, session, pending shares and stats. The others are shut down and built again, if still there.
+    Call BeginPoolActivation after, new pools are not connected yet.
+    \param canon one for each fresh pool, as AddPool.
+    \param report a line is added for each pool rebuilt, added or removed. */
+    void ReconfigurePools(const std::vector<std::unique_ptr<PoolInfo>> &fresh, const std::vector<CanonicalInfo> &canon, std::vector<std::string> &report);
+
+    //! Sets what each pool socket waits for, call before Network::SleepOn.
+	virtual void UpdateInterest();
+    virtual void Refresh();
 
 protected:
     NetworkInterface &network;
@@ -47,6 +61,24 @@ protected:
     virtual void PoolCommand(const AbstractWorkSource &owner) = 0; //!< called when at least a byte is received. Or a command? I haven't decided yet.
 	virtual void WorkChange(const AbstractWorkSource &pool, std::unique_ptr<stratum::AbstractWorkFactory> &newWork) = 0; //!< newWork can be nullptr(no work)
     virtual void DiffChange(const AbstractWorkSource &pool, const stratum::WorkDiff &diff) = 0;
+    //! Switches mining away from degraded pools and back, see PoolHealth. Reporting goes through ConnectionState, ce_degraded and ce_recovered.
+    virtual void HealthChange(const AbstractWorkSource &pool, bool degraded) = 0;
+
+    PoolHealth::Limits healthLimits; //!< after which a pool is considered degraded
+
+    /*! Pools having PoolInfo::targetSharesPerMinute get their difficulty negotiated, see ShareRateController.
+    Each algorithm is mined by its own devices so each has its own controller, fed by the pools of that algorithm only.
+    They are all copies of this one: its parameters can be changed here, its shares are never counted. */
+    ShareRateController shareRateDefaults;
+
+    //! Shares found for this pool in the last minute, stale or not. They cost the same to verify.
+    asizei GetSharesLastMinute(asizei index) const {
+        const auto since(std::chrono::steady_clock::now() - std::chrono::minutes(1));
+        const auto &found(pools[index].recentShares);
+        return found.cend() - std::upper_bound(found.cbegin(), found.cend(), since);
+    }
+    //! CPU time spent checking results for this pool, since program start.
+    std::chrono::microseconds GetVerificationTime(asizei index) const { return pools[index].verification; }
 
     //! Performance monitoring. Called after some shares have been queued for sending to the pool.
     virtual void AddSent(const AbstractWorkSource &pool, asizei sent) = 0;
@@ -64,7 +96,11 @@ protected:
         ce_failedResolve,
         ce_badSocket,
         ce_failedConnect,
-        ce_noRoutes
+        ce_noRoutes,
+
+        // Those are about a pool still connected, see PoolHealth. A pool going down while degraded just gets ce_failed.
+        ce_degraded,
+        ce_recovered
     };
     virtual void ConnectionState(const AbstractWorkSource &pool, ConnectionEvent status) = 0;
 
@@ -85,6 +121,8 @@ protected:
     }
 
     const AbstractWorkSource& GetPool(asizei index) const { return *pools[index].source; }
+    //! Milliseconds between the first pool announcing a block and this pool doing the same, 0 if it was the first.
+    const LatencyHistogram& GetJobLag(asizei index) const { return pools[index].jobLag; }
 
     asizei GetNumActiveServers() const {
         return std::count_if(pools.cbegin(), pools.cend(), [](const Pool &test) {
@@ -107,13 +145,32 @@ protected:
         bool block;
         asizei gpuIndex;
         std::array<unsigned char, 4> hashSlice;
+        // Those are needed to send the share again on a new connection, see Pool::journal.
+        std::string job;
+        auint ntime, nonce2, nonce;
+        std::chrono::steady_clock::time_point found;
     };
     std::map<ShareIdentifier, ShareFeedbackData> sentShares;
 
-    void SendResults(const NonceOriginIdentifier &from, const VerifiedNonces &sharesFound);
+    /*! When a connection goes down, shares the server never got and shares found while reconnecting go in a journal, see ShareJournal.
+    Those limits keep it bounded, a pool which takes minutes to come back isn't going to take those shares anyway. */
+    asizei journalCapacity = 64;
+    std::chrono::seconds journalMaxAge = std::chrono::seconds(120);
+
+    /*! Called once the journal has been processed after a reconnect. Replayed shares not counted before go through AddSent as well.
+    \param unanswered shares written on the connection which went down without getting a reply, those are not sent again. */
+    virtual void SharesReplayed(const AbstractWorkSource &pool, asizei replayed, asizei dropped, asizei unanswered) = 0;
+
+    /*! Everything the miners found since last time. Results are grouped by pool, keeping the order they were found, so each pool gets
+    its shares queued back to back and they go out together: at the next tick in a single send or right away if one of them solves a block.
+    The vector is sorted in place. */
+    void SendResults(std::vector<std::pair<NonceOriginIdentifier, VerifiedNonces>> &batch);
 
     virtual void BadHashes(const AbstractWorkSource &owner, asizei linDevice, asizei badCount) = 0;
 
+    //! Called by ReconfigurePools after the pool list changed, pool indices mean something else now.
+    virtual void PoolListChanged() = 0;
+
     // PoolEnumeratorInterface ////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     asizei GetNumServers() const { return pools.size(); }
     const PoolInfo& GetServerInfo(asizei i) const { return pools[i].config; }
@@ -137,20 +194,64 @@ private:
 
         std::unique_ptr<WorkSource> source; //!< This is created when InitPools for the corresponding algo is called and then stays persistent.
         Network::ConnectedSocketInterface *route = nullptr; //!< Created when Activate is called
+
+        PoolHealth health; //!< tracked for each connection, reset when it goes down
+        LatencyHistogram jobLag; //!< same measure as health.notifyLag but kept across connections
+        ShareRateController::Pool rate;
+        std::deque<std::chrono::steady_clock::time_point> recentShares; //!< last minute only
+        std::chrono::microseconds verification = std::chrono::microseconds(0);
+
+        ShareJournal<ShareFeedbackData> journal;
+
         explicit Pool() = default;
         Pool(Pool &&other) {
             config = std::move(other.config);
             activated = std::move(other.activated);
             numActivations = other.numActivations;
-            totalTime = std::move(totalTime);
+            totalTime = other.totalTime;
+            nextReconnect = other.nextReconnect;
             source = std::move(other.source);
             route = other.route;
             other.route = nullptr;
+            health = other.health;
+            jobLag = other.jobLag;
+            rate = other.rate;
+            recentShares = std::move(other.recentShares);
+            verification = other.verification;
+            journal = std::move(other.journal);
         }
     private:
         Pool(const Pool &) = delete;
     };
     std::vector<Pool> pools;
     std::chrono::seconds reconnectDelay = std::chrono::seconds(30);
+    Pool NewPool(const PoolInfo &copy, const CanonicalInfo &algoInfo);
+    void Retire(Pool &entry); //!< shuts down a pool going away for good, see ReconfigurePools
     void AttemptReconnections();
+    void Goodbye(Pool &entry); //!< shuts down a pool whose connection has gone down
+    bool SendResults(Pool &entry, const NonceOriginIdentifier &from, const VerifiedNonces &sharesFound); //!< true if a block share got queued
+
+    //! Blocks recently announced by any pool and when the first announce came in. Only the last few are kept.
+    std::vector<std::pair<std::array<aubyte, 32>, std::chrono::steady_clock::time_point>> announced;
+    void JobReceived(Pool &entry, const stratum::AbstractWorkFactory &work); //!< updates notify lag
+    void ShareReplied(const AbstractWorkSource &pool, StratumShareResponse stat); //!< updates reject rate
+    void UpdateHealth(); //!< marks pools degraded or good again, calls HealthChange and ConnectionState on change
+    void NegotiateDifficulty(); //!< suggests a difficulty to pools finding too many or too few shares
+    std::map<std::string, ShareRateController> shareRates; //!< by PoolInfo::algo, lowercase as algorithms are matched ignoring case
+    ShareRateController& GetShareRate(const Pool &entry); //!< of its algorithm, made from shareRateDefaults the first time
+
+    static void FillFeedback(ShareFeedbackData &fback, const NonceOriginIdentifier &from, auint ntime, const VerifiedNonces &found, const VerifiedNonces::Nonce &result) {
+        fback.block = result.block;
+        fback.hashSlice = result.hashSlice;
+        fback.shareDiff = result.diff;
+        fback.targetDiff = found.targetDiff;
+        fback.gpuIndex = found.device;
+        fback.job = from.job;
+        fback.ntime = ntime;
+        fback.nonce2 = found.nonce2;
+        fback.nonce = result.nonce;
+        fback.found = std::chrono::steady_clock::now();
+    }
+    void ReplayJournal(Pool &entry); //!< sends or drops the journal when the new connection is good to go
+    void JournalClosed(const Pool &entry, const ShareJournal<ShareFeedbackData>::Outcome &result);
 };
@@ -127,6 +127,7 @@ void M8MPoolMonitoringApp::ConnectionState(const AbstractWorkSource &owner, Conn
                 entry.cumulatedTime += system_clock::now() - entry.lastActivated;
                 entry.lastActivated = system_clock::time_point();
                 entry.lastConnDown = system_clock::now();
+                entry.degraded = false;
                 break;
             }
         }
@@ -144,6 +145,18 @@ void M8MPoolMonitoringApp::ConnectionState(const AbstractWorkSource &owner, Conn
     case ce_noRoutes:
         cout<<" !! Error connecting, no routes !!";
         break;
+    case ce_degraded:
+    case ce_recovered:
+        cout<<(ce == ce_degraded? "degraded, preferring other pools." : "back in service.");
+        for(auto &entry : poolShares) {
+            if(entry.src == &owner) {
+                entry.degraded = ce == ce_degraded;
+                if(entry.degraded) entry.numDegraded++;
+                break;
+            }
+        }
+        if(ce == ce_degraded) Warning(L"A pool is degraded, mining on the others");
+        break;
     default: std::cout<<"??Impossible! Code out of sync??";
     }
     cout<<std::endl;
@@ -162,6 +175,18 @@ void M8MPoolMonitoringApp::AddSent(const AbstractWorkSource &pool, asizei sent)
 }
 
 
+void M8MPoolMonitoringApp::SharesReplayed(const AbstractWorkSource &pool, asizei replayed, asizei dropped, asizei unanswered) {
+    using std::cout;
+    cout<<"Pool ";
+    if(pool.name.length()) cout<<'"'<<pool.name<<'"';
+    else cout<<"0x"<<&pool;
+    cout<<" reconnected, "<<replayed<<" share"<<(replayed != 1? "s" : "")<<" sent again, ";
+    cout<<dropped<<" dropped as no more valid";
+    if(unanswered) cout<<", "<<unanswered<<" sent before going down never got a reply";
+    cout<<'.'<<std::endl;
+}
+
+
 void M8MPoolMonitoringApp::ShareFeedback(const ShareIdentifier &share, const ShareFeedbackData &data, StratumShareResponse response, asizei poolIndex) {
     using namespace std;
     //   H   M   S   :       []<space>
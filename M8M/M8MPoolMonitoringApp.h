@@ -5,11 +5,13 @@
 #pragma once
 #include "M8MPoolConnectingApp.h"
 #include "commands/Monitor/PoolStats.h"
+#include "commands/Monitor/PoolLatencyCMD.h"
 #include <iostream>
 #include <chrono>
 
 class M8MPoolMonitoringApp : public M8MPoolConnectingApp,
-                             protected commands::monitor::PoolStats::ValueSourceInterface {
+                             protected commands::monitor::PoolStats::ValueSourceInterface,
+                             protected commands::monitor::PoolLatencyCMD::ValueSourceInterface {
 public:
     M8MPoolMonitoringApp(NetworkInterface &factory) : M8MPoolConnectingApp(factory) { }
 
@@ -31,6 +33,19 @@ private:
     void ConnectionState(const AbstractWorkSource &owner, ConnectionEvent ce);
     void BadHashes(const AbstractWorkSource &owner, asizei linearDevice, asizei badCount);
     void AddSent(const AbstractWorkSource &pool, asizei sent);
+    void SharesReplayed(const AbstractWorkSource &pool, asizei replayed, asizei dropped, asizei unanswered);
+
+    //! Stats follow their pool to its new index, new pools start from scratch.
+    void PoolListChanged() {
+        std::vector<TimeLapsePoolStats> remap(GetNumServers());
+        for(asizei loop = 0; loop < remap.size(); loop++) {
+            const AbstractWorkSource *src = &GetPool(loop);
+            auto match(std::find_if(poolShares.cbegin(), poolShares.cend(), [src](const TimeLapsePoolStats &test) { return test.src == src; }));
+            if(match != poolShares.cend()) remap[loop] = *match;
+            remap[loop].src = src;
+        }
+        poolShares = std::move(remap);
+    }
 
     static void ShareFeedback(const ShareIdentifier &share, const ShareFeedbackData &data, StratumShareResponse response, asizei poolIndex);
     static std::string Suffixed(unsigned __int64 value);
@@ -47,6 +62,22 @@ private:
     bool GetPoolShareStats(commands::monitor::PoolStats::ShareStats &out, asizei poolIndex) {
         if(poolIndex >= poolShares.size()) return false;
         out = poolShares[poolIndex];
+        out.shareSendLatency = GetPool(poolIndex).GetSendLatency(StratumState::sl_share).average;
+        out.blockSendLatency = GetPool(poolIndex).GetSendLatency(StratumState::sl_block).average;
+        out.sharesPerMinute = auint(GetSharesLastMinute(poolIndex));
+        out.suggestedDiff = GetPool(poolIndex).GetSuggestedDiff();
+        out.verificationTime = GetVerificationTime(poolIndex).count() / 1000.0;
+        return true;
+    }
+
+    // commands::monitor::PoolLatencyCMD::ValueSourceInterface ///////////////////////////////////////////////
+    bool GetPoolLatencies(commands::monitor::PoolLatencyCMD::Latencies &out, asizei poolIndex) {
+        if(poolIndex >= GetNumServers()) return false;
+        const auto &timings(GetPool(poolIndex).GetTimings());
+        out.submit = timings.submitRoundTrip;
+        out.request = timings.requestRoundTrip;
+        out.notify = timings.notifyInterval;
+        out.jobLag = GetJobLag(poolIndex);
         return true;
     }
 };
@@ -5,16 +5,16 @@
 #include "M8MWebServingApp.h"
 
 
-void M8MWebServingApp::Refresh(std::vector<Network::SocketInterface*> &toRead, std::vector<Network::SocketInterface*> &toWrite) {
+void M8MWebServingApp::Refresh() {
     // Rather than driving the icon on events in callbacks, look at server states and figure out what to do each time.
     // It is way less efficient but this is not a performance path and this is much cleaner.
-    M8MMinerTrackingApp::Refresh(toRead, toWrite);
+    M8MMinerTrackingApp::Refresh();
     using namespace std::chrono;
     const auto zero = system_clock::time_point();
     bool closing = reloadRequested == zero? false : reloadRequested + seconds(1) < system_clock::now(); // some time to send late replies, should really be based on tick count but anyway...
-    auto webTick = [&toRead, &toWrite, closing](std::unique_ptr<AbstractWSServer> &server) {
+    auto webTick = [closing](std::unique_ptr<AbstractWSServer> &server) {
         if(server) {
-            server->Refresh(toRead, toWrite);
+            server->Refresh();
             if(closing) {
                 if(server->AreYouClosing() == false) server->BeginClose();
                 else if(server->GetNumClients() == 0) server.reset();
@@ -109,6 +109,8 @@ void M8MWebServingApp::RegisterMonitorCommands(AbstractWSServer &server) {
     RegisterCommand(server, new ScanTime(perfStats));
     RegisterCommand(server, new DeviceShares(*this));
     RegisterCommand(server, new PoolStats(*this));
+    RegisterCommand(server, new PoolLatencyCMD(*this));
+    RegisterCommand(server, new ResultQueueCMD(*this));
     RegisterCommand(server, new UptimeCMD(*this));
     RegisterCommand(server, new commands::VersionCMD);
     RegisterCommand(server, new commands::ExtensionListCMD(extensions));
@@ -123,7 +125,8 @@ void M8MWebServingApp::RegisterAdminCommands(AbstractWSServer &server) {
     RegisterCommand(server, new GetRawConfigCMD(config));
     RegisterCommand(server, new SaveRawConfigCMD(loadInfo.configFile.c_str()));
     RegisterCommand(server, new ReloadCMD([this]() {
-        reloadRequested = std::chrono::system_clock::now();
-        return false; // will reload listening?
+        reloadPending = true;
+        return true; // web servers keep listening, only what changed in the configuration is rebuilt
     }));
+    RegisterCommand(server, new DeviceControlCMD(*this));
 }
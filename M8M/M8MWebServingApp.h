@@ -16,6 +16,7 @@
 #include "commands/Admin/GetRawConfigCMD.h"
 #include "commands/Admin/SaveRawConfigCMD.h"
 #include "commands/Admin/ReloadCMD.h"
+#include "commands/Admin/DeviceControlCMD.h"
 
 
 class M8MWebServingApp : public M8MMinerTrackingApp,
@@ -40,13 +41,24 @@ public:
     }
     bool Reboot() const { return reloadRequested != std::chrono::system_clock::time_point(); }
 
-    void FillSleepLists(std::vector<Network::SocketInterface*> &toRead, std::vector<Network::SocketInterface*> &toWrite) {
-        M8MMinerTrackingApp::FillSleepLists(toRead, toWrite);
-        if(monitor.server) monitor.server->FillSleepLists(toRead, toWrite);
-        if(admin.server) admin.server->FillSleepLists(toRead, toWrite);
+    /*! The reload command used to restart everything, now it only asks main to apply the configuration file again, see
+    M8MMiningApp::Reconfigure. True once for each request. */
+    bool TakeReloadRequest() {
+        const bool ret = reloadPending;
+        reloadPending = false;
+        return ret;
+    }
+
+    //! The old way: close the web servers and have main build the application again. For when Reconfigure can't make it.
+    void RequestReboot() { reloadRequested = std::chrono::system_clock::now(); }
+
+    void UpdateInterest() {
+        M8MMinerTrackingApp::UpdateInterest();
+        if(monitor.server) monitor.server->UpdateInterest();
+        if(admin.server) admin.server->UpdateInterest();
 	}
 
-    void Refresh(std::vector<Network::SocketInterface*> &toRead, std::vector<Network::SocketInterface*> &toWrite);
+    void Refresh();
 
     bool KeepRunning() const {
         using namespace std::chrono;
@@ -58,6 +70,7 @@ public:
 
 private:
     std::chrono::system_clock::time_point reloadRequested; //!< leave it a couple of seconds to dispatch quit message
+    bool reloadPending = false; //!< see TakeReloadRequest
     std::map<std::string, commands::ExtensionState> extensions; //!< nothing really defined for the time being
 
     struct Service {
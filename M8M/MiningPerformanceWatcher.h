@@ -3,9 +3,14 @@
  * For conditions of distribution and use, see the LICENSE or hit the web.
  */
 #pragma once
+#include "../Common/AREN/ArenDataTypes.h"
 #include <chrono>
 #include <vector>
-#include <mutex>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <algorithm>
 
 class MiningPerformanceWatcherInterface {
 public:
@@ -14,6 +19,9 @@ public:
 
     virtual size_t GetNumDevices() const = 0;
 
+    //! Averages can be taken over more than a single time window, up to this many.
+    static const size_t MAX_WINDOWS = 4;
+
 	struct DevStats {
         //! Main type of performance monitoring involves taking averages across GetAverageWindow() seconds.
 		std::chrono::microseconds avg;
@@ -24,112 +32,171 @@ public:
 
         //! Max and Min iteration time are also tracked. Implementations can start tracking those after reaching performance stability.
 		std::chrono::microseconds min, max;
+
+        //! Average for each of GetAverageWindows(), [0] is the same as avg. Unused windows are 0.
+        std::array<std::chrono::microseconds, MAX_WINDOWS> windows;
 	};
 
     //! The watcher collects performance samples over this amount of seconds and then produces an average.
     virtual std::chrono::seconds GetAverageWindow() const = 0;
 
+    //! All the windows averages are taken over, the first is GetAverageWindow().
+    virtual std::vector<std::chrono::seconds> GetAverageWindows() const = 0;
+
     //! Returns false if device >= GetNumDevices or if performance cannot be yet inspected.
     virtual bool GetPerformance(DevStats &out, size_t device) const = 0;
 };
 
 
+/*! Each mining thread calls Completed for its own device at every scan while the main thread reads the results for every monitor client
+at every push. Performance monitoring should not slow down what it monitors so there are no locks here.
+Each device is written by a single thread, the one mining on it: everything needed to compute the values is private to that thread,
+only the results are published. Readers get a consistent copy through a sequence lock: the writer makes the sequence odd, stores the values
+and makes it even again; readers copy the values and try again if the sequence was odd or changed meanwhile. Readers never write anything
+so no matter how many monitor clients are connected, the mining threads don't see them.
+Devices are padded to their own cache lines so they don't bother each other either. */
 class MiningPerformanceWatcher : public MiningPerformanceWatcherInterface {
-    std::vector<DevStats> stats;
-
-    struct Info {
-        std::chrono::system_clock::time_point start;
-        size_t iterations = 0; //!< to compute average iteration time across the time window
-        bool used = false, sleeping = false;
-    };
-    std::vector<Info> info;
-
 public:
-    std::chrono::seconds averageWindow;
+    //! Windows must be set before the mining threads start, with SetNumDevices. Values after the first MAX_WINDOWS are ignored.
+    explicit MiningPerformanceWatcher(std::chrono::seconds twindow = std::chrono::seconds(5)) : numDevices(0) { averageWindows.push_back(twindow); }
 
-    explicit MiningPerformanceWatcher(std::chrono::seconds twindow = std::chrono::seconds(5)) : averageWindow(twindow) { }
+    void SetAverageWindows(const std::vector<std::chrono::seconds> &twindows) {
+        if(twindows.empty()) return;
+        averageWindows.assign(twindows.cbegin(), twindows.cbegin() + std::min(twindows.size(), size_t(MAX_WINDOWS)));
+    }
 
+    //! Not thread safe, call this before the mining threads start. Reallocates only if count changes.
     void SetNumDevices(size_t count) {
-        stats.resize(count);
-        info.resize(count);
+        if(count == numDevices) return;
+        devices.reset(count? new Device[count] : nullptr);
+        numDevices = count;
     }
+
     // It is assumed an iteration always takes > 0 microseconds to complete.
     // Passing elapsed = 0 means 'device is being disabled'
+    // Only the thread mining on devIndex can call this.
     void Completed(size_t devIndex, bool found, std::chrono::microseconds elapsed) {
         using namespace std::chrono;
-        auto &dev(stats[devIndex]);
-        auto &collect(info[devIndex]);
+        if(devIndex >= numDevices) return;
+        auto &dev(devices[devIndex]);
+        auto &stats(dev.building);
         const std::chrono::microseconds zero(0);
-        bool wasActive = collect.used && collect.sleeping == false;
-        collect.used = true;
+        bool wasActive = dev.used && dev.sleeping == false;
+        dev.used = true;
         if(elapsed == zero) {
-            collect = Info();
-            collect.used = true;
-            collect.sleeping = true;
-            dev.last = zero;
-            dev.avg = zero;
+            for(auto &el : dev.window) el = Device::Window();
+            dev.sleeping = true;
+            stats.last = zero;
+            stats.avg = zero;
+            for(auto &el : stats.windows) el = zero;
+            Publish(dev);
             return;
         }
-        else collect.sleeping = false;
-
-        auto now(system_clock::now());
-        if(collect.start == system_clock::time_point()) collect.start = now;
-        collect.iterations++;
+        else dev.sleeping = false;
 
         // Computing min and max takes some care. I update those only after a first nonce has been found as the first few iterations
         // are usually a bit unstable.
         if(wasActive) {
-            if(dev.min == zero) dev.min = elapsed; // the assumption here is that everything will take at least 1 us.
-            else if(elapsed < dev.min) dev.min = elapsed;
-            if(dev.max == zero) dev.max = elapsed;
-            else if(elapsed > dev.max) dev.max = elapsed;
+            if(stats.min == zero) stats.min = elapsed; // the assumption here is that everything will take at least 1 us.
+            else if(elapsed < stats.min) stats.min = elapsed;
+            if(stats.max == zero) stats.max = elapsed;
+            else if(elapsed > stats.max) stats.max = elapsed;
         }
 
-        if(found) dev.last = elapsed;
-
-        microseconds total = duration_cast<microseconds>(now - collect.start);
-        if(total >= duration_cast<microseconds>(averageWindow)) {
-            dev.avg = duration_cast<microseconds>(total / double(collect.iterations));
-            collect.start = system_clock::time_point();
-            collect.iterations = 0;
+        if(found) stats.last = elapsed;
+
+        const auto now(steady_clock::now());
+        for(size_t loop = 0; loop < averageWindows.size(); loop++) {
+            auto &collect(dev.window[loop]);
+            if(collect.start == steady_clock::time_point()) collect.start = now;
+            collect.iterations++;
+            microseconds total = duration_cast<microseconds>(now - collect.start);
+            if(total >= duration_cast<microseconds>(averageWindows[loop])) {
+                stats.windows[loop] = duration_cast<microseconds>(total / double(collect.iterations));
+                collect = Device::Window();
+            }
         }
+        stats.avg = stats.windows[0];
+        Publish(dev);
     }
 
     // base class
-    size_t GetNumDevices() const { return stats.size(); }
+    size_t GetNumDevices() const { return numDevices; }
     bool GetPerformance(DevStats &out, size_t dev) const {
-        if(dev < stats.size()) {
-            if(info[dev].used == false) return false;
-            out = stats[dev];
+        if(dev >= numDevices) return false;
+        const auto &src(devices[dev]);
+        Value copy[v_count];
+        while(true) {
+            const auint before = src.sequence.load(std::memory_order_acquire);
+            if(before & 1) { // writer in progress, it's a few stores so it will be done soon
+                std::this_thread::yield();
+                continue;
+            }
+            for(size_t cp = 0; cp < v_count; cp++) copy[cp] = src.published[cp].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if(src.sequence.load(std::memory_order_relaxed) == before) break;
         }
-        return dev < stats.size();
+        if(copy[v_used] == 0) return false;
+        out.avg = microseconds(copy[v_avg]);
+        out.last = microseconds(copy[v_last]);
+        out.min = microseconds(copy[v_min]);
+        out.max = microseconds(copy[v_max]);
+        for(size_t loop = 0; loop < MAX_WINDOWS; loop++) out.windows[loop] = microseconds(copy[v_windows + loop]);
+        return true;
     }
-    std::chrono::seconds GetAverageWindow() const { return averageWindow; }
-};
+    std::chrono::seconds GetAverageWindow() const { return averageWindows[0]; }
+    std::vector<std::chrono::seconds> GetAverageWindows() const { return averageWindows; }
+
+private:
+    typedef std::chrono::microseconds::rep Value;
+    enum PublishedValue {
+        v_used,
+        v_avg,
+        v_last,
+        v_min,
+        v_max,
+        v_windows,
+        v_count = v_windows + MAX_WINDOWS
+    };
 
+    struct Device {
+        // Owned by the mining thread.
+        struct Window {
+            std::chrono::steady_clock::time_point start;
+            size_t iterations = 0; //!< to compute average iteration time across the time window
+        };
+        std::array<Window, MAX_WINDOWS> window;
+        bool used = false, sleeping = false;
+        DevStats building;
 
- class SyncMiningPerformanceWatcher : public MiningPerformanceWatcher {
-    mutable std::mutex lock;
-    typedef MiningPerformanceWatcher base;
-public:
-    void SetNumDevices(asizei count) {
-        std::unique_lock<std::mutex> sync(lock);
-        base::SetNumDevices(count);
-    }
-    void Completed(size_t devIndex, bool found, std::chrono::microseconds elapsed) {
-        std::unique_lock<std::mutex> sync(lock);
-        base::Completed(devIndex, found, elapsed);
-    }
-    size_t GetNumDevices() const {
-        std::unique_lock<std::mutex> sync(lock);
-        return base::GetNumDevices();
-    }
-    bool GetPerformance(DevStats &out, size_t dev) const {
-        std::unique_lock<std::mutex> sync(lock);
-        return base::GetPerformance(out, dev);
-    }
-    std::chrono::seconds GetAverageWindow() const {
-        std::unique_lock<std::mutex> sync(lock);
-        return base::GetAverageWindow();
+        // Published for everybody else.
+        std::atomic<auint> sequence;
+        std::array<std::atomic<Value>, v_count> published;
+
+        std::array<aubyte, 64> padding; //!< so the next device doesn't share the cache line with my sequence and values
+
+        Device() : sequence(0) {
+            const std::chrono::microseconds zero(0);
+            building.avg = building.last = building.min = building.max = zero;
+            for(auto &el : building.windows) el = zero;
+            for(auto &el : published) el.store(0, std::memory_order_relaxed);
+        }
+    };
+    std::unique_ptr<Device[]> devices;
+    size_t numDevices;
+    std::vector<std::chrono::seconds> averageWindows;
+
+    static void Publish(Device &dev) {
+        const auint seq = dev.sequence.load(std::memory_order_relaxed);
+        dev.sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        const DevStats &src(dev.building);
+        dev.published[v_used].store(dev.used? 1 : 0, std::memory_order_relaxed);
+        dev.published[v_avg].store(src.avg.count(), std::memory_order_relaxed);
+        dev.published[v_last].store(src.last.count(), std::memory_order_relaxed);
+        dev.published[v_min].store(src.min.count(), std::memory_order_relaxed);
+        dev.published[v_max].store(src.max.count(), std::memory_order_relaxed);
+        for(size_t loop = 0; loop < MAX_WINDOWS; loop++) dev.published[v_windows + loop].store(src.windows[loop].count(), std::memory_order_relaxed);
+        dev.sequence.store(seq + 2, std::memory_order_release);
     }
 };
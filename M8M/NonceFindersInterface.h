@@ -6,6 +6,7 @@
 #include "../Common/AbstractWorkSource.h"
 #include "NonceStructs.h"
 #include "../Common/Stratum/Work.h"
+#include "../Common/LatencyHistogram.h"
 #include <chrono>
 
 
@@ -31,6 +32,11 @@ public:
     The miner thread will get full ownership of the factory, consider it gone forever. */
     virtual bool SetWorkFactory(const AbstractWorkSource &from, std::unique_ptr<stratum::AbstractWorkFactory> &factory) = 0;
 
+    /*! A degraded pool still produces work but it is late at announcing new blocks or it is rejecting too much.
+    Its work is only used if no healthy pool has any. The pools are all kept connected so switching is immediate.
+    \return false if owner is not being mangled by this set of devices. */
+    virtual bool SetDegraded(const AbstractWorkSource &from, bool degraded) = 0;
+
     /*! Call this whatever possible to pull out a set of results if found. Those results are guaranteed to be valid and checked to be over provided
     difficulty target however, the generating block might have become stale. Objects implementing this interface should not be concerned about
     filtering stale work, this concern belongs to someone else. Results can accumulate over time which means in theory this shall be called in a loop.
@@ -40,6 +46,16 @@ public:
         > 0 on returning true. If this does not hold, just return false and update nothing. */
     virtual bool ResultsFound(NonceOriginIdentifier &src, VerifiedNonces &nonces) = 0;
 
+    /*! Results wait in a queue until ResultsFound pulls them out. Those tell if the consumer keeps up. They are updated by ResultsFound
+    so they're meant to be read by the same thread calling it. */
+    struct ResultQueueStats {
+        asizei depth = 0; //!< results waiting right now, approximate
+        asizei peakDepth = 0; //!< most results ever found waiting by ResultsFound
+        aulong pulled = 0; //!< total number of results ResultsFound returned
+        LatencyHistogram age; //!< milliseconds each result waited in the queue
+    };
+    virtual ResultQueueStats GetResultQueueStats() const = 0;
+
 
     enum Status {
         s_created,
@@ -65,4 +81,12 @@ public:
     /*! Even if threads are running (not failed) they could still have issues. Monitoring the time of last work generation seems to be a fairly
     accurate way of probing their state. Shall the thread have any issue, they will go late with this one. */
     virtual std::chrono::system_clock::time_point GetLastWUGenTime(asizei queue) const = 0;
+
+    /*! A queue which is s_running but does not complete a scan for much longer than the device usually takes is most likely stuck in the driver.
+    \returns when the queue last completed a scan or started waiting for one. Zero if the queue is not to be watched this way. */
+    virtual std::chrono::steady_clock::time_point GetLastScanTime(asizei queue) const = 0;
+
+    /*! Replaces the queue with a new one on the same device, built from scratch. The old one is abandoned, other queues are not touched.
+    Main thread only. */
+    virtual void RecoverQueue(asizei queue) = 0;
 };
@@ -8,6 +8,7 @@
 #include <string>
 #include <vector>
 #include <array>
+#include <chrono>
 
 /*! This structure uniquely identify the source of a header so results can be passed back to the right source.
 The source itself is identified by a void* to avoid dependancy on the specific structure, which is bad anyway as
@@ -54,6 +55,7 @@ struct VerifiedNonces {
     std::vector<Nonce> nonces;
     asizei device; //!< device which produced the nonces for running statistics
     adouble targetDiff; //!< target diff used for the scan which produced this set of nonces.
-    VerifiedNonces() : discarded(0), wrong(0) { }
+    std::chrono::microseconds verification; //!< CPU time it took to check those, hashing is not cheap for some algos
+    VerifiedNonces() : discarded(0), wrong(0), verification(0) { }
     asizei Total() const { return discarded + wrong + nonces.size(); }
 };
@@ -0,0 +1,71 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+#include "../Common/AREN/ArenDataTypes.h"
+#include <array>
+#include <chrono>
+#include <vector>
+
+
+/*! All the pools for the current algorithm are connected so the backups are subscribed and getting jobs all the time.
+Switching to them is instant when a pool goes down but a pool can also be up and still be bad for us. This is how M8MPoolConnectingApp
+figures out, tracked for each connection and reset when it goes down. The miners then prefer the pools which are good, see HotStandby.
+It's out of the app so failover can be tested without one.
+
+Notify lag is measured only when a pool announces a block some other pool announced before so pools mining different things don't
+affect each other. The app keeps track of the announces, this only gets the lag. */
+struct PoolHealth {
+    double notifyLag = .0; //!< milliseconds, moving average
+    double rejectRate = .0; //!< moving average of rejected shares, 0..1
+    std::chrono::steady_clock::time_point lastNotify; //!< 0 until the first job comes in
+    std::array<aubyte, 32> block; //!< previous block hash of the last job, meaningful only after first job
+    bool degraded = false;
+
+    //! The limits after which a pool is considered degraded. It gets back in service when it goes below half of them.
+    struct Limits {
+        std::chrono::milliseconds maxNotifyLag = std::chrono::milliseconds(1500); //!< average delay in telling us about new blocks compared to the first pool telling
+        double maxRejectRate = .1; //!< moving average, about 4 rejects in a row
+        std::chrono::seconds maxNotifySilence = std::chrono::seconds(180); //!< pools send new jobs every minute or so
+    };
+
+    //! The pool told us about a new block \p lag milliseconds after the first pool telling, 0 if it was the first.
+    void Announced(double lag) { notifyLag = notifyLag * .75 + lag * .25; }
+
+    //! A share got a reply. Stale shares and the like don't count, only accepted or rejected.
+    void Replied(bool rejected) {
+        const double weight = 1.0 / 32.0;
+        rejectRate = rejectRate * (1.0 - weight) + (rejected? weight : .0);
+    }
+
+    /*! Called every tick while the pool is connected. Pools which never sent a job have nothing to decide.
+    \returns true if degraded changed. */
+    bool Update(std::chrono::steady_clock::time_point now, const Limits &limits) {
+        if(lastNotify == std::chrono::steady_clock::time_point()) return false;
+        const double tolerance = degraded? .5 : 1.0; // hysteresis, so we don't flip back and forth
+        const bool silent = now - lastNotify > limits.maxNotifySilence;
+        const bool late = notifyLag > limits.maxNotifyLag.count() * tolerance;
+        const bool rejecting = rejectRate > limits.maxRejectRate * tolerance;
+        const bool bad = silent || late || rejecting;
+        if(bad == degraded) return false;
+        degraded = bad;
+        return true;
+    }
+};
+
+
+/*! How ThreadedNonceFinders::HotStandbyPool picks the pool to mine: the first having work and not degraded, in configuration order.
+If all are degraded the first having work is still better than nothing.
+Pool is AbstractNonceFindersBuild::CurrentWork, anything having factory and degraded will do.
+\returns nullptr if no pool has work. */
+template<typename Pool>
+const Pool* HotStandby(const std::vector<Pool> &pools) {
+    const Pool *fallback = nullptr;
+    for(auto &pool : pools) {
+        if(!pool.factory) continue;
+        if(!pool.degraded) return &pool;
+        if(!fallback) fallback = &pool;
+    }
+    return fallback;
+}
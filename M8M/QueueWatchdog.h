@@ -0,0 +1,67 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+#include "../Common/AREN/ArenDataTypes.h"
+#include <algorithm>
+#include <chrono>
+#include <tuple>
+#include <vector>
+
+
+/*! Devices stuck in the driver, see M8MMiningApp::WatchQueues. Config file has it as
+"watchdog": { "scanTimes": 8, "minimum": 10, "firstScan": 120, "recoveries": 3 }
+or false to turn it off. Every key is optional, times are in seconds. */
+struct WatchdogSettings {
+    bool enabled = true;
+    auint scanTimes = 8; //!< a device not completing a scan in this many times its expected scan time is stalled
+    std::chrono::seconds minimum = std::chrono::seconds(10); //!< but never before this, fast devices have jittery scan times
+    std::chrono::seconds firstScan = std::chrono::seconds(120); //!< used until the expected scan time is known
+    auint recoveries = 3; //!< per device. Each recovery leaks a thread stuck in the driver, after this many the device is left failed.
+};
+
+
+//! A queue found stalled by WatchQueues.
+struct QueueStall {
+    asizei queue, device;
+    std::chrono::milliseconds late; //!< since its last scan
+    std::chrono::microseconds expected; //!< scan time, 0 if not known yet
+    bool givingUp; //!< recovered too many times already, it's left alone from now on. Told once.
+};
+
+
+/*! The watchdog. A device stuck in the driver still looks s_running: its thread is there, only it does not come back.
+Each queue's last completed scan is compared with the device's expected scan time and queues late enough are rebuilt,
+see NonceFindersInterface::RecoverQueue. It's out of M8MMiningApp so it can be driven with stub miners.
+Finders is an AbstractNonceFindersBuild, or anything having GetNumWorkQueues, GetTerminationReason, GetLastScanTime and RecoverQueue.
+\param recovered how many times each queue has been recovered, resized to the number of queues and updated.
+\param expectedScan called with the device linear index, returns its expected scan time or 0 if not known yet.
+\param report called for each queue recovered and, once, for those given up on. */
+template<typename Finders, typename ExpectedScan, typename Report>
+void WatchQueues(Finders &miner, std::vector<auint> &recovered, const WatchdogSettings &settings, std::chrono::steady_clock::time_point now,
+                 ExpectedScan &&expectedScan, Report &&report) {
+    using namespace std::chrono;
+    const asizei count = miner.GetNumWorkQueues()[1];
+    recovered.resize(count);
+    for(asizei loop = 0; loop < count; loop++) {
+        const auto stat(miner.GetTerminationReason(loop));
+        if(std::get<1>(stat) != Finders::s_running) continue; // initializing, sleeping or failed already: nothing to watch
+        const auto lastScan(miner.GetLastScanTime(loop));
+        if(lastScan == steady_clock::time_point()) continue; // isolated or retuning
+        const microseconds expected(expectedScan(std::get<0>(stat)));
+        const microseconds deadline(expected.count()? std::max(microseconds(settings.minimum), expected * settings.scanTimes) : microseconds(settings.firstScan));
+        if(now < lastScan + deadline) continue;
+        const QueueStall stall { loop, std::get<0>(stat), duration_cast<milliseconds>(now - lastScan), expected, recovered[loop] >= settings.recoveries };
+        if(stall.givingUp) { // it's still there, stuck, looking like it's running. Tell once.
+            if(recovered[loop] == settings.recoveries) {
+                report(stall);
+                recovered[loop]++;
+            }
+            continue;
+        }
+        report(stall);
+        recovered[loop]++;
+        miner.RecoverQueue(loop);
+    }
+}
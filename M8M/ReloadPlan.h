@@ -0,0 +1,124 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+#include "../Common/PoolInfo.h"
+#include <rapidjson/document.h>
+#include <vector>
+#include <string>
+
+
+/*! A configuration reload rebuilds only what changed. Contexts, programs, buffers, pool connections and web servers take long enough to
+build to lose quite some hashing, most of the time for a single value changed, so here I figure out what can stay as it is.
+This is only deciding, see M8MMiningApp::Reconfigure for the doing. */
+namespace reload {
+
+
+//! Same connection, same credentials, same everything. If anything changes the pool is built again, it's cheap anyway.
+inline bool SamePool(const PoolInfo &one, const PoolInfo &two) {
+    return one.name == two.name && one.algo == two.algo &&
+           one.appLevelProtocol == two.appLevelProtocol && one.service == two.service && one.host == two.host && one.explicitPort == two.explicitPort &&
+           one.user == two.user && one.pass == two.pass &&
+           one.diffMul.stratum == two.diffMul.stratum && one.diffMul.one == two.diffMul.one && one.diffMul.share == two.diffMul.share &&
+           one.diffMode == two.diffMode && one.merkleMode == two.merkleMode &&
+           one.targetSharesPerMinute == two.targetSharesPerMinute;
+}
+
+
+struct PoolPlan {
+    std::vector<asizei> reuse; //!< for each new pool, index of the old pool to keep as is, or asizei(-1) to build a new one
+    std::vector<asizei> dropped; //!< indices of old pools to shut down, including those changed
+};
+
+//! Names are unique in a valid configuration so they identify pools across reloads. Order can change, it's the priority.
+inline PoolPlan PlanPools(const std::vector<const PoolInfo*> &was, const std::vector<const PoolInfo*> &now) {
+    PoolPlan ret;
+    std::vector<bool> kept(was.size());
+    for(const auto fresh : now) {
+        asizei match = 0;
+        while(match < was.size() && (kept[match] || was[match]->name != fresh->name)) match++;
+        if(match < was.size() && SamePool(*was[match], *fresh)) {
+            kept[match] = true;
+            ret.reuse.push_back(match);
+        }
+        else ret.reuse.push_back(asizei(-1));
+    }
+    for(asizei loop = 0; loop < was.size(); loop++) {
+        if(!kept[loop]) ret.dropped.push_back(loop);
+    }
+    return ret;
+}
+
+
+enum DeviceChange {
+    dc_idle, //!< not used before, not used now
+    dc_keep, //!< same settings, the mining thread keeps going with its context, programs and buffers
+    dc_rebuild, //!< settings changed, the mining thread is replaced
+    dc_start, //!< was not used
+    dc_stop //!< not to be used anymore
+};
+
+/*! \param was settings the device was mining with, nullptr if it wasn't
+\param now settings it has been assigned now, nullptr if none.
+Settings are compared by value, so it's fine for them to come from different documents and for their order in the config to change. */
+inline DeviceChange PlanDevice(const rapidjson::Value *was, const rapidjson::Value *now) {
+    if(!was && !now) return dc_idle;
+    if(!was) return dc_start;
+    if(!now) return dc_stop;
+    return *was == *now? dc_keep : dc_rebuild;
+}
+
+
+/*! Some changes are too big to go device by device: this tells why the whole miner must be built again, empty if it doesn't.
+Groups are in algorithm order and order decides which devices go where, so a different order is a different miner. */
+inline std::string RebuildEverything(bool mining, const std::vector<std::string> &was, const std::vector<std::string> &now, bool samePlacement, bool sameIsolation) {
+    if(!mining) return "nothing was mining";
+    bool sameAlgos = was.size() == now.size();
+    for(asizei loop = 0; sameAlgos && loop < was.size(); loop++) sameAlgos = _stricmp(was[loop].c_str(), now[loop].c_str()) == 0;
+    if(!sameAlgos) {
+        std::string ret("algorithms changed to");
+        for(const auto &algo : now) ret += ' ' + algo;
+        return ret;
+    }
+    if(!samePlacement) return "threadPlacement changed";
+    if(!sameIsolation) return "isolateDevices changed";
+    return std::string();
+}
+
+
+/*! What M8MMiningApp::Redeploy does to each device once settings have been assigned again. Device has .group and .queue, asizei(-1)
+if it has none. Queues are by group: once created they stay there even if stopped, a device moving to another group gets a new one.
+Backend does the real work:
+    void StopQueue(Device &dev); // dev.group and dev.queue are those to stop
+    std::string GenQueue(Device &dev, const rapidjson::Value &settings); // in dev.group, a new queue if dev.queue is asizei(-1), else the thread
+                                                                           // there is replaced; returns something to add to the report
+    const std::string& GetAlgo(asizei group);
+\param group the device gets its settings from, asizei(-1) if it got none.
+eturns what happened, for the report. Empty if nothing did. */
+template<typename Backend, typename Device>
+std::string Redeploy(Backend &backend, Device &dev, const std::string &name, const rapidjson::Value *was, const rapidjson::Value *now, asizei group) {
+    auto plan(PlanDevice(was, now));
+    if(plan == dc_keep && group != dev.group) plan = dc_rebuild; // same settings, for another algorithm
+    switch(plan) {
+    case dc_idle: return std::string();
+    case dc_keep: return name + " kept";
+    case dc_stop:
+        if(dev.queue != asizei(-1)) backend.StopQueue(dev);
+        return name + " stopped";
+    default: break;
+    }
+    std::string moved;
+    if(dev.queue != asizei(-1) && dev.group != group) {
+        backend.StopQueue(dev);
+        dev.queue = asizei(-1);
+        moved = ", now mining " + backend.GetAlgo(group);
+    }
+    const bool fresh = dev.queue == asizei(-1);
+    dev.group = group;
+    const std::string remark(backend.GenQueue(dev, *now));
+    return name + (fresh? " started" : " rebuilt") + remark + moved;
+}
+
+
+}
@@ -0,0 +1,92 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+#include "../Common/AREN/ArenDataTypes.h"
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+
+/*! When a connection goes down, shares the server never got go here. They are sent again if the server resumes our session and
+their job is still valid, otherwise they're dropped. The server never got them if they were found while the connection was down or
+they were still queued when it went.
+
+Shares which were written instead are another story: the server might have them, we just don't know as the reply didn't come.
+Sending those again gets them rejected as duplicates if it had them, and a burst of rejects right after reconnecting looks
+like a pool going bad to the reject rate. So they are only counted: nobody is going to tell us what happened to them.
+
+Share is M8MPoolConnectingApp::ShareFeedbackData, all that's needed is a found time point. It's a template so it can be tested without a pool. */
+template<typename Share>
+struct ShareJournal {
+    struct Entry {
+        Share share;
+        bool counted; //!< queued on the connection which went down so it has been given to AddSent already
+    };
+    std::vector<Entry> shares; //!< oldest first
+    bool open = false; //!< from the connection going down to the journal being replayed or dropped
+    std::chrono::steady_clock::time_point since; //!< when it was opened
+    asizei evicted = 0; //!< dropped because it was full or they got too old
+    asizei unanswered = 0; //!< written on the connection which went down, not sent again
+
+    //! Evicts the oldest if full.
+    void Add(const Share &share, bool counted, asizei capacity) {
+        if(shares.size() >= capacity) {
+            shares.erase(shares.begin());
+            evicted++;
+        }
+        shares.push_back(Entry{ share, counted });
+    }
+
+    //! A share waiting for a reply when the connection went down. \param written see AbstractWorkSource::Written.
+    void Unanswered(const Share &share, bool written, asizei capacity) {
+        if(written) unanswered++;
+        else Add(share, true, capacity);
+    }
+
+    /*! Call after the shares of the connection which went down have been given to Unanswered.
+    Those come by share index, which is not necessarily the order they were found: block shares skip the queue.
+    \param from number of shares in the journal before the first of those. */
+    void Open(asizei from, std::chrono::steady_clock::time_point now) {
+        std::stable_sort(shares.begin() + from, shares.end(), [](const Entry &a, const Entry &b) { return a.share.found < b.share.found; });
+        if(open) return;
+        open = true;
+        since = now;
+    }
+
+    //! Drops the shares found more than maxAge ago.
+    void Expire(std::chrono::steady_clock::time_point now, std::chrono::steady_clock::duration maxAge) {
+        auto old = [now, maxAge](const Entry &test) { return now - test.share.found > maxAge; };
+        const asizei prev = shares.size();
+        shares.erase(std::remove_if(shares.begin(), shares.end(), old), shares.end());
+        evicted += prev - shares.size();
+    }
+
+    struct Outcome {
+        asizei replayed = 0;
+        asizei fresh = 0; //!< replayed and not counted before, those go to AddSent
+        asizei dropped = 0; //!< the job wasn't valid anymore, the session wasn't resumed, the journal was full or too old
+        asizei unanswered = 0;
+    };
+
+    /*! Gives each share to send(const Share&), which returns false if it cannot go (job not valid anymore) and closes the journal.
+    Shares are replayed oldest first. */
+    template<typename SendFunc>
+    Outcome Replay(SendFunc send) {
+        Outcome ret;
+        for(const auto &el : shares) {
+            if(!send(el.share)) continue;
+            ret.replayed++;
+            if(!el.counted) ret.fresh++;
+        }
+        ret.dropped = shares.size() - ret.replayed + evicted;
+        ret.unanswered = unanswered;
+        shares.clear();
+        open = false;
+        evicted = unanswered = 0;
+        return ret;
+    }
+
+    Outcome Drop() { return Replay([](const Share&) { return false; }); }
+};
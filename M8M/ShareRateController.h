@@ -0,0 +1,78 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+#include "../Common/AREN/ArenDataTypes.h"
+#include <chrono>
+#include <deque>
+
+
+/*! Pools pick a difficulty for us and on fast algorithms it's often so low we find hundreds of shares per minute: every one of them
+has to be verified on the CPU, sent and replied to, for no benefit at all as pools pay by difficulty anyway.
+This figures out which difficulty would give a certain number of shares per minute.
+
+How fast we're going is measured from the shares themselves: the sum of the difficulty of the shares found in a time window is proportional
+to the hashrate and it's already expressed in difficulty units, so there's no need to know how many hashes a difficulty 1 share takes for each algorithm.
+Difficulties here are the "canonical" ones used by miners (stratum difficulty times PoolInfo::DiffMultipliers::stratum), the conversion
+to what the pool wants is done when suggesting. */
+class ShareRateController {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    std::chrono::seconds window = std::chrono::minutes(5); //!< shares older than this are forgotten
+    std::chrono::seconds warmup = std::chrono::seconds(60); //!< measuring for less than this is just noise
+    asizei minShares = 4; //!< neither suggest anything if we have less than this in the window
+    std::chrono::seconds minInterval = std::chrono::seconds(60); //!< between two suggestions to the same pool
+    double hysteresis = 1.5; //!< nothing is suggested unless the ideal difficulty is off by this factor, in either direction
+
+    //! Each pool has a different target and is suggested different things. This is only changed by Suggest.
+    struct Pool {
+        double suggested = .0; //!< stratum difficulty, 0 if nothing suggested yet
+        Clock::time_point when;
+    };
+
+    void Found(double diff, Clock::time_point when) {
+        if(first == Clock::time_point()) first = when;
+        found.push_back(std::make_pair(when, diff));
+        sum += diff;
+        Trim(when);
+    }
+
+    //! Difficulty found per second over the window, 0 if not enough data yet.
+    double GetDiffRate(Clock::time_point now) {
+        Trim(now);
+        if(first == Clock::time_point() || now - first < warmup || found.size() < minShares) return .0;
+        const auto span(std::min(std::chrono::duration_cast<Clock::duration>(window), now - first));
+        return sum / std::chrono::duration_cast<std::chrono::duration<double>>(span).count();
+    }
+
+    /*! \param stratumMul PoolInfo::DiffMultipliers::stratum of the pool, to convert back to its units.
+    \param current stratum difficulty the pool is currently giving us.
+    \returns stratum difficulty to suggest or 0 if there's nothing to do. */
+    double Suggest(Pool &pool, double targetPerMinute, double stratumMul, double current, Clock::time_point now) {
+        if(targetPerMinute <= .0 || stratumMul <= .0 || current <= .0) return .0;
+        if(pool.when != Clock::time_point() && now - pool.when < minInterval) return .0;
+        const double rate = GetDiffRate(now);
+        if(rate <= .0) return .0;
+        const double ideal = rate * 60.0 / targetPerMinute / stratumMul;
+        const double reference = pool.suggested > .0? pool.suggested : current;
+        if(ideal < reference * hysteresis && ideal * hysteresis > reference) return .0;
+        pool.suggested = ideal;
+        pool.when = now;
+        return ideal;
+    }
+
+private:
+    std::deque<std::pair<Clock::time_point, double>> found;
+    double sum = .0;
+    Clock::time_point first; //!< first share ever, until the window is full the rate is measured from there
+
+    void Trim(Clock::time_point now) {
+        while(found.size() && now - found.front().first > window) {
+            sum -= found.front().second;
+            found.pop_front();
+        }
+        if(found.empty()) sum = .0; // don't let rounding accumulate
+    }
+};
@@ -121,6 +121,28 @@ public:
         // Do nothing. Stop-n-wait has only early bound buffers.
     }
 
+    /*! Live tuning, the algorithm is about to become bigger or produce longer hashes. Kernels don't check how big the nonce buffer is so
+    it must grow with them, it never shrinks. Call between scans: if a new buffer is created, $candidates refers to it from now on
+    but the algorithm kernels are still bound to the old one, which is returned. Release it after the algorithm is bound again.
+    \returns 0 if the current buffer is fine. */
+    cl_mem ReserveCandidates(asizei hashCount, asizei uintsPerHash) {
+        const asizei bytes = CandidateBytes(hashCount, uintsPerHash);
+        cl_mem ret = 0;
+        if(bytes > nonceBufferSize) {
+            cl_int error;
+            cl_mem bigger = clCreateBuffer(algo.context, CL_MEM_ALLOC_HOST_PTR, bytes, NULL, &error);
+            if(error) throw std::string("OpenCL error ") + std::to_string(error) + " while trying to resize resulting nonces buffer.";
+            ret = candidates;
+            candidates = bigger;
+            nonceBufferSize = bytes;
+            for(auto &el : specials) {
+                if(el.name == "$candidates") el.binding.resource.buff = candidates;
+            }
+        }
+        maxResults = (nonceBufferSize - 4) / (sizeof(cl_uint) * (1 + uintsPerHash));
+        return ret;
+    }
+
     //! So I have more private stuff.
     AbstractSpecialValuesProvider& AsValueProvider() { return *this; }
 
@@ -165,15 +187,19 @@ private:
         byteCount = 5 * sizeof(cl_uint);
         dispatchData = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, byteCount, NULL, &error);
         if(error != CL_SUCCESS) throw std::string("OpenCL error ") + std::to_string(error) + " while trying to create dispatchData buffer.";
+        nonceBufferSize = CandidateBytes(hashCount, algo.uintsPerHash);
+        maxResults = (nonceBufferSize - 4) / (sizeof(cl_uint) * (1 + algo.uintsPerHash));
+        candidates = clCreateBuffer(context, CL_MEM_ALLOC_HOST_PTR, nonceBufferSize, NULL, &error);
+        if(error) throw std::string("OpenCL error ") + std::to_string(error) + " while trying to resulting nonces buffer.";
+    }
+
+    static asizei CandidateBytes(asizei hashCount, asizei uintsPerHash) {
         // The candidate buffer should really be dependant on difficulty setting but I take it easy.
-        byteCount = hashCount / (16 * 1024);
+        asizei byteCount = hashCount / (16 * 1024);
         //! \todo pull the whole hash down so I can check mismatches
         if(byteCount < 32) byteCount = 32;
-        maxResults = byteCount;
-        byteCount *= sizeof(cl_uint) * (1 + algo.uintsPerHash);
+        byteCount *= sizeof(cl_uint) * (1 + uintsPerHash);
         byteCount += 4; // initial candidate count
-        nonceBufferSize = byteCount;
-        candidates = clCreateBuffer(context, CL_MEM_ALLOC_HOST_PTR, byteCount, NULL, &error);
-        if(error) throw std::string("OpenCL error ") + std::to_string(error) + " while trying to resulting nonces buffer.";
+        return byteCount;
     }
 };
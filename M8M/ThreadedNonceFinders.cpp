@@ -10,12 +10,28 @@ std::function<void(ThreadedNonceFinders::MiningThreadParams)> ThreadedNonceFinde
 #if defined REPLICATE_CLDEVICE_LINEARINDEX
         const auto devLinearIndex(meh.devLinearIndex);
 #endif
+        detached::Leaving gone(self.exited, exitedThreads); // every way out goes through this, it must be the first thing we build
         {
             std::unique_lock<std::mutex> lock(self.sync);
             self.lastUpdate = std::chrono::system_clock::now();
         }
+        // Placement goes first so everything allocated from now on, by us or by the driver on our behalf, comes from the right place.
+        // It's not worth failing over: if the OS says no, we just run wherever we would have run before.
+        if(build.affinity.size()) placement::SetCurrentThreadCPUs(build.affinity);
+        if(build.numaNode >= 0) placement::PreferNUMANode(build.numaNode);
         ThreadResources *heap = nullptr;
         try {
+            if(!build.ctx) { // recovering, see RecoverQueue
+                cl_platform_id platform;
+                if(clGetDeviceInfo(build.dev, CL_DEVICE_PLATFORM, sizeof(platform), &platform, NULL) != CL_SUCCESS) throw "Could not get device platform.";
+                cl_context_properties cprops[] = {
+                    CL_CONTEXT_PLATFORM, cl_context_properties(platform), 0
+                };
+                cl_int error;
+                self.ownContext = clCreateContext(cprops, 1, &build.dev, NULL, NULL, &error);
+                if(error != CL_SUCCESS) throw "Error creating context: " + std::to_string(error);
+                build.ctx = self.ownContext;
+            }
             // DataDrivenAlgorithm *algo = new DataDrivenAlgorithm(numHashes, ctx, cldev, algoname, implname, version, candHashUints);
             DataDrivenAlgorithm *algo = new DataDrivenAlgorithm(build.numHashes, build.ctx, build.dev, build.candHashUints);
 #if defined REPLICATE_CLDEVICE_LINEARINDEX
@@ -23,16 +39,31 @@ std::function<void(ThreadedNonceFinders::MiningThreadParams)> ThreadedNonceFinde
 #endif
             self.algo.reset(algo);
             algo->identifier = std::move(build.identifier);
-            self.dispatcher.reset(new StopWaitDispatcher(*self.algo));
             heap = new ThreadResources;
             self.heapResources.reset(heap);
             heap->sleepInterval = std::chrono::milliseconds(500 + index * 50);
-            heap->workValidationInterval = std::chrono::milliseconds(100 + index * 10);
-            auto err(algo->Init(self.dispatcher->AsValueProvider(), loader, build.res, build.kern));
-            if(err.size()) {
-                std::string conc;
-                for(auto &meh : err) conc += meh + '\n';
-                throw conc;
+            heap->loader = loader;
+#if defined REPLICATE_CLDEVICE_LINEARINDEX
+            heap->devLinear = auint(devLinearIndex);
+#else
+            heap->devLinear = linearDevice.find(build.dev)->second;
+#endif
+            if(build.verification.size()) {
+                heap->verification = std::move(build.verification);
+                heap->mining = placement::GetCurrentThreadCPUs();
+            }
+            if(build.workerProgram.size()) { // the algorithm object is still there but it's never initialized, the worker process does that
+                heap->supervisor.reset(new isolation::Supervisor(build.workerProgram, build.workerArgs, build.workerDevice));
+            }
+            else {
+                self.dispatcher.reset(new StopWaitDispatcher(*self.algo));
+                auto err(algo->Init(self.dispatcher->AsValueProvider(), loader, build.res, build.kern));
+                if(err.size()) {
+                    std::string conc;
+                    for(auto &meh : err) conc += meh + '\n';
+                    throw conc;
+                }
+                heap->channel = build.workerChannel;
             }
             build.res.clear();
             build.kern.clear();
@@ -42,11 +73,15 @@ std::function<void(ThreadedNonceFinders::MiningThreadParams)> ThreadedNonceFinde
         catch(std::string ohno)    { BadThings(self, s_initFailed, ohno.c_str()); }
         catch(...)                 { BadThings(self, s_initFailed, "Mining thread failed to initialize due to unknown exception."); }
         if(self.status != s_created) return;
+        self.lastScan.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_release);
         self.status = s_running;
+        if(heap->channel) heap->channel->state.store(isolation::ws_running, std::memory_order_release);
 
         try {
-            while(keepRunning) {
-                MiningPump(self, *heap);
+            while(!self.abandoned.load(std::memory_order_acquire) && keepRunning) { // abandoned first, we might be leaked by the DTOR
+                if(heap->supervisor) ProxyPump(self, *heap);
+                else if(heap->channel) WorkerPump(self, *heap);
+                else MiningPump(self, *heap);
                 std::unique_lock<std::mutex> lock(self.sync);
                 if(self.status == s_running) self.lastUpdate = std::chrono::system_clock::now();
             }
@@ -55,21 +90,92 @@ std::function<void(ThreadedNonceFinders::MiningThreadParams)> ThreadedNonceFinde
         catch(const char *ohno)    { BadThings(self, s_failed, ohno); }
         catch(std::string ohno)    { BadThings(self, s_failed, ohno.c_str()); }
         catch(...)                 { BadThings(self, s_failed, "Mining thread terminated due to unknown exception."); }
-        exitedThreads++; // not quite yet but what can possibly go wrong at this point? It's the best we can do.
     };
 }
 
 
 void ThreadedNonceFinders::MiningPump(Miner &self, ThreadResources &heap) {
+    if(!heap.algoStarted) { // scan boundary, the only time the algorithm can be changed
+        if(self.retunePending.load(std::memory_order_acquire)) Retune(self, heap);
+        if(Paused(self, heap)) return;
+    }
     bool newWork = false, newDiff = false;
+    if(SelectWork(self, heap, newWork, newDiff)) PumpDispatcher(self, heap, newWork, newDiff);
+}
+
+
+bool ThreadedNonceFinders::Paused(Miner &self, ThreadResources &heap) {
+    if(!self.paused.load(std::memory_order_acquire)) {
+        if(heap.paused) {
+            heap.paused = false;
+            TickStatus(self);
+        }
+        return false;
+    }
+    if(!heap.paused) {
+        heap.paused = true;
+        heap.myWork.reset(); // it will be stale by the time we're resumed, SelectWork gets something new
+        heap.remoteFed = false;
+        heap.iterations = 0; // as after starting, the first few scans after resuming are not meaningful
+        if(onIterationCompleted) onIterationCompleted(heap.devLinear, false, std::chrono::microseconds(0));
+        std::unique_lock<std::mutex> lock(self.sync);
+        self.status = s_sleeping;
+    }
+    std::unique_lock<std::mutex> lock(guard);
+    workChanged.wait_for(lock, heap.sleepInterval, [&self]() { return self.paused.load(std::memory_order_acquire) == false; });
+    lock.unlock();
+    self.lastScan.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_release); // as in SelectWork, a nap is not a scan
+    return true;
+}
+
+
+void ThreadedNonceFinders::Retune(Miner &self, ThreadResources &heap) {
+    std::unique_ptr<AlgoBuild> build;
+    std::unique_lock<std::mutex> lock(self.sync);
+    build = std::move(self.retune);
+    self.retunePending.store(false, std::memory_order_relaxed);
+    lock.unlock();
+    if(!build) return;
+    // Rebuilding might compile kernels, which is not a scan taking too long: the watchdog leaves us alone as it does while initializing.
+    self.lastScan.store(0, std::memory_order_release);
+    const auto started(placement::GetCurrentThreadCPUTime()); // CPU time, being preempted mid-hash is not the hash being slow
+    auto &algo(static_cast<DataDrivenAlgorithm&>(*self.algo));
+    auto &dispatcher(*self.dispatcher);
+    std::vector<std::string> errors;
+    try {
+        cl_mem replaced = dispatcher.ReserveCandidates(build->numHashes, build->candHashUints);
+        errors = algo.Rebuild(dispatcher.AsValueProvider(), heap.loader, build->numHashes, build->candHashUints, build->res, build->kern);
+        if(replaced) clReleaseMemObject(replaced); // the algorithm is bound to the new one, success or not
+    }
+    catch(std::exception ohno) { errors.push_back(ohno.what()); }
+    catch(const char *ohno)    { errors.push_back(ohno); }
+    catch(std::string ohno)    { errors.push_back(ohno); }
+    std::string outcome;
+    if(errors.empty()) {
+        algo.identifier = build->identifier;
+        heap.iterations = 0; // different numbers now, the scan time averages start again
+        if(onIterationCompleted) onIterationCompleted(heap.devLinear, false, std::chrono::microseconds(0));
+        const auto took(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started));
+        outcome = "applied in " + std::to_string(took.count()) + " ms";
+    }
+    else {
+        outcome = "failed, still running as before:";
+        for(const auto &el : errors) outcome += '\n' + el;
+    }
+    self.lastScan.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_release); // watched again from now
+    lock.lock();
+    self.retuneOutcome = std::move(outcome);
+    if(errors.empty()) self.retuned = std::move(build);
+}
+
+
+bool ThreadedNonceFinders::SelectWork(Miner &self, ThreadResources &heap, bool &newWork, bool &newDiff) {
     if(heap.myWork == nullptr) {
-        std::unique_lock<std::mutex> lock(guard);
-        auto use(psPolicy.Select(owners));
-        heap.myWork = use.work;
+        heap.generation = work.Generation();
+        auto use(psPolicy.Select(Snapshot()->owners));
+        heap.myWork = std::move(use.work);
         heap.owner = use.owner;
         if(heap.myWork) {
-            AddFactory(heap.myWork);
-            heap.workValidated = std::chrono::system_clock::now();
             newWork = true;
             if(heap.diff != use.diff) {
                 heap.diff = use.diff;
@@ -77,38 +183,42 @@ void ThreadedNonceFinders::MiningPump(Miner &self, ThreadResources &heap) {
             }
             self.sleepCount = 0;
         }
-        else { // still nothing to do
-            auto devLinear(GetDeviceLinearIndex(*self.dispatcher));
-            if(self.sleepCount == 1 && onIterationCompleted) onIterationCompleted(devLinear, false, std::chrono::microseconds(0));
-            lock.unlock();
+        else { // still nothing to do, wait for some pool to produce work
+            if(self.sleepCount == 1 && onIterationCompleted) onIterationCompleted(heap.devLinear, false, std::chrono::microseconds(0));
             std::unique_lock<std::mutex> pre(self.sync);
             self.status = s_sleeping;
             pre.unlock();
-            std::this_thread::sleep_for(heap.sleepInterval);
+            const asizei seen = heap.generation;
+            std::unique_lock<std::mutex> lock(guard);
+            workChanged.wait_for(lock, heap.sleepInterval, [this, seen]() { return work.Generation() != seen; });
+            lock.unlock();
             self.sleepCount++;
+            self.lastScan.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_release); // before running, or the watchdog sees a scan as long as the nap
             std::unique_lock<std::mutex> post(self.sync);
             self.status = s_running;
-            return;
+            return false;
         }
     }
-    // Ok, I have work. Every once in a while, check if the work is already valid.
-    if(std::chrono::system_clock::now() > heap.workValidated + heap.workValidationInterval) {
-        std::unique_lock<std::mutex> lock(guard);
+    // Ok, I have work. If something has been published, check it's still the work to do. Most of the time it's just an atomic load.
+    const asizei published = work.Generation();
+    if(heap.generation != published) {
+        heap.generation = published;
+        const auto snap(Snapshot());
+        const auto &owners(snap->owners);
         auto match(std::find_if(owners.cbegin(), owners.cend(), [&heap](const CurrentWork &cw) { return cw.factory == heap.myWork; }));
-        if(match != owners.cend()) heap.workValidated = std::chrono::system_clock::now();
-        else { // I must get another one; easiest way is to just give up and the policy will get me one next time but handle the ref counting
-            auto factory(std::find(usedFactories.begin(), usedFactories.end(), heap.myWork));
-            self.dispatcher->Cancel(heap.waiting);
+        if(match != owners.cend() && psPolicy.Select(owners).work != heap.myWork) match = owners.cend(); // failover or failback
+        if(match == owners.cend()) { // I must get another one; easiest way is to just give up and the policy will get me one next time
+            if(self.dispatcher) self.dispatcher->Cancel(heap.waiting);
             heap.algoStarted = false;
-            heap.myWork = nullptr;
-            RemFactory(factory->res.get());
-            return;
+            heap.remoteFed = false;
+            heap.myWork.reset(); // if I was the last one using it, it's gone now
+            return false;
         }
         // Also take the chance to update the work difficulty - the header data comes automatically from the factory
         if(heap.diff != match->workDiff) newDiff = true;
         heap.diff = match->workDiff;
     }
-    PumpDispatcher(self, heap, newWork, newDiff);
+    return true;
 }
 
 
@@ -141,7 +251,10 @@ void ThreadedNonceFinders::PumpDispatcher(Miner &self, ThreadResources &heap, bo
             clWaitForEvents(cl_uint(heap.waiting.size()), heap.waiting.data());
         } break;
         case AlgoEvent::results: {
+            // If the watchdog gave up on us, somebody else owns the device now, performance stats included. Leave quietly.
+            if(self.abandoned.load(std::memory_order_acquire)) return;
             TickStatus(self);
+            self.lastScan.store(steady_clock::now().time_since_epoch().count(), std::memory_order_release);
             auto produced(dispatcher.GetResults()); // we know header already!
             const auto devLinear(GetDeviceLinearIndex(dispatcher));
             LARGE_INTEGER now;
@@ -154,7 +267,9 @@ void ThreadedNonceFinders::PumpDispatcher(Miner &self, ThreadResources &heap, bo
             if(produced.nonces.empty()) break;
             auto matchPred = [&produced](const NonceValidation &test) { return test.header == produced.from; };
             auto dispatch(*std::find_if(heap.flying.cbegin(), heap.flying.cend(), matchPred));
+            const bool moved = heap.verification.size() && placement::SetCurrentThreadCPUs(heap.verification);
             auto verified(CheckResults(dispatcher.algo.uintsPerHash, produced, dispatch)); // note with stop-n-wait dispatchers there is only one possible match so a set will suffice
+            if(moved) placement::SetCurrentThreadCPUs(heap.mining);
             verified.device = devLinear;
             verified.nonce2 = dispatch.nonce2;
             if(verified.Total()) Found(dispatch.generator, verified);
@@ -187,13 +302,168 @@ void ThreadedNonceFinders::Feed(Miner &self, ThreadResources &heap, bool newWork
 }
 
 
+void ThreadedNonceFinders::ProxyPump(Miner &self, ThreadResources &heap) {
+    using isolation::Supervisor;
+    auto &super(*heap.supervisor);
+    // The worker would keep scanning the last header it got for a long while, better have it go. It will be started again on resume.
+    if(self.paused.load(std::memory_order_acquire)) super.Stop(std::chrono::seconds(2));
+    if(Paused(self, heap)) return;
+    const auto state(super.Supervise(Supervisor::Clock::now()));
+    if(state == Supervisor::s_gaveUp) throw "Device worker process cannot start, last error: " + super.GetLastError();
+    if(super.GetIncarnation() != heap.incarnation) { // new worker, whatever was sent to the previous one is gone
+        heap.incarnation = super.GetIncarnation();
+        heap.remote.clear();
+        heap.remoteFed = false;
+        heap.iterations = 0;
+    }
+    if(state != Supervisor::s_running) { // it can take a while, no point in polling fast
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        return;
+    }
+    bool newWork = false, newDiff = false;
+    if(!SelectWork(self, heap, newWork, newDiff)) return;
+    auto &channel(*super.GetChannel());
+    const bool roll = newWork || !heap.remoteFed;
+    if(roll || newDiff) ProxyFeed(self, heap, channel, roll);
+
+    isolation::ResultPacket got;
+    bool any = false;
+    while(channel.results.Pop(got)) {
+        any = true;
+        TickStatus(self);
+        if(got.flags & isolation::ResultPacket::rp_iteration) {
+            if(heap.iterations < 16) heap.iterations++;
+            else if(onIterationCompleted) onIterationCompleted(heap.devLinear, got.count != 0, std::chrono::microseconds(got.elapsedus));
+        }
+        auto match(std::find_if(heap.remote.cbegin(), heap.remote.cend(), [&got](const std::pair<auint, NonceValidation> &test) { return test.first == got.id; }));
+        // Results for headers we don't know anymore are dropped, the same happens when a dispatcher is cancelled.
+        if(got.count && match != heap.remote.cend() && got.count <= isolation::MAX_NONCES && got.uintsPerHash <= isolation::MAX_HASH_UINTS) {
+            const NonceValidation &dispatch(match->second);
+            MinedNonces produced(dispatch.header);
+            produced.nonces.assign(got.nonces.cbegin(), got.nonces.cbegin() + got.count);
+            produced.hashes.assign(got.hashes.cbegin(), got.hashes.cbegin() + got.count * got.uintsPerHash);
+            const bool moved = heap.verification.size() && placement::SetCurrentThreadCPUs(heap.verification);
+            auto verified(CheckResults(got.uintsPerHash, produced, dispatch));
+            if(moved) placement::SetCurrentThreadCPUs(heap.mining);
+            verified.device = heap.devLinear;
+            verified.nonce2 = dispatch.nonce2;
+            if(verified.Total()) Found(dispatch.generator, verified);
+        }
+        if((got.flags & isolation::ResultPacket::rp_exhausted) && got.id == heap.packet) heap.remoteFed = false;
+    }
+    if(any) heap.idle.Busy();
+    else heap.idle.Idle();
+}
+
+
+void ThreadedNonceFinders::ProxyFeed(Miner &self, ThreadResources &heap, isolation::Channel &channel, bool roll) {
+    if(roll) {
+        heap.current = heap.myWork->MakeNoncedHeader(self.canon.bigEndian == false, self.canon.diffNumerator);
+        for(asizei cp = 0; cp < heap.header.size(); cp++) heap.header[cp] = heap.current.header[cp];
+        self.lastWUGen = std::chrono::system_clock::now();
+    }
+    isolation::WorkPacket packet;
+    packet.id = heap.packet + 1;
+    packet.reserved = 0;
+    packet.targetBits = heap.diff.target[3];
+    packet.header = heap.header;
+    if(!channel.work.Push(packet)) { // worker not taking work, most likely busy dying. Try again next time, with a new header.
+        heap.remoteFed = false;
+        return;
+    }
+    heap.packet = packet.id;
+    heap.remoteFed = true;
+    NonceValidation track { { heap.owner, heap.myWork->job }, heap.myWork->GetNetworkDiff(), heap.diff.shareDiff, heap.current.nonce2, heap.header };
+    heap.remote.push_back(std::make_pair(packet.id, std::move(track)));
+    const asizei keep = 8; // the worker only processes the last header, a few more cover results already in the ring
+    if(heap.remote.size() > keep) heap.remote.erase(heap.remote.begin(), heap.remote.begin() + (heap.remote.size() - keep));
+}
+
+
+void ThreadedNonceFinders::WorkerPump(Miner &self, ThreadResources &heap) {
+    using isolation::ResultPacket;
+    auto &channel(*heap.channel);
+    auto &dispatcher(*self.dispatcher);
+    channel.heartbeat.fetch_add(1, std::memory_order_relaxed);
+    isolation::WorkPacket packet;
+    bool got = false;
+    while(channel.work.Pop(packet)) got = true; // only the most recent matters
+    if(got) {
+        if(!heap.hasWork || packet.header != heap.header) {
+            dispatcher.Cancel(heap.waiting);
+            dispatcher.algo.Restart();
+            heap.header = packet.header;
+            dispatcher.BlockHeader(heap.header);
+        }
+        dispatcher.TargetBits(packet.targetBits);
+        heap.workerPacket = packet.id;
+        heap.hasWork = true;
+    }
+    if(!heap.hasWork) {
+        heap.idle.Idle();
+        return;
+    }
+    heap.idle.Busy();
+    switch(dispatcher.Tick(heap.waiting)) {
+    case AlgoEvent::dispatched:
+        heap.dispatchedPacket = heap.workerPacket;
+        heap.dispatchedAt = std::chrono::steady_clock::now();
+        break;
+    case AlgoEvent::exhausted: {
+        ResultPacket done = ResultPacket();
+        done.id = heap.workerPacket;
+        done.flags = ResultPacket::rp_exhausted;
+        Send(channel, done);
+        heap.hasWork = false;
+    } break;
+    case AlgoEvent::working:
+        dispatcher.GetEvents(heap.waiting);
+        clWaitForEvents(cl_uint(heap.waiting.size()), heap.waiting.data());
+        break;
+    case AlgoEvent::results: {
+        TickStatus(self);
+        const auto produced(dispatcher.GetResults());
+        const auto elapsed(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - heap.dispatchedAt));
+        const asizei uintsPerHash = std::min(dispatcher.algo.uintsPerHash, asizei(isolation::MAX_HASH_UINTS));
+        asizei sent = 0;
+        do {
+            ResultPacket out = ResultPacket();
+            out.id = heap.dispatchedPacket;
+            out.flags = sent? 0 : ResultPacket::rp_iteration;
+            out.elapsedus = elapsed.count();
+            out.uintsPerHash = auint(uintsPerHash);
+            out.count = auint(std::min(produced.nonces.size() - sent, asizei(isolation::MAX_NONCES)));
+            for(auint cp = 0; cp < out.count; cp++) {
+                out.nonces[cp] = produced.nonces[sent + cp];
+                for(asizei h = 0; h < uintsPerHash; h++) out.hashes[cp * uintsPerHash + h] = produced.hashes[(sent + cp) * dispatcher.algo.uintsPerHash + h];
+            }
+            sent += out.count;
+            if(sent < produced.nonces.size()) out.flags |= ResultPacket::rp_more;
+            Send(channel, out);
+        } while(sent < produced.nonces.size());
+    } break;
+    }
+}
+
+
+void ThreadedNonceFinders::Send(isolation::Channel &channel, const isolation::ResultPacket &packet) {
+    // The main process is not keeping up. Waiting is the only option, the ring is the only way to talk. If it's gone, we'll be killed.
+    while(!channel.results.Push(packet) && !channel.quit.load(std::memory_order_relaxed)) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+
 VerifiedNonces ThreadedNonceFinders::CheckResults(asizei uintsPerHash, const MinedNonces &found, const NonceValidation &input) const {
     VerifiedNonces verified;
     verified.targetDiff = input.target;
+    const auto started(std::chrono::steady_clock::now());
     auto match = [&input](const CurrentWork &test) { return test.owner == input.generator.owner; };
-    std::unique_lock<std::mutex> lock(guard);
-    const auto diffMul(std::find_if(owners.cbegin(), owners.cend(), match)->diffMul);
-    lock.unlock();
+    const auto snap(Snapshot());
+    const auto owner(std::find_if(snap->owners.cbegin(), snap->owners.cend(), match));
+    if(owner == snap->owners.cend()) { // pool removed by a configuration reload while we were scanning, nobody to send those to
+        verified.discarded = found.nonces.size();
+        return verified;
+    }
+    const auto diffMul(owner->diffMul);
     for(asizei test = 0; test < found.nonces.size(); test++) {
         std::array<aubyte, 80> header; // hashers expect header in opposite byte order
         for(auint i = 0; i < 80; i += 4) {
@@ -223,5 +493,6 @@ VerifiedNonces ThreadedNonceFinders::CheckResults(asizei uintsPerHash, const Min
         if(shareDiff >= input.network * diffMul.share * diffMul.share) good.block = true;
         verified.nonces.push_back(good);
     }
+    verified.verification = placement::GetCurrentThreadCPUTime() - started;
     return verified;
 }
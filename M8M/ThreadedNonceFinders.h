@@ -7,6 +7,7 @@
 #include <functional>
 #include <algorithm>
 #include "DataDrivenAlgorithm.h"
+#include "PoolHealth.h"
 
 #ifdef _WIN32
 #include <Windows.h>
@@ -18,11 +19,11 @@ protected:
     virtual std::array<aubyte, 32> HashHeader(std::array<aubyte, 80> &header, auint nonce) const = 0;
 
     struct WorkInfo {
-        stratum::AbstractWorkFactory *work;
+        std::shared_ptr<stratum::AbstractWorkFactory> work;
         stratum::WorkDiff diff;
         const void *owner;
-        explicit WorkInfo() { owner = nullptr;    work = nullptr; }
-        WorkInfo(stratum::AbstractWorkFactory *w, stratum::WorkDiff d, const void *o) : work(w), diff(d), owner(o) { }
+        explicit WorkInfo() { owner = nullptr; }
+        WorkInfo(const std::shared_ptr<stratum::AbstractWorkFactory> &w, stratum::WorkDiff d, const void *o) : work(w), diff(d), owner(o) { }
     };
 
     struct PoolSelectionPolicyInterface {
@@ -37,20 +38,30 @@ protected:
             }
             return WorkInfo();
         }
+    };
+
+    /*! All the pools for the algorithm are connected and producing work, the others are in standby. This goes in config order
+    as FirstWorkingPool but skips the degraded ones. If everything is degraded, a degraded pool is still better than nothing.
+    Since the threads are told as soon as selection changes, failing over to a backup doesn't wait for anything. */
+    struct HotStandbyPool : PoolSelectionPolicyInterface {
+        WorkInfo Select(const std::vector<CurrentWork> &pools) {
+            const CurrentWork *pool = HotStandby(pools);
+            return pool? WorkInfo(pool->factory, pool->workDiff, pool->owner) : WorkInfo();
+        }
     } psPolicy;
 
 
 private:
     struct ThreadResources : Miner::HeapResourcesInterface {
-        std::chrono::milliseconds sleepInterval, workValidationInterval;
-        std::chrono::system_clock::time_point workValidated;
+        std::chrono::milliseconds sleepInterval;
 #if defined _WIN32
         bool algoStarted = false;
         LARGE_INTEGER startTick; //!< in theory, QPC might return 0 as value so guard this
 #endif
 
-        stratum::AbstractWorkFactory *myWork = nullptr;
+        std::shared_ptr<stratum::AbstractWorkFactory> myWork; //!< keeps the factory alive even if the main thread dropped it already
         const void *owner = nullptr;
+        asizei generation = 0; //!< work.Generation() when myWork was last validated
         stratum::Work current;
         stratum::WorkDiff diff;
         std::array<aubyte, 80> header; //!< header to dispatch at next Feed. It is kept so when diff changes we don't regen.
@@ -59,6 +70,27 @@ private:
 
         std::vector<cl_event> waiting;
         asizei iterations = 0;
+
+        placement::CPUSet verification; //!< AlgoBuild::verification
+        placement::CPUSet mining; //!< where to go back after verifying, what the thread had after applying AlgoBuild::affinity
+        auint devLinear = 0; //!< looked up once, in isolated mode there's no dispatcher to look it up from
+        AbstractAlgorithm::SourceCodeBufferGetterFunc loader; //!< kept for Retune
+        bool paused = false; //!< the thread noticed Miner::paused, see Paused
+
+        // Isolated mode, main process side, see ProxyPump.
+        std::unique_ptr<isolation::Supervisor> supervisor;
+        auint incarnation = 0; //!< of the worker remote refers to
+        auint packet = 0; //!< last WorkPacket::id sent
+        bool remoteFed = false; //!< worker has the current header, if not a new one must be rolled
+        std::vector<std::pair<auint, NonceValidation>> remote; //!< validation data for the last few headers sent, by WorkPacket::id
+        isolation::Backoff idle;
+
+        // Isolated mode, worker process side, see WorkerPump.
+        isolation::Channel *channel = nullptr;
+        bool hasWork = false;
+        auint workerPacket = 0; //!< WorkPacket::id of the header given to the dispatcher
+        auint dispatchedPacket = 0; //!< WorkPacket::id of the header being processed by the device, results belong to this
+        std::chrono::steady_clock::time_point dispatchedAt;
     };
 
     std::function<void(MiningThreadParams)> GetMiningMain();
@@ -66,9 +98,30 @@ private:
     //! In this function I mostly take care of the work to mangle. Once decided what to do PumpDispatcher is the real deal.
     void MiningPump(Miner &self, ThreadResources &heap);
 
+    /*! Work selection part of MiningPump, also used by ProxyPump.
+    \returns false if there's nothing to do: no work (after sleeping a bit) or the work was dropped and must be selected again. */
+    bool SelectWork(Miner &self, ThreadResources &heap, bool &newWork, bool &newDiff);
+
+    /*! Isolated mode, main process. Keeps the worker process running, sends it headers as MiningPump would dispatch them
+    and verifies what comes back. Throws if the worker cannot be started at all. */
+    void ProxyPump(Miner &self, ThreadResources &heap);
+    void ProxyFeed(Miner &self, ThreadResources &heap, isolation::Channel &channel, bool roll);
+
+    /*! Isolated mode, worker process. Same as PumpDispatcher but headers come from the channel and nonces go back there unverified. */
+    void WorkerPump(Miner &self, ThreadResources &heap);
+    static void Send(isolation::Channel &channel, const isolation::ResultPacket &packet);
+
 
     void PumpDispatcher(Miner &self, ThreadResources &heap, bool newWork, bool newDiff);
 
+    /*! Live tuning, see AbstractNonceFindersBuild::PauseQueue. \returns true if the queue is paused, after sleeping a bit.
+    The first time it notices, the thread drops its work and tells performance monitoring the device is not used. */
+    bool Paused(Miner &self, ThreadResources &heap);
+
+    /*! Live tuning, see AbstractNonceFindersBuild::RetuneQueue. Called between scans, nothing is in flight.
+    Errors are not fatal: they go to Miner::retuneOutcome and the algorithm stays as it was. */
+    void Retune(Miner &self, ThreadResources &heap);
+
     //! Start a new algorithm iteration. This means updating new data to device and remember the validation data.
     void Feed(Miner &self, ThreadResources &heap, bool newWork, bool newDiff);
 
@@ -91,8 +144,8 @@ private:
     VerifiedNonces CheckResults(asizei uintsPerHash, const MinedNonces &found, const NonceValidation &input) const;
 
     void Found(const NonceOriginIdentifier &owner, VerifiedNonces &magic) {
-        std::unique_lock<std::mutex> lock(guard);
-        results.push(std::make_pair(owner, std::move(magic)));
+        results.Push(std::make_pair(owner, std::move(magic)));
+        if(onResultsFound) onResultsFound();
     }
 
     void BadThings(Miner &self, Status status, const char *msg) {
@@ -0,0 +1,90 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+#include "../AbstractCommand.h"
+
+namespace commands {
+namespace admin {
+
+/*! Live tuning of a single device, without touching the configuration file. Parameters:
+	.device, linear index of the device, required.
+	.pause, optional boolean. Paused devices keep everything allocated, resuming is immediate.
+	.linearIntensity, optional, same as in the configuration.
+	.impl, optional, implementation to switch to.
+	.algo, optional, algorithm to switch to, among those being mined. The device starts from the first good settings the configuration has for it.
+Changes are applied by the mining thread at the end of its current scan, only what changed is allocated again.
+With no changes, it just tells how the device is doing. Look at scanTime to see what the changes did.
+Changes last until the device settings are changed in the configuration and it's reloaded, or until restart. */
+class DeviceControlCMD : public AbstractCommand {
+public:
+	struct DeviceControlInterface {
+		enum PauseRequest { pr_keep, pr_pause, pr_resume };
+		struct Change {
+			PauseRequest pause = pr_keep;
+			auint linearIntensity = 0; //!< 0 to keep
+			std::string algo, impl; //!< empty to keep
+		};
+		struct State {
+			std::string algo, impl;
+			auint linearIntensity = 0;
+			aulong hashCount = 0;
+			bool paused = false;
+			bool pending = false; //!< a change has not been applied by the mining thread yet
+			std::string lastChange; //!< outcome of the last change, as told by the mining thread
+		};
+		//! Throw std::string if the change cannot be done, nothing happens then.
+		virtual State ControlDevice(auint device, const Change &change) = 0;
+		virtual ~DeviceControlInterface() { }
+	};
+	DeviceControlCMD(DeviceControlInterface &control) : devices(control), AbstractCommand("deviceControl") { }
+
+	PushInterface* Parse(rapidjson::Document &build, const rapidjson::Value &input) {
+		using namespace rapidjson;
+		Value::ConstMemberIterator params = input.FindMember("params");
+		if(params == input.MemberEnd() || params->value.IsObject() == false) throw std::string("Missing .params object.");
+		const Value &args(params->value);
+		Value::ConstMemberIterator device = args.FindMember("device");
+		if(device == args.MemberEnd() || device->value.IsUint() == false) throw std::string(".params.device must be a device linear index.");
+		DeviceControlInterface::Change change;
+		Value::ConstMemberIterator field = args.FindMember("pause");
+		if(field != args.MemberEnd()) {
+			if(field->value.IsBool() == false) throw std::string(".params.pause must be a boolean.");
+			change.pause = field->value.GetBool()? DeviceControlInterface::pr_pause : DeviceControlInterface::pr_resume;
+		}
+		field = args.FindMember("linearIntensity");
+		if(field != args.MemberEnd()) {
+			if(field->value.IsUint() == false || field->value.GetUint() == 0) throw std::string(".params.linearIntensity must be a positive integer.");
+			change.linearIntensity = field->value.GetUint();
+		}
+		auto optString = [&args](const char *name, std::string &dst) {
+			Value::ConstMemberIterator field = args.FindMember(name);
+			if(field == args.MemberEnd()) return;
+			if(field->value.IsString() == false || field->value.GetStringLength() == 0) throw std::string(".params.") + name + " must be a non-empty string.";
+			dst.assign(field->value.GetString(), field->value.GetStringLength());
+		};
+		optString("algo", change.algo);
+		optString("impl", change.impl);
+
+		const auto state(devices.ControlDevice(device->value.GetUint(), change));
+		build.SetObject();
+		auto &alloc(build.GetAllocator());
+		build.AddMember("device", device->value.GetUint(), alloc);
+		build.AddMember("algo", Value(state.algo.c_str(), SizeType(state.algo.length()), alloc), alloc);
+		build.AddMember("impl", Value(state.impl.c_str(), SizeType(state.impl.length()), alloc), alloc);
+		build.AddMember("linearIntensity", state.linearIntensity, alloc);
+		build.AddMember("hashCount", uint64_t(state.hashCount), alloc); // aulong is not uint64_t everywhere
+		build.AddMember("paused", state.paused, alloc);
+		build.AddMember("pending", state.pending, alloc);
+		build.AddMember("lastChange", Value(state.lastChange.c_str(), SizeType(state.lastChange.length()), alloc), alloc);
+		return nullptr;
+	}
+
+private:
+	DeviceControlInterface &devices;
+};
+
+
+}
+}
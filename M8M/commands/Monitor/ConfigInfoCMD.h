@@ -15,6 +15,7 @@ public:
     struct ConfigInfo {
         const rapidjson::Value *specified = nullptr; //!< original json value pulled from config file
         std::vector<std::string> rejectReasons; //!< device-independant reasons for which the object was discarded.
+        std::string algo; //!< settings are given by algorithm and more than one can be mined at once
 
         // Stuff below is only valid when rejectReasons.empty() is true.
         std::string impl; //!< algorithm implementation being used
@@ -24,7 +25,7 @@ public:
     struct ConfigDescriptorInterface {
         virtual ~ConfigDescriptorInterface() { }
         virtual bool ValidSelection() const = 0; //!< true if {algo,impl} pair selected a valid algo
-        virtual std::string GetSelectedAlgorithm() const = 0;
+        virtual std::string GetSelectedAlgorithm() const = 0; //!< comma separated if mining more than one
         virtual bool ValidConfig() const = 0; //!< true if a corresponding set of configs has been successfully loaded from config file
         virtual asizei GetNumDeducedConfigs() const = 0; //!< how many configs to probe using GetConfig or GetResources
         virtual ConfigInfo GetConfig(asizei cfg) const = 0; //!< every used device is mapped to a config and therefore to a single set of resources
@@ -54,10 +55,12 @@ public:
             for(asizei loop = 0; loop < conf.GetNumDeducedConfigs(); loop++) {
                 auto el(conf.GetConfig(loop));
                 Value entry;
+                Value algo(el.algo.c_str(), SizeType(el.algo.length()), alloc);
                 if(el.rejectReasons.size()) {
                     Value reasons(kArrayType);
                     for(auto &str : el.rejectReasons) reasons.PushBack(StringRef(str.c_str()), alloc);
                     entry.SetObject();
+                    entry.AddMember("algo", algo, alloc);
                     entry.AddMember("rejectReasons", reasons, alloc);
                     Document copy;
                     copy.CopyFrom(*el.specified, alloc);
@@ -65,6 +68,7 @@ public:
                 }
                 else {
                     entry.SetObject();
+                    entry.AddMember("algo", algo, alloc);
                     entry.AddMember("impl", Value(el.impl.c_str(), SizeType(el.impl.length()), alloc), alloc);
                     Value devArr(kArrayType);
                     for(auto &dev : el.devices) {
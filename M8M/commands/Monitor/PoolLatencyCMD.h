@@ -0,0 +1,113 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+#include "../AbstractStreamingCommand.h"
+#include "../../../Common/LatencyHistogram.h"
+
+namespace commands {
+namespace monitor {
+
+
+/*! PoolStats tells how many shares go to a pool, this tells how fast it deals with them. For each pool there are four histograms:
+- submit: mining.submit round trips;
+- request: round trips of everything else we ask, subscribe and authorize mostly;
+- notify: time between two jobs;
+- jobLag: how late the pool is at announcing a new block WRT the first pool doing the same.
+Those are cumulative since program start and only grow so pools are sent again only when they got new samples.
+Bucket limits are sent once, in the reply, since they never change. */
+class PoolLatencyCMD : public AbstractStreamingCommand {
+public:
+    struct Latencies {
+        LatencyHistogram submit, request, notify, jobLag;
+        bool operator!=(const Latencies &other) const {
+            return submit != other.submit || request != other.request || notify != other.notify || jobLag != other.jobLag;
+        }
+    };
+    class ValueSourceInterface {
+    public:
+        virtual ~ValueSourceInterface() { }
+        virtual bool GetPoolLatencies(Latencies &out, asizei poolIndex) = 0;
+    };
+
+    PoolLatencyCMD(ValueSourceInterface &src) : pools(src), AbstractStreamingCommand("poolLatency") { }
+
+
+private:
+    ValueSourceInterface &pools;
+
+    AbstractInternalPush* NewPusher() { return new Pusher(pools); }
+
+    class Pusher : public AbstractInternalPush {
+        ValueSourceInterface &pools;
+        std::vector<Latencies> sent;
+        bool limitsSent = false;
+
+        static rapidjson::Value Describe(const LatencyHistogram &hist, rapidjson::MemoryPoolAllocator<rapidjson::CrtAllocator> &alloc) {
+            using namespace rapidjson;
+            Value ret(kObjectType);
+            ret.AddMember("samples", hist.samples, alloc);
+            if(hist.samples) {
+                ret.AddMember("min", hist.min, alloc);
+                ret.AddMember("max", hist.max, alloc);
+                ret.AddMember("avg", hist.Average(), alloc);
+                ret.AddMember("recent", hist.recent, alloc);
+                ret.AddMember("p50", hist.Percentile(.5), alloc);
+                ret.AddMember("p90", hist.Percentile(.9), alloc);
+                ret.AddMember("p99", hist.Percentile(.99), alloc);
+            }
+            Value counts(kArrayType);
+            counts.Reserve(SizeType(hist.counts.size()), alloc);
+            for(auto el : hist.counts) counts.PushBack(el, alloc);
+            ret.AddMember("counts", counts, alloc);
+            return ret;
+        }
+
+    public:
+        Pusher(ValueSourceInterface &getters) : pools(getters) { }
+        bool MyCommand(const std::string &signature) const { return strcmp(signature.c_str(), "poolLatency") == 0; }
+        std::string GetPushName() const { return std::string("poolLatency"); }
+        void SetState(const rapidjson::Value &input) {
+            asizei count = 0;
+            Latencies out;
+            while(pools.GetPoolLatencies(out, count)) count++;
+            sent.resize(count);
+        }
+        bool RefreshAndReply(rapidjson::Document &build, bool changes) {
+            using namespace rapidjson;
+            auto &alloc(build.GetAllocator());
+            build.SetObject();
+            if(!limitsSent || changes) {
+                Value limits(kArrayType);
+                for(auto el : LatencyHistogram::GetLimits()) limits.PushBack(el, alloc);
+                build.AddMember("limits", limits, alloc);
+                limitsSent = true;
+            }
+            Value list(kArrayType);
+            list.Reserve(SizeType(sent.size()), alloc);
+            asizei differences = 0;
+            for(asizei check = 0; check < sent.size(); check++) {
+                Latencies out;
+                pools.GetPoolLatencies(out, check);
+                if(out != sent[check] || changes) {
+                    differences++;
+                    Value add(kObjectType);
+                    if(out.submit != sent[check].submit || changes) add.AddMember("submit", Describe(out.submit, alloc), alloc);
+                    if(out.request != sent[check].request || changes) add.AddMember("request", Describe(out.request, alloc), alloc);
+                    if(out.notify != sent[check].notify || changes) add.AddMember("notify", Describe(out.notify, alloc), alloc);
+                    if(out.jobLag != sent[check].jobLag || changes) add.AddMember("jobLag", Describe(out.jobLag, alloc), alloc);
+                    sent[check] = out;
+                    list.PushBack(add, alloc);
+                }
+                else list.PushBack(Value(kNullType), alloc);
+            }
+            build.AddMember("pools", list, alloc);
+            return differences != 0 || changes;
+        }
+    };
+};
+
+
+}
+}
@@ -21,13 +21,22 @@ public:
         auint numActivationAttempts = 0;
         std::chrono::system_clock::duration cumulatedTime;
         std::chrono::system_clock::time_point lastSubmitReply, lastActivity;
+        adouble shareSendLatency, blockSendLatency; //!< milliseconds from share found to the OS, moving average, current connection
+        auint sharesPerMinute; //!< found in the last minute, including stale
+        adouble suggestedDiff; //!< last difficulty suggested to the pool, 0 if none
+        adouble verificationTime; //!< milliseconds of CPU spent checking results for this pool, cumulated
+        bool degraded = false; //!< connected but bad for us so mining goes to the other pools, see PoolHealth
+        auint numDegraded = 0; //!< how many times it went degraded
 
-		ShareStats() : sent(0), accepted(0), rejected(0), daps(.0) { }
+		ShareStats() : sent(0), accepted(0), rejected(0), daps(.0), shareSendLatency(.0), blockSendLatency(.0), sharesPerMinute(0), suggestedDiff(.0), verificationTime(.0) { }
         bool operator!=(const ShareStats &other) const {
             return sent != other.sent || accepted != other.accepted || rejected != other.rejected || daps != other.daps ||
                 lastActivated != other.lastActivated || lastConnDown != other.lastConnDown ||
                 numActivationAttempts != other.numActivationAttempts || cumulatedTime != other.cumulatedTime ||
-                lastSubmitReply != other.lastSubmitReply || lastActivity != other.lastActivity;
+                lastSubmitReply != other.lastSubmitReply || lastActivity != other.lastActivity ||
+                shareSendLatency != other.shareSendLatency || blockSendLatency != other.blockSendLatency ||
+                sharesPerMinute != other.sharesPerMinute || suggestedDiff != other.suggestedDiff || verificationTime != other.verificationTime ||
+                degraded != other.degraded || numDegraded != other.numDegraded;
         }
 	};
 	class ValueSourceInterface {
@@ -96,6 +105,13 @@ private:
                         auto howMuch(duration_cast<seconds>(out.cumulatedTime));
                         add.AddMember("cumulatedTime", howMuch.count(), alloc);
                     }
+                    if(out.shareSendLatency != sent[check].shareSendLatency || changes) add.AddMember("shareSendLatency", out.shareSendLatency, alloc);
+                    if(out.blockSendLatency != sent[check].blockSendLatency || changes) add.AddMember("blockSendLatency", out.blockSendLatency, alloc);
+                    if(out.sharesPerMinute != sent[check].sharesPerMinute || changes) add.AddMember("sharesPerMinute", out.sharesPerMinute, alloc);
+                    if(out.suggestedDiff != sent[check].suggestedDiff || changes) add.AddMember("suggestedDiff", out.suggestedDiff, alloc);
+                    if(out.verificationTime != sent[check].verificationTime || changes) add.AddMember("verificationTime", out.verificationTime, alloc);
+                    if(out.degraded != sent[check].degraded || changes) add.AddMember("degraded", out.degraded, alloc);
+                    if(out.numDegraded != sent[check].numDegraded || changes) add.AddMember("numDegraded", out.numDegraded, alloc);
                     sent[check] = out;
                     build.PushBack(add, alloc);
                 }
@@ -0,0 +1,76 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+#include "../AbstractStreamingCommand.h"
+#include "../../NonceFindersInterface.h"
+
+namespace commands {
+namespace monitor {
+
+
+/*! Results found by the mining threads wait in a queue for the main thread to send them. If the main thread doesn't keep up, shares
+go out late and might be stale by the time the pool sees them. This tells how many are waiting, how many waited at worst and for how long.
+Pushed only when something has been pulled out of the queue as that's the only time the values change, except depth which is
+interesting only when it's big and then it will be pulled soon anyway. */
+class ResultQueueCMD : public AbstractStreamingCommand {
+public:
+    class ValueSourceInterface {
+    public:
+        virtual ~ValueSourceInterface() { }
+        //! \returns false if not mining.
+        virtual bool GetResultQueueStats(NonceFindersInterface::ResultQueueStats &out) const = 0;
+    };
+
+    ResultQueueCMD(const ValueSourceInterface &src) : miner(src), AbstractStreamingCommand("resultQueue") { }
+
+
+private:
+    const ValueSourceInterface &miner;
+
+    AbstractInternalPush* NewPusher() { return new Pusher(miner); }
+
+    class Pusher : public AbstractInternalPush {
+        const ValueSourceInterface &miner;
+        aulong sent = aulong(-1); //!< ResultQueueStats::pulled last time, so first time is always sent
+
+    public:
+        Pusher(const ValueSourceInterface &getters) : miner(getters) { }
+        bool MyCommand(const std::string &signature) const { return strcmp(signature.c_str(), "resultQueue") == 0; }
+        std::string GetPushName() const { return std::string("resultQueue"); }
+        void SetState(const rapidjson::Value &input) { }
+        bool RefreshAndReply(rapidjson::Document &build, bool changes) {
+            using namespace rapidjson;
+            NonceFindersInterface::ResultQueueStats stats;
+            if(!miner.GetResultQueueStats(stats)) {
+                if(!changes) return false;
+                build.SetNull();
+                return true;
+            }
+            if(stats.pulled == sent && !changes) return false;
+            sent = stats.pulled;
+            auto &alloc(build.GetAllocator());
+            build.SetObject();
+            build.AddMember("depth", aulong(stats.depth), alloc);
+            build.AddMember("peakDepth", aulong(stats.peakDepth), alloc);
+            build.AddMember("pulled", stats.pulled, alloc);
+            const LatencyHistogram &age(stats.age);
+            if(age.samples) {
+                Value ms(kObjectType);
+                ms.AddMember("min", age.min, alloc);
+                ms.AddMember("max", age.max, alloc);
+                ms.AddMember("avg", age.Average(), alloc);
+                ms.AddMember("recent", age.recent, alloc);
+                ms.AddMember("p50", age.Percentile(.5), alloc);
+                ms.AddMember("p99", age.Percentile(.99), alloc);
+                build.AddMember("age", ms, alloc);
+            }
+            return true;
+        }
+    };
+};
+
+
+}
+}
@@ -10,7 +10,8 @@
 namespace commands {
 namespace monitor {
 
-/*! The first truly interesting command. Besides providing a reply, can optionally initiate data streaming on change. */
+/*! The first truly interesting command. Besides providing a reply, can optionally initiate data streaming on change.
+If more than one averaging window is configured, "twindows" lists them and each device gets "avgs", one for each window, milliseconds. */
 class ScanTime : public AbstractStreamingCommand {
 public:
 	ScanTime(MiningPerformanceWatcherInterface &src) : devices(src), AbstractStreamingCommand("scanTime") { }
@@ -47,6 +48,12 @@ private:
 			using namespace rapidjson;
 			build.SetObject();
 			build.AddMember("twindow", Value(devices.GetAverageWindow().count()), build.GetAllocator());
+            const auto windows(devices.GetAverageWindows());
+            if(windows.size() > 1) {
+                Value list(kArrayType);
+                for(auto el : windows) list.PushBack(Value(el.count()), build.GetAllocator());
+                build.AddMember("twindows", list, build.GetAllocator());
+            }
 			build.AddMember("measurements", rapidjson::Value(rapidjson::kArrayType), build.GetAllocator());
 			rapidjson::Value &arr(build["measurements"]);
             arr.Reserve(SizeType(poll.size()), build.GetAllocator());
@@ -59,6 +66,15 @@ private:
                     updated |= MaybeAddValue_ms(add, "max", refreshed.max, poll[loop].max, changes, build.GetAllocator());
                     updated |= MaybeAddValue_ms(add, "avg", refreshed.avg, poll[loop].avg, changes, build.GetAllocator());
                     updated |= MaybeAddValue_ms(add, "last", refreshed.last, poll[loop].last, changes, build.GetAllocator());
+                    if(windows.size() > 1 && (changes || refreshed.windows != poll[loop].windows)) { // all of them or nothing, order matters
+                        Value list(kArrayType);
+                        for(asizei w = 0; w < windows.size(); w++) {
+                            list.PushBack(std::chrono::duration_cast<std::chrono::milliseconds>(refreshed.windows[w]).count(), build.GetAllocator());
+                        }
+                        add.AddMember("avgs", list, build.GetAllocator());
+                        poll[loop].windows = refreshed.windows;
+                        updated = true;
+                    }
                     arr.PushBack(add, build.GetAllocator());
                 }
                 else arr.PushBack(Value(kNullType), build.GetAllocator());
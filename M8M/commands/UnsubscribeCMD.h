@@ -25,10 +25,10 @@ public:
 protected:
 	PushInterface* Parse(rapidjson::Document &reply, const rapidjson::Value &input) {
 		using namespace rapidjson;
-		Value::ConstMemberIterator &params(input.FindMember("params"));
+		Value::ConstMemberIterator params(input.FindMember("params"));
 		if(params == input.MemberEnd() || params->value.IsObject() == false) throw std::exception("\"unsubscribe\", .parameters must be object.");
-		Value::ConstMemberIterator &ori(params->value.FindMember("originator"));
-		Value::ConstMemberIterator &stream(params->value.FindMember("stream"));
+		Value::ConstMemberIterator ori(params->value.FindMember("originator"));
+		Value::ConstMemberIterator stream(params->value.FindMember("stream"));
 		if(ori == params->value.MemberEnd() || ori->value.IsString() == false) throw std::exception("\"unsubscribe\", .parameters.originator missing or not a string.");
 		const std::string cmd(ori->value.GetString(), ori->value.GetStringLength());
 		if(stream == params->value.MemberEnd()) owner.Unsubscribe(cmd, std::string());
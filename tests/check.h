@@ -0,0 +1,36 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+#include <iostream>
+
+/*! Each test is a program returning 0 if everything went fine. No framework, the failing expression and where it is are enough. */
+namespace check {
+inline unsigned& Failures() {
+    static unsigned count = 0;
+    return count;
+}
+inline int Report(const char *test) {
+    if(Failures()) std::cout<<test<<": "<<Failures()<<" check"<<(Failures() == 1? "" : "s")<<" failed."<<std::endl;
+    else std::cout<<test<<": ok"<<std::endl;
+    return Failures()? 1 : 0;
+}
+}
+
+#define CHECK(cond) do { \
+    if(!(cond)) { \
+        check::Failures()++; \
+        std::cout<<__FILE__<<':'<<__LINE__<<": CHECK("<<#cond<<") failed"<<std::endl; \
+    } \
+} while(false)
+
+//! Expressions expected to throw, of any type as the sources throw std::exception, std::string and const char*.
+#define CHECK_THROWS(expr) do { \
+    bool thrown = false; \
+    try { expr; } catch(...) { thrown = true; } \
+    if(!thrown) { \
+        check::Failures()++; \
+        std::cout<<__FILE__<<':'<<__LINE__<<": "<<#expr<<" did not throw"<<std::endl; \
+    } \
+} while(false)
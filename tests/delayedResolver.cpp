@@ -0,0 +1,130 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#include "check.h"
+#include "../Common/AddressResolver.h"
+#include <netinet/in.h>
+#include <string.h>
+
+/*! AddressResolver against a stub resolver taking its time, as a slow DNS server does: Lookup must never wait for it, a slow name must
+not hold up the others, answers and failures are cached for their TTL, addresses which stopped working get resolved again.
+Names: "slow" takes a second and a half, "gone" does not exist, "short" has a one second TTL, the rest resolve right away with no TTL. */
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+using std::chrono::milliseconds;
+
+struct Calls {
+    std::mutex mutex;
+    std::map<std::string, asizei> count;
+    asizei Get(const std::string &host) {
+        std::unique_lock<std::mutex> lock(mutex);
+        return count[host];
+    }
+};
+
+AddressResolver::ResolveFunc Stub(std::shared_ptr<Calls> calls) {
+    return [calls](const std::string &host, const std::string &port) {
+        {
+            std::unique_lock<std::mutex> lock(calls->mutex);
+            calls->count[host]++;
+        }
+        AddressResolver::Answer ret;
+        if(host == "slow") std::this_thread::sleep_for(milliseconds(1500));
+        if(host == "gone") return ret;
+        if(host == "short") ret.ttl = std::chrono::seconds(1);
+        AddressResolver::Address add;
+        memset(&add, 0, sizeof(add));
+        sockaddr_in &ip(reinterpret_cast<sockaddr_in&>(add.address));
+        ip.sin_family = AF_INET;
+        ip.sin_port = htons(aushort(std::stoul(port)));
+        ip.sin_addr.s_addr = htonl(0x7F000000 + auint(host.length()));
+        add.family = AF_INET;
+        add.socktype = SOCK_STREAM;
+        add.protocol = IPPROTO_TCP;
+        add.length = sizeof(sockaddr_in);
+        ret.addresses.push_back(add);
+        return ret;
+    };
+}
+
+//! Polls as the networks do until the lookup is not pending anymore, 5 seconds at most.
+AddressResolver::Status Wait(AddressResolver &resolver, const std::string &host, std::vector<AddressResolver::Address> &got) {
+    const auto limit(Clock::now() + std::chrono::seconds(5));
+    AddressResolver::Status status;
+    while((status = resolver.Lookup(got, host, "3333")) == AddressResolver::rs_pending && Clock::now() < limit) {
+        std::this_thread::sleep_for(milliseconds(AddressResolver::pollMilliseconds));
+    }
+    return status;
+}
+
+}
+
+
+int main(int argc, char **argv) {
+    auto calls(std::make_shared<Calls>());
+    std::vector<AddressResolver::Address> got;
+    {
+        AddressResolver resolver(Stub(calls));
+        resolver.negativeTTL = std::chrono::seconds(2);
+
+        // The slow name doesn't block the lookup, nor the names asked after it.
+        auto start(Clock::now());
+        CHECK(resolver.Lookup(got, "slow", "3333") == AddressResolver::rs_pending);
+        CHECK(resolver.Lookup(got, "pool", "3333") == AddressResolver::rs_pending);
+        CHECK(resolver.Lookup(got, "gone", "3333") == AddressResolver::rs_pending);
+        CHECK(Clock::now() - start < milliseconds(100));
+        CHECK(Wait(resolver, "pool", got) == AddressResolver::rs_resolved && got.size() == 1);
+        CHECK(Wait(resolver, "gone", got) == AddressResolver::rs_failed);
+        CHECK(resolver.Lookup(got, "slow", "3333") == AddressResolver::rs_pending); // still there
+        CHECK(Clock::now() - start < milliseconds(1000));
+        CHECK(Wait(resolver, "slow", got) == AddressResolver::rs_resolved);
+        CHECK(Clock::now() - start >= milliseconds(1500));
+
+        // Answers and failures are cached: no more calls.
+        got.clear();
+        start = Clock::now();
+        CHECK(resolver.Lookup(got, "slow", "3333") == AddressResolver::rs_resolved && got.size() == 1);
+        CHECK(resolver.Lookup(got, "pool", "3333") == AddressResolver::rs_resolved);
+        CHECK(resolver.Lookup(got, "gone", "3333") == AddressResolver::rs_failed);
+        CHECK(Clock::now() - start < milliseconds(10));
+        CHECK(calls->Get("slow") == 1 && calls->Get("pool") == 1 && calls->Get("gone") == 1);
+
+        // The record TTL is respected, no TTL means positiveTTL. Failures are retried after negativeTTL.
+        CHECK(Wait(resolver, "short", got) == AddressResolver::rs_resolved);
+        CHECK(resolver.Lookup(got, "short", "3333") == AddressResolver::rs_resolved && calls->Get("short") == 1);
+        std::this_thread::sleep_for(milliseconds(1100));
+        CHECK(resolver.Lookup(got, "short", "3333") == AddressResolver::rs_pending);
+        CHECK(Wait(resolver, "short", got) == AddressResolver::rs_resolved && calls->Get("short") == 2);
+        CHECK(resolver.Lookup(got, "pool", "3333") == AddressResolver::rs_resolved && calls->Get("pool") == 1);
+        CHECK(resolver.Lookup(got, "gone", "3333") == AddressResolver::rs_pending);
+        CHECK(Wait(resolver, "gone", got) == AddressResolver::rs_failed && calls->Get("gone") == 2);
+
+        // All the addresses of an answer failing to connect: it's asked again, once it's older than negativeTTL.
+        CHECK(resolver.Lookup(got, "pool", "3333") == AddressResolver::rs_resolved);
+        resolver.ConnectResult(got[0], false, milliseconds(0));
+        CHECK(resolver.Lookup(got, "pool", "3333") == AddressResolver::rs_pending);
+        CHECK(Wait(resolver, "pool", got) == AddressResolver::rs_resolved && calls->Get("pool") == 2);
+        resolver.ConnectResult(got[0], false, milliseconds(0));
+        CHECK(resolver.Lookup(got, "pool", "3333") == AddressResolver::rs_resolved); // answer is fresh, no hammering
+        resolver.ConnectResult(got[0], true, milliseconds(5));
+        std::this_thread::sleep_for(milliseconds(2100));
+        CHECK(resolver.Lookup(got, "pool", "3333") == AddressResolver::rs_resolved && calls->Get("pool") == 2); // works again
+    }
+    {
+        // A single thread: the fast name waits behind the slow one. Going away with the slow one in flight doesn't wait for it.
+        auto start(Clock::now());
+        {
+            AddressResolver resolver(Stub(calls));
+            resolver.maxThreads = 1;
+            CHECK(resolver.Lookup(got, "slow", "4444") == AddressResolver::rs_pending);
+            CHECK(resolver.Lookup(got, "other", "4444") == AddressResolver::rs_pending);
+            std::this_thread::sleep_for(milliseconds(300));
+            CHECK(resolver.Lookup(got, "other", "4444") == AddressResolver::rs_pending);
+            CHECK(calls->Get("other") == 0);
+        }
+        CHECK(Clock::now() - start < milliseconds(1000));
+    }
+    return check::Report("delayedResolver");
+}
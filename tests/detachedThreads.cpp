@@ -0,0 +1,203 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#include "check.h"
+#include "../Common/DetachedThreads.h"
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+
+/*! The thread bookkeeping of AbstractNonceFindersBuild with a stub nonce finder whose threads block "in the driver" until told otherwise.
+It follows the same protocol as ThreadedNonceFinders: Leaving first, abandoned checked before anything else, RecoverQueue marking stuck
+and respawning, the DTOR dismissing.
+This is built with AddressSanitizer: a thread coming back after its owner is gone must find its slot still there. */
+namespace {
+
+struct Miner;
+
+/*! What the driver does when a stub thread calls it: either return right away or hang, for as long as the test wants.
+Forever, if it never says otherwise. */
+class Driver {
+public:
+    void Call(Miner &who);
+    void Hang(Miner &who, bool forever);
+    bool WaitInside(Miner &who);
+
+private:
+    std::mutex mutex;
+    std::condition_variable changed;
+};
+
+
+struct Miner {
+    std::atomic<bool> abandoned { false };
+    std::atomic<bool> exited { false };
+    bool stuck = false;
+    bool hang = false, inside = false; //!< Driver's, guarded by its mutex
+};
+
+
+void Driver::Call(Miner &who) {
+    std::unique_lock<std::mutex> lock(mutex);
+    who.inside = true;
+    changed.notify_all();
+    changed.wait(lock, [&who]() { return !who.hang; });
+    who.inside = false;
+}
+
+void Driver::Hang(Miner &who, bool forever) {
+    std::unique_lock<std::mutex> lock(mutex);
+    who.hang = forever;
+    changed.notify_all();
+}
+
+bool Driver::WaitInside(Miner &who) {
+    std::unique_lock<std::mutex> lock(mutex);
+    return changed.wait_for(lock, std::chrono::seconds(5), [&who]() { return who.inside && who.hang; });
+}
+
+
+class StubFinders {
+public:
+    enum Behaviour {
+        b_mine, //!< calls the driver in a loop
+        b_initFails //!< returns right away, as ThreadedNonceFinders does when initialization fails
+    };
+    std::chrono::milliseconds patience = std::chrono::seconds(10);
+    asizei leaked = 0;
+
+    explicit StubFinders(Driver &driver) : driver(driver) { }
+    ~StubFinders() {
+        keepRunning = false;
+        leaked = detached::Dismiss(miners, retired, spawned, exitedThreads, patience);
+        if(onDismissed) onDismissed(leaked);
+    }
+
+    void GenQueue(Behaviour what) {
+        miners.push_back(std::make_unique<Miner>());
+        Spawn(*miners.back(), what);
+    }
+    void RecoverQueue(asizei queue) {
+        miners[queue]->stuck = true;
+        auto replacement(std::make_unique<Miner>());
+        Spawn(*replacement, b_mine);
+        miners[queue]->abandoned.store(true, std::memory_order_release);
+        retired.push_back(std::move(miners[queue]));
+        miners[queue] = std::move(replacement);
+    }
+
+    Miner& Get(asizei queue) { return *miners[queue]; }
+    detached::ExitCounter GetExitCounter() const { return exitedThreads; }
+    std::function<void(asizei leaked)> onDismissed;
+
+private:
+    Driver &driver;
+    std::vector<std::unique_ptr<Miner>> miners, retired;
+    asizei spawned = 0;
+    std::atomic<bool> keepRunning { true };
+    detached::ExitCounter exitedThreads = detached::NewExitCounter();
+
+    void Spawn(Miner &self, Behaviour what) {
+        std::thread([this, &self, what]() {
+            detached::Leaving gone(self.exited, exitedThreads);
+            if(what == b_initFails) return;
+            while(!self.abandoned.load(std::memory_order_acquire) && keepRunning) driver.Call(self);
+        }).detach();
+        spawned++;
+    }
+};
+
+
+using std::chrono::steady_clock;
+using std::chrono::seconds;
+using std::chrono::milliseconds;
+
+//! Waits for the counter to get there. Threads count themselves after their slot so this is what tells they're really gone.
+bool WaitExits(const detached::ExitCounter &counter, asizei count) {
+    const auto limit(steady_clock::now() + seconds(5));
+    while(counter->load() != count && steady_clock::now() < limit) std::this_thread::sleep_for(milliseconds(1));
+    return counter->load() == count;
+}
+
+}
+
+
+int main(int argc, char **argv) {
+    {
+        // Everybody behaving: going away is quick, nothing leaked.
+        Driver driver;
+        detached::ExitCounter exits;
+        const auto start(steady_clock::now());
+        {
+            StubFinders finders(driver);
+            for(asizei loop = 0; loop < 4; loop++) finders.GenQueue(StubFinders::b_mine);
+            exits = finders.GetExitCounter();
+            finders.onDismissed = [](asizei leaked) { CHECK(leaked == 0); };
+        }
+        CHECK(steady_clock::now() - start < seconds(2));
+        CHECK(exits->load() == 4);
+    }
+    {
+        // A thread leaving early is counted as well: nobody waits for it.
+        Driver driver;
+        const auto start(steady_clock::now());
+        {
+            StubFinders finders(driver);
+            finders.GenQueue(StubFinders::b_initFails);
+            finders.GenQueue(StubFinders::b_mine);
+            CHECK(WaitExits(finders.GetExitCounter(), 1));
+            finders.onDismissed = [](asizei leaked) { CHECK(leaked == 0); };
+        }
+        CHECK(steady_clock::now() - start < seconds(2));
+    }
+    {
+        // A thread stuck in the driver and recovered is not waited for. Its Miner is leaked and when it comes back, it's still there.
+        Driver driver;
+        detached::ExitCounter exits;
+        Miner *zombie = nullptr;
+        const auto start(steady_clock::now());
+        {
+            StubFinders finders(driver);
+            finders.GenQueue(StubFinders::b_mine);
+            finders.GenQueue(StubFinders::b_mine);
+            zombie = &finders.Get(0);
+            driver.Hang(*zombie, true);
+            CHECK(driver.WaitInside(*zombie));
+            finders.RecoverQueue(0);
+            CHECK(&finders.Get(0) != zombie && zombie->stuck && zombie->abandoned);
+            exits = finders.GetExitCounter();
+            finders.onDismissed = [](asizei leaked) { CHECK(leaked == 1); };
+        }
+        CHECK(steady_clock::now() - start < seconds(2));
+        CHECK(exits->load() == 2 && !zombie->exited);
+        driver.Hang(*zombie, false);
+        CHECK(WaitExits(exits, 3));
+        CHECK(zombie->exited);
+        delete zombie; // leaked on purpose, we know it's gone now
+    }
+    {
+        // A thread becoming unresponsive without anybody noticing is waited for, then leaked.
+        Driver driver;
+        detached::ExitCounter exits;
+        Miner *zombie = nullptr;
+        const auto start(steady_clock::now());
+        {
+            StubFinders finders(driver);
+            finders.GenQueue(StubFinders::b_mine);
+            finders.GenQueue(StubFinders::b_mine);
+            zombie = &finders.Get(1);
+            driver.Hang(*zombie, true);
+            CHECK(driver.WaitInside(*zombie));
+            exits = finders.GetExitCounter();
+            finders.patience = milliseconds(300);
+            finders.onDismissed = [](asizei leaked) { CHECK(leaked == 1); };
+        }
+        CHECK(steady_clock::now() - start >= milliseconds(300));
+        CHECK(exits->load() == 1 && zombie->abandoned);
+        driver.Hang(*zombie, false);
+        CHECK(WaitExits(exits, 2));
+        delete zombie;
+    }
+    return check::Report("detachedThreads");
+}
@@ -0,0 +1,301 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#include "check.h"
+#include "../M8M/AbstractWSServer.h"
+#include "../M8M/commands/Admin/DeviceControlCMD.h"
+
+/*! deviceControl the way a web page would use it: the real AbstractWSServer on 127.0.0.1, the command registered as M8M does
+and a WebSocket client written out here, byte by byte, so it does not share the server's Framer or HandShaker.
+The mining side is a fake which tells what it was asked to do. */
+namespace {
+
+using namespace std::chrono;
+typedef NetworkInterface::SocketInterface Socket;
+typedef commands::admin::DeviceControlCMD::DeviceControlInterface Control;
+
+class FakeDevices : public Control {
+public:
+    std::vector<Change> asked; //!< only changes which made it through parsing get here
+    State state;
+
+    FakeDevices() {
+        state.algo = "qubit";
+        state.impl = "fiveSteps";
+        state.linearIntensity = 64;
+        state.hashCount = 0x123456789ull; // does not fit 32 bit
+        state.lastChange = "ok";
+    }
+    State ControlDevice(auint device, const Change &change) {
+        if(device > 1) throw std::string("no such device");
+        asked.push_back(change);
+        if(change.pause == pr_pause) state.paused = true;
+        if(change.pause == pr_resume) state.paused = false;
+        if(change.linearIntensity) state.linearIntensity = change.linearIntensity;
+        if(change.algo.length()) state.algo = change.algo;
+        if(change.impl.length()) state.impl = change.impl;
+        state.pending = change.linearIntensity || change.algo.length() || change.impl.length();
+        return state;
+    }
+};
+
+
+/*! The browser side. Frames going out are masked as the server requires, frames coming in are not. Everything is text. */
+class Client {
+public:
+    Client(EpollNetwork &network, AbstractWSServer &server) : network(network), server(server), conn(nullptr) { }
+
+    //! \returns the server response to the upgrade request, empty if it never came.
+    std::string Connect(const std::string &port, const std::string &key) {
+        auto connecting(network.BeginConnection("127.0.0.1", port.c_str()));
+        if(!connecting.first) return std::string();
+        conn = connecting.first;
+        if(!Pump([this]() { return conn->Writable(); })) return std::string();
+        connected = true;
+        const std::string request("GET /admin HTTP/1.1\r\n"
+                                  "Host: 127.0.0.1:" + port + "\r\n"
+                                  "Upgrade: websocket\r\n"
+                                  "Connection: keep-alive, Upgrade\r\n"
+                                  "Sec-WebSocket-Key: " + key + "\r\n"
+                                  "Sec-WebSocket-Version: 13\r\n"
+                                  "Sec-WebSocket-Protocol: M8M-admin\r\n"
+                                  "\r\n");
+        Write(request.data(), request.length());
+        std::string response;
+        Pump([this, &response]() {
+            ReadSome();
+            const asizei end = std::string(inbound.begin(), inbound.end()).find("\r\n\r\n");
+            if(end == std::string::npos) return false;
+            response.assign(inbound.begin(), inbound.begin() + end + 4);
+            inbound.erase(inbound.begin(), inbound.begin() + end + 4);
+            return true;
+        });
+        return response;
+    }
+
+    //! Builds a masked frame, several can be sent together.
+    static std::vector<aubyte> Frame(const std::string &payload, aubyte opcode = 0x1) {
+        std::vector<aubyte> frame;
+        frame.push_back(0x80 | opcode);
+        const aulong len = payload.length();
+        if(len <= 125) frame.push_back(0x80 | aubyte(len));
+        else if(len < 64 * 1024) {
+            frame.push_back(0x80 | 126);
+            for(aint shift = 8; shift >= 0; shift -= 8) frame.push_back(aubyte(len >> shift));
+        }
+        else {
+            frame.push_back(0x80 | 127);
+            for(aint shift = 56; shift >= 0; shift -= 8) frame.push_back(aubyte(len >> shift));
+        }
+        const aubyte mask[4] = { 0x37, 0xfa, 0x21, 0x3d };
+        frame.insert(frame.end(), mask, mask + 4);
+        for(asizei loop = 0; loop < payload.length(); loop++) frame.push_back(aubyte(payload[loop]) ^ mask[loop % 4]);
+        return frame;
+    }
+
+    void Send(const std::vector<aubyte> &frames) { Write(frames.data(), frames.size()); }
+
+    //! Waits for the next complete frame from the server. \returns false if none came. opcode is 0x1 for text.
+    bool Receive(std::string &payload, aubyte *opcode = nullptr) {
+        return Pump([&]() {
+            ReadSome();
+            if(inbound.size() < 2) return false;
+            if((inbound[0] & 0x80) == 0 || (inbound[1] & 0x80)) throw std::string("server frames are final and not masked");
+            asizei header = 2;
+            aulong len = inbound[1] & 0x7F;
+            const asizei extra = len == 126? 2 : (len == 127? 8 : 0);
+            if(extra) {
+                if(inbound.size() < header + extra) return false;
+                len = 0;
+                for(asizei loop = 0; loop < extra; loop++) len = (len << 8) | inbound[header + loop];
+                header += extra;
+            }
+            if(inbound.size() < header + len) return false;
+            if(opcode) *opcode = inbound[0] & 0x0F;
+            payload.assign(inbound.begin() + header, inbound.begin() + header + asizei(len));
+            inbound.erase(inbound.begin(), inbound.begin() + header + asizei(len));
+            return true;
+        });
+    }
+
+    //! Sending a text message, getting its reply.
+    std::string Call(const std::string &json) {
+        Send(Frame(json));
+        std::string reply;
+        if(!Receive(reply)) return "(no reply)";
+        return reply;
+    }
+
+    //! Runs both ends until done() or about 5 seconds.
+    template<typename Done>
+    bool Pump(Done done) {
+        const auto deadline = steady_clock::now() + seconds(5);
+        while(true) {
+            server.UpdateInterest();
+            if(conn) conn->SetInterest(outbound.size() || !connected? Socket::si_write | Socket::si_read : Socket::si_read);
+            network.SleepOn(20);
+            server.Refresh();
+            Flush();
+            if(done()) return true;
+            if(steady_clock::now() > deadline) return false;
+        }
+    }
+
+    NetworkInterface::ConnectedSocketInterface& GetConnection() { return *conn; }
+
+private:
+    EpollNetwork &network;
+    AbstractWSServer &server;
+    NetworkInterface::ConnectedSocketInterface *conn;
+    bool connected = false; //!< until then, waiting to be writable is waiting for the connection
+    std::vector<aubyte> inbound, outbound;
+
+    void Write(const void *data, asizei count) {
+        const aubyte *bytes = reinterpret_cast<const aubyte*>(data);
+        outbound.insert(outbound.end(), bytes, bytes + count);
+        Flush();
+    }
+    void Flush() {
+        if(outbound.empty() || !conn->Works()) return;
+        const asizei sent = conn->Send(outbound.data(), outbound.size());
+        outbound.erase(outbound.begin(), outbound.begin() + sent);
+    }
+    void ReadSome() {
+        aubyte storage[4096];
+        while(conn->Works() && conn->GotData()) {
+            const asizei count = conn->Receive(storage, sizeof(storage));
+            inbound.insert(inbound.end(), storage, storage + count);
+            if(count == 0) break;
+        }
+    }
+};
+
+
+//! Documents are not movable in this rapidjson.
+rapidjson::Document& Parse(rapidjson::Document &dst, const std::string &reply) {
+    dst.Parse(reply.c_str());
+    return dst;
+}
+
+
+std::string GetString(const rapidjson::Value &obj, const char *name) {
+    if(!obj.IsObject() || !obj.HasMember(name) || !obj[name].IsString()) return "(missing)";
+    return std::string(obj[name].GetString(), obj[name].GetStringLength());
+}
+
+
+//! The network hands out ephemeral ports, the server wants to be told one. Grab one, let it go and hope nobody takes it meanwhile.
+aushort FreePort(EpollNetwork &network) {
+    auto &probe(network.NewServiceSocket(0, 0));
+    const aushort port = probe.GetPort();
+    network.CloseServiceSocket(probe);
+    return port;
+}
+
+}
+
+
+int main(int argc, char **argv) {
+    EpollNetwork network;
+    FakeDevices devices;
+    AbstractWSServer server(network, FreePort(network), "admin", "M8M-admin");
+    std::unique_ptr<commands::AbstractCommand> cmd(new commands::admin::DeviceControlCMD(devices));
+    server.RegisterCommand(cmd);
+    server.Listen();
+    CHECK(server.AreYouListening());
+    Client client(network, server);
+
+    // The sample key from RFC 6455, section 1.3.
+    const std::string response(client.Connect(std::to_string(server.port), "dGhlIHNhbXBsZSBub25jZQ=="));
+    CHECK(response.find("HTTP/1.1 101 ") == 0);
+    CHECK(response.find("\r\nSec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n") != std::string::npos);
+    CHECK(response.find("\r\nSec-WebSocket-Protocol: M8M-admin\r\n") != std::string::npos);
+    CHECK(server.GetNumClients() == 1);
+    if(response.empty()) return check::Report("deviceControl");
+
+    {
+        // Nothing to change: it just tells how the device is doing.
+        rapidjson::Document reply;
+        Parse(reply, client.Call("{\"command\":\"deviceControl\",\"params\":{\"device\":1}}"));
+        CHECK(!reply.HasParseError() && reply.IsObject());
+        CHECK(reply["device"].GetUint() == 1);
+        CHECK(GetString(reply, "algo") == "qubit" && GetString(reply, "impl") == "fiveSteps");
+        CHECK(reply["linearIntensity"].GetUint() == 64);
+        CHECK(reply["hashCount"].IsUint64() && reply["hashCount"].GetUint64() == 0x123456789ull);
+        CHECK(reply["paused"].IsFalse() && reply["pending"].IsFalse());
+        CHECK(GetString(reply, "lastChange") == "ok");
+        CHECK(devices.asked.size() == 1);
+        CHECK(devices.asked.back().pause == Control::pr_keep && devices.asked.back().linearIntensity == 0);
+        CHECK(devices.asked.back().algo.empty() && devices.asked.back().impl.empty());
+    }
+    {
+        // Everything at once goes through as a single change.
+        rapidjson::Document reply;
+        Parse(reply, client.Call("{\"command\":\"deviceControl\",\"params\":{\"device\":0,\"pause\":true,\"linearIntensity\":12,"
+                                     "\"algo\":\"neoScrypt\",\"impl\":\"smooth\"}}"));
+        CHECK(reply.IsObject() && reply["device"].GetUint() == 0);
+        CHECK(reply["paused"].IsTrue() && reply["pending"].IsTrue() && reply["linearIntensity"].GetUint() == 12);
+        CHECK(GetString(reply, "algo") == "neoScrypt" && GetString(reply, "impl") == "smooth");
+        CHECK(devices.asked.size() == 2);
+        const auto &change(devices.asked.back());
+        CHECK(change.pause == Control::pr_pause && change.linearIntensity == 12 && change.algo == "neoScrypt" && change.impl == "smooth");
+
+        Parse(reply, client.Call("{\"command\":\"deviceControl\",\"params\":{\"device\":0,\"pause\":false}}"));
+        CHECK(reply.IsObject() && reply["paused"].IsFalse());
+        CHECK(devices.asked.size() == 3 && devices.asked.back().pause == Control::pr_resume);
+    }
+    {
+        // Bad requests are told apart and never get to the devices.
+        const std::pair<const char*, const char*> bad[] = {
+            { "{\"command\":\"deviceControl\"}", "Missing .params object." },
+            { "{\"command\":\"deviceControl\",\"params\":[0]}", "Missing .params object." },
+            { "{\"command\":\"deviceControl\",\"params\":{}}", ".params.device must be a device linear index." },
+            { "{\"command\":\"deviceControl\",\"params\":{\"device\":-1}}", ".params.device must be a device linear index." },
+            { "{\"command\":\"deviceControl\",\"params\":{\"device\":\"0\"}}", ".params.device must be a device linear index." },
+            { "{\"command\":\"deviceControl\",\"params\":{\"device\":0,\"pause\":1}}", ".params.pause must be a boolean." },
+            { "{\"command\":\"deviceControl\",\"params\":{\"device\":0,\"linearIntensity\":0}}", ".params.linearIntensity must be a positive integer." },
+            { "{\"command\":\"deviceControl\",\"params\":{\"device\":0,\"linearIntensity\":2.5}}", ".params.linearIntensity must be a positive integer." },
+            { "{\"command\":\"deviceControl\",\"params\":{\"device\":0,\"algo\":\"\"}}", ".params.algo must be a non-empty string." },
+            { "{\"command\":\"deviceControl\",\"params\":{\"device\":0,\"impl\":7}}", ".params.impl must be a non-empty string." }
+        };
+        const asizei before = devices.asked.size();
+        for(const auto &test : bad) CHECK(client.Call(test.first) == std::string("!!ERROR: ") + test.second + "!!");
+        CHECK(devices.asked.size() == before);
+
+        // What the mining side refuses comes back the same way.
+        CHECK(client.Call("{\"command\":\"deviceControl\",\"params\":{\"device\":9}}") == "!!ERROR: no such device!!");
+        CHECK(client.Call("{\"command\":\"devicecontrol\",\"params\":{\"device\":0}}") == "!!ERROR: no such command \"devicecontrol\"!!");
+    }
+    {
+        // Requests sent together are replied in order.
+        std::vector<aubyte> both(Client::Frame("{\"command\":\"deviceControl\",\"params\":{\"device\":1,\"linearIntensity\":20}}"));
+        const auto second(Client::Frame("{\"command\":\"deviceControl\",\"params\":{\"device\":1,\"linearIntensity\":21}}"));
+        both.insert(both.end(), second.begin(), second.end());
+        client.Send(both);
+        std::string first, next;
+        CHECK(client.Receive(first) && client.Receive(next));
+        rapidjson::Document one, two;
+        CHECK(Parse(one, first)["linearIntensity"].GetUint() == 20 && Parse(two, next)["linearIntensity"].GetUint() == 21);
+    }
+    {
+        // Longer messages use the 16 and 64 bit lengths, both ways.
+        const std::string medium(300, 'm'), huge(70 * 1024, 'h');
+        rapidjson::Document reply;
+        Parse(reply, client.Call("{\"command\":\"deviceControl\",\"params\":{\"device\":1,\"impl\":\"" + medium + "\"}}"));
+        CHECK(GetString(reply, "impl") == medium && devices.asked.back().impl == medium);
+        Parse(reply, client.Call("{\"command\":\"deviceControl\",\"params\":{\"device\":1,\"impl\":\"" + huge + "\"}}"));
+        CHECK(GetString(reply, "impl") == huge && devices.asked.back().impl == huge);
+    }
+    {
+        // Closing: the server confirms and lets the client go.
+        const char normal[2] = { char(1000 >> 8), char(1000 & 0xFF) };
+        client.Send(Client::Frame(std::string(normal, 2), 0x8));
+        std::string payload;
+        aubyte opcode = 0;
+        CHECK(client.Receive(payload, &opcode) && opcode == 0x8);
+        CHECK(client.Pump([&server]() { return server.GetNumClients() == 0; }));
+        network.CloseConnection(client.GetConnection());
+    }
+    return check::Report("deviceControl");
+}
@@ -0,0 +1,152 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#include "check.h"
+#include "../Common/Network.h"
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+/*! EpollNetwork over 127.0.0.1: listening, connecting, moving more data than the socket buffers hold (so the edge triggered
+readiness cache has to be dropped and picked up again), Wake, peer shutdown and refused connections.
+This is built without msvc.h on purpose, it's the compile check for the Linux port as well. */
+namespace {
+
+using namespace std::chrono;
+typedef NetworkInterface::SocketInterface Socket;
+
+//! SleepOn until done() or about 5 seconds. Sockets here are all local, if something takes longer it's broken.
+template<typename Done>
+bool Pump(EpollNetwork &network, Done done) {
+    const auto deadline = steady_clock::now() + seconds(5);
+    while(!done()) {
+        if(steady_clock::now() > deadline) return false;
+        network.SleepOn(100);
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char **argv) {
+    EpollNetwork network;
+    auto &listener(network.NewServiceSocket(0, 0));
+    CHECK(listener.GetPort() != 0);
+    listener.SetInterest(Socket::si_read);
+    const std::string port(std::to_string(listener.GetPort()));
+
+    auto connecting(network.BeginConnection("127.0.0.1", port.c_str()));
+    CHECK(connecting.first && connecting.second == NetworkInterface::ce_ok);
+    if(!connecting.first) return check::Report("epollLoopback");
+    auto &client(*connecting.first);
+    client.SetInterest(Socket::si_write);
+    CHECK(Pump(network, [&]() { return listener.Readable(); }));
+    auto &server(network.BeginConnection(listener));
+    CHECK(Pump(network, [&]() { return client.Writable(); }));
+    CHECK(client.Works() && server.Works());
+
+    // 8 MiB is way more than the loopback buffers so sends go short and both sides have to wait for new edges.
+    std::vector<abyte> sent(8 * 1024 * 1024), got;
+    for(asizei loop = 0; loop < sent.size(); loop++) sent[loop] = abyte(loop * 7 + loop / 4093);
+    got.reserve(sent.size());
+    asizei offset = 0;
+    server.SetInterest(Socket::si_read);
+    std::vector<abyte> storage(64 * 1024);
+    auto transfer = [&]() {
+        if(client.Writable() && offset < sent.size()) {
+            const asizei third = (sent.size() - offset) / 3;
+            NetworkInterface::AbstractDataSocket::Chunk chunks[3] = {
+                { sent.data() + offset, third },
+                { sent.data() + offset + third, third },
+                { sent.data() + offset + third * 2, sent.size() - offset - third * 2 }
+            };
+            offset += client.SendGather(chunks, 3);
+            if(offset == sent.size()) client.SetInterest(Socket::si_none);
+        }
+        if(server.Readable()) {
+            while(true) {
+                const asizei count = server.Receive(storage.data(), storage.size());
+                got.insert(got.end(), storage.begin(), storage.begin() + count);
+                if(count < storage.size()) break;
+            }
+        }
+        return got.size() == sent.size() || !client.Works() || !server.Works();
+    };
+    CHECK(Pump(network, transfer));
+    CHECK(offset == sent.size());
+    CHECK(got == sent);
+
+    // The other way, plain Send.
+    const char *hello = "{\"id\":1,\"result\":true,\"error\":null}\n";
+    CHECK(server.Send(hello, strlen(hello)) == strlen(hello));
+    client.SetInterest(Socket::si_read);
+    CHECK(Pump(network, [&]() { return client.Readable(); }));
+    char line[64];
+    CHECK(client.Receive(line, sizeof(line)) == strlen(hello) && memcmp(line, hello, strlen(hello)) == 0);
+    CHECK(!client.GotData());
+
+    {
+        // Nobody interested in anything and a long timeout: only Wake can get us out early.
+        client.SetInterest(Socket::si_none);
+        server.SetInterest(Socket::si_none);
+        listener.SetInterest(Socket::si_none);
+        std::thread waker([&network]() {
+            std::this_thread::sleep_for(milliseconds(50));
+            network.Wake();
+        });
+        const auto start = steady_clock::now();
+        CHECK(network.SleepOn(10000) == 0);
+        CHECK(steady_clock::now() - start < seconds(5));
+        waker.join();
+    }
+
+    // Peer going away is signaled as readable, then the read tells there's nothing more.
+    client.SetInterest(Socket::si_read);
+    network.CloseConnection(server);
+    CHECK(Pump(network, [&]() { return client.Readable(); }));
+    client.Receive(line, sizeof(line));
+    CHECK(!client.Works());
+    network.CloseConnection(client);
+
+    {
+        // connect() failing right away with something else than refused, ENETUNREACH for a broadcast address, is just an address
+        // which did not work. Nothing thrown: it's either told right away or the socket fails, depending on resolution being cached.
+        auto unreachable(network.BeginConnection("255.255.255.255", port.c_str()));
+        if(unreachable.first) {
+            unreachable.first->SetInterest(Socket::si_write);
+            CHECK(Pump(network, [&]() { return unreachable.first->Signaled(); }));
+            CHECK(!unreachable.first->Works());
+            network.CloseConnection(*unreachable.first);
+        }
+        else CHECK(unreachable.second == NetworkInterface::ce_noRoutes);
+    }
+
+    {
+        // Nobody listening there anymore, the connection must fail rather than hang.
+        const std::string gone(port);
+        network.CloseServiceSocket(listener);
+        auto refused(network.BeginConnection("127.0.0.1", gone.c_str()));
+        if(refused.first) {
+            refused.first->SetInterest(Socket::si_write);
+            CHECK(Pump(network, [&]() { return refused.first->Signaled(); }));
+            CHECK(!refused.first->Works());
+            network.CloseConnection(*refused.first);
+        }
+    }
+
+    {
+        // Service sockets are only good for the network which made them.
+        EpollNetwork other;
+        auto &foreign(other.NewServiceSocket(0, 0));
+        bool thrown = false;
+        try {
+            network.BeginConnection(foreign);
+        } catch(const std::runtime_error &) {
+            thrown = true;
+        }
+        CHECK(thrown);
+    }
+    return check::Report("epollLoopback");
+}
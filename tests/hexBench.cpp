@@ -0,0 +1,67 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#include "../Common/Stratum/hexCodec.h"
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+/*! Benchmark: hex codec throughput, each path on its own and the dispatching calls the stratum code uses. GB/s are of binary data
+produced (decode) or consumed (encode), so the two compare. Sizes are what stratum has: 4 bytes (ntime, nbits, nonces), 32 (prevhash,
+merkles), a couple hundred (coinbase halves) and a big buffer to see the paths at full speed. */
+namespace {
+
+using namespace stratum::hex;
+typedef std::chrono::steady_clock Clock;
+
+const asizei TOTAL = 64 * 1024 * 1024; //!< bytes for each measurement
+
+//! \returns GB/s of calling op on size bytes until TOTAL bytes went through.
+template<typename Op>
+double Measure(asizei size, Op &&op) {
+    const asizei rounds = TOTAL / size;
+    const auto start(Clock::now());
+    for(asizei loop = 0; loop < rounds; loop++) op();
+    return double(rounds * size) / std::chrono::duration<double>(Clock::now() - start).count() / 1e9;
+}
+
+}
+
+
+int main(int argc, char **argv) {
+    std::mt19937 gen(28);
+    const asizei BIG = 1024 * 1024;
+    std::vector<aubyte> binary(BIG), decoded(BIG);
+    for(auto &el : binary) el = aubyte(gen());
+    std::vector<char> hex(BIG * 2);
+    Encode(hex.data(), binary.data(), BIG);
+    volatile bool sink = true;
+
+#if STRATUM_HEX_SIMD
+    const bool avx2 = detail::HasAVX2();
+    std::cout<<"hexBench, GB/s of binary, SSE2"<<(avx2? " and AVX2" : ", no AVX2 here")<<std::endl;
+#else
+    const bool avx2 = false;
+    std::cout<<"hexBench, GB/s of binary, scalar only on this target"<<std::endl;
+#endif
+    for(asizei size : { asizei(4), asizei(32), asizei(200), BIG }) {
+        std::cout<<"  "<<size<<" bytes"<<std::endl;
+        std::cout<<"    decode scalar "<<Measure(size, [&]() { sink = detail::DecodeScalar(decoded.data(), hex.data(), size); });
+#if STRATUM_HEX_SIMD
+        std::cout<<", SSE2 "<<Measure(size, [&]() {
+            asizei left = size;
+            sink = detail::DecodeSSE2(decoded.data(), hex.data(), left) && detail::DecodeScalar(decoded.data() + size - left, hex.data() + (size - left) * 2, left);
+        });
+        if(avx2) std::cout<<", AVX2 "<<Measure(size, [&]() {
+            asizei left = size;
+            sink = detail::DecodeAVX2(decoded.data(), hex.data(), left) && detail::DecodeScalar(decoded.data() + size - left, hex.data() + (size - left) * 2, left);
+        });
+#endif
+        std::cout<<", Decode "<<Measure(size, [&]() { sink = Decode(decoded.data(), hex.data(), size * 2); })<<std::endl;
+        std::cout<<"    encode scalar "<<Measure(size, [&]() { detail::EncodeScalar(hex.data(), binary.data(), size); });
+        std::cout<<", Encode "<<Measure(size, [&]() { Encode(hex.data(), binary.data(), size); })<<std::endl;
+    }
+    return sink && decoded == binary? 0 : 1;
+}
@@ -0,0 +1,96 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#include "check.h"
+#include "../Common/Stratum/hexCodec.h"
+#include <random>
+#include <string>
+#include <vector>
+
+/*! The scalar code is the reference: every other path must agree with it on the outcome and, when successful, on every byte.
+Inputs are random lengths (so every path gets its tail handed over to the next one) of mostly valid hex, sometimes
+with a single bad char thrown in at a random place. Chars adjacent to the valid ranges are the interesting ones. */
+namespace {
+
+using namespace stratum::hex;
+
+const char *nearMisses = "/:@G`g \x7F\x80\xFF";
+
+std::string RandomHex(std::mt19937 &gen, asizei len) {
+    const char *digits = "0123456789abcdefABCDEF";
+    std::string ret(len, '0');
+    for(auto &c : ret) c = digits[gen() % 22];
+    return ret;
+}
+
+void CheckDecode(const std::string &hex) {
+    const asizei bytes = hex.length() / 2;
+    std::vector<aubyte> reference(bytes + 1, 0), fast(bytes + 1, 0);
+    const bool refOK = hex.length() % 2 == 0 && detail::DecodeScalar(reference.data(), hex.c_str(), bytes);
+    const bool fastOK = Decode(fast.data(), hex.c_str(), hex.length());
+    CHECK(refOK == fastOK);
+    if(refOK && fastOK) CHECK(reference == fast);
+#if STRATUM_HEX_SIMD
+    if(hex.length() % 2) return;
+    // Also the single paths on their own, Decode could pick one and never test the other.
+    std::vector<aubyte> sse(bytes + 1, 0);
+    asizei left = bytes;
+    bool sseOK = detail::DecodeSSE2(sse.data(), hex.c_str(), left);
+    const asizei done = bytes - left;
+    if(sseOK) sseOK = detail::DecodeScalar(sse.data() + done, hex.c_str() + done * 2, left);
+    CHECK(refOK == sseOK);
+    if(refOK && sseOK) CHECK(reference == sse);
+    if(!detail::HasAVX2()) return;
+    std::vector<aubyte> avx(bytes + 1, 0);
+    left = bytes;
+    bool avxOK = detail::DecodeAVX2(avx.data(), hex.c_str(), left);
+    const asizei avxDone = bytes - left;
+    if(avxOK) avxOK = detail::DecodeScalar(avx.data() + avxDone, hex.c_str() + avxDone * 2, left);
+    CHECK(refOK == avxOK);
+    if(refOK && avxOK) CHECK(reference == avx);
+#endif
+}
+
+void CheckEncode(const std::vector<aubyte> &bin) {
+    std::string reference(bin.size() * 2, '?'), fast(bin.size() * 2, '?');
+    detail::EncodeScalar(&reference[0], bin.data(), bin.size());
+    Encode(&fast[0], bin.data(), bin.size());
+    CHECK(reference == fast);
+    std::vector<aubyte> back(bin.size());
+    CHECK(Decode(back.data(), fast.c_str(), fast.length()));
+    CHECK(back == bin);
+}
+
+}
+
+int main(int argc, char **argv) {
+    CheckDecode("");
+    CheckDecode("0");
+    CheckDecode("00112233445566778899aAbBcCdDeEfF");
+    CheckDecode("00112233445566778899aAbBcCdDeEfG");
+    {
+        aubyte out[4];
+        CHECK(Decode(out, "DEADbeef", 8) && out[0] == 0xDE && out[1] == 0xAD && out[2] == 0xBE && out[3] == 0xEF);
+        char text[8];
+        EncodeBE(text, 0x0123ABCDu);
+        CHECK(std::string(text, 8) == "0123abcd");
+        EncodeLE(text, 0x0123ABCDu);
+        CHECK(std::string(text, 8) == "cdab2301");
+    }
+    std::mt19937 gen(28);
+    for(asizei loop = 0; loop < 20000; loop++) {
+        std::string hex(RandomHex(gen, gen() % 150));
+        if(hex.length() && gen() % 2) hex[gen() % hex.length()] = nearMisses[gen() % strlen(nearMisses)];
+        CheckDecode(hex);
+        std::vector<aubyte> bin(gen() % 80);
+        for(auto &b : bin) b = aubyte(gen());
+        CheckEncode(bin);
+    }
+#if STRATUM_HEX_SIMD
+    printf("hexCodec: SIMD paths tested, AVX2 %s.\n", stratum::hex::detail::HasAVX2() ? "included" : "not available");
+#else
+    printf("hexCodec: no SIMD on this target, scalar only.\n");
+#endif
+    return check::Report("hexCodec");
+}
@@ -0,0 +1,133 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+/* Benchmark: messages per second on recorded pool traffic (streams/poolTraffic.stratum or the file given), mostly submit replies with
+a notify every hundred lines, some difficulty changes, rejects and a message of the day. Each line is taken to its product the way
+AbstractWorkSource::ProcessLine does it, with the DOM only and with HotMessageParser first, the DOM for what it declines.
+Lines are copied to a scratch buffer before each parse in both cases as ParseInsitu needs it. Also each kind on its own. */
+#include "Stratum/hotParsing.h"
+#include <rapidjson/document.h>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace stratum;
+using namespace stratum::parsing;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+//! Products are summed in there so nothing gets optimized away.
+struct Sink {
+    asizei notified = 0, merkles = 0, accepted = 0, rejected = 0, other = 0;
+    double diff = 0;
+};
+
+void Dom(rapidjson::Document &json, char *line, Sink &sink) {
+    json.ParseInsitu(line);
+    const auto method(json.FindMember("method"));
+    if(method != json.MemberEnd() && method->value.IsString()) {
+        if(!strcmp(method->value.GetString(), "mining.notify")) {
+            std::unique_ptr<MiningNotify> product(MiningNotifyParser().Mangle(json["params"]));
+            sink.notified++;
+            sink.merkles += product->merkles.size();
+        }
+        else if(!strcmp(method->value.GetString(), "mining.set_difficulty")) {
+            std::unique_ptr<MiningSetDifficultyNotify> product(MiningSetDifficulty().Mangle(json["params"]));
+            sink.diff += product->newDiff;
+        }
+        else sink.other++;
+        return;
+    }
+    const rapidjson::Value &result(json["result"]);
+    if(result.IsBool()) {
+        std::unique_ptr<MiningSubmitResponse> product(MiningSubmit().Mangle(result));
+        if(product->accepted) sink.accepted++;
+        else sink.rejected++;
+    }
+    else sink.rejected++;
+}
+
+void Hot(HotMessageParser &hot, MiningNotify &notify, rapidjson::Document &json, char *line, Sink &sink) {
+    if(hot.Parse(line)) {
+        double diff;
+        aulong id;
+        bool accepted;
+        switch(hot.GetKind()) {
+        case HotMessageParser::hm_notify:
+            if(!hot.Decode(notify)) break;
+            sink.notified++;
+            sink.merkles += notify.merkles.size();
+            return;
+        case HotMessageParser::hm_difficulty:
+            if(!hot.Decode(diff)) break;
+            sink.diff += diff;
+            return;
+        case HotMessageParser::hm_reply:
+            if(!hot.GetSubmitReply(id, accepted)) break;
+            if(accepted) sink.accepted++;
+            else sink.rejected++;
+            return;
+        default: break;
+        }
+    }
+    Dom(json, line, sink);
+}
+
+//! \returns messages per second going through all the lines the given number of times.
+template<typename Parse>
+double Run(const std::vector<std::string> &lines, asizei times, Sink &sink, Parse &&parse) {
+    std::vector<char> scratch;
+    const auto start(Clock::now());
+    for(asizei loop = 0; loop < times; loop++) {
+        for(const auto &line : lines) {
+            scratch.assign(line.c_str(), line.c_str() + line.length() + 1);
+            parse(scratch.data(), sink);
+        }
+    }
+    return lines.size() * times / std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+}
+
+
+int main(int argc, char **argv) {
+    std::ifstream in(argc > 1? argv[1] : "streams/poolTraffic.stratum");
+    std::vector<std::string> lines, notifies, replies;
+    for(std::string line; std::getline(in, line); ) {
+        if(line.empty()) continue;
+        lines.push_back(line);
+        if(line.find("mining.notify") != std::string::npos) notifies.push_back(line);
+        else if(line.find("\"result\":true") != std::string::npos) replies.push_back(line);
+    }
+    if(lines.empty()) {
+        std::cout<<"hotParseBench: no traffic to parse"<<std::endl;
+        return 1;
+    }
+    rapidjson::Document json;
+    HotMessageParser hot;
+    MiningNotify notify;
+    auto dom = [&json](char *line, Sink &sink) { Dom(json, line, sink); };
+    auto fast = [&](char *line, Sink &sink) { Hot(hot, notify, json, line, sink); };
+    std::cout<<"hotParseBench, "<<lines.size()<<" lines ("<<notifies.size()<<" notifies, "<<replies.size()<<" accepted shares), messages/s"<<std::endl;
+    struct Set {
+        const char *name;
+        const std::vector<std::string> &lines;
+        asizei times;
+    } sets[] = {
+        { "recorded traffic: ", lines, 100 },
+        { "notifies only:    ", notifies, 1000 },
+        { "share replies:    ", replies, 100 }
+    };
+    for(const auto &set : sets) {
+        Sink one, two;
+        const double slow = Run(set.lines, set.times, one, dom), quick = Run(set.lines, set.times, two, fast);
+        const bool same = one.notified == two.notified && one.merkles == two.merkles && one.accepted == two.accepted &&
+                          one.rejected == two.rejected && one.other == two.other && one.diff == two.diff;
+        std::cout<<"  "<<set.name<<"DOM "<<slow<<", hot "<<quick<<" ("<<quick / slow<<"x)"<<(same? "" : " (products differ!)")<<std::endl;
+    }
+    return 0;
+}
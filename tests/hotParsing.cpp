@@ -0,0 +1,165 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+/* HotMessageParser must agree with the DOM parsers on everything it accepts: same products, same errors.
+Everything it declines goes through the DOM anyway so declining is always correct, but the lines pools send most
+(notify, set_difficulty and submit replies) must be accepted or the hot path is pointless. */
+#include "check.h"
+#include "Stratum/hotParsing.h"
+#include <rapidjson/document.h>
+#include <random>
+
+using namespace stratum;
+using namespace stratum::parsing;
+
+namespace {
+
+enum Outcome { o_declined, o_accepted, o_threw };
+
+Outcome Hot(HotMessageParser &hot, const std::string &line, MiningNotify &notify, double &diff, aulong &id, bool &accepted) {
+    if(!hot.Parse(line.c_str())) return o_declined;
+    try {
+        switch(hot.GetKind()) {
+        case HotMessageParser::hm_notify: return hot.Decode(notify)? o_accepted : o_declined;
+        case HotMessageParser::hm_difficulty: return hot.Decode(diff)? o_accepted : o_declined;
+        case HotMessageParser::hm_reply: return hot.GetSubmitReply(id, accepted)? o_accepted : o_declined;
+        default: return o_declined;
+        }
+    }
+    catch(...) { return o_threw; }
+}
+
+//! What AbstractWorkSource::ProcessLine and WorkSource do for the same line. Replies are taken as replies to a submit.
+Outcome Dom(const std::string &line, HotMessageParser::Kind kind, MiningNotify &notify, double &diff, bool &accepted) {
+    std::vector<char> copy(line.cbegin(), line.cend());
+    copy.push_back(0);
+    rapidjson::Document json;
+    json.ParseInsitu(copy.data());
+    if(json.HasParseError()) return o_threw;
+    try {
+        switch(kind) {
+        case HotMessageParser::hm_notify: {
+            std::unique_ptr<MiningNotify> product(MiningNotifyParser().Mangle(json["params"]));
+            notify = *product;
+            return o_accepted;
+        }
+        case HotMessageParser::hm_difficulty: {
+            std::unique_ptr<MiningSetDifficultyNotify> product(MiningSetDifficulty().Mangle(json["params"]));
+            diff = product->newDiff;
+            return o_accepted;
+        }
+        case HotMessageParser::hm_reply: {
+            std::unique_ptr<MiningSubmitResponse> product(MiningSubmit().Mangle(json["result"]));
+            accepted = product->accepted;
+            return o_accepted;
+        }
+        default: return o_declined;
+        }
+    }
+    catch(...) { return o_threw; }
+}
+
+bool Same(const MiningNotify &one, const MiningNotify &two) {
+    if(one.job != two.job || one.prevHash != two.prevHash || one.coinBaseOne != two.coinBaseOne || one.coinBaseTwo != two.coinBaseTwo) return false;
+    if(one.blockVer != two.blockVer || one.nbits != two.nbits || one.ntime != two.ntime || one.clear != two.clear) return false;
+    if(one.merkles.size() != two.merkles.size()) return false;
+    for(asizei loop = 0; loop < one.merkles.size(); loop++) {
+        if(one.merkles[loop].hash != two.merkles[loop].hash) return false;
+    }
+    return true;
+}
+
+//! \returns what the hot parser did, after checking the DOM agrees.
+Outcome Compare(HotMessageParser &hot, const std::string &line) {
+    MiningNotify hotNotify, domNotify;
+    double hotDiff = -1, domDiff = -2;
+    aulong id = 0;
+    bool hotAccepted = false, domAccepted = true;
+    const Outcome fast = Hot(hot, line, hotNotify, hotDiff, id, hotAccepted);
+    if(fast == o_declined) return fast;
+    const auto kind(hot.GetKind());
+    const Outcome slow = Dom(line, kind, domNotify, domDiff, domAccepted);
+    CHECK(fast == slow);
+    if(fast != slow) std::cout<<"    "<<line<<std::endl;
+    else if(fast == o_accepted) {
+        if(kind == HotMessageParser::hm_notify) CHECK(Same(hotNotify, domNotify));
+        if(kind == HotMessageParser::hm_difficulty) CHECK(hotDiff == domDiff);
+        if(kind == HotMessageParser::hm_reply) CHECK(hotAccepted == domAccepted);
+    }
+    return fast;
+}
+
+const std::string prevHash("0123456789abcdef0123456789ABCDEF00112233445566778899aabbccddeeff");
+
+std::string Notify(const std::string &job, const std::string &prev, const std::string &cb1, const std::string &cb2,
+                   const std::vector<std::string> &merkles, const std::string &ver, const std::string &bits, const std::string &time,
+                   const char *clear, const char *id = "null") {
+    std::string line("{\"id\":" + std::string(id) + ",\"method\":\"mining.notify\",\"params\":[\"" + job + "\",\"" + prev + "\",\"" + cb1 + "\",\"" + cb2 + "\",[");
+    for(asizei loop = 0; loop < merkles.size(); loop++) line += (loop? ",\"" : "\"") + merkles[loop] + '"';
+    return line + "],\"" + ver + "\",\"" + bits + "\",\"" + time + "\"," + clear + "]}";
+}
+
+std::string RandomHex(std::mt19937 &gen, asizei len) {
+    const char *digits = "0123456789abcdefABCDEF";
+    std::string ret;
+    for(asizei loop = 0; loop < len; loop++) ret.push_back(digits[gen() % 22]);
+    return ret;
+}
+
+}
+
+
+int main() {
+    HotMessageParser hot; // reused across lines as AbstractWorkSource does
+    const std::vector<std::string> twoMerkles { prevHash, "ffeeddccbbaa99887766554433221100ffeeddccbbaa99887766554433221100" };
+
+    // The hot ones, which must be accepted.
+    CHECK(Compare(hot, Notify("4f2a", prevHash, "01000000010000", "ffffffff0100", twoMerkles, "00000002", "1b0404cb", "504e86ed", "true")) == o_accepted);
+    CHECK(Compare(hot, Notify("x", prevHash, "", "", { }, "20000000", "1d00ffff", "5a0b0c0d", "false")) == o_accepted);
+    CHECK(Compare(hot, Notify("job", prevHash, "aa", "bb", twoMerkles, "00000002", "1b0404cb", "504e86ed", "false", "7")) == o_accepted); // P2Pool
+    CHECK(Compare(hot, "{\"id\":null,\"method\":\"mining.set_difficulty\",\"params\":[16]}") == o_accepted);
+    CHECK(Compare(hot, "{\"id\":null,\"method\":\"mining.set_difficulty\",\"params\":[0.0625]}") == o_accepted);
+    CHECK(Compare(hot, "{\"params\":[2.5],\"id\":null,\"method\":\"mining.set_difficulty\"}") == o_accepted);
+    CHECK(Compare(hot, "{\"id\":4,\"result\":true,\"error\":null}") == o_accepted);
+    CHECK(Compare(hot, "{\"id\":5,\"result\":false,\"error\":null}") == o_accepted);
+    CHECK(Compare(hot, "{\"id\":\"12\",\"result\":true}") == o_accepted);
+
+    // Malformed values: both must complain.
+    CHECK(Compare(hot, Notify("j", prevHash, "0g", "", { }, "00000002", "1b0404cb", "504e86ed", "true")) == o_threw);
+    CHECK(Compare(hot, Notify("j", prevHash, "abc", "", { }, "00000002", "1b0404cb", "504e86ed", "true")) == o_threw);
+    CHECK(Compare(hot, Notify("j", prevHash + "00", "", "", { }, "00000002", "1b0404cb", "504e86ed", "true")) == o_threw);
+    CHECK(Compare(hot, Notify("j", prevHash, "", "", { "zz" }, "00000002", "1b0404cb", "504e86ed", "true")) == o_threw);
+    CHECK(Compare(hot, Notify("j", prevHash, "", "", { }, "0000000002", "1b0404cb", "504e86ed", "true")) == o_threw);
+
+    // Anything unusual goes to the DOM.
+    CHECK(Compare(hot, "{\"id\":1,\"result\":[[[\"mining.notify\",\"ae68\"]],\"08000002\",4],\"error\":null}") == o_declined);
+    CHECK(Compare(hot, "{\"id\":2,\"result\":null,\"error\":[21,\"Job not found\",null]}") == o_declined);
+    CHECK(Compare(hot, "{\"id\":2,\"result\":null,\"error\":{\"code\":23,\"message\":\"Low difficulty\"}}") == o_declined);
+    CHECK(Compare(hot, "{\"id\":3,\"method\":\"client.get_version\",\"params\":[]}") == o_declined);
+    CHECK(Compare(hot, "{\"id\":null,\"method\":\"mining.set_difficulty\",\"params\":[18446744073709551615]}") == o_declined);
+    CHECK(Compare(hot, "{\"id\":null,\"method\":\"mining.notify\",\"params\":{\"job\":1}}") == o_declined);
+    CHECK(Compare(hot, "{\"id\":null,\"method\":\"mining.notify\",\"params\":[1,2,3]}") == o_declined);
+    CHECK(Compare(hot, "{\"id\":-1,\"result\":true,\"error\":null}") == o_declined);
+    CHECK(Compare(hot, "{\"id\":\"a1\",\"result\":true,\"error\":null}") == o_declined);
+    CHECK(Compare(hot, "{\"id\":4,\"result\":true,\"error\":null") == o_declined); // truncated
+    CHECK(Compare(hot, "") == o_declined);
+
+    /* Random notifies, valid and not. Whatever hot accepts, the DOM must produce the same; whatever it throws on, the DOM must throw on.
+    Hashes shorter than 32 bytes are accepted by both but leave the rest of the array as it was so they're not generated,
+    wrong hashes are too long or odd. */
+    std::mt19937 gen(50);
+    asizei accepted = 0;
+    auto hash = [&gen]() { return RandomHex(gen, gen() % 16? 64 : 65 + gen() % 6); };
+    for(asizei loop = 0; loop < 2000; loop++) {
+        std::vector<std::string> merkles(gen() % 12);
+        for(auto &el : merkles) el = hash();
+        auto field = [&gen](asizei good) { return RandomHex(gen, gen() % 16? good : gen() % 12); };
+        const std::string line(Notify(RandomHex(gen, 1 + gen() % 8), hash(),
+                                      RandomHex(gen, 2 * (gen() % 100)), RandomHex(gen, 2 * (gen() % 100) + (gen() % 16 == 0)),
+                                      merkles, field(8), field(8), field(8), gen() % 2? "true" : "false"));
+        if(Compare(hot, line) == o_accepted) accepted++;
+    }
+    CHECK(accepted > 100); // most are valid, make sure the comparison is not vacuous
+    return check::Report("hotParsing");
+}
@@ -0,0 +1,104 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#include "../M8M/IsolatedWorker.h"
+#include <algorithm>
+#include <iostream>
+
+/*! Benchmark: what isolation adds to each result. A header goes down the work ring, an echo worker sends a result packet back for it,
+the time is from pushing the work to popping the result. Both sides poll with isolation::Backoff as M8M does.
+- in process: the same Channel in plain memory, the echo is a thread;
+- isolated: the Channel in SharedMemory, the echo is a worker process started by a Supervisor, as isolatedWorker.cpp does.
+Each is measured back to back, the poller always spinning, and paced every few milliseconds as GPU iterations are, where the poller
+has gone to sleep by the time the next one comes. Microseconds. */
+namespace {
+
+using namespace isolation;
+typedef Supervisor::Clock Clock;
+
+void Echo(Channel &channel) {
+    channel.state.store(ws_running, std::memory_order_release);
+    Backoff idle;
+    while(channel.quit.load(std::memory_order_acquire) == 0) {
+        channel.heartbeat.fetch_add(1, std::memory_order_relaxed);
+        WorkPacket work;
+        if(!channel.work.Pop(work)) {
+            idle.Idle();
+            continue;
+        }
+        idle.Busy();
+        ResultPacket found = ResultPacket();
+        found.id = work.id;
+        found.flags = ResultPacket::rp_iteration;
+        found.count = 1;
+        while(!channel.results.Push(found)) std::this_thread::yield();
+    }
+}
+
+//! \returns round trips, microseconds, sorted. Tick is called while waiting, the supervisor needs it.
+template<typename Tick>
+std::vector<double> RoundTrips(Channel &channel, asizei count, std::chrono::microseconds pace, Tick tick) {
+    std::vector<double> took;
+    took.reserve(count);
+    for(asizei loop = 0; loop < count; loop++) {
+        if(pace.count()) std::this_thread::sleep_for(pace);
+        WorkPacket work = WorkPacket();
+        work.id = auint(loop + 1);
+        const auto sent(Clock::now());
+        while(!channel.work.Push(work)) std::this_thread::yield();
+        Backoff idle;
+        ResultPacket got;
+        while(!channel.results.Pop(got) || got.id != work.id) idle.Idle();
+        took.push_back(std::chrono::duration<double, std::micro>(Clock::now() - sent).count());
+        if(loop % 64 == 0) tick();
+    }
+    std::sort(took.begin(), took.end());
+    return took;
+}
+
+void Print(const char *what, const std::vector<double> &sorted) {
+    auto at = [&sorted](double fraction) { return sorted[std::min(sorted.size() - 1, asizei(fraction * sorted.size()))]; };
+    std::cout<<"  "<<what<<"p50 "<<at(.5)<<", p90 "<<at(.9)<<", p99 "<<at(.99)<<", max "<<sorted.back()<<std::endl;
+}
+
+}
+
+
+int main(int argc, char **argv) {
+    if(argc == 3 && std::string(argv[1]) == "--worker") {
+        SharedMemory shared(argv[2], sizeof(Channel), SharedMemory::sm_open);
+        auto &channel(*reinterpret_cast<Channel*>(shared.Get()));
+        if(channel.version != PROTOCOL_VERSION) return 3;
+        Echo(channel);
+        return 0;
+    }
+    const asizei BACK_TO_BACK = 20000, PACED = 500;
+    const std::chrono::microseconds PACE(3000);
+    std::cout<<"isolatedLatency, work to result round trip, microseconds"<<std::endl;
+    {
+        std::unique_ptr<Channel> channel(new Channel());
+        channel->version = PROTOCOL_VERSION;
+        std::thread echo([&]() { Echo(*channel); });
+        while(channel->state.load() != ws_running) std::this_thread::yield();
+        auto nothing = []() { };
+        Print("in process, back to back: ", RoundTrips(*channel, BACK_TO_BACK, std::chrono::microseconds(0), nothing));
+        Print("in process, paced:        ", RoundTrips(*channel, PACED, PACE, nothing));
+        channel->quit = 1;
+        echo.join();
+    }
+    {
+        Supervisor sup(ChildProcess::GetOwnExecutable(), std::vector<std::string>(), 0);
+        const auto limit(Clock::now() + std::chrono::seconds(10));
+        while(sup.Supervise(Clock::now()) != Supervisor::s_running && Clock::now() < limit) std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        if(!sup.GetChannel()) {
+            std::cout<<"  worker did not start: "<<sup.GetLastError()<<std::endl;
+            return 1;
+        }
+        auto tick = [&sup]() { sup.Supervise(Clock::now()); };
+        Print("isolated, back to back:   ", RoundTrips(*sup.GetChannel(), BACK_TO_BACK, std::chrono::microseconds(0), tick));
+        Print("isolated, paced:          ", RoundTrips(*sup.GetChannel(), PACED, PACE, tick));
+        sup.Stop(std::chrono::seconds(2));
+    }
+    return 0;
+}
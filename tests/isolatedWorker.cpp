@@ -0,0 +1,152 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#include "check.h"
+#include "../M8M/IsolatedWorker.h"
+#include <signal.h>
+#include <sys/resource.h>
+
+/*! isolation::Supervisor against fake workers. As M8M does, this program is its own worker: the supervisor starts it again as
+"isolatedWorker <behaviour> --worker <channel>" and the worker side does whatever behaviour says, talking the real Channel protocol.
+There's no OpenCL in here, the point is what the supervisor does with workers crashing, hanging, failing or never getting ready. */
+namespace {
+
+using namespace isolation;
+typedef Supervisor::Clock Clock;
+
+int FakeWorker(const std::string &behaviour, const std::string &name) {
+    rlimit none = { 0, 0 };
+    setrlimit(RLIMIT_CORE, &none); // crashing is the point, no need to leave cores around
+    SharedMemory shared(name, sizeof(Channel), SharedMemory::sm_open);
+    auto &channel(*reinterpret_cast<Channel*>(shared.Get()));
+    if(channel.version != PROTOCOL_VERSION) return 3;
+    if(behaviour == "exit") return 5;
+    if(behaviour == "fail") {
+        strcpy(channel.message, "no such device");
+        channel.state.store(ws_failed, std::memory_order_release);
+        return 2;
+    }
+    if(behaviour == "silent") {
+        while(true) std::this_thread::sleep_for(std::chrono::seconds(1)); // never gets to ws_running
+    }
+    channel.state.store(ws_running, std::memory_order_release);
+    const auto started(Clock::now());
+    while(channel.quit.load(std::memory_order_acquire) == 0) {
+        if(behaviour == "hang" && Clock::now() > started + std::chrono::milliseconds(100)) {
+            while(true) std::this_thread::sleep_for(std::chrono::seconds(1)); // stuck in a driver call
+        }
+        if(behaviour == "crash" && Clock::now() > started + std::chrono::milliseconds(100)) abort();
+        channel.heartbeat.fetch_add(1, std::memory_order_relaxed);
+        WorkPacket work;
+        while(channel.work.Pop(work)) { // "finds" a nonce derived from the work so the parent can tell it's been processed
+            ResultPacket found = ResultPacket();
+            found.id = work.id;
+            found.flags = ResultPacket::rp_iteration;
+            found.count = 1;
+            found.nonces[0] = work.id * 2 + work.header[0];
+            while(!channel.results.Push(found)) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return 0;
+}
+
+
+//! Supervises until done() or timeout. Supervisor timeouts are in seconds so waiting a few of them is normal.
+template<typename Done>
+bool Until(Supervisor &sup, Done done, std::chrono::seconds timeout = std::chrono::seconds(10)) {
+    const auto limit(Clock::now() + timeout);
+    while(Clock::now() < limit) {
+        sup.Supervise(Clock::now());
+        if(done()) return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return false;
+}
+
+
+std::unique_ptr<Supervisor> Make(const std::string &behaviour) {
+    std::unique_ptr<Supervisor> sup(new Supervisor(ChildProcess::GetOwnExecutable(), std::vector<std::string>(1, behaviour), 7));
+    sup->startTimeout = std::chrono::seconds(1);
+    sup->hangTimeout = std::chrono::seconds(1);
+    sup->minBackoff = std::chrono::milliseconds(10);
+    sup->maxBackoff = std::chrono::milliseconds(40);
+    return sup;
+}
+
+}
+
+
+int main(int argc, char **argv) {
+    if(argc == 4 && std::string(argv[2]) == "--worker") return FakeWorker(argv[1], argv[3]);
+    CHECK(ChildProcess::GetOwnExecutable().size());
+    {
+        // The good one: starts, does work, goes away when asked.
+        auto sup(Make("good"));
+        CHECK(Until(*sup, [&]() { return sup->Supervise(Clock::now()) == Supervisor::s_running; }));
+        CHECK(sup->GetChannel() && sup->GetChannel()->device == 7);
+        WorkPacket work = WorkPacket();
+        work.id = 21;
+        work.header[0] = 3;
+        CHECK(sup->GetChannel()->work.Push(work));
+        ResultPacket got = ResultPacket();
+        CHECK(Until(*sup, [&]() { return sup->GetChannel()->results.Pop(got); }));
+        CHECK(got.id == 21 && got.count == 1 && got.nonces[0] == 45);
+        // Working fine for longer than hangTimeout, it's beating.
+        std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+        CHECK(sup->Supervise(Clock::now()) == Supervisor::s_running);
+        CHECK(sup->GetRestarts() == 0 && sup->GetIncarnation() == 1);
+        const auto stopping(Clock::now());
+        sup->Stop(std::chrono::seconds(5));
+        CHECK(Clock::now() - stopping < std::chrono::seconds(2)); // it quit by itself, not killed after the grace
+        CHECK(sup->GetChannel() == nullptr);
+    }
+    {
+        // Crashing after running is restarted with a new channel, failures while running do not count towards giving up.
+        auto sup(Make("crash"));
+        CHECK(Until(*sup, [&]() { return sup->GetRestarts() >= 4; }, std::chrono::seconds(20)));
+        CHECK(sup->GetLastError() == "worker exited, code " + std::to_string(-SIGABRT));
+        CHECK(sup->Supervise(Clock::now()) != Supervisor::s_gaveUp);
+        CHECK(sup->GetIncarnation() >= 4);
+    }
+    {
+        // Hanging is noticed through the heartbeat, the process is killed and started again.
+        auto sup(Make("hang"));
+        CHECK(Until(*sup, [&]() { return sup->GetRestarts() >= 1; }));
+        CHECK(sup->GetLastError() == "worker hung");
+        CHECK(Until(*sup, [&]() { return sup->Supervise(Clock::now()) == Supervisor::s_running; }));
+        CHECK(sup->GetIncarnation() == 2);
+    }
+    {
+        // Failing to initialize tells why. Doing so maxStartFailures times in a row is final.
+        auto sup(Make("fail"));
+        CHECK(Until(*sup, [&]() { return sup->Supervise(Clock::now()) == Supervisor::s_gaveUp; }));
+        // It might be gone before the supervisor looks at it, "worker exited" then, but the message is there anyway.
+        const std::string &error(sup->GetLastError());
+        CHECK(error.length() > 16 && error.substr(error.length() - 16) == ": no such device");
+        CHECK(sup->GetRestarts() == sup->maxStartFailures);
+        CHECK(sup->GetChannel() == nullptr);
+        const auint incarnations = sup->GetIncarnation();
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        CHECK(sup->Supervise(Clock::now()) == Supervisor::s_gaveUp && sup->GetIncarnation() == incarnations);
+    }
+    {
+        auto sup(Make("exit"));
+        CHECK(Until(*sup, [&]() { return sup->Supervise(Clock::now()) == Supervisor::s_gaveUp; }));
+        CHECK(sup->GetLastError() == "worker exited, code 5");
+    }
+    {
+        auto sup(Make("silent"));
+        CHECK(Until(*sup, [&]() { return sup->GetRestarts() >= 1; }));
+        CHECK(sup->GetLastError() == "worker took too long to initialize");
+    }
+    {
+        // Not even a program: exec fails in the child, which is just another exit code.
+        Supervisor sup("/nonexistent/M8M", std::vector<std::string>(), 0);
+        sup.minBackoff = std::chrono::milliseconds(10);
+        CHECK(Until(sup, [&]() { return sup.Supervise(Clock::now()) == Supervisor::s_gaveUp; }));
+        CHECK(sup.GetLastError() == "worker exited, code 127");
+    }
+    return check::Report("isolatedWorker");
+}
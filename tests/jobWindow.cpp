@@ -0,0 +1,111 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#include "check.h"
+#include "scriptedPool.h"
+#include <set>
+
+/*! Notifies without clean_jobs arriving while a scan is still going on the previous job: the shares it finds are still good for the
+pool and must go out with that job's ntime, see StratumState::GetJobNetworkTime. Clean notifies make them stale. The pool here accepts
+shares for every job it sent since its last clean notify, as pools do. */
+namespace {
+
+//! Job and id of each mining.submit we sent.
+std::vector<std::pair<std::string, asizei>> Submits(const std::string &outbound) {
+    std::vector<std::pair<std::string, asizei>> ret;
+    for(const auto &line : scripted::Lines(outbound)) {
+        if(!scripted::Is(line, "mining.submit")) continue;
+        const asizei start = line.find("\"params\": [\"worker\", \"");
+        if(start == std::string::npos) continue;
+        const asizei job = start + 22;
+        ret.push_back(std::make_pair(line.substr(job, line.find('"', job) - job), scripted::IdOf(line)));
+    }
+    return ret;
+}
+
+std::string NTime(asizei index) {
+    char hex[9];
+    snprintf(hex, sizeof(hex), "%08x", 0x504e86ed + auint(index) * 30);
+    return hex;
+}
+
+}
+
+
+int main(int argc, char **argv) {
+    {
+        // The basics: a notify with clean_jobs false leaves the previous job valid with its own ntime, clean drops everything but itself.
+        scripted::Pool pool;
+        pool.Connect();
+        pool.Handshake("s1", "01020304", "j1");
+        const auint first = pool.source.IsCurrentJob("j1");
+        CHECK(first != 0);
+        pool.Say(scripted::Notify("j2", false, "504e8800"));
+        pool.Tick();
+        CHECK(pool.source.IsCurrentJob("j1") == first);
+        CHECK(pool.source.IsCurrentJob("j2") == 0x504e8800);
+        // The window is 8 jobs: after 8 more non-clean notifies the oldest goes.
+        for(auint loop = 3; loop <= 9; loop++) pool.Say(scripted::Notify("j" + std::to_string(loop), false));
+        pool.Tick();
+        CHECK(pool.source.IsCurrentJob("j1") == 0);
+        CHECK(pool.source.IsCurrentJob("j2") != 0 && pool.source.IsCurrentJob("j9") != 0);
+        pool.Say(scripted::Notify("j10", true));
+        pool.Tick();
+        CHECK(pool.source.IsCurrentJob("j10") != 0);
+        for(auint loop = 2; loop <= 9; loop++) CHECK(pool.source.IsCurrentJob("j" + std::to_string(loop)) == 0);
+        // A job notified again after being dropped is valid again: the pool just sent it.
+        pool.Say(scripted::Notify("j9", false));
+        pool.Tick();
+        CHECK(pool.source.IsCurrentJob("j9") != 0 && pool.source.IsCurrentJob("j10") != 0);
+    }
+
+    /* 200 scans, a share each. Every 5th scan a new job comes in the middle of it, before the share is found: every 10th of those
+    is clean. A share is sent if its job is still valid. Before the window only the current job was, so each share found on a job
+    replaced mid-scan was dropped. */
+    scripted::Pool pool;
+    pool.Connect();
+    pool.Handshake("s1", "01020304", "k0");
+    std::set<std::string> poolValid { "k0" };
+    asizei accepted = 0, rejected = 0, dropped = 0, recovered = 0, stale = 0;
+    pool.source.shareResponseCallback = [&](const AbstractWorkSource &, asizei id, StratumShareResponse status) {
+        if(status == ssr_accepted) accepted++;
+        else rejected++;
+    };
+    std::string current("k0");
+    asizei jobs = 1;
+    for(asizei scan = 0; scan < 200; scan++) {
+        const std::string working(current);
+        if(scan % 5 == 4) {
+            const bool clean = jobs % 10 == 0;
+            current = "k" + std::to_string(jobs);
+            pool.Say(scripted::Notify(current, clean, NTime(jobs).c_str()));
+            pool.Tick();
+            if(clean) poolValid.clear();
+            poolValid.insert(current);
+            jobs++;
+        }
+        const auint ntime = pool.source.IsCurrentJob(working);
+        if(working != current) {
+            if(ntime) recovered++;
+            else stale++;
+        }
+        if(!ntime) {
+            dropped++;
+            continue;
+        }
+        CHECK(ntime == (working == "k0"? 0x504e86ed : std::stoul(NTime(std::stoul(working.substr(1))), nullptr, 16)));
+        pool.socket.outbound.clear();
+        pool.source.SendShare(working, ntime, 0, auint(scan));
+        pool.Tick();
+        for(const auto &sent : Submits(pool.socket.outbound)) {
+            const bool good = poolValid.find(sent.first) != poolValid.end();
+            pool.Say("{\"id\":\"" + std::to_string(sent.second) + "\",\"result\":" + (good? "true" : "false") + ",\"error\":null}");
+        }
+        pool.Tick();
+    }
+    // 40 jobs replaced mid-scan, 4 of them by clean notifies.
+    CHECK(recovered == 36 && stale == 4 && dropped == 4);
+    CHECK(accepted == 196 && rejected == 0);
+    return check::Report("jobWindow");
+}
@@ -0,0 +1,100 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#include "check.h"
+#include "../Common/LatencyHistogram.h"
+#include <cmath>
+
+/*! LatencyHistogram buckets, percentiles and merging. Percentiles are the upper limit of the bucket reaching the fraction,
+never less than the real value and never more than max. */
+namespace {
+
+bool Near(double value, double expected) { return std::fabs(value - expected) < 1e-9; }
+
+}
+
+
+int main(int argc, char **argv) {
+    const auto &limits(LatencyHistogram::GetLimits());
+    CHECK(limits.size() == LatencyHistogram::numBuckets - 1);
+    for(asizei loop = 1; loop < limits.size(); loop++) CHECK(limits[loop - 1] < limits[loop]);
+    {
+        LatencyHistogram empty;
+        CHECK(empty.samples == 0);
+        CHECK(empty.Average() == .0);
+        CHECK(empty.Percentile(.5) == .0 && empty.Percentile(1.0) == .0);
+        LatencyHistogram other;
+        CHECK(!(empty != other));
+    }
+    {
+        // Limits are upper bounds excluded: 10 goes in the second bucket.
+        LatencyHistogram hist;
+        hist.Add(0);
+        hist.Add(9.99);
+        hist.Add(10);
+        hist.Add(25);
+        hist.Add(120000);
+        hist.Add(500000);
+        CHECK(hist.counts[0] == 2);
+        CHECK(hist.counts[1] == 1);
+        CHECK(hist.counts[2] == 1);
+        CHECK(hist.counts[LatencyHistogram::numBuckets - 1] == 2);
+        CHECK(hist.samples == 6);
+        CHECK(hist.min == 0 && hist.max == 500000);
+        CHECK(Near(hist.Average(), (9.99 + 10 + 25 + 120000 + 500000) / 6));
+    }
+    {
+        // 90 fast samples and 10 slow ones: the median is the fast bucket's limit, the 95th is the slow one's.
+        LatencyHistogram hist;
+        for(asizei loop = 0; loop < 90; loop++) hist.Add(30 + loop % 10);
+        for(asizei loop = 0; loop < 10; loop++) hist.Add(3000);
+        CHECK(hist.Percentile(.5) == 50);
+        CHECK(hist.Percentile(.9) == 50);
+        CHECK(hist.Percentile(.95) == 3000); // bucket limit is 5000 but nothing went above max
+        CHECK(hist.Percentile(1.0) == 3000);
+        CHECK(hist.Percentile(.0) == 50); // at least one sample
+        hist.Add(4000);
+        CHECK(hist.Percentile(1.0) == 4000);
+        hist.Add(200000); // last bucket has no limit, max it is
+        CHECK(hist.Percentile(1.0) == 200000);
+    }
+    {
+        // Recent follows the last samples, the average does not.
+        LatencyHistogram hist;
+        hist.Add(100);
+        CHECK(hist.recent == 100);
+        for(asizei loop = 0; loop < 64; loop++) hist.Add(1000);
+        CHECK(hist.recent > 990 && hist.recent <= 1000);
+        for(asizei loop = 0; loop < 64; loop++) hist.Add(10);
+        CHECK(hist.recent < 20);
+        CHECK(hist.Average() > 400);
+    }
+    {
+        LatencyHistogram a, b, both;
+        for(asizei loop = 0; loop < 50; loop++) {
+            a.Add(double(loop * 3));
+            both.Add(double(loop * 3));
+        }
+        for(asizei loop = 0; loop < 30; loop++) {
+            b.Add(double(loop * 700));
+            both.Add(double(loop * 700));
+        }
+        LatencyHistogram merged(a);
+        merged.Merge(LatencyHistogram());
+        CHECK(!(merged != a));
+        merged.Merge(b);
+        CHECK(!(merged != both));
+        CHECK(merged.counts == both.counts);
+        CHECK(merged.min == both.min && merged.max == both.max);
+        CHECK(Near(merged.total, both.total));
+        CHECK(merged.recent == std::max(a.recent, b.recent));
+        for(double fraction = .1; fraction <= 1.0; fraction += .1) CHECK(merged.Percentile(fraction) == both.Percentile(fraction));
+
+        LatencyHistogram into;
+        into.Merge(b);
+        CHECK(!(into != b) && into.min == b.min && into.max == b.max && into.recent == b.recent);
+        CHECK(a != b);
+    }
+    return check::Report("latencyHistogram");
+}
@@ -0,0 +1,94 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#include "../Common/MPSCQueue.h"
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*! Benchmark: many threads pushing results while one drains them, for more and more producers. Compares MPSCQueue with what
+ThreadedNonceFinders had before, a deque guarded by the mutex the mining threads also take for work. Prints for each
+- producer throughput: pushes per microsecond, all producers together;
+- the consumer: nanoseconds per pop, including the pops finding nothing. */
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct Result {
+    asizei producer = 0, sequence = 0;
+    std::vector<auint> nonces; //!< a VerifiedNonces has a few vectors, moving them is what pushing costs
+};
+
+class LockedQueue {
+public:
+    void Push(Result &&value) {
+        std::unique_lock<std::mutex> lock(guard);
+        queue.push_back(std::move(value));
+    }
+    bool Pop(Result &out) {
+        std::unique_lock<std::mutex> lock(guard);
+        if(queue.empty()) return false;
+        out = std::move(queue.front());
+        queue.pop_front();
+        return true;
+    }
+private:
+    std::mutex guard;
+    std::deque<Result> queue;
+};
+
+struct Timing {
+    double pushesPerMicro, nsPerPop;
+};
+
+template<typename Queue>
+Timing Run(asizei producers, asizei each) {
+    Queue queue;
+    std::atomic<asizei> ready(0);
+    std::atomic<bool> go(false);
+    std::vector<std::thread> threads;
+    for(asizei loop = 0; loop < producers; loop++) {
+        threads.push_back(std::thread([&, loop]() {
+            ready++;
+            while(!go.load()) { }
+            for(asizei seq = 0; seq < each; seq++) {
+                Result add;
+                add.producer = loop;
+                add.sequence = seq;
+                add.nonces.assign(2, auint(seq));
+                queue.Push(std::move(add));
+            }
+        }));
+    }
+    while(ready.load() < producers) { }
+    const auto start(Clock::now());
+    go = true;
+    asizei popped = 0, pops = 0;
+    Result out;
+    while(popped < producers * each) {
+        pops++;
+        if(queue.Pop(out)) popped++;
+    }
+    const auto elapsed(Clock::now() - start);
+    for(auto &el : threads) el.join();
+    const double ns = double(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    return Timing { popped / (ns / 1000.0), ns / pops };
+}
+
+}
+
+
+int main(int argc, char **argv) {
+    const asizei TOTAL = 800000;
+    std::cout<<"mpscContention, "<<TOTAL<<" results, "<<std::thread::hardware_concurrency()<<" hardware threads"<<std::endl;
+    std::cout<<"  producers   MPSCQueue push/us  ns/pop   mutex+deque push/us  ns/pop"<<std::endl;
+    for(asizei producers : { 1, 2, 4, 8, 16 }) {
+        const Timing lockFree(Run<MPSCQueue<Result>>(producers, TOTAL / producers));
+        const Timing locked(Run<LockedQueue>(producers, TOTAL / producers));
+        std::cout<<"  "<<producers<<"\t\t"<<lockFree.pushesPerMicro<<"\t"<<lockFree.nsPerPop<<"\t\t"<<locked.pushesPerMicro<<"\t"<<locked.nsPerPop<<std::endl;
+    }
+    return 0;
+}
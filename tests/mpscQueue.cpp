@@ -0,0 +1,113 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#include "check.h"
+#include "../Common/MPSCQueue.h"
+#include <memory>
+#include <thread>
+#include <vector>
+
+/*! Many producers pushing while the consumer drains, as the mining threads and the main thread do with results.
+Every value must come out exactly once and each producer's values in the order it pushed them, whatever the interleaving.
+Built with the thread sanitizer. */
+namespace {
+
+struct Result {
+    asizei producer = 0, sequence = 0;
+    std::unique_ptr<int> payload; //!< move only, as VerifiedNonces are moved around; leaks would show with the sanitizer
+};
+
+}
+
+
+int main(int argc, char **argv) {
+    {
+        MPSCQueue<Result> queue;
+        Result out;
+        CHECK(!queue.Pop(out));
+        CHECK(queue.Size() == 0);
+        Result one;
+        one.sequence = 7;
+        queue.Push(std::move(one));
+        CHECK(queue.Size() == 1);
+        MPSCQueue<Result>::Clock::time_point queued;
+        CHECK(queue.Pop(out, queued));
+        CHECK(out.sequence == 7 && queued <= MPSCQueue<Result>::Clock::now());
+        CHECK(!queue.Pop(out));
+        CHECK(queue.Size() == 0);
+    }
+    {
+        // Going through the stub again and again: one element at a time, alternating.
+        MPSCQueue<Result> queue;
+        Result out;
+        for(asizei loop = 0; loop < 1000; loop++) {
+            Result add;
+            add.sequence = loop;
+            queue.Push(std::move(add));
+            CHECK(queue.Pop(out) && out.sequence == loop);
+            CHECK(!queue.Pop(out));
+        }
+    }
+    {
+        // Left in there on destruction, they're released.
+        MPSCQueue<Result> queue;
+        for(asizei loop = 0; loop < 100; loop++) {
+            Result add;
+            add.payload.reset(new int(int(loop)));
+            queue.Push(std::move(add));
+        }
+    }
+    {
+        const asizei PRODUCERS = 8, EACH = 50000;
+        MPSCQueue<Result> queue;
+        std::atomic<asizei> started(0);
+        std::vector<std::thread> producers;
+        for(asizei loop = 0; loop < PRODUCERS; loop++) {
+            producers.push_back(std::thread([&queue, &started, loop]() {
+                started++;
+                while(started.load() < PRODUCERS) { } // all at once, so they fight over head
+                for(asizei seq = 0; seq < EACH; seq++) {
+                    Result add;
+                    add.producer = loop;
+                    add.sequence = seq;
+                    add.payload.reset(new int(int(seq)));
+                    queue.Push(std::move(add));
+                    if(seq % 1024 == 0) std::this_thread::yield();
+                }
+            }));
+        }
+        std::vector<asizei> next(PRODUCERS);
+        std::vector<MPSCQueue<Result>::Clock::time_point> lastQueued(PRODUCERS);
+        asizei popped = 0, outOfOrder = 0, badPayload = 0, peakDepth = 0, emptyPops = 0;
+        Result out;
+        MPSCQueue<Result>::Clock::time_point queued;
+        while(popped < PRODUCERS * EACH) {
+            peakDepth = std::max(peakDepth, queue.Size());
+            if(!queue.Pop(out, queued)) { // empty or a producer halfway through pushing, try again
+                emptyPops++;
+                continue;
+            }
+            popped++;
+            if(out.producer >= PRODUCERS) {
+                outOfOrder++;
+                continue;
+            }
+            outOfOrder += out.sequence != next[out.producer];
+            next[out.producer] = out.sequence + 1;
+            badPayload += !out.payload || *out.payload != int(out.sequence);
+            outOfOrder += queued < lastQueued[out.producer];
+            lastQueued[out.producer] = queued;
+        }
+        for(auto &el : producers) el.join();
+        CHECK(popped == PRODUCERS * EACH);
+        CHECK(outOfOrder == 0);
+        CHECK(badPayload == 0);
+        for(auto el : next) CHECK(el == EACH);
+        CHECK(!queue.Pop(out));
+        CHECK(queue.Size() == 0);
+        CHECK(peakDepth > 0);
+        std::cout<<"mpscQueue: peak depth "<<peakDepth<<", "<<emptyPops<<" empty pops"<<std::endl;
+    }
+    return check::Report("mpscQueue");
+}
@@ -0,0 +1,27 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+/* M8M is built with Visual C++ and the sources use a few of its extensions. The tests are built with GCC or Clang so they can run
+anywhere, this is force-included to make the sources under test happy. Keep it to the bare minimum: when something new is needed,
+it's often better to make the code under test portable instead. */
+#include <bits/stdc++.h>
+#include <strings.h>
+
+#define __int8 char
+#define __int16 short
+#define __int32 int
+#define __int64 long long
+#define _stricmp strcasecmp
+#define _strnicmp strncasecmp
+#define memcpy_s(dst, dstSize, src, count) memcpy(dst, src, count)
+#define sprintf_s snprintf
+
+/* MSVC's std::exception takes a message, the standard one does not. Every standard header is already in (bits/stdc++.h),
+so this only affects the sources under test: their throws and their catches agree. */
+#define exception runtime_error
+
+// <stdlib.h> rotations, the hashers use them.
+inline unsigned int _rotl(unsigned int value, int shift) { shift &= 31; return shift? (value << shift) | (value >> (32 - shift)) : value; }
+inline unsigned int _rotr(unsigned int value, int shift) { shift &= 31; return shift? (value >> shift) | (value << (32 - shift)) : value; }
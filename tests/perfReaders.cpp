@@ -0,0 +1,97 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#include "../M8M/MiningPerformanceWatcher.h"
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+/*! Benchmark: does reading scan times from many monitor clients slow down the mining threads writing them?
+A mining thread "scans" (spins for a while) and calls Completed, reader threads call GetPerformance for every device as fast as they can,
+which is a lot more than any number of monitor clients. Measured is Completed as seen by the mining thread, nanoseconds, for
+MiningPerformanceWatcher and for the same watcher behind a mutex as SyncMiningPerformanceWatcher used to be. */
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+using std::chrono::microseconds;
+
+class LockedWatcher {
+public:
+    explicit LockedWatcher() { watcher.SetNumDevices(DEVICES); }
+    void Completed(size_t devIndex, bool found, microseconds elapsed) {
+        std::unique_lock<std::mutex> lock(guard);
+        watcher.Completed(devIndex, found, elapsed);
+    }
+    bool GetPerformance(MiningPerformanceWatcherInterface::DevStats &out, size_t device) {
+        std::unique_lock<std::mutex> lock(guard);
+        return watcher.GetPerformance(out, device);
+    }
+    static const size_t DEVICES = 4;
+private:
+    std::mutex guard;
+    MiningPerformanceWatcher watcher;
+};
+
+class FreeWatcher : public MiningPerformanceWatcher {
+public:
+    explicit FreeWatcher() { SetNumDevices(LockedWatcher::DEVICES); }
+};
+
+struct Timing {
+    double p50, p99, max; //!< nanoseconds spent in Completed
+    aulong reads;
+};
+
+template<typename Watcher>
+Timing Run(asizei readers, Clock::duration length) {
+    Watcher watcher;
+    std::atomic<bool> done(false);
+    std::atomic<aulong> reads(0);
+    std::vector<std::thread> threads;
+    for(asizei loop = 0; loop < readers; loop++) {
+        threads.push_back(std::thread([&]() {
+            MiningPerformanceWatcherInterface::DevStats out;
+            aulong mine = 0;
+            while(!done.load(std::memory_order_relaxed)) {
+                for(size_t dev = 0; dev < LockedWatcher::DEVICES; dev++) mine += watcher.GetPerformance(out, dev)? 1 : 0;
+            }
+            reads += mine;
+        }));
+    }
+    std::vector<double> took;
+    took.reserve(1000000);
+    const auto until(Clock::now() + length);
+    auto scanStart(Clock::now());
+    while(scanStart < until) {
+        while(Clock::now() - scanStart < microseconds(20)) { } // hashing
+        const auto before(Clock::now());
+        watcher.Completed(0, took.size() % 4 == 0, std::chrono::duration_cast<microseconds>(before - scanStart));
+        scanStart = Clock::now();
+        took.push_back(double(std::chrono::duration_cast<std::chrono::nanoseconds>(scanStart - before).count()));
+    }
+    done = true;
+    for(auto &el : threads) el.join();
+    std::sort(took.begin(), took.end());
+    return Timing { took[took.size() / 2], took[took.size() * 99 / 100], took.back(), reads.load() };
+}
+
+void Print(const char *what, const Timing &timing) {
+    std::cout<<what<<"p50 "<<timing.p50<<", p99 "<<timing.p99<<", max "<<timing.max<<" ("<<timing.reads<<" reads)";
+}
+
+}
+
+
+int main(int argc, char **argv) {
+    const auto LENGTH = std::chrono::milliseconds(500);
+    std::cout<<"perfReaders, ns in Completed, "<<std::thread::hardware_concurrency()<<" hardware threads"<<std::endl;
+    for(asizei readers : { 0, 1, 4, 16 }) {
+        std::cout<<"  "<<readers<<" readers"<<std::endl;
+        Print("    seqlock: ", Run<FreeWatcher>(readers, LENGTH));
+        std::cout<<std::endl;
+        Print("    mutex:   ", Run<LockedWatcher>(readers, LENGTH));
+        std::cout<<std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,93 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#include "check.h"
+#include "../M8M/MiningPerformanceWatcher.h"
+#include <thread>
+
+/*! MiningPerformanceWatcher seqlock: readers hammering a device while its thread keeps publishing must never get a mix of two publishes.
+Values are fed so some fields are always equal in a single publish: scan times always growing and always finding make last == max,
+avg is always windows[0] and windows of the same length are equal. A torn copy would break one of those sooner or later. */
+int main(int argc, char **argv) {
+    using std::chrono::microseconds;
+    using std::chrono::seconds;
+    {
+        MiningPerformanceWatcher watcher;
+        MiningPerformanceWatcherInterface::DevStats out;
+        CHECK(watcher.GetNumDevices() == 0);
+        CHECK(!watcher.GetPerformance(out, 0));
+        watcher.SetNumDevices(2);
+        CHECK(!watcher.GetPerformance(out, 0)); // nothing published yet
+        watcher.Completed(0, true, microseconds(100));
+        CHECK(watcher.GetPerformance(out, 0));
+        CHECK(out.last == microseconds(100));
+        CHECK(out.min == microseconds(0) && out.max == microseconds(0)); // first scan is not trusted for those
+        watcher.Completed(0, false, microseconds(50));
+        watcher.Completed(0, true, microseconds(300));
+        CHECK(watcher.GetPerformance(out, 0));
+        CHECK(out.min == microseconds(50) && out.max == microseconds(300) && out.last == microseconds(300));
+        CHECK(!watcher.GetPerformance(out, 1));
+        CHECK(!watcher.GetPerformance(out, 2));
+        watcher.Completed(0, false, microseconds(0)); // disabled
+        CHECK(watcher.GetPerformance(out, 0));
+        CHECK(out.last == microseconds(0) && out.avg == microseconds(0));
+    }
+    {
+        // Two windows of the same length start and roll together, so they're equal in every publish.
+        MiningPerformanceWatcher watcher;
+        watcher.SetAverageWindows(std::vector<seconds> { seconds(1), seconds(1) });
+        CHECK(watcher.GetAverageWindows().size() == 2);
+        watcher.SetNumDevices(2);
+        const asizei READERS = 4;
+        const MiningPerformanceWatcherInterface::microseconds::rep SCANS = 200000;
+        std::atomic<bool> done(false);
+        std::vector<asizei> torn(READERS), reads(READERS), backwards(READERS);
+        std::vector<std::thread> readers;
+        for(asizei loop = 0; loop < READERS; loop++) {
+            readers.push_back(std::thread([&, loop]() {
+                MiningPerformanceWatcherInterface::DevStats out;
+                microseconds prev(0);
+                while(!done.load(std::memory_order_relaxed)) {
+                    for(asizei dev = 0; dev < 2; dev++) {
+                        if(!watcher.GetPerformance(out, dev)) continue;
+                        reads[loop]++;
+                        if(out.max == microseconds(0)) continue; // first publish
+                        torn[loop] += out.last != out.max || out.avg != out.windows[0] || out.windows[0] != out.windows[1];
+                        if(dev == 0) {
+                            backwards[loop] += out.last < prev;
+                            prev = out.last;
+                        }
+                    }
+                }
+            }));
+        }
+        // Device 1 is written by another thread, they share nothing but the array.
+        std::thread other([&]() {
+            for(MiningPerformanceWatcherInterface::microseconds::rep scan = 1; scan <= SCANS; scan++) watcher.Completed(1, true, microseconds(scan * 3));
+        });
+        // Long enough for the windows to roll a couple of times.
+        const auto until(std::chrono::steady_clock::now() + std::chrono::milliseconds(2200));
+        MiningPerformanceWatcherInterface::microseconds::rep scan = 0;
+        while(++scan <= SCANS || std::chrono::steady_clock::now() < until) {
+            const auto scanned(std::chrono::steady_clock::now() + microseconds(2));
+            while(std::chrono::steady_clock::now() < scanned) { } // so the window averages are not 0
+            watcher.Completed(0, true, microseconds(scan));
+            if(scan % 4096 == 0) std::this_thread::yield(); // let the readers catch us in the middle of something
+        }
+        scan--;
+        other.join();
+        done = true;
+        for(auto &el : readers) el.join();
+        MiningPerformanceWatcherInterface::DevStats out;
+        CHECK(watcher.GetPerformance(out, 0) && out.last == microseconds(scan) && out.max == microseconds(scan) && out.min == microseconds(2));
+        CHECK(out.windows[0] > microseconds(0));
+        CHECK(watcher.GetPerformance(out, 1) && out.last == microseconds(SCANS * 3));
+        for(asizei loop = 0; loop < READERS; loop++) {
+            CHECK(torn[loop] == 0);
+            CHECK(backwards[loop] == 0);
+            CHECK(reads[loop] > 0);
+        }
+    }
+    return check::Report("perfWatcher");
+}
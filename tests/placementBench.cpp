@@ -0,0 +1,93 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#include "../Common/ThreadPlacement.h"
+#include "../Common/BTC/Funcs.h"
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+/*! Benchmark: nonce verification throughput, a thread per CPU, left to the scheduler or each pinned to its own CPU. Verifying here is
+hashing headers with the SHA256 the stratum code uses, a batch per result. Also prints what a mining thread pays to move to the
+verification CPUs and back for each result, as ThreadedNonceFinders does when "verification" is set. */
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+const asizei BATCH = 64; //!< hashes per result
+
+double Verify(std::array<aubyte, 80> &header) {
+    std::array<aubyte, 32> hash, again;
+    auint sum = 0;
+    for(asizei loop = 0; loop < BATCH; loop++) {
+        header[76] = aubyte(loop);
+        btc::SHA256Based(hash, header.data(), header.size());
+        btc::SHA256Based(again, hash);
+        sum += again[31];
+    }
+    return sum;
+}
+
+//! \returns results verified per second, all threads together.
+double Run(const placement::CPUSet &cpus, bool pinned, Clock::duration length) {
+    std::atomic<bool> go(false), done(false);
+    std::atomic<aulong> total(0);
+    std::vector<std::thread> threads;
+    for(auto cpu : cpus) {
+        threads.push_back(std::thread([&, cpu]() {
+            if(pinned) placement::SetCurrentThreadCPUs(placement::CPUSet({ cpu }));
+            std::array<aubyte, 80> header;
+            for(asizei loop = 0; loop < header.size(); loop++) header[loop] = aubyte(loop * 13 + cpu);
+            while(!go.load()) std::this_thread::yield();
+            aulong count = 0;
+            double keep = 0;
+            while(!done.load(std::memory_order_relaxed)) {
+                keep += Verify(header);
+                count++;
+            }
+            total += count + (keep < 0? 1 : 0);
+        }));
+    }
+    go = true;
+    std::this_thread::sleep_for(length);
+    done = true;
+    for(auto &el : threads) el.join();
+    return total / std::chrono::duration<double>(length).count();
+}
+
+}
+
+
+int main(int argc, char **argv) {
+    const auto LENGTH = std::chrono::seconds(1);
+    const placement::CPUSet cpus(placement::GetCurrentThreadCPUs());
+    std::cout<<"placementBench, "<<BATCH<<" hashes per result, "<<cpus.size()<<" CPUs ("<<placement::DescribeCPUSet(cpus)<<"), "
+             <<placement::GetNumNUMANodes()<<" NUMA nodes"<<std::endl;
+    if(cpus.empty()) return 1;
+    std::cout<<"  unpinned: "<<Run(cpus, false, LENGTH)<<" results/s"<<std::endl;
+    std::cout<<"  pinned:   "<<Run(cpus, true, LENGTH)<<" results/s"<<std::endl;
+
+    const placement::CPUSet mining({ cpus.front() }), verification({ cpus.back() });
+    std::array<aubyte, 80> header;
+    header.fill(0);
+    const asizei RESULTS = 5000;
+    placement::SetCurrentThreadCPUs(mining);
+    double keep = 0;
+    auto start(Clock::now());
+    for(asizei loop = 0; loop < RESULTS; loop++) keep += Verify(header);
+    const auto stay(Clock::now() - start);
+    start = Clock::now();
+    for(asizei loop = 0; loop < RESULTS; loop++) {
+        placement::SetCurrentThreadCPUs(verification);
+        keep += Verify(header);
+        placement::SetCurrentThreadCPUs(mining);
+    }
+    const auto moving(Clock::now() - start);
+    placement::SetCurrentThreadCPUs(cpus);
+    auto us = [RESULTS](Clock::duration elapsed) { return std::chrono::duration<double, std::micro>(elapsed).count() / RESULTS; };
+    std::cout<<"  verify in place:     "<<us(stay)<<" us/result"<<std::endl;
+    std::cout<<"  move, verify, back:  "<<us(moving)<<" us/result (CPU "<<mining[0]<<" to "<<verification[0]<<")"<<(keep < 0? " " : "")<<std::endl;
+    return 0;
+}
@@ -0,0 +1,166 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#include "check.h"
+#include "../M8M/PoolHealth.h"
+#include <memory>
+#include <string>
+
+/*! A primary and a backup pool, both connected and getting jobs. The primary goes bad in the ways PoolHealth knows about,
+mining must switch to the backup and come back when the primary recovers, not before.
+Driven as M8MPoolConnectingApp::UpdateHealth does, with a fake clock. */
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+using std::chrono::seconds;
+
+//! What M8MPoolConnectingApp keeps for each pool and what the miners see of it, AbstractNonceFindersBuild::CurrentWork.
+struct Pool {
+    std::string name;
+    PoolHealth health;
+    std::shared_ptr<int> factory; //!< stands for the stratum::AbstractWorkFactory, null = no work
+    bool degraded = false; //!< as set by HealthChange
+};
+
+struct Failover {
+    std::vector<Pool> pools;
+    PoolHealth::Limits limits;
+    std::vector<std::string> reported; //!< the ConnectionState events, "name degraded" or "name recovered"
+
+    explicit Failover(Clock::time_point now) {
+        pools.resize(2);
+        pools[0].name = "primary";
+        pools[1].name = "backup";
+        for(auto &el : pools) {
+            el.factory = std::make_shared<int>(0);
+            el.health.lastNotify = now;
+        }
+    }
+    void UpdateHealth(Clock::time_point now) {
+        for(auto &entry : pools) {
+            if(entry.health.Update(now, limits) == false) continue;
+            entry.degraded = entry.health.degraded; // HealthChange
+            reported.push_back(entry.name + (entry.degraded? " degraded" : " recovered")); // ConnectionState
+        }
+    }
+    std::string Mining() const {
+        const Pool *pool = HotStandby(pools);
+        return pool? pool->name : "nothing";
+    }
+};
+
+const Clock::time_point base = Clock::time_point() + std::chrono::hours(1);
+
+}
+
+
+int main(int argc, char **argv) {
+    {
+        // No job yet, nothing to decide even if it's been silent for long.
+        PoolHealth health;
+        CHECK(health.Update(base + std::chrono::hours(1), PoolHealth::Limits()) == false);
+        CHECK(health.degraded == false);
+    }
+    {
+        // Rejecting shares: a couple of rejects is just bad luck, a streak is a pool gone bad.
+        Failover app(base);
+        CHECK(app.Mining() == "primary");
+        app.pools[0].health.Replied(true);
+        app.pools[0].health.Replied(true);
+        app.UpdateHealth(base);
+        CHECK(app.reported.empty());
+        CHECK(app.Mining() == "primary");
+        app.pools[0].health.Replied(true);
+        app.pools[0].health.Replied(true);
+        app.UpdateHealth(base);
+        CHECK(app.reported.size() == 1 && app.reported.back() == "primary degraded");
+        CHECK(app.Mining() == "backup");
+
+        // Below the limit but above half of it: still degraded, so it doesn't flip at each reply.
+        asizei accepted = 0;
+        while(app.pools[0].health.rejectRate > app.limits.maxRejectRate * .75) {
+            app.pools[0].health.Replied(false);
+            accepted++;
+        }
+        app.UpdateHealth(base);
+        CHECK(app.reported.size() == 1);
+        CHECK(app.Mining() == "backup");
+        while(app.reported.size() == 1 && accepted < 1000) {
+            app.pools[0].health.Replied(false);
+            accepted++;
+            app.UpdateHealth(base);
+        }
+        CHECK(app.reported.size() == 2 && app.reported.back() == "primary recovered");
+        CHECK(app.pools[0].health.rejectRate <= app.limits.maxRejectRate * .5);
+        CHECK(app.Mining() == "primary");
+    }
+    {
+        // Late with blocks.
+        Failover app(base);
+        for(asizei loop = 0; loop < 8; loop++) {
+            app.pools[1].health.Announced(.0);
+            app.pools[0].health.Announced(4000.0);
+        }
+        app.UpdateHealth(base);
+        CHECK(app.reported.size() == 1 && app.reported.back() == "primary degraded");
+        CHECK(app.Mining() == "backup");
+        while(app.reported.size() == 1 && app.pools[0].health.notifyLag > 1.0) {
+            app.pools[0].health.Announced(.0);
+            app.UpdateHealth(base);
+        }
+        CHECK(app.reported.size() == 2 && app.reported.back() == "primary recovered");
+        CHECK(app.pools[0].health.notifyLag <= app.limits.maxNotifyLag.count() * .5);
+        CHECK(app.Mining() == "primary");
+    }
+    {
+        // Silent: connected but no jobs anymore. The backup keeps getting jobs.
+        Failover app(base);
+        auto now(base + app.limits.maxNotifySilence - seconds(1));
+        app.pools[1].health.lastNotify = now;
+        app.UpdateHealth(now);
+        CHECK(app.reported.empty());
+        now += seconds(2);
+        app.UpdateHealth(now);
+        CHECK(app.reported.size() == 1 && app.reported.back() == "primary degraded");
+        CHECK(app.Mining() == "backup");
+        app.pools[0].health.lastNotify = now; // a job, finally
+        app.UpdateHealth(now);
+        CHECK(app.reported.size() == 2 && app.reported.back() == "primary recovered");
+        CHECK(app.Mining() == "primary");
+
+        // Both silent: the first pool still having work is better than not mining at all.
+        now += app.limits.maxNotifySilence + seconds(1);
+        app.UpdateHealth(now);
+        CHECK(app.reported.size() == 4);
+        CHECK(app.pools[0].degraded && app.pools[1].degraded);
+        CHECK(app.Mining() == "primary");
+        app.pools[1].health.lastNotify = now;
+        app.UpdateHealth(now);
+        CHECK(app.reported.back() == "backup recovered");
+        CHECK(app.Mining() == "backup");
+    }
+    {
+        // Degraded and then the connection goes: no work, the backup mines. Back with a fresh start, see Goodbye.
+        Failover app(base);
+        for(asizei loop = 0; loop < 8; loop++) app.pools[0].health.Replied(true);
+        app.UpdateHealth(base);
+        CHECK(app.Mining() == "backup");
+        app.pools[0].factory.reset();
+        app.pools[0].health = PoolHealth();
+        app.pools[0].degraded = false;
+        CHECK(app.Mining() == "backup");
+        app.UpdateHealth(base + seconds(10));
+        CHECK(app.reported.size() == 1);
+        app.pools[0].factory = std::make_shared<int>(1);
+        app.pools[0].health.lastNotify = base + seconds(20);
+        app.UpdateHealth(base + seconds(20));
+        CHECK(app.reported.size() == 1);
+        CHECK(app.Mining() == "primary");
+    }
+    {
+        std::vector<Pool> none(2);
+        CHECK(HotStandby(none) == nullptr);
+    }
+    return check::Report("poolFailover");
+}
@@ -0,0 +1,105 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#include "check.h"
+#include "../Common/PublishedSnapshot.h"
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+/*! The main thread swapping work while mining threads roll it, as AbstractNonceFindersBuild::Publish and ThreadedNonceFinders::SelectWork do.
+Built with the thread sanitizer so it's not just about the values being right. */
+namespace {
+
+std::atomic<int> liveFactories { 0 };
+
+//! Stands for stratum::AbstractWorkFactory: shared by the snapshots having it and the threads using it, rolled by those.
+struct Factory {
+    const asizei stamp;
+    std::atomic<auint> nonce2 { 0 };
+    explicit Factory(asizei stamp) : stamp(stamp) { liveFactories++; }
+    ~Factory() { liveFactories--; }
+};
+
+struct Work {
+    asizei stamp = 0; //!< generation it was published with
+    std::vector<asizei> owners; //!< all equal to stamp, a torn copy would show
+    std::shared_ptr<Factory> factory;
+};
+
+}
+
+
+int main(int argc, char **argv) {
+    const asizei PUBLISHES = 2000, ROLLERS = 4;
+    PublishedSnapshot<Work> work;
+    std::mutex guard;
+    std::condition_variable workChanged;
+    CHECK(work.Generation() == 0 && work.Get() && work.Get()->factory == nullptr);
+
+    std::atomic<bool> done { false };
+    std::vector<asizei> errors(ROLLERS), seenChanges(ROLLERS);
+    std::vector<aulong> rolled(ROLLERS);
+    std::vector<std::thread> rollers;
+    for(asizei loop = 0; loop < ROLLERS; loop++) {
+        rollers.push_back(std::thread([&, loop]() {
+            asizei seen = 0;
+            std::shared_ptr<Factory> mine;
+            while(!done.load(std::memory_order_acquire)) {
+                const asizei now = work.Generation();
+                if(now != seen) {
+                    const auto snap(work.Get());
+                    if(snap->stamp < now) errors[loop]++;
+                    for(auto el : snap->owners) errors[loop] += el != snap->stamp;
+                    if(snap->factory && snap->factory->stamp != snap->stamp) errors[loop]++;
+                    mine = snap->factory; // the previous one might go away right here, if we were the last using it
+                    seen = now;
+                    seenChanges[loop]++;
+                }
+                if(mine) {
+                    mine->nonce2++;
+                    rolled[loop]++;
+                }
+            }
+        }));
+    }
+
+    // This one has no work and sleeps until some is published, it must not miss any.
+    asizei woken = 0;
+    std::thread sleeper([&]() {
+        asizei seen = 0;
+        while(seen < PUBLISHES) {
+            std::unique_lock<std::mutex> lock(guard);
+            if(!workChanged.wait_for(lock, std::chrono::seconds(10), [&]() { return work.Generation() != seen; })) return;
+            seen = work.Generation();
+            woken++;
+        }
+    });
+
+    for(asizei loop = 0; loop < PUBLISHES; loop++) {
+        auto next(std::make_shared<Work>());
+        next->stamp = loop + 1;
+        next->owners.assign(1 + loop % 7, loop + 1);
+        next->factory = std::make_shared<Factory>(loop + 1);
+        work.Publish(std::move(next), guard);
+        workChanged.notify_all();
+        if(loop % 64 == 0) std::this_thread::yield();
+    }
+    sleeper.join();
+    CHECK(woken > 0 && woken <= PUBLISHES);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    done = true;
+    for(auto &el : rollers) el.join();
+
+    CHECK(work.Generation() == PUBLISHES);
+    CHECK(work.Get()->stamp == PUBLISHES);
+    for(asizei loop = 0; loop < ROLLERS; loop++) {
+        CHECK(errors[loop] == 0);
+        CHECK(seenChanges[loop] > 0);
+        CHECK(rolled[loop] > 0);
+    }
+    // Everything but the last published went away as soon as nobody used it anymore.
+    CHECK(liveFactories == 1);
+    return check::Report("publishedSnapshot");
+}
@@ -0,0 +1,207 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#include "check.h"
+#include "../M8M/QueueWatchdog.h"
+#include "../Common/DetachedThreads.h"
+#include <array>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/*! The watchdog against stub miners: each queue has a real thread "scanning" through a stub driver which can be told to hang the next
+scan of a device until released, as a driver stuck in a call does. The stub recovers queues as AbstractNonceFindersBuild::RecoverQueue
+does: the stuck thread is abandoned, its slot retired, a new thread started. Checks stall detection, the recovery limit, threads coming
+back from the driver and going away quietly, and the owner going away with a thread still stuck. */
+namespace {
+
+using namespace std::chrono;
+typedef steady_clock Clock;
+
+class Driver {
+public:
+    explicit Driver(asizei devices) : hangNext(devices, false) { }
+    //! A scan, 1ms. If the device is hanging, until released.
+    void Scan(asizei device) {
+        std::unique_lock<std::mutex> lock(guard);
+        if(!hangNext[device]) {
+            lock.unlock();
+            std::this_thread::sleep_for(milliseconds(1));
+            return;
+        }
+        hangNext[device] = false;
+        hung++;
+        const asizei mine = epoch;
+        released.wait(lock, [this, mine]() { return epoch != mine; });
+        hung--;
+    }
+    void Hang(asizei device) {
+        std::unique_lock<std::mutex> lock(guard);
+        hangNext[device] = true;
+    }
+    //! Lets go all the scans hanging now, later ones will hang until the next call.
+    void Release() {
+        std::unique_lock<std::mutex> lock(guard);
+        epoch++;
+        released.notify_all();
+    }
+    asizei Hung() {
+        std::unique_lock<std::mutex> lock(guard);
+        return hung;
+    }
+private:
+    std::mutex guard;
+    std::condition_variable released;
+    std::vector<bool> hangNext;
+    asizei hung = 0, epoch = 0;
+};
+
+class StubFinders {
+public:
+    enum Status { s_created, s_running, s_sleeping, s_failed };
+
+    struct Miner {
+        std::atomic<bool> exited { false }, abandoned { false };
+        bool stuck = false;
+        std::atomic<Clock::rep> lastScan { 0 };
+        std::atomic<auint> scans { 0 };
+        Status status = s_running;
+    };
+    std::vector<std::unique_ptr<Miner>> miners, retired;
+    asizei spawned = 0;
+    const detached::ExitCounter exits = detached::NewExitCounter();
+    std::atomic<bool> keepRunning { true };
+    asizei recoveries = 0; //!< RecoverQueue calls
+
+    StubFinders(Driver &driver, asizei queues) : driver(driver) {
+        for(asizei loop = 0; loop < queues; loop++) {
+            miners.push_back(std::make_unique<Miner>());
+            Spawn(loop);
+        }
+    }
+
+    std::array<asizei, 2> GetNumWorkQueues() const { return std::array<asizei, 2> { 0, miners.size() }; }
+    std::tuple<asizei, Status, std::vector<std::string>> GetTerminationReason(asizei queue) const {
+        return std::make_tuple(queue + 10, miners[queue]->status, std::vector<std::string>()); // device index is not the queue index
+    }
+    Clock::time_point GetLastScanTime(asizei queue) const { return Clock::time_point(Clock::duration(miners[queue]->lastScan.load())); }
+    void RecoverQueue(asizei queue) {
+        recoveries++;
+        miners[queue]->stuck = true;
+        miners[queue]->abandoned = true;
+        retired.push_back(std::move(miners[queue]));
+        miners[queue] = std::make_unique<Miner>();
+        Spawn(queue);
+    }
+
+private:
+    Driver &driver;
+    void Spawn(asizei queue) {
+        Miner &slot(*miners[queue]);
+        slot.lastScan = Clock::now().time_since_epoch().count(); // started waiting for a scan
+        std::thread([this, &slot, queue](detached::ExitCounter exits) {
+            detached::Leaving gone(slot.exited, exits);
+            while(keepRunning.load()) {
+                driver.Scan(queue);
+                if(slot.abandoned.load()) return; // somebody else owns the device now, leave without touching anything
+                slot.lastScan = Clock::now().time_since_epoch().count();
+                slot.scans++;
+            }
+        }, exits).detach();
+        spawned++;
+    }
+};
+
+//! Sleeps until the condition holds, 5 seconds at most.
+template<typename Cond>
+bool Wait(Cond cond) {
+    const auto limit(Clock::now() + seconds(5));
+    while(!cond() && Clock::now() < limit) std::this_thread::sleep_for(milliseconds(2));
+    return cond();
+}
+
+}
+
+
+int main(int argc, char **argv) {
+    WatchdogSettings settings;
+    settings.minimum = seconds(1);
+    settings.recoveries = 2;
+    auto expected = [](asizei device) { return microseconds(1000); }; // so the deadline is the minimum
+    std::vector<QueueStall> reports;
+    auto report = [&reports](const QueueStall &stall) { reports.push_back(stall); };
+    std::vector<auint> recovered;
+
+    Driver driver(2);
+    StubFinders finders(driver, 2);
+    CHECK(Wait([&]() { return finders.miners[0]->scans > 0 && finders.miners[1]->scans > 0; }));
+    WatchQueues(finders, recovered, settings, Clock::now(), expected, report);
+    CHECK(reports.empty() && recovered.size() == 2);
+
+    // Queue 1 stalls: only it is recovered, a new thread scans for it, the old one is left in the driver.
+    for(asizei round = 0; round < settings.recoveries; round++) {
+        driver.Hang(1);
+        CHECK(Wait([&]() { return driver.Hung() == round + 1; }));
+        StubFinders::Miner *stuck = finders.miners[1].get();
+        std::this_thread::sleep_for(settings.minimum + milliseconds(200));
+        WatchQueues(finders, recovered, settings, Clock::now(), expected, report);
+        CHECK(reports.size() == round + 1);
+        CHECK(reports.back().queue == 1 && reports.back().device == 11 && !reports.back().givingUp);
+        CHECK(reports.back().late >= settings.minimum && reports.back().expected == microseconds(1000));
+        CHECK(recovered[0] == 0 && recovered[1] == round + 1);
+        CHECK(finders.recoveries == round + 1);
+        CHECK(finders.retired.back().get() == stuck && stuck->stuck && stuck->abandoned);
+        CHECK(Wait([&]() { return finders.miners[1]->scans > 0; }));
+        WatchQueues(finders, recovered, settings, Clock::now(), expected, report);
+        CHECK(reports.size() == round + 1);
+    }
+
+    // Once more: it's given up on, told once, not recovered anymore.
+    driver.Hang(1);
+    CHECK(Wait([&]() { return driver.Hung() == 3; }));
+    StubFinders::Miner *givenUp = finders.miners[1].get();
+    std::this_thread::sleep_for(settings.minimum + milliseconds(200));
+    WatchQueues(finders, recovered, settings, Clock::now(), expected, report);
+    CHECK(reports.size() == 3 && reports.back().givingUp && reports.back().device == 11);
+    std::this_thread::sleep_for(milliseconds(200));
+    WatchQueues(finders, recovered, settings, Clock::now(), expected, report);
+    CHECK(reports.size() == 3);
+    CHECK(finders.recoveries == 2 && finders.spawned == 4);
+    CHECK(finders.miners[0]->scans > 0 && recovered[0] == 0); // queue 0 never noticed anything
+
+    // The driver comes back. The abandoned threads leave without touching their slots, the last one goes on as nothing happened.
+    std::vector<auint> before;
+    for(auto &el : finders.retired) before.push_back(el->scans);
+    const auint givenUpScans = givenUp->scans;
+    driver.Release();
+    CHECK(Wait([&]() { return finders.retired[0]->exited && finders.retired[1]->exited; }));
+    for(asizei loop = 0; loop < before.size(); loop++) CHECK(finders.retired[loop]->scans == before[loop]);
+    CHECK(Wait([&]() { return givenUp->scans > givenUpScans; }));
+
+    // Sleeping queues are not watched, whatever their last scan. First scan not known: firstScan is the deadline.
+    finders.miners[0]->status = StubFinders::s_sleeping;
+    WatchQueues(finders, recovered, settings, Clock::now() + hours(1), expected, report);
+    CHECK(reports.size() == 3);
+    finders.miners[0]->status = StubFinders::s_running;
+    auto unknown = [](asizei device) { return microseconds(0); };
+    WatchQueues(finders, recovered, settings, Clock::now() + settings.firstScan - seconds(1), unknown, report);
+    CHECK(reports.size() == 3);
+
+    // Going away with a thread stuck: the others are waited for, the stuck one is not, its slot is leaked.
+    driver.Hang(0);
+    CHECK(Wait([&]() { return driver.Hung() == 1; }));
+    std::this_thread::sleep_for(settings.minimum + milliseconds(200));
+    WatchQueues(finders, recovered, settings, Clock::now(), expected, report);
+    CHECK(reports.size() == 4 && reports.back().queue == 0 && !reports.back().givingUp);
+    finders.keepRunning = false;
+    const auto start(Clock::now());
+    const asizei leaked = detached::Dismiss(finders.miners, finders.retired, finders.spawned, finders.exits, milliseconds(5000));
+    CHECK(Clock::now() - start < seconds(2));
+    CHECK(leaked == 1);
+    CHECK(finders.exits->load() == finders.spawned - 1);
+    driver.Release(); // it comes back to an abandoned slot and leaves
+    CHECK(Wait([&]() { return finders.exits->load() == finders.spawned; }));
+    return check::Report("queueWatchdog");
+}
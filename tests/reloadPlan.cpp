@@ -0,0 +1,246 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#include "check.h"
+#include "../Common/AREN/ArenDataTypes.h"
+#include "../M8M/ReloadPlan.h"
+
+/*! What a configuration reload decides to keep, rebuild, start and stop. Then a whole reload goes through two versions of a configuration file
+as M8MPoolConnectingApp and M8MMiningApp do: pools are parsed to PoolInfo, device settings are compared as they are in the documents.
+Last, what M8MMiningApp::Redeploy does with the plan, against a stub miner instead of OpenCL devices. */
+namespace {
+
+using namespace reload;
+const asizei fresh = asizei(-1);
+
+PoolInfo Pool(const char *name, const char *url, const char *user = "worker") {
+    PoolInfo ret(name, url, user, "x");
+    ret.algo = "qubit";
+    return ret;
+}
+
+std::vector<const PoolInfo*> Pointers(const std::vector<PoolInfo> &pools) {
+    std::vector<const PoolInfo*> ret;
+    for(const auto &el : pools) ret.push_back(&el);
+    return ret;
+}
+
+/*! Stands for M8MMiningApp with its groups of queues, see reload::Redeploy. It only keeps track of what it's asked to do.
+Queues are never taken away from a group, as in AbstractNonceFindersBuild. */
+struct StubBackend {
+    struct Queue {
+        bool running = true;
+        auint threads = 1; //!< replacing the thread counts one more
+        const rapidjson::Value *settings = nullptr;
+    };
+    struct Group {
+        std::string algo;
+        std::vector<Queue> queues;
+    };
+    std::vector<Group> groups;
+    std::vector<std::string> calls;
+    bool failing = false; //!< as building programs or buffers going wrong
+
+    struct Device {
+        asizei group = asizei(-1), queue = asizei(-1);
+    };
+
+    void StopQueue(Device &dev) {
+        calls.push_back("stop " + groups[dev.group].algo + '.' + std::to_string(dev.queue));
+        groups[dev.group].queues[dev.queue].running = false;
+    }
+    std::string GenQueue(Device &dev, const rapidjson::Value &settings) {
+        if(failing) throw std::string("clCreateBuffer failed");
+        auto &queues(groups[dev.group].queues);
+        if(dev.queue == asizei(-1)) {
+            dev.queue = queues.size();
+            queues.push_back(Queue());
+        }
+        else queues[dev.queue].threads++;
+        queues[dev.queue].running = true;
+        queues[dev.queue].settings = &settings;
+        calls.push_back("gen " + groups[dev.group].algo + '.' + std::to_string(dev.queue));
+        return std::string();
+    }
+    const std::string& GetAlgo(asizei group) const { return groups[group].algo; }
+};
+
+
+//! Values of the same document kind can be compared across documents, that's what lets the old config go away.
+void Parse(rapidjson::Document &dst, const char *json) {
+    dst.Parse(json);
+    CHECK(!dst.HasParseError());
+}
+
+}
+
+
+int main(int argc, char **argv) {
+    {
+        // Nothing changed, nothing to do. Order is priority: moving a pool does not rebuild it.
+        const std::vector<PoolInfo> was { Pool("a", "stratum+tcp://a.pool:3333"), Pool("b", "stratum+tcp://b.pool:3333") };
+        const std::vector<PoolInfo> now { Pool("b", "stratum+tcp://b.pool:3333"), Pool("a", "stratum+tcp://a.pool:3333") };
+        auto same(PlanPools(Pointers(was), Pointers(was)));
+        CHECK((same.reuse == std::vector<asizei> { 0, 1 }) && same.dropped.empty());
+        auto swapped(PlanPools(Pointers(was), Pointers(now)));
+        CHECK((swapped.reuse == std::vector<asizei> { 1, 0 }) && swapped.dropped.empty());
+    }
+    {
+        // Any field changing rebuilds that pool only. The old one is dropped, even if the name is still there.
+        const std::vector<PoolInfo> was { Pool("a", "stratum+tcp://a.pool:3333"), Pool("b", "stratum+tcp://b.pool:3333"), Pool("c", "stratum+tcp://c.pool:3333") };
+        std::vector<PoolInfo> now(was);
+        now[0].pass = "y";
+        now[2].targetSharesPerMinute = 6.0;
+        auto plan(PlanPools(Pointers(was), Pointers(now)));
+        CHECK((plan.reuse == std::vector<asizei> { fresh, 1, fresh }));
+        CHECK((plan.dropped == std::vector<asizei> { 0, 2 }));
+        for(auto change : { &PoolInfo::host, &PoolInfo::explicitPort, &PoolInfo::user, &PoolInfo::algo, &PoolInfo::service }) {
+            std::vector<PoolInfo> edit(was);
+            edit[1].*change += "2";
+            CHECK((PlanPools(Pointers(was), Pointers(edit)).reuse == std::vector<asizei> { 0, fresh, 2 }));
+        }
+        std::vector<PoolInfo> diff(was);
+        diff[1].diffMul.stratum = 65536.0;
+        CHECK((PlanPools(Pointers(was), Pointers(diff)).reuse == std::vector<asizei> { 0, fresh, 2 }));
+    }
+    {
+        // Added and removed.
+        const std::vector<PoolInfo> was { Pool("a", "stratum+tcp://a.pool:3333"), Pool("b", "stratum+tcp://b.pool:3333") };
+        const std::vector<PoolInfo> now { Pool("c", "stratum+tcp://c.pool:3333"), Pool("b", "stratum+tcp://b.pool:3333") };
+        auto plan(PlanPools(Pointers(was), Pointers(now)));
+        CHECK((plan.reuse == std::vector<asizei> { fresh, 1 }));
+        CHECK((plan.dropped == std::vector<asizei> { 0 }));
+        auto empty(PlanPools(Pointers(was), std::vector<const PoolInfo*>()));
+        CHECK(empty.reuse.empty() && (empty.dropped == std::vector<asizei> { 0, 1 }));
+        auto first(PlanPools(std::vector<const PoolInfo*>(), Pointers(now)));
+        CHECK((first.reuse == std::vector<asizei> { fresh, fresh }) && first.dropped.empty());
+    }
+    {
+        // Names are unique in valid configurations but an old pool must never be reused twice anyway.
+        const std::vector<PoolInfo> was { Pool("a", "stratum+tcp://a.pool:3333") };
+        const std::vector<PoolInfo> now { Pool("a", "stratum+tcp://a.pool:3333"), Pool("a", "stratum+tcp://a.pool:3333") };
+        auto plan(PlanPools(Pointers(was), Pointers(now)));
+        CHECK((plan.reuse == std::vector<asizei> { 0, fresh }) && plan.dropped.empty());
+    }
+    {
+        rapidjson::Document one;
+        Parse(one, R"({ "linearIntensity": 64, "dispatchCount": 2 })");
+        rapidjson::Document reordered;
+        Parse(reordered, R"({ "dispatchCount": 2, "linearIntensity": 64 })");
+        rapidjson::Document changed;
+        Parse(changed, R"({ "linearIntensity": 128, "dispatchCount": 2 })");
+        rapidjson::Document more;
+        Parse(more, R"({ "linearIntensity": 64, "dispatchCount": 2, "cpu": [ 0, 1 ] })");
+        CHECK(PlanDevice(nullptr, nullptr) == dc_idle);
+        CHECK(PlanDevice(nullptr, &one) == dc_start);
+        CHECK(PlanDevice(&one, nullptr) == dc_stop);
+        CHECK(PlanDevice(&one, &one) == dc_keep);
+        CHECK(PlanDevice(&one, &reordered) == dc_keep);
+        CHECK(PlanDevice(&one, &changed) == dc_rebuild);
+        CHECK(PlanDevice(&one, &more) == dc_rebuild);
+        CHECK(PlanDevice(&more, &one) == dc_rebuild);
+    }
+    {
+        // A whole reload: one pool's password changes, one device gets new settings, one is removed and another added.
+        rapidjson::Document before;
+        Parse(before, R"({
+            "pools": [ { "name": "main", "url": "stratum+tcp://main.pool:3333", "user": "me", "pass": "x" },
+                       { "name": "backup", "url": "stratum+tcp://backup.pool:3333", "user": "me", "pass": "x" } ],
+            "devices": [ { "linearIntensity": 64 }, { "linearIntensity": 64 }, { "linearIntensity": 32 }, null ]
+        })");
+        rapidjson::Document after;
+        Parse(after, R"({
+            "pools": [ { "name": "main", "url": "stratum+tcp://main.pool:3333", "user": "me", "pass": "x" },
+                       { "name": "backup", "url": "stratum+tcp://backup.pool:3333", "user": "me", "pass": "secret" } ],
+            "devices": [ { "linearIntensity": 64 }, { "linearIntensity": 128 }, null, { "linearIntensity": 32 } ]
+        })");
+        auto pools = [](const rapidjson::Document &config) {
+            std::vector<PoolInfo> ret;
+            for(auto el = config["pools"].Begin(); el != config["pools"].End(); ++el) {
+                ret.push_back(Pool((*el)["name"].GetString(), (*el)["url"].GetString(), (*el)["user"].GetString()));
+                ret.back().pass = (*el)["pass"].GetString();
+            }
+            return ret;
+        };
+        const auto was(pools(before)), now(pools(after));
+        auto poolPlan(PlanPools(Pointers(was), Pointers(now)));
+        CHECK((poolPlan.reuse == std::vector<asizei> { 0, fresh }));
+        CHECK((poolPlan.dropped == std::vector<asizei> { 1 }));
+        std::vector<DeviceChange> devices;
+        for(rapidjson::SizeType loop = 0; loop < before["devices"].Size(); loop++) {
+            const rapidjson::Value &old(before["devices"][loop]), &current(after["devices"][loop]);
+            devices.push_back(PlanDevice(old.IsNull()? nullptr : &old, current.IsNull()? nullptr : &current));
+        }
+        CHECK((devices == std::vector<DeviceChange> { dc_keep, dc_rebuild, dc_stop, dc_start }));
+    }
+    {
+        // Only changes to the miner as a whole rebuild it as a whole. Algorithms are matched ignoring case, as groups are.
+        const std::vector<std::string> algos { "qubit", "neoScrypt" };
+        CHECK(RebuildEverything(true, algos, algos, true, true).empty());
+        CHECK(RebuildEverything(true, algos, { "QUBIT", "neoscrypt" }, true, true).empty());
+        CHECK(RebuildEverything(false, algos, algos, true, true) == "nothing was mining");
+        CHECK(RebuildEverything(true, algos, { "neoScrypt", "qubit" }, true, true) == "algorithms changed to neoScrypt qubit");
+        CHECK(RebuildEverything(true, algos, { "qubit" }, true, true) == "algorithms changed to qubit");
+        CHECK(RebuildEverything(true, algos, algos, false, true) == "threadPlacement changed");
+        CHECK(RebuildEverything(true, algos, algos, true, false) == "isolateDevices changed");
+    }
+    {
+        // Redeploy against a stub miner, two reloads in a row. Settings for the same algorithm compare equal across documents.
+        StubBackend backend;
+        backend.groups.resize(2);
+        backend.groups[0].algo = "qubit";
+        backend.groups[1].algo = "neoScrypt";
+        rapidjson::Document first;
+        Parse(first, R"([ { "linearIntensity": 64 }, { "linearIntensity": 64 }, { "linearIntensity": 32 }, null, { "linearIntensity": 8 } ])");
+        std::vector<StubBackend::Device> devices(5);
+        const std::vector<asizei> firstGroups { 0, 0, 0, fresh, 1 };
+        std::vector<std::string> report;
+        auto redeploy = [&](const rapidjson::Value *was, const rapidjson::Document &now, const std::vector<asizei> &group) {
+            report.clear();
+            backend.calls.clear();
+            for(rapidjson::SizeType loop = 0; loop < now.Size(); loop++) {
+                const rapidjson::Value *before = was && !(*was)[loop].IsNull()? &(*was)[loop] : nullptr;
+                const rapidjson::Value *after = now[loop].IsNull()? nullptr : &now[loop];
+                const auto line(Redeploy(backend, devices[loop], "device " + std::to_string(loop), before, after, group[loop]));
+                if(line.size()) report.push_back(line);
+            }
+        };
+        redeploy(nullptr, first, firstGroups);
+        CHECK((report == std::vector<std::string> { "device 0 started", "device 1 started", "device 2 started", "device 4 started" }));
+        CHECK(backend.groups[0].queues.size() == 3 && backend.groups[1].queues.size() == 1);
+
+        // Device 0 stays, 1 gets new settings, 2 stops, 3 starts, 4 moves to qubit with the same settings it had.
+        rapidjson::Document second;
+        Parse(second, R"([ { "linearIntensity": 64 }, { "linearIntensity": 128 }, null, { "linearIntensity": 32 }, { "linearIntensity": 8 } ])");
+        redeploy(&first, second, { 0, 0, fresh, 1, 0 });
+        CHECK((report == std::vector<std::string> {
+            "device 0 kept", "device 1 rebuilt", "device 2 stopped", "device 3 started", "device 4 started, now mining qubit"
+        }));
+        CHECK((backend.calls == std::vector<std::string> { "gen qubit.1", "stop qubit.2", "gen neoScrypt.1", "stop neoScrypt.0", "gen qubit.3" }));
+        const auto &qubit(backend.groups[0].queues), &neo(backend.groups[1].queues);
+        CHECK(qubit[0].running && qubit[0].threads == 1 && qubit[0].settings == &first[rapidjson::SizeType(0)]); // kept means untouched, old settings and all
+        CHECK(qubit[1].running && qubit[1].threads == 2 && qubit[1].settings == &second[rapidjson::SizeType(1)]);
+        CHECK(!qubit[2].running);
+        CHECK(qubit.size() == 4 && qubit[3].running && qubit[3].settings == &second[rapidjson::SizeType(4)]);
+        CHECK(neo.size() == 2 && !neo[0].running && neo[1].running);
+        CHECK(devices[4].group == 0 && devices[4].queue == 3);
+        CHECK(devices[2].group == 0 && devices[2].queue == 2); // its queue is still there, starting it again reuses it
+
+        // The backend failing halfway is for the caller to handle, M8M restarts everything then. What was done stays done.
+        rapidjson::Document third;
+        Parse(third, R"([ { "linearIntensity": 64 }, { "linearIntensity": 128 }, { "linearIntensity": 16 }, { "linearIntensity": 32 }, { "linearIntensity": 8 } ])");
+        backend.failing = true;
+        bool thrown = false;
+        try {
+            redeploy(&second, third, { 0, 0, 0, 1, 0 });
+        } catch(const std::string &what) {
+            thrown = what == "clCreateBuffer failed";
+        }
+        CHECK(thrown && (report == std::vector<std::string> { "device 0 kept", "device 1 kept" }));
+        backend.failing = false;
+        redeploy(&second, third, { 0, 0, 0, 1, 0 });
+        CHECK(report[2] == "device 2 rebuilt" && backend.groups[0].queues[2].running && backend.groups[0].queues[2].threads == 2);
+    }
+    return check::Report("reloadPlan");
+}
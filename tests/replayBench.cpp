@@ -0,0 +1,135 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#include "scriptedPool.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+/*! Benchmark: a recorded stratum stream (streams/notifyBurst.stratum or the file given) replayed through a WorkSource, received in
+chunks of various sizes, everything included: receive, line splitting, JSON parsing, job building.
+Then the splitting alone, parsing left out, as the receive buffer does it now (a window, memchr resuming where it stopped, a memmove
+when the tail is full) and as it did before: growing 2 KiB at a time, searching for newlines from the start at every receive and moving
+the leftover bytes down one at a time after each pass. Small chunks and the 40 KiB line in there are where the old one hurts. */
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+std::string Load(const char *file) {
+    std::ifstream in(file, std::ios::binary);
+    std::stringstream all;
+    all<<in.rdbuf();
+    return all.str();
+}
+
+//! \returns seconds to replay the stream the given number of times.
+double Replay(const std::string &stream, asizei chunk, asizei times) {
+    scripted::Pool pool;
+    pool.Connect();
+    pool.Handshake("s1", "01020304", "j0");
+    const auto start(Clock::now());
+    for(asizei loop = 0; loop < times; loop++) {
+        for(asizei off = 0; off < stream.length(); off += chunk) {
+            pool.socket.inbound.append(stream, off, chunk);
+            while(pool.socket.inbound.size()) pool.Tick();
+        }
+    }
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+//! AbstractWorkSource::RecvBuffer and the line loop in Refresh, lines are only counted.
+double NewSplitting(const std::string &stream, asizei chunk, asizei times, asizei &lines) {
+    std::vector<char> data(16 * 1024);
+    asizei begin = 0, scanned = 0, used = 0;
+    lines = 0;
+    const auto start(Clock::now());
+    for(asizei loop = 0; loop < times; loop++) {
+        for(asizei off = 0; off < stream.length(); ) {
+            if(used == data.size()) { // MakeRoom
+                if(begin) {
+                    memmove(data.data(), data.data() + begin, used - begin);
+                    scanned -= begin;
+                    used -= begin;
+                    begin = 0;
+                }
+                else data.resize(data.size() * 2);
+            }
+            const asizei take = std::min(std::min(chunk, stream.length() - off), data.size() - used);
+            memcpy(data.data() + used, stream.data() + off, take);
+            off += take;
+            used += take;
+            char *const base = data.data(), *const end = base + used;
+            char *pos = base + scanned, *lineStart = base + begin;
+            while(pos < end) {
+                char *limit = static_cast<char*>(memchr(pos, '\n', end - pos));
+                if(!limit) break;
+                lines++;
+                pos = lineStart = limit + 1;
+            }
+            scanned = used;
+            begin = lineStart - base; // Consumed
+            if(begin == used) begin = scanned = used = 0;
+        }
+    }
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+//! The old RecvBuffer and line loop, with the parsing left out: lines are only counted.
+double OldSplitting(const std::string &stream, asizei chunk, asizei times, asizei &lines) {
+    std::vector<char> data(4096);
+    asizei used = 0;
+    lines = 0;
+    const auto start(Clock::now());
+    for(asizei loop = 0; loop < times; loop++) {
+        for(asizei off = 0; off < stream.length(); ) {
+            const asizei take = std::min(std::min(chunk, stream.length() - off), data.size() - used);
+            memcpy(data.data() + used, stream.data() + off, take);
+            off += take;
+            used += take;
+            if(used == data.size()) data.resize(data.size() + 2048);
+            char *pos = data.data(), *lastEndl = nullptr, *end = data.data() + used;
+            while(pos < end) {
+                char *limit = std::find(pos, end, '\n');
+                if(limit >= end) pos = limit;
+                else {
+                    lines++;
+                    pos = limit;
+                    lastEndl = pos++;
+                }
+            }
+            if(lastEndl) {
+                const char *src = lastEndl + 1;
+                char *dst = data.data();
+                for(; src < end; src++, dst++) *dst = *src;
+                used = src - (lastEndl + 1);
+            }
+        }
+    }
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+}
+
+
+int main(int argc, char **argv) {
+    const std::string stream(Load(argc > 1? argv[1] : "streams/notifyBurst.stratum"));
+    if(stream.empty()) {
+        std::cout<<"replayBench: no stream to replay"<<std::endl;
+        return 1;
+    }
+    const asizei lines = std::count(stream.begin(), stream.end(), '\n');
+    const asizei TIMES = 100;
+    const double mib = double(stream.size()) * TIMES / (1024 * 1024);
+    std::cout<<"replayBench, "<<stream.size()<<" bytes, "<<lines<<" lines, replayed "<<TIMES<<" times"<<std::endl;
+    for(asizei chunk : { asizei(100), asizei(1460), asizei(16 * 1024), asizei(64 * 1024) }) {
+        const double took = Replay(stream, chunk, TIMES);
+        asizei counted, oldCounted;
+        const double now = NewSplitting(stream, chunk, TIMES, counted), old = OldSplitting(stream, chunk, TIMES, oldCounted);
+        std::cout<<"  "<<chunk<<" byte chunks: "<<mib / took<<" MiB/s, "<<lines * TIMES / took<<" lines/s; splitting alone "
+                 <<mib / now<<" MiB/s, before "<<mib / old<<" MiB/s"<<(counted == lines * TIMES && oldCounted == counted? "" : " (miscounted!)")<<std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,93 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#include "../Common/Network.h"
+#include "../Common/MPSCQueue.h"
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*! Benchmark: latency from a result being found to its share being sent, as M8M.cpp runs the main loop.
+A synthetic producer stands for the mining threads: it pushes found time points in a MPSCQueue as ThreadedNonceFinders::Found does,
+at random intervals. The main thread sleeps on an EpollNetwork for the 200ms tick, drains the queue and sends a line for each to a
+loopback connection. Measured from the push to the send returning. Done twice:
+- the producer calling Wake after pushing, as the miners do through onResultsFound;
+- no Wake, results wait for the tick as they used to. */
+namespace {
+
+using namespace std::chrono;
+typedef steady_clock Clock;
+typedef NetworkInterface::SocketInterface Socket;
+
+const asizei TICK_MS = 200; //!< M8M.cpp tickTime
+
+struct Link {
+    EpollNetwork network;
+    NetworkInterface::ConnectedSocketInterface *client = nullptr, *server = nullptr;
+
+    Link() {
+        auto &listener(network.NewServiceSocket(0, 0));
+        listener.SetInterest(Socket::si_read);
+        const std::string port(std::to_string(listener.GetPort()));
+        auto connecting(network.BeginConnection("127.0.0.1", port.c_str()));
+        if(!connecting.first) throw std::runtime_error("could not connect to loopback");
+        client = connecting.first;
+        client->SetInterest(Socket::si_write);
+        while(!listener.Readable()) network.SleepOn(100);
+        server = &network.BeginConnection(listener);
+        while(!client->Writable()) network.SleepOn(100);
+        network.CloseServiceSocket(listener);
+        client->SetInterest(Socket::si_none);
+        server->SetInterest(Socket::si_read); // drained as lines come in, readiness wakes us as well but nothing waits for it
+    }
+};
+
+//! \returns found-to-send latencies, microseconds, sorted.
+std::vector<double> Run(asizei count, microseconds maxInterval, bool wake) {
+    Link link;
+    MPSCQueue<Clock::time_point> results;
+    std::thread producer([&]() {
+        std::mt19937 gen(2016);
+        std::uniform_int_distribution<int> interval(0, int(maxInterval.count()));
+        for(asizei loop = 0; loop < count; loop++) {
+            std::this_thread::sleep_for(microseconds(interval(gen)));
+            results.Push(Clock::now());
+            if(wake) link.network.Wake();
+        }
+    });
+    const std::string share("{\"id\": \"1234\", \"method\": \"mining.submit\", \"params\": [\"worker\", \"4f2a\", \"00000000\", \"504e86ed\", \"00000000\"]}\n");
+    std::vector<double> latency;
+    latency.reserve(count);
+    std::vector<abyte> sink(64 * 1024);
+    while(latency.size() < count) {
+        link.network.SleepOn(TICK_MS);
+        Clock::time_point found;
+        while(results.Pop(found)) {
+            link.client->Send(reinterpret_cast<const abyte*>(share.c_str()), share.length());
+            latency.push_back(duration_cast<duration<double, std::micro>>(Clock::now() - found).count());
+        }
+        while(link.server->Readable() && link.server->Receive(sink.data(), sink.size()) == sink.size()) { }
+    }
+    producer.join();
+    std::sort(latency.begin(), latency.end());
+    return latency;
+}
+
+void Print(const char *what, const std::vector<double> &sorted) {
+    auto at = [&sorted](double fraction) { return sorted[std::min(sorted.size() - 1, asizei(fraction * sorted.size()))]; };
+    std::cout<<"  "<<what<<sorted.size()<<" results, p50 "<<at(.5)<<", p90 "<<at(.9)<<", p99 "<<at(.99)<<", max "<<sorted.back()<<std::endl;
+}
+
+}
+
+
+int main(int argc, char **argv) {
+    std::cout<<"resultWake, found to send latency with a "<<TICK_MS<<"ms tick, microseconds"<<std::endl;
+    Print("woken:     ", Run(2000, microseconds(2000), true));
+    Print("tick only: ", Run(25, microseconds(150000), false));
+    return 0;
+}
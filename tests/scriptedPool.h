@@ -0,0 +1,123 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+#include "../Common/WorkSource.h"
+#include <string>
+#include <vector>
+
+/*! A WorkSource talking to a pool which is really a test: what the pool says is put in the socket by hand, what we send piles up there.
+Nothing leaves the process and nothing happens unless Tick is called so everything is deterministic.
+Tests including this link ../Common/WorkSource.cpp, AbstractWorkSource.cpp, StratumState.cpp, BTC/Funcs.cpp and Network.cpp. */
+namespace scripted {
+
+class Socket : public NetworkInterface::ConnectedSocketInterface {
+public:
+    std::string inbound; //!< what the pool sent and we didn't receive yet
+    std::string outbound; //!< everything we sent
+    asizei writeLimit = ~asizei(0); //!< the OS takes at most this many bytes each call, to force short writes
+    asizei sendCalls = 0;
+    bool broken = false;
+
+    asizei Send(const abyte *octects, asizei count) throw() {
+        Chunk one { octects, count };
+        return SendGather(&one, 1);
+    }
+    asizei SendGather(const Chunk *chunks, asizei count) throw() {
+        if(broken) return 0;
+        sendCalls++;
+        asizei took = 0;
+        for(asizei loop = 0; loop < count && took < writeLimit; loop++) {
+            const asizei amount = std::min(chunks[loop].count, writeLimit - took);
+            outbound.append(chunks[loop].data, amount);
+            took += amount;
+        }
+        return took;
+    }
+    asizei Receive(abyte *octects, asizei buffSize) throw() {
+        if(broken) return 0;
+        const asizei amount = std::min(buffSize, asizei(inbound.length()));
+        memcpy(octects, inbound.data(), amount);
+        inbound.erase(0, amount);
+        return amount;
+    }
+    bool GotData() const { return !inbound.empty(); }
+    bool CanSend() const { return !broken; }
+    bool Works() const { return !broken; }
+    std::string PeerHost() const { return "scripted"; }
+    std::string PeerPort() const { return "3333"; }
+};
+
+
+//! The messages we sent, split in lines. \sa Socket::outbound
+inline std::vector<std::string> Lines(const std::string &outbound) {
+    std::vector<std::string> ret;
+    for(asizei begin = 0, end; (end = outbound.find('\n', begin)) != std::string::npos; begin = end + 1) ret.push_back(outbound.substr(begin, end - begin));
+    return ret;
+}
+
+//! Our ids are always quoted naturals so there's no need for a parser.
+inline asizei IdOf(const std::string &line) {
+    const asizei start = line.find("\"id\": \"");
+    return start == std::string::npos? 0 : asizei(strtoul(line.c_str() + start + 7, NULL, 10));
+}
+
+inline bool Is(const std::string &line, const char *method) { return line.find(std::string("\"method\": \"") + method + '"') != std::string::npos; }
+
+//! Id of the first message we sent for method, 0 if none.
+inline asizei Find(const std::string &outbound, const char *method) {
+    for(const auto &line : Lines(outbound)) {
+        if(Is(line, method)) return IdOf(line);
+    }
+    return 0;
+}
+
+inline std::string Notify(const std::string &job, bool clean, const char *ntime = "504e86ed") {
+    return "{\"id\":null,\"method\":\"mining.notify\",\"params\":[\"" + job + "\",\"0123456789abcdef0123456789abcdef00112233445566778899aabbccddeeff\","
+           "\"01000000010000\",\"ffffffff0100\",[],\"00000002\",\"1b0404cb\",\"" + ntime + "\"," + (clean? "true" : "false") + "]}";
+}
+
+
+class Pool {
+public:
+    Socket socket;
+    WorkSource source;
+
+    Pool() : source("scripted", CanonicalInfo(), Diff(), PoolInfo::mm_SHA256D) {
+        source.AddCredentials("worker", "x");
+    }
+    void Connect() {
+        socket = Socket();
+        source.Use(&socket);
+    }
+    //! The connection went down, see M8MPoolConnectingApp::Goodbye.
+    void Drop() {
+        socket.broken = true;
+        source.Disconnected();
+    }
+    void Say(const std::string &line) { socket.inbound += line + '\n'; }
+    AbstractWorkSource::Events Tick() { return source.Refresh(true, true); }
+
+    /*! Sends what's queued, then does what a pool does: replies to subscribe and authorize, sends difficulty and a first job.
+    \param extraNonceOne same as the previous connection to resume the session. */
+    void Handshake(const char *session, const char *extraNonceOne, const std::string &job, bool clean = true) {
+        Tick();
+        Say("{\"id\":\"" + std::to_string(Find(socket.outbound, "mining.subscribe")) + "\",\"result\":[[\"mining.notify\",\"" + session + "\"],\"" +
+            extraNonceOne + "\",4],\"error\":null}");
+        Say("{\"id\":\"" + std::to_string(Find(socket.outbound, "mining.authorize")) + "\",\"result\":true,\"error\":null}");
+        Say("{\"id\":null,\"method\":\"mining.set_difficulty\",\"params\":[1]}");
+        Say(Notify(job, clean));
+        Tick();
+    }
+
+private:
+    static std::pair<PoolInfo::DiffMode, PoolInfo::DiffMultipliers>& Diff() {
+        static std::pair<PoolInfo::DiffMode, PoolInfo::DiffMultipliers> ret;
+        ret.first = PoolInfo::dm_btc;
+        ret.second.stratum = ret.second.one = ret.second.share = 1.0;
+        return ret;
+    }
+};
+
+}
@@ -0,0 +1,73 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#include "check.h"
+#include "scriptedPool.h"
+
+/*! Block shares go ahead of ordinary shares not sent yet but never ahead of control messages, nor in the middle of a message
+already partially written. See StratumState::SendWork. */
+namespace {
+
+//! What kind of message each line is: 'c' for control, 's' for shares, 'b' for the block shares. Those have nonce2 = 1.
+std::string Kinds(const std::string &outbound) {
+    std::string ret;
+    for(const auto &line : scripted::Lines(outbound)) {
+        if(!scripted::Is(line, "mining.submit")) ret += 'c';
+        else ret += line.find("\"00000001\"") != std::string::npos? 'b' : 's';
+    }
+    return ret;
+}
+
+}
+
+
+int main(int argc, char **argv) {
+    scripted::Pool pool;
+    pool.Connect();
+    pool.Handshake("s1", "01020304", "j1");
+    const auint ntime = pool.source.IsCurrentJob("j1");
+    CHECK(ntime != 0);
+    pool.socket.outbound.clear();
+
+    // The socket takes nothing for a while: everything piles up in the queue.
+    pool.socket.writeLimit = 0;
+    pool.source.SuggestDifficulty(8);
+    pool.source.SendShare("j1", ntime, 0, 1);
+    pool.source.SendShare("j1", ntime, 0, 2);
+    pool.source.SendShare("j1", ntime, 1, 3, true);
+    pool.socket.writeLimit = ~asizei(0);
+    const asizei before = pool.socket.sendCalls;
+    CHECK(pool.source.Flush());
+    CHECK(Kinds(pool.socket.outbound) == "cbss");
+    CHECK(pool.socket.sendCalls == before + 1); // all in a single call
+    CHECK(pool.source.GetSendLatency(StratumState::sl_block).count == 1);
+    CHECK(pool.source.GetSendLatency(StratumState::sl_share).count == 2);
+
+    // A share half written must be completed first, the next one is overtaken.
+    pool.socket.outbound.clear();
+    pool.socket.writeLimit = 20;
+    pool.source.SendShare("j1", ntime, 0, 4);
+    pool.source.SendShare("j1", ntime, 0, 5);
+    CHECK(pool.source.Flush());
+    pool.socket.writeLimit = 0;
+    pool.source.SendShare("j1", ntime, 1, 6, true);
+    pool.source.SendShare("j1", ntime, 1, 7, true);
+    pool.socket.writeLimit = ~asizei(0);
+    CHECK(pool.source.Flush());
+    CHECK(Kinds(pool.socket.outbound) == "sbbs");
+    const auto lines(scripted::Lines(pool.socket.outbound));
+    if(lines.size() == 4) { // block shares keep their order between them
+        CHECK(lines[1].find("\"06000000\"") != std::string::npos);
+        CHECK(lines[2].find("\"07000000\"") != std::string::npos);
+    }
+    CHECK(!pool.source.NeedsToSend());
+
+    // Nothing queued, Flush doesn't even call the OS. A dead socket makes it fail.
+    const asizei calls = pool.socket.sendCalls;
+    CHECK(pool.source.Flush() && pool.socket.sendCalls == calls);
+    pool.socket.broken = true;
+    pool.source.SendShare("j1", ntime, 1, 8, true);
+    CHECK(!pool.source.Flush());
+    return check::Report("sendLanes");
+}
@@ -0,0 +1,133 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#include "check.h"
+#include "scriptedPool.h"
+#include "../M8M/ShareJournal.h"
+#include <map>
+
+/*! A pool going down while shares are in flight and coming back resuming the session. The bookkeeping is the one
+M8MPoolConnectingApp does in Goodbye, SendResults and ReplayJournal, the pool is a real WorkSource over a scripted socket. */
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct Share {
+    std::string job;
+    auint nonce;
+    Clock::time_point found;
+};
+
+//! What's in the mining.submit lines we sent, in order.
+std::vector<std::string> Submitted(const std::string &outbound) {
+    std::vector<std::string> ret;
+    for(const auto &line : scripted::Lines(outbound)) {
+        if(scripted::Is(line, "mining.submit")) ret.push_back(line);
+    }
+    return ret;
+}
+
+bool Carries(const std::string &line, auint nonce) {
+    // Nonces go in memory order, see StratumState::SendWork.
+    char hex[9];
+    sprintf(hex, "%02x%02x%02x%02x", nonce & 0xFF, (nonce >> 8) & 0xFF, (nonce >> 16) & 0xFF, nonce >> 24);
+    return line.find(std::string("\"") + hex + '"') != std::string::npos;
+}
+
+}
+
+
+int main(int argc, char **argv) {
+    const auto t0(Clock::now());
+    scripted::Pool pool;
+    pool.Connect();
+    pool.Handshake("s1", "01020304", "j1");
+    CHECK(pool.source.Notified() && pool.source.IsCurrentJob("j1"));
+
+    std::map<asizei, Share> sentShares; // M8MPoolConnectingApp::sentShares
+    auto send = [&pool, &sentShares](const Share &share) {
+        const asizei index = pool.source.SendShare(share.job, pool.source.IsCurrentJob(share.job), 0, share.nonce);
+        sentShares[index] = share;
+        return index;
+    };
+    const Share a { "j1", 0xA0A0A0A0, t0 }, b { "j1", 0xB0B0B0B0, t0 + std::chrono::milliseconds(1) };
+    const Share c { "j1", 0xC0C0C0C0, t0 + std::chrono::milliseconds(2) };
+    const asizei idA = send(a);
+    pool.Tick(); // a is written, the server has it
+    pool.socket.writeLimit = 10;
+    const asizei idB = send(b);
+    const asizei idC = send(c);
+    pool.Tick(); // b is only partially written, c not at all
+    CHECK(pool.source.Written(idA));
+    CHECK(!pool.source.Written(idB));
+    CHECK(!pool.source.Written(idC));
+
+    // Down it goes, no reply came for any of those. Goodbye:
+    ShareJournal<Share> journal;
+    const asizei capacity = 64;
+    for(const auto &el : sentShares) journal.Unanswered(el.second, pool.source.Written(el.first), capacity);
+    sentShares.clear();
+    journal.Open(0, Clock::now());
+    pool.Drop();
+    CHECK(journal.open && journal.shares.size() == 2 && journal.unanswered == 1);
+
+    // Found while reconnecting. SendResults journals those still on a job valid when the connection went down.
+    const Share d { "j1", 0xD0D0D0D0, t0 + std::chrono::milliseconds(3) };
+    CHECK(pool.source.WasCurrentJob(d.job) != 0);
+    journal.Add(d, false, capacity);
+
+    // Back, same extranonce1. The pool still has j1 but also moved on, a share for some other job is dropped.
+    pool.Connect();
+    CHECK(scripted::Lines(pool.socket.outbound).empty());
+    pool.Tick();
+    CHECK(pool.socket.outbound.find("[\"M8M\", \"s1\"]") != std::string::npos); // asking to resume
+    pool.Handshake("s1", "01020304", "j1", false);
+    pool.Say(scripted::Notify("j2", false));
+    pool.Tick();
+    CHECK(pool.source.GetSessionResume() == AbstractWorkSource::sr_resumed);
+    journal.Add(Share { "gone", 0xE0E0E0E0, t0 + std::chrono::milliseconds(4) }, false, capacity);
+    pool.socket.outbound.clear();
+
+    // ReplayJournal:
+    auto result(journal.Replay([&pool, &send](const Share &share) {
+        if(!pool.source.IsCurrentJob(share.job)) return false;
+        send(share);
+        return true;
+    }));
+    pool.Tick();
+    CHECK(result.replayed == 3 && result.dropped == 1 && result.unanswered == 1);
+    CHECK(result.fresh == 1); // b and c went through AddSent already when they were first queued
+    CHECK(!journal.open && journal.shares.empty() && journal.unanswered == 0);
+    const auto submitted(Submitted(pool.socket.outbound));
+    CHECK(submitted.size() == 3);
+    if(submitted.size() == 3) {
+        CHECK(Carries(submitted[0], b.nonce) && Carries(submitted[1], c.nonce) && Carries(submitted[2], d.nonce));
+    }
+    for(const auto &line : submitted) CHECK(!Carries(line, a.nonce));
+
+    {
+        // Full journals drop the oldest, old shares go as well, all of them counted as dropped.
+        ShareJournal<Share> small;
+        small.Open(0, t0);
+        for(auint loop = 0; loop < 5; loop++) small.Add(Share { "j", loop, t0 + std::chrono::seconds(loop) }, false, 3);
+        CHECK(small.shares.size() == 3 && small.shares.front().share.nonce == 2 && small.evicted == 2);
+        small.Expire(t0 + std::chrono::seconds(13), std::chrono::seconds(10));
+        CHECK(small.shares.size() == 2 && small.evicted == 3);
+        const auto dropped(small.Drop());
+        CHECK(dropped.replayed == 0 && dropped.fresh == 0 && dropped.dropped == 5);
+    }
+    {
+        // Block shares skip the queue so the ones waiting come by index out of the order they were found. Open sorts them,
+        // leaving alone what was already there.
+        ShareJournal<Share> order;
+        order.Add(Share { "j", 9, t0 + std::chrono::seconds(9) }, false, 8);
+        order.Unanswered(Share { "j", 2, t0 + std::chrono::seconds(2) }, false, 8);
+        order.Unanswered(Share { "j", 1, t0 + std::chrono::seconds(1) }, false, 8);
+        order.Unanswered(Share { "j", 0, t0 }, true, 8);
+        order.Open(1, t0);
+        CHECK(order.shares.size() == 3 && order.unanswered == 1);
+        if(order.shares.size() == 3) CHECK(order.shares[0].share.nonce == 9 && order.shares[1].share.nonce == 1 && order.shares[2].share.nonce == 2);
+    }
+    return check::Report("shareJournal");
+}
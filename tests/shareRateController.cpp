@@ -0,0 +1,109 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#include "check.h"
+#include "../M8M/ShareRateController.h"
+#include <cmath>
+
+/*! ShareRateController is pure arithmetic over time points so it's all driven with a fake clock: shares are "found" at
+regular intervals starting from base, which is not the epoch as the controller uses a default time point as "never". */
+namespace {
+
+typedef ShareRateController::Clock Clock;
+using std::chrono::seconds;
+using std::chrono::minutes;
+
+const Clock::time_point base = Clock::time_point() + std::chrono::hours(1);
+
+//! One share of difficulty diff every second for count seconds, the first at from + 1s. \returns the time of the last one.
+Clock::time_point Feed(ShareRateController &ctrl, Clock::time_point from, asizei count, double diff) {
+    for(asizei loop = 1; loop <= count; loop++) ctrl.Found(diff, from + seconds(loop));
+    return from + seconds(count);
+}
+
+bool Near(double value, double expected, double tolerance = .02) {
+    return std::fabs(value - expected) <= std::fabs(expected) * tolerance;
+}
+
+}
+
+int main(int argc, char **argv) {
+    {
+        ShareRateController ctrl;
+        ShareRateController::Pool pool;
+        CHECK(ctrl.GetDiffRate(base) == .0);
+        CHECK(ctrl.Suggest(pool, 6.0, 1.0, 1.0, base) == .0);
+        CHECK(pool.suggested == .0);
+    }
+    {
+        // Plenty of shares but measured for less than the warmup: not trusted yet.
+        ShareRateController ctrl;
+        const auto last = Feed(ctrl, base, 30, 1.0);
+        CHECK(ctrl.GetDiffRate(last) == .0);
+        CHECK(ctrl.GetDiffRate(base + seconds(1) + ctrl.warmup) > .0);
+    }
+    {
+        // Long enough but too few shares.
+        ShareRateController ctrl;
+        ctrl.Found(100.0, base);
+        ctrl.Found(100.0, base + seconds(30));
+        CHECK(ctrl.GetDiffRate(base + minutes(2)) == .0);
+    }
+    {
+        // Before the window is full the rate is measured from the first share, after it's the window.
+        ShareRateController ctrl;
+        const auto warm = Feed(ctrl, base, 120, 2.0);
+        CHECK(Near(ctrl.GetDiffRate(warm), 2.0 * 120 / 119));
+        const auto full = Feed(ctrl, warm, 600, 2.0);
+        CHECK(Near(ctrl.GetDiffRate(full), 2.0));
+        // Shares older than the window are forgotten, going idle eventually means no data.
+        CHECK(Near(ctrl.GetDiffRate(full + minutes(4)), 2.0 * 60 / 300, .05));
+        CHECK(ctrl.GetDiffRate(full + ctrl.window + seconds(1)) == .0);
+    }
+    {
+        // 1 diff/s wanting 6 shares per minute means difficulty 10. stratumMul converts to pool units.
+        ShareRateController ctrl;
+        ShareRateController::Pool pool, scaled;
+        const auto now = Feed(ctrl, base, 300, 1.0);
+        const double first = ctrl.Suggest(pool, 6.0, 1.0, 1.0, now);
+        CHECK(Near(first, 10.0));
+        CHECK(pool.suggested == first && pool.when == now);
+        CHECK(Near(ctrl.Suggest(scaled, 6.0, 65536.0, 1.0 / 65536.0, now), 10.0 / 65536.0));
+
+        // Rate limited per pool.
+        CHECK(ctrl.Suggest(pool, 1.0, 1.0, 1.0, now + ctrl.minInterval - seconds(1)) == .0);
+        CHECK(pool.suggested == first);
+
+        // Same rate later on: what we suggested last time is still good, nothing to do.
+        const auto later = Feed(ctrl, now, 120, 1.0);
+        CHECK(ctrl.Suggest(pool, 6.0, 1.0, 1.0, later) == .0);
+
+        // Going slower: wanting 1 share per minute at 1 diff/s is difficulty 60, way above what we suggested.
+        CHECK(Near(ctrl.Suggest(pool, 1.0, 1.0, first, later), 60.0));
+    }
+    {
+        // Hysteresis is relative to the pool difficulty when nothing has been suggested yet. Ideal is 10 there.
+        ShareRateController ctrl;
+        const auto now = Feed(ctrl, base, 300, 1.0);
+        ShareRateController::Pool close, below, above, tooHigh;
+        CHECK(ctrl.Suggest(close, 6.0, 1.0, 8.0, now) == .0);
+        CHECK(ctrl.Suggest(close, 6.0, 1.0, 14.0, now) == .0);
+        CHECK(close.suggested == .0 && close.when == Clock::time_point());
+        CHECK(Near(ctrl.Suggest(below, 6.0, 1.0, 6.0, now), 10.0));
+        CHECK(Near(ctrl.Suggest(tooHigh, 6.0, 1.0, 16.0, now), 10.0)); // lowering works too
+        CHECK(Near(ctrl.Suggest(above, 6.0, 1.0, 1000.0, now), 10.0));
+    }
+    {
+        // Nonsense in, nothing out.
+        ShareRateController ctrl;
+        ShareRateController::Pool pool;
+        const auto now = Feed(ctrl, base, 300, 1.0);
+        CHECK(ctrl.Suggest(pool, .0, 1.0, 1.0, now) == .0);
+        CHECK(ctrl.Suggest(pool, 6.0, .0, 1.0, now) == .0);
+        CHECK(ctrl.Suggest(pool, 6.0, 1.0, .0, now) == .0);
+        CHECK(ctrl.Suggest(pool, -6.0, 1.0, 1.0, now) == .0);
+        CHECK(pool.suggested == .0);
+    }
+    return check::Report("shareRateController");
+}
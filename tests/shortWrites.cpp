@@ -0,0 +1,182 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#include "check.h"
+#include "scriptedPool.h"
+#include "../Common/Linux/EpollNetwork.h"
+#include <chrono>
+
+/*! Short writes while the send queue is gathered, see AbstractWorkSource::SendChunk. First on a scripted socket which takes so many bytes
+each call: cuts land in the middle of messages and across them, what goes out must be the same as without cuts, each send call must be one
+syscall for as many messages as fit. Then for real: a WorkSource over a loopback socket whose peer doesn't read until the kernel buffers
+are full, which is the only way to get a real short write. Syscalls are counted by a socket wrapper. */
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+const asizei MAX_GATHER = 16; //!< as in SendChunk
+
+//! Puts count shares in the queue without sending anything.
+void Queue(scripted::Pool &pool, asizei count) {
+    const auint ntime = pool.source.IsCurrentJob("j1");
+    const asizei limit = pool.socket.writeLimit;
+    pool.socket.writeLimit = 0;
+    for(asizei loop = 0; loop < count; loop++) pool.source.SendShare("j1", ntime, 0, auint(loop * 0x01010101));
+    pool.socket.writeLimit = limit;
+}
+
+//! Forwards everything to the real socket, counting send calls and those which did not take everything.
+class Counting : public NetworkInterface::ConnectedSocketInterface {
+public:
+    NetworkInterface::ConnectedSocketInterface &real;
+    asizei calls = 0, shortWrites = 0;
+    explicit Counting(NetworkInterface::ConnectedSocketInterface &real) : real(real) { }
+    asizei Send(const abyte *octects, asizei count) throw() {
+        Chunk one { octects, count };
+        return SendGather(&one, 1);
+    }
+    asizei SendGather(const Chunk *chunks, asizei count) throw() {
+        asizei offered = 0;
+        for(asizei loop = 0; loop < count; loop++) offered += chunks[loop].count;
+        const asizei took = real.SendGather(chunks, count);
+        calls++;
+        if(took < offered) shortWrites++;
+        return took;
+    }
+    asizei Receive(abyte *octects, asizei buffSize) throw() { return real.Receive(octects, buffSize); }
+    bool GotData() const { return real.GotData(); }
+    bool CanSend() const { return real.CanSend(); }
+    bool Works() const { return real.Works(); }
+    std::string PeerHost() const { return real.PeerHost(); }
+    std::string PeerPort() const { return real.PeerPort(); }
+};
+
+template<typename Done>
+bool Pump(EpollNetwork &network, Done done) {
+    const auto deadline = Clock::now() + std::chrono::seconds(10);
+    while(!done()) {
+        if(Clock::now() > deadline) return false;
+        network.SleepOn(100);
+    }
+    return true;
+}
+
+//! Everything available now, appended.
+void Drain(NetworkInterface::ConnectedSocketInterface &socket, std::string &got) {
+    char buffer[64 * 1024];
+    while(true) {
+        const asizei count = socket.Receive(buffer, sizeof(buffer));
+        got.append(buffer, count);
+        if(count < sizeof(buffer)) break;
+    }
+}
+
+}
+
+
+int main(int argc, char **argv) {
+    const asizei SHARES = 40;
+    std::string reference; // what goes out when the socket takes everything
+    {
+        scripted::Pool pool;
+        pool.Connect();
+        pool.Handshake("s1", "01020304", "j1");
+        pool.socket.outbound.clear();
+        Queue(pool, SHARES);
+        const asizei before = pool.socket.sendCalls;
+        CHECK(pool.source.Flush() && !pool.source.NeedsToSend());
+        CHECK(pool.socket.sendCalls - before == (SHARES + MAX_GATHER - 1) / MAX_GATHER);
+        reference = pool.socket.outbound;
+        CHECK(scripted::Lines(reference).size() == SHARES);
+    }
+    // Shares are about 130 bytes: 1 and 7 cut in the middle of messages, 200 and 333 cut the second or third message in a call.
+    for(asizei limit : { asizei(1), asizei(7), asizei(130), asizei(200), asizei(333), asizei(4000) }) {
+        scripted::Pool pool;
+        pool.Connect();
+        pool.Handshake("s1", "01020304", "j1");
+        pool.socket.outbound.clear();
+        Queue(pool, SHARES);
+        pool.socket.writeLimit = limit;
+        asizei flushes = 0;
+        const asizei before = pool.socket.sendCalls;
+        while(pool.source.NeedsToSend() && flushes < reference.size() + 1) {
+            CHECK(pool.source.Flush());
+            flushes++;
+        }
+        CHECK(pool.socket.outbound == reference);
+        const asizei calls = pool.socket.sendCalls - before;
+        if(limit * MAX_GATHER < reference.size() / SHARES * MAX_GATHER) {
+            // Every call is short so it's the last of its Flush, each takes exactly limit bytes but possibly the last one.
+            CHECK(calls == flushes);
+            CHECK(calls == (reference.size() + limit - 1) / limit);
+        }
+        else CHECK(calls >= (SHARES + MAX_GATHER - 1) / MAX_GATHER && calls <= (reference.size() + limit - 1) / limit + flushes);
+    }
+
+    // The real thing over loopback.
+    EpollNetwork network;
+    auto &listener(network.NewServiceSocket(0, 0));
+    listener.SetInterest(NetworkInterface::SocketInterface::si_read);
+    const std::string port(std::to_string(listener.GetPort()));
+    auto connecting(network.BeginConnection("127.0.0.1", port.c_str()));
+    CHECK(connecting.first != nullptr);
+    if(!connecting.first) return check::Report("shortWrites");
+    auto &client(*connecting.first);
+    client.SetInterest(NetworkInterface::SocketInterface::si_write);
+    CHECK(Pump(network, [&]() { return listener.Readable(); }));
+    auto &server(network.BeginConnection(listener));
+    CHECK(Pump(network, [&]() { return client.Writable(); }));
+
+    Counting counted(client);
+    std::pair<PoolInfo::DiffMode, PoolInfo::DiffMultipliers> diff;
+    diff.first = PoolInfo::dm_btc;
+    diff.second.stratum = diff.second.one = diff.second.share = 1.0;
+    WorkSource source("loopback", CanonicalInfo(), diff, PoolInfo::mm_SHA256D);
+    source.AddCredentials("worker", "x");
+    source.Use(&counted);
+    std::string got;
+    client.SetInterest(NetworkInterface::SocketInterface::si_read | NetworkInterface::SocketInterface::si_write);
+    server.SetInterest(NetworkInterface::SocketInterface::si_read);
+    CHECK(Pump(network, [&]() {
+        source.Refresh(client.Readable(), client.Writable());
+        if(server.Readable()) Drain(server, got);
+        return scripted::Find(got, "mining.authorize") != 0;
+    }));
+    auto say = [&server](const std::string &line) { return server.Send(line.c_str(), line.length()) == line.length(); };
+    CHECK(say("{\"id\":\"" + std::to_string(scripted::Find(got, "mining.subscribe")) + "\",\"result\":[[\"mining.notify\",\"s1\"],\"01020304\",4],\"error\":null}\n"));
+    CHECK(say("{\"id\":\"" + std::to_string(scripted::Find(got, "mining.authorize")) + "\",\"result\":true,\"error\":null}\n"));
+    CHECK(say("{\"id\":null,\"method\":\"mining.set_difficulty\",\"params\":[1]}\n"));
+    CHECK(say(scripted::Notify("j1", true) + '\n'));
+    CHECK(Pump(network, [&]() {
+        source.Refresh(client.Readable(), client.Writable());
+        return source.IsCurrentJob("j1") != 0;
+    }));
+    got.clear();
+
+    // 100000 shares are over 10 megabytes, way more than the loopback buffers. Nobody reads until the kernel takes no more.
+    const asizei MANY = 100000;
+    const auint ntime = source.IsCurrentJob("j1");
+    const asizei start = counted.calls;
+    for(asizei loop = 0; loop < MANY; loop++) source.SendShare("j1", ntime, 0, auint(loop));
+    while(counted.shortWrites == 0 && source.NeedsToSend()) CHECK(source.Flush());
+    CHECK(counted.shortWrites > 0 && source.NeedsToSend());
+    client.SetInterest(NetworkInterface::SocketInterface::si_write);
+    CHECK(Pump(network, [&]() {
+        if(client.Writable() && source.NeedsToSend()) CHECK(source.Flush());
+        if(server.Readable()) Drain(server, got);
+        return !source.NeedsToSend() && scripted::Lines(got).size() == MANY;
+    }));
+    const auto lines(scripted::Lines(got));
+    CHECK(lines.size() == MANY && got.back() == '\n');
+    asizei ordered = 0;
+    for(asizei loop = 1; loop < lines.size(); loop++) {
+        if(scripted::IdOf(lines[loop]) == scripted::IdOf(lines[loop - 1]) + 1 && lines[loop].front() == '{' && lines[loop].back() == '}') ordered++;
+    }
+    CHECK(ordered == MANY - 1);
+    // Gathering 16 at a time, a short write ends a Flush. Many more calls than that means messages went out one by one.
+    const asizei calls = counted.calls - start;
+    CHECK(calls <= MANY / MAX_GATHER + counted.shortWrites + 1);
+    network.CloseConnection(server);
+    network.CloseConnection(client);
+    return check::Report("shortWrites");
+}
@@ -0,0 +1,87 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#include "check.h"
+#include "scriptedPool.h"
+#include <fstream>
+#include <sstream>
+
+/*! A recorded stratum stream replayed from a file through the receive buffer, chopped in all sorts of ways: a byte at a time, less than
+a line, the usual TCP segment, more than the whole buffer. Whatever the chopping the same lines must come out. The stream is a burst of
+60 notifies with a dozen merkles each, clean every ten, and a difficulty change in the middle. Job r30 carries 600 merkles, about 40 KiB,
+more than the whole buffer, so it has to grow. The file to replay can be given on the command line, the default is the one in streams/. */
+namespace {
+
+std::string Load(const char *file) {
+    std::ifstream in(file, std::ios::binary);
+    std::stringstream all;
+    all<<in.rdbuf();
+    return all.str();
+}
+
+struct Replayed {
+    asizei bytes = 0, newWork = 0, diffChanged = 0, ticks = 0;
+    double diff = 0;
+    std::vector<std::string> validJobs;
+};
+
+//! The stream goes to the pool chunk bytes at a time, each chunk ticked until it's all received.
+Replayed Replay(const std::string &stream, asizei chunk) {
+    scripted::Pool pool;
+    pool.Connect();
+    pool.Handshake("s1", "01020304", "j0");
+    Replayed ret;
+    for(asizei off = 0; off < stream.length(); off += chunk) {
+        pool.socket.inbound.append(stream, off, chunk);
+        while(pool.socket.inbound.size()) {
+            const auto events(pool.Tick());
+            ret.bytes += events.bytesReceived;
+            ret.newWork += events.newWork? 1 : 0;
+            ret.diffChanged += events.diffChanged? 1 : 0;
+            ret.ticks++;
+        }
+    }
+    ret.diff = pool.source.GetCurrentDiff().shareDiff;
+    for(auint loop = 0; loop < 60; loop++) {
+        char job[8];
+        snprintf(job, sizeof(job), "r%02u", loop);
+        if(pool.source.IsCurrentJob(job)) ret.validJobs.push_back(job);
+    }
+    return ret;
+}
+
+}
+
+
+int main(int argc, char **argv) {
+    const std::string stream(Load(argc > 1? argv[1] : "streams/notifyBurst.stratum"));
+    CHECK(stream.size() > 100 * 1024 && stream.back() == '\n');
+    if(stream.empty()) return check::Report("streamReplay");
+    asizei shortest = stream.size(), lines = 0;
+    for(asizei begin = 0, end; (end = stream.find('\n', begin)) != std::string::npos; begin = end + 1) {
+        shortest = std::min(shortest, end - begin + 1);
+        lines++;
+    }
+    CHECK(lines == 62);
+
+    const Replayed whole(Replay(stream, stream.size()));
+    CHECK(whole.bytes == stream.size());
+    CHECK(whole.ticks > 1); // it does not fit in a single receive
+    // The last clean job is r50, the ring keeps the last 8.
+    const std::vector<std::string> valid { "r52", "r53", "r54", "r55", "r56", "r57", "r58", "r59" };
+    CHECK(whole.validJobs == valid);
+    CHECK(whole.diff > 0);
+
+    for(asizei chunk : { asizei(1), asizei(7), asizei(100), asizei(1460), asizei(4096), asizei(16 * 1024), asizei(16 * 1024 + 1), asizei(50000) }) {
+        const Replayed got(Replay(stream, chunk));
+        CHECK(got.bytes == stream.size());
+        CHECK(got.validJobs == valid);
+        CHECK(got.diff == whole.diff);
+        if(chunk < shortest) { // at most a line completes each tick so each notify and difficulty change is seen on its own
+            CHECK(got.newWork == 60);
+            CHECK(got.diffChanged == 2);
+        }
+    }
+    return check::Report("streamReplay");
+}
@@ -0,0 +1,39 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+#include <sstream>
+#include <string>
+#include <stdio.h>
+
+/*! mining.submit formatted the way StratumState did before rendering it from a template: the params array put together with strings,
+then KeyValue through a stringstream and PushMethod. Hex goes through printf here so it doesn't share anything with the code tested. */
+namespace submit {
+
+inline std::string Reference(asizei id, const std::string &worker, const std::string &job, auint nonce2, auint ntime, auint nonce) {
+    const char *sep = "\", \"";
+    char hexNonce2[9], hexTime[9], hexNonce[9];
+    snprintf(hexNonce2, sizeof(hexNonce2), "%08x", nonce2);
+    snprintf(hexTime, sizeof(hexTime), "%08x", ntime);
+    snprintf(hexNonce, sizeof(hexNonce), "%02x%02x%02x%02x", nonce & 0xFF, (nonce >> 8) & 0xFF, (nonce >> 16) & 0xFF, nonce >> 24); // memory order
+    std::string message("[\"");
+    message += worker + sep + job + sep;
+    message += hexNonce2;
+    message += sep;
+    message += hexTime;
+    message += sep;
+    message += hexNonce;
+    message += "\"]";
+    std::stringstream pairs; // KeyValue("params", message, false)
+    pairs<<'"'<<"params"<<'"'<<": "<<message;
+    std::string line("{");
+    line += "\"id\": \"" + std::to_string(id) + "\", ";
+    line += "\"method\": \"";
+    line += "mining.submit";
+    line += "\", ";
+    line += pairs.str() + "}\n";
+    return line;
+}
+
+}
@@ -0,0 +1,70 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#include "scriptedPool.h"
+#include "submitReference.h"
+#include <chrono>
+#include <random>
+
+/*! Benchmark: a burst of shares, as a fast algorithm on a low difficulty pool gives. Shares go out 64 at a time and the pool replies
+to each one. Prints nanoseconds per share for
+- the stringstream formatting mining.submit used to go through, formatting only;
+- SendShare, which renders from the template and does the bookkeeping (pending request, submitted work);
+- the whole thing: SendShare, Flush to the socket and parsing the reply. */
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double Nanoseconds(Clock::duration elapsed, asizei count) {
+    return std::chrono::duration_cast<std::chrono::duration<double, std::nano>>(elapsed).count() / count;
+}
+
+}
+
+
+int main(int argc, char **argv) {
+    const asizei SHARES = 200000, BURST = 64;
+    std::mt19937 gen(2016);
+    std::vector<auint> values(SHARES * 3);
+    for(auto &el : values) el = auint(gen());
+
+    scripted::Pool pool;
+    pool.Connect();
+    pool.Handshake("s1", "01020304", "4f2a");
+    const auint ntime = pool.source.IsCurrentJob("4f2a");
+
+    asizei bytes = 0;
+    auto start(Clock::now());
+    for(asizei loop = 0; loop < SHARES; loop++) {
+        std::string line(submit::Reference(loop + 1, "worker", "4f2a", values[loop * 3], ntime, values[loop * 3 + 2]));
+        std::vector<__int8> blob(line.cbegin(), line.cend()); // StratumState::Blob copied it
+        bytes += blob.size();
+    }
+    const double formatting = Nanoseconds(Clock::now() - start, SHARES);
+
+    asizei sent = 0;
+    Clock::duration sending(0), total(0);
+    std::vector<asizei> ids(BURST);
+    std::string replies;
+    for(asizei loop = 0; loop < SHARES; loop += BURST) {
+        const auto burst(Clock::now());
+        for(asizei cp = 0; cp < BURST; cp++) ids[cp] = pool.source.SendShare("4f2a", ntime, values[(loop + cp) * 3], values[(loop + cp) * 3 + 2]);
+        sending += Clock::now() - burst;
+        pool.source.Flush();
+        const auto flushed(Clock::now());
+        sent += pool.socket.outbound.length();
+        pool.socket.outbound.clear();
+        replies.clear();
+        for(auto id : ids) replies += "{\"id\":\"" + std::to_string(id) + "\",\"result\":true,\"error\":null}\n";
+        const auto reply(Clock::now());
+        pool.socket.inbound += replies;
+        pool.Tick();
+        total += Clock::now() - reply + (flushed - burst);
+    }
+    std::cout<<"submitStorm, "<<SHARES<<" shares in bursts of "<<BURST<<", ns/share ("<<bytes<<" bytes formatted, "<<sent<<" sent)"<<std::endl;
+    std::cout<<"  stringstream formatting: "<<formatting<<std::endl;
+    std::cout<<"  SendShare:               "<<Nanoseconds(sending, SHARES)<<std::endl;
+    std::cout<<"  send, flush, reply:      "<<Nanoseconds(total, SHARES)<<std::endl;
+    return 0;
+}
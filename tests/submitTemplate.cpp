@@ -0,0 +1,48 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#include "check.h"
+#include "scriptedPool.h"
+#include "submitReference.h"
+#include <random>
+
+/*! mining.submit is rendered from a template patched in place, see StratumState::SendWork. It must produce the very same bytes
+the stringstream formatting it replaced did, for every id length, job and value. */
+int main(int argc, char **argv) {
+    scripted::Pool pool;
+    pool.Connect();
+    pool.Handshake("s1", "01020304", "j1");
+    const std::vector<std::string> jobs { "j1", "j2", "4f2a", "a_much_longer_job_identifier_0123456789" };
+    for(asizei loop = 1; loop < jobs.size(); loop++) pool.Say(scripted::Notify(jobs[loop], false));
+    pool.Tick();
+    for(const auto &job : jobs) CHECK(pool.source.IsCurrentJob(job) != 0);
+
+    std::mt19937 gen(2016);
+    asizei mismatches = 0, checked = 0;
+    const asizei SHARES = 100000;
+    for(asizei loop = 0; loop < SHARES; loop++) {
+        // Switching job makes the template rebuild, but usually many shares go out on the same job.
+        const std::string &job(jobs[gen() % 16 == 0? gen() % jobs.size() : loop / 5000 % jobs.size()]);
+        // Extremes now and then, the hex encoding of those is where off-by-ones would show.
+        auint values[3];
+        for(auto &el : values) {
+            switch(gen() % 8) {
+            case 0: el = 0; break;
+            case 1: el = 0xFFFFFFFF; break;
+            default: el = auint(gen());
+            }
+        }
+        pool.socket.outbound.clear();
+        const asizei id = pool.source.SendShare(job, values[1], values[0], values[2]);
+        pool.source.Flush();
+        const std::string expected(submit::Reference(id, "worker", job, values[0], values[1], values[2]));
+        if(pool.socket.outbound != expected) {
+            if(mismatches++ < 4) std::cout<<"expected "<<expected<<"got      "<<pool.socket.outbound;
+        }
+        checked++;
+    }
+    CHECK(checked == SHARES);
+    CHECK(mismatches == 0);
+    return check::Report("submitTemplate");
+}
@@ -0,0 +1,123 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#include "check.h"
+#include "../Common/ThreadPlacement.h"
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/mempolicy.h>
+#include <thread>
+
+/*! CPU lists and the Linux affinity masks they turn into. The masks are read back with sched_getaffinity, not GetCurrentThreadCPUs,
+so it's not the code checking itself. Works on whatever CPUs the test is allowed to run on, even just one. */
+namespace {
+
+using namespace placement;
+
+CPUSet Parse(const std::string &list) {
+    std::string error;
+    CPUSet ret(ParseCPUList(list, error));
+    if(error.size()) ret.push_back(0xFFFFFFFF); // so errors don't look like an empty list
+    return ret;
+}
+
+//! Mask of the calling thread as the kernel has it.
+CPUSet KernelMask() {
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    CPUSet ret;
+    if(sched_getaffinity(0, sizeof(mask), &mask)) return ret;
+    for(auint cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if(CPU_ISSET(cpu, &mask)) ret.push_back(cpu);
+    }
+    return ret;
+}
+
+}
+
+
+int main(int argc, char **argv) {
+    CHECK(Parse("") == CPUSet());
+    CHECK(Parse("  ") == CPUSet());
+    CHECK(Parse("3") == CPUSet({ 3 }));
+    CHECK(Parse("0-3,8,10-11") == CPUSet({ 0, 1, 2, 3, 8, 10, 11 }));
+    CHECK(Parse(" 8 , 0 - 2 ,1") == CPUSet({ 0, 1, 2, 8 }));
+    CHECK(Parse("3-1").size() == 1 && Parse("3-1")[0] == 0xFFFFFFFF);
+    CHECK(Parse("0,").back() == 0xFFFFFFFF);
+    CHECK(Parse("a").back() == 0xFFFFFFFF);
+    CHECK(Parse("0;1").back() == 0xFFFFFFFF);
+    CHECK(Parse("70000").back() == 0xFFFFFFFF);
+    {
+        std::string error;
+        CHECK(ParseCPUList("1-2,x", error).empty() && error.size());
+    }
+    CHECK(DescribeCPUSet(CPUSet()) == "");
+    CHECK(DescribeCPUSet(CPUSet({ 0, 1, 2, 3, 8, 10, 11 })) == "0-3,8,10,11");
+    CHECK(DescribeCPUSet(CPUSet({ 5 })) == "5");
+    for(const char *list : { "0-3,8,10-11", "1,3,5-9", "0", "0-63" }) CHECK(Parse(DescribeCPUSet(Parse(list))) == Parse(list));
+
+    const CPUSet allowed(KernelMask());
+    CHECK(allowed.size() > 0);
+    CHECK(GetNumCPUs() >= 1 && GetNumCPUs() > allowed.back());
+    CHECK(GetCurrentThreadCPUs() == allowed);
+
+    // Nothing usable in there: refused, mask untouched.
+    CHECK(!SetCurrentThreadCPUs(CPUSet()));
+    CHECK(!SetCurrentThreadCPUs(CPUSet({ 60000 })));
+    CHECK(KernelMask() == allowed);
+
+    // A single CPU, then back. CPUs not in the system are dropped, the rest goes through.
+    CHECK(SetCurrentThreadCPUs(CPUSet({ allowed.front(), 60000 })));
+    CHECK(KernelMask() == CPUSet({ allowed.front() }));
+    CHECK(sched_getcpu() == int(allowed.front()));
+    CPUSet inherited;
+    std::thread child([&inherited]() { inherited = KernelMask(); });
+    child.join();
+    CHECK(inherited == CPUSet({ allowed.front() }));
+    if(allowed.size() > 1) {
+        CHECK(SetCurrentThreadCPUs(CPUSet({ allowed.back() })));
+        CHECK(KernelMask() == CPUSet({ allowed.back() }));
+    }
+    CHECK(SetCurrentThreadCPUs(allowed));
+    CHECK(KernelMask() == allowed);
+
+    // Nodes: all their CPUs exist, no CPU in two nodes.
+    const auint nodes = GetNumNUMANodes();
+    CHECK(nodes >= 1);
+    std::vector<auint> owners(GetNumCPUs());
+    for(auint node = 0; node < nodes; node++) {
+        for(auto cpu : GetNUMANodeCPUs(int(node))) {
+            CHECK(cpu < owners.size());
+            if(cpu < owners.size()) owners[cpu]++;
+        }
+    }
+    for(auto el : owners) CHECK(el <= 1);
+    CHECK(GetNUMANodeCPUs(-1).empty());
+    CHECK(GetNUMANodeCPUs(int(nodes) + 1000).empty());
+    CHECK(GetPCIDeviceNUMANode(0xFF, 0x1F, 7, 0xFFFF) == -1); // no such device
+
+    CHECK(!PreferNUMANode(-1));
+    CHECK(!PreferNUMANode(int(nodes)));
+    if(PreferNUMANode(0)) syscall(SYS_set_mempolicy, MPOL_DEFAULT, nullptr, 0); // allowed or not depends on the sandbox
+
+    // Thread CPU time: sleeping and other threads working don't count, spinning does.
+    {
+        using std::chrono::milliseconds;
+        const auto before(GetCurrentThreadCPUTime());
+        std::this_thread::sleep_for(milliseconds(50));
+        std::thread busy([]() {
+            const auto until(std::chrono::steady_clock::now() + milliseconds(50));
+            while(std::chrono::steady_clock::now() < until) { }
+        });
+        busy.join();
+        CHECK(GetCurrentThreadCPUTime() - before < milliseconds(10));
+        const auto spin(GetCurrentThreadCPUTime());
+        const auto until(std::chrono::steady_clock::now() + milliseconds(50));
+        while(std::chrono::steady_clock::now() < until) { }
+        const auto spent(GetCurrentThreadCPUTime() - spin);
+        CHECK(spent > milliseconds(10) && spent <= milliseconds(60));
+    }
+    return check::Report("threadPlacement");
+}
@@ -0,0 +1,148 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#include "../Common/Network.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+/*! Benchmark: cost of a main loop tick, SleepOn plus each component finding out what its sockets have to say and reading it.
+10 pools and a bunch of web monitor clients over loopback, the far ends in a second EpollNetwork nobody sleeps on. Each tick every
+pool sends a line and one monitor client in ten sends a small message.
+- readiness flags: as M8M does now, each component asks its own sockets Readable();
+- socket vectors: as it was before, emulated over the same SleepOn: every tick each component pushes its sockets in a list, what's
+  ready is collected in a vector and each component std::finds its sockets in there.
+Microseconds per tick. */
+namespace {
+
+typedef NetworkInterface::SocketInterface Socket;
+typedef NetworkInterface::ConnectedSocketInterface Connection;
+typedef std::chrono::steady_clock Clock;
+
+struct Setup {
+    EpollNetwork local, remote;
+    std::vector<Connection*> pools, monitors; //!< our ends
+    std::vector<Connection*> poolServers, browsers; //!< their ends
+
+    template<typename Done>
+    bool Pump(Done done) {
+        const auto limit(Clock::now() + std::chrono::seconds(10));
+        while(!done() && Clock::now() < limit) {
+            local.SleepOn(1);
+            remote.SleepOn(1);
+        }
+        return done();
+    }
+
+    //! A connection from network from to a listener in network to. \returns (from end, to end)
+    std::pair<Connection*, Connection*> Connect(EpollNetwork &from, EpollNetwork &to, NetworkInterface::ServiceSocketInterface &listener) {
+        const std::string port(std::to_string(listener.GetPort()));
+        auto begun(from.BeginConnection("127.0.0.1", port.c_str()));
+        if(!begun.first) return std::make_pair(nullptr, nullptr);
+        begun.first->SetInterest(Socket::si_write);
+        if(!Pump([&]() { return listener.Readable() && begun.first->Writable(); })) return std::make_pair(nullptr, nullptr);
+        begun.first->SetInterest(Socket::si_none);
+        return std::make_pair(begun.first, &to.BeginConnection(listener));
+    }
+
+    bool Build(asizei numPools, asizei numMonitors) {
+        auto &stratum(remote.NewServiceSocket(0, 0)), &web(local.NewServiceSocket(0, 0));
+        stratum.SetInterest(Socket::si_read);
+        web.SetInterest(Socket::si_read);
+        for(asizei loop = 0; loop < numPools; loop++) {
+            auto pair(Connect(local, remote, stratum));
+            if(!pair.first) return false;
+            pools.push_back(pair.first);
+            poolServers.push_back(pair.second);
+        }
+        for(asizei loop = 0; loop < numMonitors; loop++) {
+            auto pair(Connect(remote, local, web));
+            if(!pair.first) return false;
+            browsers.push_back(pair.first);
+            monitors.push_back(pair.second);
+        }
+        stratum.SetInterest(Socket::si_none);
+        web.SetInterest(Socket::si_none);
+        for(auto el : pools) el->SetInterest(Socket::si_read);
+        for(auto el : monitors) el->SetInterest(Socket::si_read);
+        return true;
+    }
+};
+
+asizei Drain(Connection &socket) {
+    char buffer[4096];
+    asizei total = 0;
+    while(true) {
+        const asizei count = socket.Receive(buffer, sizeof(buffer));
+        total += count;
+        if(count < sizeof(buffer)) break;
+    }
+    return total;
+}
+
+//! \returns microseconds of each tick, sorted.
+template<typename Dispatch>
+std::vector<double> Ticks(Setup &setup, asizei count, Dispatch &&dispatch) {
+    const std::string line(120, 'n'), message(40, 'm');
+    std::vector<double> took;
+    took.reserve(count);
+    asizei bytes = 0;
+    for(asizei tick = 0; tick < count; tick++) {
+        for(auto el : setup.poolServers) el->Send(line.data(), line.length());
+        for(asizei loop = tick % 10; loop < setup.browsers.size(); loop += 10) setup.browsers[loop]->Send(message.data(), message.length());
+        const auto start(Clock::now());
+        bytes += dispatch();
+        took.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+    }
+    std::sort(took.begin(), took.end());
+    const asizei expected = count * (setup.poolServers.size() * line.length()) + count / 10 * setup.browsers.size() * message.length();
+    if(bytes + 10 * setup.browsers.size() * message.length() < expected) std::cout<<"    (lost data: "<<bytes<<" of "<<expected<<")"<<std::endl;
+    return took;
+}
+
+void Print(const char *what, const std::vector<double> &sorted) {
+    double sum = 0;
+    for(auto el : sorted) sum += el;
+    std::cout<<"    "<<what<<"avg "<<sum / sorted.size()<<", p50 "<<sorted[sorted.size() / 2]<<", p99 "<<sorted[sorted.size() * 99 / 100]<<std::endl;
+}
+
+}
+
+
+int main(int argc, char **argv) {
+    const asizei POOLS = 10, TICKS = 4000;
+    std::cout<<"tickBench, "<<POOLS<<" pools, microseconds per tick"<<std::endl;
+    for(asizei monitors : { asizei(120), asizei(480) }) {
+        Setup setup;
+        if(!setup.Build(POOLS, monitors)) {
+            std::cout<<"  could not connect "<<monitors<<" monitors over loopback"<<std::endl;
+            return 1;
+        }
+        std::cout<<"  "<<monitors<<" monitor clients"<<std::endl;
+        auto flags = [&setup]() {
+            asizei got = 0;
+            setup.local.SleepOn(100);
+            for(auto el : setup.pools) if(el->Readable()) got += Drain(*el);
+            for(auto el : setup.monitors) if(el->Readable()) got += Drain(*el);
+            return got;
+        };
+        std::vector<Socket*> interested, readable;
+        auto vectors = [&]() {
+            asizei got = 0;
+            interested.clear();
+            for(auto el : setup.pools) interested.push_back(el);
+            for(auto el : setup.monitors) interested.push_back(el);
+            setup.local.SleepOn(100);
+            readable.clear();
+            for(auto el : interested) if(el->Readable()) readable.push_back(el);
+            for(auto el : setup.pools) if(std::find(readable.begin(), readable.end(), el) != readable.end()) got += Drain(*el);
+            for(auto el : setup.monitors) if(std::find(readable.begin(), readable.end(), el) != readable.end()) got += Drain(*el);
+            return got;
+        };
+        Print("readiness flags: ", Ticks(setup, TICKS, flags));
+        Print("socket vectors:  ", Ticks(setup, TICKS, vectors));
+    }
+    return 0;
+}
@@ -355,7 +355,8 @@ window.onload = function() {
             for(var check = 0; check < reply.selected.length; check++) {
                 for(var innerCheck = 0; innerCheck < reply.selected[check].active.length; innerCheck++) {
                     if(reply.selected[check].active[innerCheck].device === linearDeviceIndex) {
-                        return reply.selected[check].impl;
+                        var algo = reply.selected[check].algo;
+                        return (algo? algo + '.' : '') + reply.selected[check].impl; // more than one algorithm can be mined
                     }
                 }
             }
@@ -604,7 +605,8 @@ window.onload = function() {
 					}
 				}
 			}
-			if(arr[loop].algo.toUpperCase() === document.getElementById('algo').textContent.toUpperCase()) {
+			var mined = document.getElementById('algo').textContent.toUpperCase().split(', ');
+			if(mined.indexOf(arr[loop].algo.toUpperCase()) >= 0) {
 				tr.style.backgroundColor = FAINT_GREEN;
 				monitorState.configuredPools[loop] = {
                     activated: null,